@@ -0,0 +1,54 @@
+# -*- Autoconf -*-
+#
+# Copyright (c)      2026  Sandia Corporation
+#
+
+# QTHREAD_CHECK_SIMD_DISPATCH([action-if-found], [action-if-not-found])
+# ------------------------------------------------------------------------
+# Checks whether the compiler can build AVX2 and AVX-512 functions (through
+# per-function target attributes) into an otherwise generic library, and can
+# ask the CPU at runtime which of them it is able to run.
+AC_DEFUN([QTHREAD_CHECK_SIMD_DISPATCH],[
+AC_ARG_ENABLE([simd-dispatch],
+  [AS_HELP_STRING([--disable-simd-dispatch],
+                  [Do not build AVX2 and AVX-512 versions of the qutil
+                   reduction kernels (which are chosen at runtime,
+                   according to what the CPU supports)])])
+AS_IF([test "x$enable_simd_dispatch" != xno],
+  [AC_CACHE_CHECK([whether AVX2 and AVX-512 code can be chosen at runtime],
+    [qthread_cv_simd_dispatch],
+    [AC_LINK_IFELSE([AC_LANG_SOURCE([[
+#include <immintrin.h>
+__attribute__((target("avx2")))
+static void f2(double *a)
+{
+	__m256i i = _mm256_loadu_si256((const __m256i *)a);
+	i = _mm256_blendv_epi8(i, i, _mm256_cmpgt_epi64(i, i));
+	_mm256_storeu_si256((__m256i *)a, i);
+	_mm256_storeu_pd(a, _mm256_add_pd(_mm256_loadu_pd(a), _mm256_loadu_pd(a)));
+}
+__attribute__((target("avx512f")))
+static void f5(double *a)
+{
+	__m512i i = _mm512_loadu_si512(a);
+	i = _mm512_min_epu64(_mm512_mullox_epi64(i, i), i);
+	_mm512_storeu_si512(a, i);
+	_mm512_storeu_pd(a, _mm512_add_pd(_mm512_loadu_pd(a), _mm512_loadu_pd(a)));
+}
+int main(void)
+{
+	double a[8] = { 0 };
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) f5(a);
+	else if (__builtin_cpu_supports("avx2")) f2(a);
+	return (int)a[0];
+}]])],
+      [qthread_cv_simd_dispatch=yes],
+      [qthread_cv_simd_dispatch=no])])],
+  [qthread_cv_simd_dispatch=no])
+AS_IF([test "x$qthread_cv_simd_dispatch" = xyes],
+  [AC_DEFINE([QTHREAD_SIMD_DISPATCH], [1],
+             [Define to build AVX2 and AVX-512 qutil kernels, chosen at runtime])
+   $1],
+  [$2])
+])
@@ -89,6 +89,47 @@ void INTERNAL qt_affinity_set(qthread_worker_t * me,
 int qt_affinity_gendists(qthread_shepherd_t   *sheps,
                          qthread_shepherd_id_t nshepherds);
 
+/**
+ * qt_affinity_mem_toshep() - place memory near a shepherd
+ * @addr:  Page-aligned start of the region.
+ * @bytes: Length of the region.
+ * @shep:  The shepherd whose memory the region should come from.
+ *
+ * Bind a region that has not yet been touched to the memory node(s) local to
+ * the given shepherd, so that pages are placed there as they are faulted in.
+ * Physical layers that cannot place memory leave it to first touch.
+ */
+void INTERNAL qt_affinity_mem_toshep(void                 *addr,
+                                     size_t                bytes,
+                                     qthread_shepherd_id_t shep);
+
+/**
+ * qt_affinity_mem_move_toshep() - move memory to a shepherd
+ * @addr:  Page-aligned start of the region.
+ * @bytes: Length of the region.
+ * @shep:  The shepherd whose memory the region should come from.
+ *
+ * Like qt_affinity_mem_toshep(), but pages of the region that have already
+ * been touched are migrated to the new location too, where the physical
+ * layer can do that.
+ */
+void INTERNAL qt_affinity_mem_move_toshep(void                 *addr,
+                                          size_t                bytes,
+                                          qthread_shepherd_id_t shep);
+
+/**
+ * qt_affinity_mem_islocal() - check where a page actually lives
+ * @addr: An address inside a page that has already been touched.
+ * @shep: The shepherd to compare against.
+ *
+ * Returns 1 if the page holding @addr is on a memory node local to the given
+ * shepherd, 0 if it is on some other node, and -1 if the physical layer
+ * cannot tell. This is a system call (or worse); it is meant for reporting,
+ * not for fast paths.
+ */
+int INTERNAL qt_affinity_mem_islocal(const void           *addr,
+                                     qthread_shepherd_id_t shep);
+
 #ifdef QTHREAD_HAVE_MEM_AFFINITY
 void INTERNAL *qt_affinity_alloc(size_t bytes);
 void INTERNAL *qt_affinity_alloc_onnode(size_t bytes,
@@ -34,6 +34,7 @@ typedef struct qthread_addrres_s {
     aligned_t                *addr; /* ptr to the memory NOT being blocked on */
     qthread_t                *waiter;
     struct qthread_addrres_s *next;
+    struct qt_feb_timed_s    *timed; /* non-NULL if waiter gives up at some point */
 } qthread_addrres_t;
 
 typedef struct _qt_blocking_queue_node_s {
@@ -28,6 +28,8 @@ int API_FUNC qthread_readFF_nb(aligned_t *restrict const       dest,
 int API_FUNC qthread_readFE_nb(aligned_t *restrict const       dest,
                                const aligned_t *restrict const src);
 int INTERNAL qthread_check_feb_preconds(qthread_t *t);
+void INTERNAL qt_feb_wait_full(const aligned_t *addr,
+                               size_t           count);
 
 void API_FUNC qthread_feb_callback(qt_feb_callback_f cb,
                                    void             *arg);
@@ -12,6 +12,7 @@
 #include "qt_qthread_struct.h"
 #include "qt_qthread_mgmt.h"
 #include "qt_debug.h"
+#include "qt_park.h"
 
 #if defined(UNPOOLED)
 # define ALLOC_SYSCALLJOB() (qt_blocking_queue_node_t *)MALLOC(sizeof(qt_blocking_queue_node_t))
@@ -24,8 +25,55 @@
 extern qt_mpool syscall_job_pool;
 
 void            qt_blocking_subsystem_init(void);
-int             qt_process_blocking_call(void);
 void            qt_blocking_subsystem_enqueue(qt_blocking_queue_node_t *job);
+int             qt_blocking_subsystem_wait(int   fd,
+                                           short events);
+int             qt_blocking_subsystem_fdmode(int       fd,
+                                             syscall_t op);
+
+/* What qt_blocking_subsystem_fdmode() says a read or write of a descriptor
+ * should do */
+#define QT_IO_FD_PROXY  0 /* go to the ring or the proxies like any other call */
+#define QT_IO_FD_WAIT   1 /* a blocking socket: try it without blocking, and wait */
+#define QT_IO_FD_INLINE 2 /* the program made it non-blocking: just make the call */
+
+/* With io_uring or epoll, blocking calls are submitted to a ring or epoll set
+ * per shepherd, and the scheduler has to collect the results: poll() whenever
+ * a worker looks for work (idle says whether it has nothing else to do, and
+ * so can afford a system call), park() instead of sleeping on the worker's
+ * spot, and unpark() after claiming a spot to wake it. */
+#ifdef QTHREAD_USE_IO_URING
+int  qt_io_uring_init(void);
+int  qt_io_uring_submit(qt_blocking_queue_node_t *job);
+int  qt_io_uring_takes(syscall_t op);
+int  qt_io_uring_poll(qthread_shepherd_id_t shep);
+int  qt_io_uring_park(qthread_shepherd_id_t shep,
+                      qt_park_spot_t       *spot,
+                      unsigned long         usec);
+void qt_io_uring_unpark(qt_park_spot_t *spot);
+#endif
+#ifdef QTHREAD_USE_EPOLL
+int  qt_io_epoll_init(void);
+int  qt_io_epoll_submit(qt_blocking_queue_node_t *job);
+int  qt_io_epoll_poll(qthread_shepherd_id_t shep,
+                      int                   idle);
+int  qt_io_epoll_park(qthread_shepherd_id_t shep,
+                      qt_park_spot_t       *spot,
+                      unsigned long         usec);
+void qt_io_epoll_unpark(qt_park_spot_t *spot);
+#endif
+#if defined(QTHREAD_USE_IO_URING) || defined(QTHREAD_USE_EPOLL)
+int  qt_blocking_subsystem_poll(qthread_shepherd_id_t shep,
+                                int                   idle);
+int  qt_blocking_subsystem_park(qthread_shepherd_id_t shep,
+                                qt_park_spot_t       *spot,
+                                unsigned long         usec);
+void qt_blocking_subsystem_unpark(qt_park_spot_t *spot);
+#else
+# define qt_blocking_subsystem_poll(shep, idle)       0
+# define qt_blocking_subsystem_park(shep, spot, usec) 0
+# define qt_blocking_subsystem_unpark(spot)           do {} while (0)
+#endif
 
 static inline int qt_blockable(void)
 {
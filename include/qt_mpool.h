@@ -14,6 +14,23 @@ void qt_mpool_free(qt_mpool pool,
 
 qt_mpool qt_mpool_create_aligned(size_t       item_size,
                                  const size_t alignment);
+qt_mpool qt_mpool_create_slab(size_t       item_size,
+                              const size_t alignment,
+                              const char  *name);
+
+/* For pools of items with pages of their own (i.e. stacks); see qt_mpool_create_paged() */
+typedef struct qt_mpool_paging_s {
+    size_t arena_size;             /* address space to reserve up front; 0 for none */
+    int    hugepages;              /* ask for transparent huge pages in the arena */
+    size_t link_offset;            /* where a free item may keep its list links */
+    void   (*prepare)(void *item); /* once per item, before it is first handed out */
+    void   (*trim)(void *item);    /* the item has gone cold; give back its pages */
+} qt_mpool_paging_t;
+
+qt_mpool qt_mpool_create_paged(size_t                   item_size,
+                               size_t                   alignment,
+                               const char              *name,
+                               const qt_mpool_paging_t *paging);
 void qt_mpool_destroy(qt_mpool pool);
 
 void qt_mpool_subsystem_init(void);
@@ -0,0 +1,106 @@
+#ifndef QT_PARK_H
+#define QT_PARK_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdint.h>
+#if defined(HAVE_LINUX_FUTEX_H) && defined(HAVE_SYS_SYSCALL_H)
+# define QTHREAD_PARK_FUTEX 1
+# include <unistd.h>
+# include <time.h>
+# include <sys/syscall.h>
+# include <linux/futex.h>
+#else
+# include <pthread.h>
+# include <sys/time.h>
+#endif
+
+#include "qthread/qthread.h"
+#include "qt_atomics.h"
+
+/* A parking spot is a place for one OS thread to sleep until somebody hands
+ * it a wakeup. The sleeper sets the state to QT_PARK_PARKED, re-checks
+ * whatever it is waiting for, and then calls qt_park_wait(). A waker must
+ * claim the spot (qt_park_claim(), which flips it back to QT_PARK_AWAKE)
+ * before calling qt_park_wake(), so each wakeup goes to exactly one sleeper
+ * and a sleeper that gives up on its own simply claims its own spot. */
+
+#define QT_PARK_AWAKE  0
+#define QT_PARK_PARKED 1
+
+typedef struct qt_park_spot_s {
+    volatile uint32_t state;
+#ifndef QTHREAD_PARK_FUTEX
+    QTHREAD_COND_DECL(trigger);
+#endif
+} qt_park_spot_t;
+
+static QINLINE void qt_park_init(qt_park_spot_t *s)
+{   /*{{{*/
+    s->state = QT_PARK_AWAKE;
+#ifndef QTHREAD_PARK_FUTEX
+    QTHREAD_COND_INIT(s->trigger);
+#endif
+} /*}}}*/
+
+static QINLINE void qt_park_destroy(qt_park_spot_t Q_UNUSED *s)
+{   /*{{{*/
+#ifndef QTHREAD_PARK_FUTEX
+    QTHREAD_COND_DESTROY(s->trigger);
+#endif
+} /*}}}*/
+
+/* Returns nonzero if the caller took the spot from parked to awake, and is
+ * therefore responsible for the wakeup. */
+static QINLINE int qt_park_claim(qt_park_spot_t *s)
+{   /*{{{*/
+    return qthread_cas32((uint32_t *)&s->state, QT_PARK_PARKED, QT_PARK_AWAKE) == QT_PARK_PARKED;
+} /*}}}*/
+
+/* Sleep for at most usec microseconds, or until the spot is claimed. */
+static QINLINE void qt_park_wait(qt_park_spot_t *s,
+                                 unsigned long   usec)
+{   /*{{{*/
+#ifdef QTHREAD_PARK_FUTEX
+    struct timespec ts;
+
+    ts.tv_sec  = usec / 1000000;
+    ts.tv_nsec = (usec % 1000000) * 1000;
+    if (s->state == QT_PARK_PARKED) {
+        syscall(SYS_futex, &s->state, FUTEX_WAIT_PRIVATE, QT_PARK_PARKED, &ts, NULL, 0);
+    }
+#else
+    QTHREAD_COND_LOCK(s->trigger);
+    if (s->state == QT_PARK_PARKED) {
+        struct timespec ts;
+        struct timeval  now;
+
+        gettimeofday(&now, NULL);
+        ts.tv_sec  = now.tv_sec + usec / 1000000;
+        ts.tv_nsec = (now.tv_usec + usec % 1000000) * 1000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&s->trigger, &s->trigger_lock, &ts);
+    }
+    QTHREAD_COND_UNLOCK(s->trigger);
+#endif /* ifdef QTHREAD_PARK_FUTEX */
+} /*}}}*/
+
+/* Wake the sleeper on a spot the caller has just claimed. */
+static QINLINE void qt_park_wake(qt_park_spot_t *s)
+{   /*{{{*/
+#ifdef QTHREAD_PARK_FUTEX
+    syscall(SYS_futex, &s->state, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+    QTHREAD_COND_LOCK(s->trigger);
+    QTHREAD_COND_SIGNAL(s->trigger);
+    QTHREAD_COND_UNLOCK(s->trigger);
+#endif
+} /*}}}*/
+
+#endif // ifndef QT_PARK_H
+/* vim:set expandtab: */
@@ -44,6 +44,10 @@ struct qthread_worker_s {
     struct qthread_s        **nostealbuffer;
     struct qthread_s        **stealbuffer;
     qthread_t                *current;
+    void                     *spare_stack; /* stack lent to the next task to start here */
+    qthread_t                *handoff;      /* task woken by current, to be switched to directly */
+    qthread_t                *handoff_from; /* task that switched to current, not yet requeued */
+    volatile uint_fast8_t     idle;         /* nonzero while qthread_master() looks for work */
     qthread_worker_id_t       unique_id;
     qthread_worker_id_t       worker_id;
     qthread_worker_id_t       packed_worker_id;
@@ -145,6 +149,8 @@ qthread_shepherd_t INTERNAL *qthread_find_active_shepherd(qthread_shepherd_id_t
                                                           unsigned int          *d);
 
 void qthread_back_to_master(qthread_t *t);
+int INTERNAL  qthread_internal_handoff_offer(qthread_t          *waiter,
+                                             qthread_shepherd_t *shep);
 void qthread_back_to_master2(qthread_t *t);
 
 #endif // ifndef QT_SHEPHERD_INNARDS_H
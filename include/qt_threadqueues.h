@@ -30,6 +30,9 @@ void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
                                      qthread_t *restrict        t);
 void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
                                              qthread_t *restrict        t);
+void INTERNAL qt_threadqueue_enqueue_batch(qt_threadqueue_t *q,
+                                           qthread_t       **t,
+                                           size_t            n);
 void INTERNAL qt_threadqueue_enqueue_cache(qt_threadqueue_t         *q,
                                            qt_threadqueue_private_t *cache);
 int INTERNAL qt_threadqueue_private_enqueue(qt_threadqueue_private_t *restrict pq,
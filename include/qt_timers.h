@@ -0,0 +1,55 @@
+#ifndef QT_TIMERS_H
+#define QT_TIMERS_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <qthread/qthread-int.h> /* for uint64_t */
+
+#include "qthread/qthread.h"
+#include "qt_blocking_structs.h"
+
+/* With the sherwood scheduler, each shepherd has a timer wheel, which its
+ * workers advance whenever they look for work. A timer is started on a
+ * shepherd's wheel with its deadline, callback and argument filled in; once
+ * the deadline has passed, a worker unlinks it and calls fire(t), outside of
+ * any lock, from the scheduler (so there is no current task). A timer that
+ * has been cancelled, or that has fired, may be started again. */
+#ifdef QTHREAD_USE_TIMER_WHEEL
+typedef struct qt_timer_s qt_timer_t;
+typedef void (*qt_timer_f)(qt_timer_t *t);
+
+struct qt_timer_s {
+    qt_timer_t           *next;
+    qt_timer_t          **prev;     /* NULL unless the timer is in a wheel */
+    uint64_t              deadline; /* nsecs, on the qt_timer_now() clock */
+    qt_timer_f            fire;
+    void                 *arg;
+    qthread_shepherd_id_t shep;
+};
+
+void          qt_timer_subsystem_init(void);
+uint64_t      qt_timer_now(void);
+void          qt_timer_start(qt_timer_t           *t,
+                             qthread_shepherd_id_t shep);
+int           qt_timer_cancel(qt_timer_t *t);
+void          qt_timer_sleep(syscall_t op,
+                             uint64_t  nsecs);
+
+/* Called by the scheduler: poll() fires whatever is due (idle says whether
+ * the worker has nothing else to do, and so can afford to look at every
+ * shepherd's wheel), and park_usecs() cuts usec down to the time left before
+ * the next timer on shep's wheel is due. */
+int           qt_timer_poll(qthread_shepherd_id_t shep,
+                            int                   idle);
+unsigned long qt_timer_park_usecs(qthread_shepherd_id_t shep,
+                                  unsigned long         usec);
+#else
+# define qt_timer_subsystem_init()       do {} while (0)
+# define qt_timer_poll(shep, idle)       0
+# define qt_timer_park_usecs(shep, usec) (usec)
+#endif
+
+#endif // ifndef QT_TIMERS_H
+/* vim:set expandtab: */
@@ -88,6 +88,31 @@ void *qt_dictionary_put_if_absent(qt_dictionary *dict,
 void *qt_dictionary_get(qt_dictionary *dict,
                         void          *key);
 
+/*
+ *      Inserts count key, value pairs, as if by qt_dictionary_put() on each, in order
+ *      results, if not NULL, receives what qt_dictionary_put() returned for each pair
+ *      returns size_t:
+ *                      the number of pairs that were inserted (fewer than count only on error)
+ *
+ */
+size_t qt_dictionary_put_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void *const   *values,
+                              size_t         count,
+                              void         **results);
+
+/*
+ *      Gets the values for count keys, as if by qt_dictionary_get() on each
+ *      values receives the item for each key, or NULL if it was not present
+ *      returns size_t:
+ *                      the number of keys that were present
+ *
+ */
+size_t qt_dictionary_get_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void         **values,
+                              size_t         count);
+
 /*
  *      Removes a key,value pair from the dictionary
  *      returns:
@@ -34,6 +34,8 @@ typedef struct qarray_s {
             size_t extras;
         } stripes;
     } dist_specific;
+    struct qarray_seg_index_s *seg_index; /* which segments each shepherd owns */
+    aligned_t                  seg_index_stale;
 } qarray;
 
 typedef void (*qa_loop_f)(const size_t startat,
@@ -100,6 +100,17 @@ void qt_loopaccum_balance_dc(const size_t     start,
                              const qt_loopr_f func,
                              void *restrict   argptr,
                              const qt_accum_f acc);
+void qt_loop_split(const size_t    start,
+                   const size_t    stop,
+                   const qt_loop_f func,
+                   void           *argptr);
+void qt_loopaccum_split(const size_t     start,
+                        const size_t     stop,
+                        const size_t     size,
+                        void *restrict   out,
+                        const qt_loopr_f func,
+                        void *restrict   argptr,
+                        const qt_accum_f acc);
 
 typedef enum {CHUNK, GUIDED, FACTORED, TIMED} qt_loop_queue_type;
 qqloop_handle_t *qt_loop_queue_create(const qt_loop_queue_type type,
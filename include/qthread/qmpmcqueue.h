@@ -0,0 +1,48 @@
+#ifndef QTHREAD_QMPMCQUEUE_H
+#define QTHREAD_QMPMCQUEUE_H
+
+#include "macros.h"
+
+Q_STARTCXX /* */
+
+typedef struct qmpmcqueue_s qmpmcqueue_t;
+
+/* Create a new qmpmcqueue (capacity is rounded up to a power of two) */
+qmpmcqueue_t *qmpmcqueue_create(size_t elements);
+
+/* destroy that queue */
+int qmpmcqueue_destroy(qmpmcqueue_t *q);
+
+/* enqueue something in the queue if there is room */
+int qmpmcqueue_enqueue(qmpmcqueue_t *q,
+                       void         *elem);
+
+/* enqueue something in the queue, blocking the qthread while it is full */
+int qmpmcqueue_enqueue_blocking(qmpmcqueue_t *q,
+                                void         *elem);
+
+/* enqueue as many of the elems as there is room for, in order; returns how
+ * many were enqueued */
+size_t qmpmcqueue_enqueue_many(qmpmcqueue_t *q,
+                               void *const  *elems,
+                               size_t        count);
+
+/* dequeue something from the queue (returns NULL for an empty queue) */
+void *qmpmcqueue_dequeue(qmpmcqueue_t *q);
+
+/* dequeue something from the queue, blocking the qthread while it is empty */
+void *qmpmcqueue_dequeue_blocking(qmpmcqueue_t *q);
+
+/* dequeue up to count elements into elems, in order; returns how many were
+ * dequeued */
+size_t qmpmcqueue_dequeue_many(qmpmcqueue_t *q,
+                               void        **elems,
+                               size_t        count);
+
+/* returns 1 if the queue is empty, 0 otherwise */
+int qmpmcqueue_empty(qmpmcqueue_t *q);
+
+Q_ENDCXX /* */
+
+#endif // ifndef QTHREAD_QMPMCQUEUE_H
+/* vim:set expandtab: */
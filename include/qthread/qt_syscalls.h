@@ -6,6 +6,8 @@
 #include <sys/select.h>   /* for fd_set */
 #include <sys/resource.h> /* for struct rusage */
 #include <poll.h>         /* for struct pollfd and nfds_t */
+#include <time.h>         /* for struct timespec */
+#include <unistd.h>       /* for useconds_t */
 
 #include "macros.h"
 
@@ -17,6 +19,8 @@ int qt_accept(int                       socket,
 int qt_connect(int                    socket,
                const struct sockaddr *address,
                socklen_t              address_len);
+int qt_nanosleep(const struct timespec *rqtp,
+                 struct timespec       *rmtp);
 int qt_poll(struct pollfd fds[],
             nfds_t        nfds,
             int           timeout);
@@ -36,7 +40,9 @@ int qt_select(int                      nfds,
               fd_set *restrict         writefds,
               fd_set *restrict         errorfds,
               struct timeval *restrict timeout);
-int   qt_system(const char *command);
+unsigned int qt_sleep(unsigned int seconds);
+int          qt_system(const char *command);
+int          qt_usleep(useconds_t useconds);
 pid_t qt_wait4(pid_t          pid,
                int           *stat_loc,
                int            options,
@@ -48,12 +54,15 @@ ssize_t qt_write(int         filedes,
 #ifdef USE_HEADER_SYSCALLS
 # define accept(s, a, l)       qt_accept((s), (a), (l))
 # define connect(s, a, l)      qt_connect((s), (a), (l))
+# define nanosleep(r, m)       qt_nanosleep((r), (m))
 # define poll(f, n, t)         qt_poll((f), (n), (t))
 # define pread(f, b, n, o)     qt_pread((f), (b), (n), (o))
 # define pwrite(f, b, n, o)    qt_pwrite((f), (b), (n), (o))
 # define read(f, b, n)         qt_read((f), (b), (n))
 # define select(n, r, w, e, t) qt_select((n), (r), (w), (e), (t))
+# define sleep(s)              qt_sleep((s))
 # define system(c)             qt_system((c))
+# define usleep(u)             qt_usleep((u))
 # define wait4(p, s, o, r)     qt_wait4((p), (s), (o), (r))
 # define write(f, b, n)        qt_write((f), (b), (n))
 #endif // ifdef USE_HEADER_SYSCALLS
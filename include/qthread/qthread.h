@@ -215,6 +215,18 @@ int qthread_fork_to(qthread_f             f,
                     aligned_t            *ret,
                     qthread_shepherd_id_t shepherd);
 
+/* qthread_fork_after() spawns the thread once usecs microseconds have passed;
+ * qthread_fork_every() runs f every usecs microseconds, until it returns a
+ * nonzero value, which is stored in ret. */
+int qthread_fork_after(qthread_f   f,
+                       const void *arg,
+                       aligned_t  *ret,
+                       uint64_t    usecs);
+int qthread_fork_every(qthread_f   f,
+                       const void *arg,
+                       aligned_t  *ret,
+                       uint64_t    usecs);
+
 #ifdef QTHREAD_LOCAL_PRIORITY
 int qthread_fork_to_local_priority(qthread_f             f,
                                    const void           *arg,
@@ -531,6 +543,15 @@ int qthread_syncvar_readFF(uint64_t *restrict  dest,
  */
 int qthread_readFE(aligned_t       *dest,
                    const aligned_t *src);
+
+/* These are readFF and readFE, except that they give up and return
+ * QTHREAD_TIMEOUT if src does not become full within usecs microseconds. */
+int qthread_readFF_timed(aligned_t       *dest,
+                         const aligned_t *src,
+                         uint64_t         usecs);
+int qthread_readFE_timed(aligned_t       *dest,
+                         const aligned_t *src,
+                         uint64_t         usecs);
 int qthread_syncvar_readFE(uint64_t *restrict  dest,
                            syncvar_t *restrict src);
 
@@ -2,6 +2,8 @@
 #define QTHREAD_QUTIL_H
 
 #include "qthread.h"
+#include "qloop.h"
+#include "qarray.h"
 
 Q_STARTCXX /* */
 
@@ -19,6 +21,19 @@ double qutil_double_max(const double *array,
 double qutil_double_min(const double *array,
                         size_t        length,
                         int           checkfeb);
+/* Likewise for floats */
+float qutil_float_sum(const float *array,
+                      size_t       length,
+                      int          checkfeb);
+float qutil_float_mult(const float *array,
+                       size_t       length,
+                       int          checkfeb);
+float qutil_float_max(const float *array,
+                      size_t       length,
+                      int          checkfeb);
+float qutil_float_min(const float *array,
+                      size_t       length,
+                      int          checkfeb);
 /* This computes the sum/product of all the aligned_ts in an array */
 aligned_t qutil_uint_sum(const aligned_t *array,
                          size_t           length,
@@ -53,6 +68,122 @@ void qutil_qsort(double *array,
 void qutil_aligned_qsort(aligned_t *array,
                          size_t     length);
 
+/* These sort an array of nmemb records of the given size each, in parallel.
+ * qutil_radix_sort() orders the records by the unsigned 64-bit key that key()
+ * extracts from each, and keeps records with equal keys in their original
+ * order; qutil_radix_key_int() and qutil_radix_key_double() map signed and
+ * floating-point keys onto unsigned ones in the same order.
+ * qutil_sample_sort() orders the records according to cmp(), which behaves
+ * like the comparison function given to qsort(). qutil_sort() uses the radix
+ * sort if given a key and the sample sort otherwise. */
+typedef uint64_t (*qutil_key_f)(const void *record);
+typedef int (*qutil_cmp_f)(const void *a,
+                           const void *b);
+
+void qutil_radix_sort(void       *array,
+                      size_t      nmemb,
+                      size_t      size,
+                      qutil_key_f key);
+void qutil_sample_sort(void       *array,
+                       size_t      nmemb,
+                       size_t      size,
+                       qutil_cmp_f cmp);
+void qutil_sort(void       *array,
+                size_t      nmemb,
+                size_t      size,
+                qutil_key_f key,
+                qutil_cmp_f cmp);
+
+static QINLINE uint64_t qutil_radix_key_int(int64_t k)
+{
+    return (uint64_t)k ^ ((uint64_t)1 << 63);
+}
+
+static QINLINE uint64_t qutil_radix_key_double(double k)
+{
+    union {
+        double   d;
+        uint64_t u;
+    } bits;
+
+    bits.d = k;
+    /* negatives count down from the top; positives sit above them */
+    return (bits.u & ((uint64_t)1 << 63)) ? ~bits.u : (bits.u | ((uint64_t)1 << 63));
+}
+
+/* These compute the running sums of an array of doubles/aligned_ts/
+ * saligned_ts into out (which may be the same array), and return the sum of
+ * the whole array. An inclusive scan's out[i] includes in[i]; an exclusive
+ * scan's stops just short of it. qutil_scan() does the same for records of
+ * any size, combined with any associative op (which accumulates its second
+ * argument into its first, as for qt_loopaccum_balance()); identity is only
+ * required for exclusive scans. */
+double qutil_double_scan(const double *in,
+                         double       *out,
+                         size_t        length,
+                         int           exclusive);
+aligned_t qutil_uint_scan(const aligned_t *in,
+                          aligned_t       *out,
+                          size_t           length,
+                          int              exclusive);
+saligned_t qutil_int_scan(const saligned_t *in,
+                          saligned_t       *out,
+                          size_t            length,
+                          int               exclusive);
+void qutil_scan(const void *in,
+                void       *out,
+                size_t      nmemb,
+                size_t      size,
+                qt_accum_f  op,
+                const void *identity,
+                int         exclusive);
+
+/* qutil_compact() copies the records for which pred() is non-zero into out
+ * (which must not overlap in), in their original order, and returns how many
+ * there were. qutil_partition() moves those records to the front of the
+ * array and the others behind them, both in their original order, and
+ * returns how many are in front. qutil_histogram() counts how many records
+ * bucket() assigns to each of the nbuckets buckets. pred() and bucket() may be
+ * called more than once for the same record. */
+typedef int (*qutil_pred_f)(const void *record);
+typedef size_t (*qutil_bucket_f)(const void *record);
+
+size_t qutil_compact(const void  *in,
+                     void        *out,
+                     size_t       nmemb,
+                     size_t       size,
+                     qutil_pred_f pred);
+size_t qutil_partition(void        *array,
+                       size_t       nmemb,
+                       size_t       size,
+                       qutil_pred_f pred);
+void qutil_histogram(const void    *in,
+                     size_t         nmemb,
+                     size_t         size,
+                     qutil_bucket_f bucket,
+                     size_t         nbuckets,
+                     size_t        *counts);
+
+/* The same for qarrays, working on each segment on its own shepherd. The
+ * output qarray must have the input's unit size and at least its count, and
+ * should be distributed like it; qutil_qarray_partition() writes its result
+ * into out rather than in place. */
+void qutil_qarray_scan(const qarray *in,
+                       qarray       *out,
+                       qt_accum_f    op,
+                       const void   *identity,
+                       int           exclusive);
+size_t qutil_qarray_compact(const qarray *in,
+                            qarray       *out,
+                            qutil_pred_f  pred);
+size_t qutil_qarray_partition(const qarray *in,
+                              qarray       *out,
+                              qutil_pred_f  pred);
+void qutil_qarray_histogram(const qarray  *in,
+                            qutil_bucket_f bucket,
+                            size_t         nbuckets,
+                            size_t        *counts);
+
 Q_ENDCXX /* */
 #endif // ifndef QTHREAD_QUTIL_H
 /* vim:set expandtab: */
@@ -370,6 +370,79 @@ void INTERNAL qt_affinity_free(void  *ptr,
 
 #endif /* ifdef QTHREAD_HAVE_MEM_AFFINITY */
 
+void INTERNAL qt_affinity_mem_toshep(void                 *addr,
+                                     size_t                bytes,
+                                     qthread_shepherd_id_t shep)
+{                                      /*{{{ */
+#ifdef QTHREAD_HAVE_MEM_AFFINITY
+    hwloc_const_cpuset_t allowed_cpuset = hwloc_topology_get_allowed_cpuset(topology);
+    hwloc_obj_t          obj            = hwloc_get_obj_inside_cpuset_by_depth(topology, allowed_cpuset, shep_depth,
+                                                                               qthread_internal_shep_to_node(shep));
+
+    DEBUG_ONLY(hwloc_topology_check(topology));
+    if (obj == NULL) {
+        return;
+    }
+    /* binding to a cpuset means "the memory nearest those PUs" */
+    if (hwloc_set_area_membind(topology, addr, bytes, obj->cpuset,
+                               HWLOC_MEMBIND_BIND,
+                               HWLOC_MEMBIND_NOCPUBIND)) {
+        qthread_debug(AFFINITY_DETAILS, "could not bind %p (%u bytes) to shep %i: %s\n",
+                      addr, (unsigned)bytes, (int)shep, strerror(errno));
+    }
+#endif /* ifdef QTHREAD_HAVE_MEM_AFFINITY */
+}                                      /*}}} */
+
+void INTERNAL qt_affinity_mem_move_toshep(void                 *addr,
+                                          size_t                bytes,
+                                          qthread_shepherd_id_t shep)
+{                                      /*{{{ */
+#ifdef QTHREAD_HAVE_MEM_AFFINITY
+    hwloc_const_cpuset_t allowed_cpuset = hwloc_topology_get_allowed_cpuset(topology);
+    hwloc_obj_t          obj            = hwloc_get_obj_inside_cpuset_by_depth(topology, allowed_cpuset, shep_depth,
+                                                                               qthread_internal_shep_to_node(shep));
+
+    DEBUG_ONLY(hwloc_topology_check(topology));
+    if (obj == NULL) {
+        return;
+    }
+    if (hwloc_set_area_membind(topology, addr, bytes, obj->cpuset,
+                               HWLOC_MEMBIND_BIND,
+                               HWLOC_MEMBIND_MIGRATE | HWLOC_MEMBIND_NOCPUBIND)) {
+        qthread_debug(AFFINITY_DETAILS, "could not move %p (%u bytes) to shep %i: %s\n",
+                      addr, (unsigned)bytes, (int)shep, strerror(errno));
+    }
+#endif /* ifdef QTHREAD_HAVE_MEM_AFFINITY */
+}                                      /*}}} */
+
+int INTERNAL qt_affinity_mem_islocal(const void           *addr,
+                                     qthread_shepherd_id_t shep)
+{                                      /*{{{ */
+#if HWLOC_API_VERSION >= 0x00020000
+    hwloc_const_cpuset_t allowed_cpuset = hwloc_topology_get_allowed_cpuset(topology);
+    hwloc_obj_t          obj            = hwloc_get_obj_inside_cpuset_by_depth(topology, allowed_cpuset, shep_depth,
+                                                                               qthread_internal_shep_to_node(shep));
+    hwloc_nodeset_t      where;
+    int                  ret = -1;
+
+    if ((obj == NULL) || (obj->nodeset == NULL)) {
+        return -1;
+    }
+    where = hwloc_bitmap_alloc();
+    if ((hwloc_get_area_memlocation(topology, addr, 1, where,
+                                    HWLOC_MEMBIND_BYNODESET) == 0) &&
+        !hwloc_bitmap_iszero(where)) {
+        ret = hwloc_bitmap_isincluded(where, obj->nodeset);
+    }
+    hwloc_bitmap_free(where);
+    return ret;
+#else
+    /* older hwlocs can only report the binding policy, not where the pages
+     * actually went */
+    return -1;
+#endif
+}                                      /*}}} */
+
 qthread_shepherd_id_t INTERNAL guess_num_shepherds(void)
 {                                      /*{{{ */
     qthread_shepherd_id_t ret = 1;
@@ -720,4 +720,70 @@ void INTERNAL qt_affinity_free(void  *ptr,
 
 #endif /* ifdef QTHREAD_HAVE_MEM_AFFINITY */
 
+static hwloc_obj_t qt_affinity_internal_shep_obj(qthread_shepherd_id_t shep)
+{                                      /*{{{ */
+    if (qt_topo.shep_level < 0) {
+        return NULL;
+    }
+    return hwloc_get_obj_inside_cpuset_by_depth(sys_topo,
+                                                hwloc_topology_get_allowed_cpuset(sys_topo),
+                                                qt_topo.shep_level, shep);
+}                                      /*}}} */
+
+void INTERNAL qt_affinity_mem_toshep(void                 *addr,
+                                     size_t                bytes,
+                                     qthread_shepherd_id_t shep)
+{                                      /*{{{ */
+    hwloc_obj_t obj = qt_affinity_internal_shep_obj(shep);
+
+    DEBUG_ONLY(hwloc_topology_check(sys_topo));
+    if (obj) {
+        /* binding to a cpuset means "the memory nearest those PUs", which is
+         * what we want whatever level the shepherd boundary was set at */
+        if (hwloc_set_area_membind(sys_topo, addr, bytes, obj->cpuset,
+                                   HWLOC_MEMBIND_BIND,
+                                   HWLOC_MEMBIND_NOCPUBIND)) {
+            qthread_debug(AFFINITY_DETAILS, "could not bind %p (%u bytes) to shep %i: %s\n",
+                          addr, (unsigned)bytes, (int)shep, strerror(errno));
+        }
+    }
+}                                      /*}}} */
+
+void INTERNAL qt_affinity_mem_move_toshep(void                 *addr,
+                                          size_t                bytes,
+                                          qthread_shepherd_id_t shep)
+{                                      /*{{{ */
+    hwloc_obj_t obj = qt_affinity_internal_shep_obj(shep);
+
+    DEBUG_ONLY(hwloc_topology_check(sys_topo));
+    if (obj) {
+        if (hwloc_set_area_membind(sys_topo, addr, bytes, obj->cpuset,
+                                   HWLOC_MEMBIND_BIND,
+                                   HWLOC_MEMBIND_MIGRATE | HWLOC_MEMBIND_NOCPUBIND)) {
+            qthread_debug(AFFINITY_DETAILS, "could not move %p (%u bytes) to shep %i: %s\n",
+                          addr, (unsigned)bytes, (int)shep, strerror(errno));
+        }
+    }
+}                                      /*}}} */
+
+int INTERNAL qt_affinity_mem_islocal(const void           *addr,
+                                     qthread_shepherd_id_t shep)
+{                                      /*{{{ */
+    hwloc_obj_t     obj = qt_affinity_internal_shep_obj(shep);
+    hwloc_nodeset_t where;
+    int             ret = -1;
+
+    if ((obj == NULL) || (obj->nodeset == NULL)) {
+        return -1;
+    }
+    where = hwloc_bitmap_alloc();
+    if ((hwloc_get_area_memlocation(sys_topo, addr, 1, where,
+                                    HWLOC_MEMBIND_BYNODESET) == 0) &&
+        !hwloc_bitmap_iszero(where)) {
+        ret = hwloc_bitmap_isincluded(where, obj->nodeset);
+    }
+    hwloc_bitmap_free(where);
+    return ret;
+}                                      /*}}} */
+
 /* vim:set expandtab: */
@@ -3,6 +3,7 @@
 #endif
 
 #include <numa.h>
+#include <numaif.h>                    /* for get_mempolicy() and mbind() */
 #include <stdio.h>
 
 #include "qt_subsystems.h"
@@ -63,6 +64,36 @@ void INTERNAL qt_affinity_free(void  *ptr,
     numa_free(ptr, bytes);
 }                                      /*}}} */
 
+void INTERNAL qt_affinity_mem_toshep(void                 *addr,
+                                     size_t                bytes,
+                                     qthread_shepherd_id_t shep)
+{                                      /*{{{ */
+    numa_tonode_memory(addr, bytes, qthread_internal_shep_to_node(shep));
+}                                      /*}}} */
+
+void INTERNAL qt_affinity_mem_move_toshep(void                 *addr,
+                                          size_t                bytes,
+                                          qthread_shepherd_id_t shep)
+{                                      /*{{{ */
+    struct bitmask *mask = numa_allocate_nodemask();
+
+    numa_bitmask_setbit(mask, qthread_internal_shep_to_node(shep));
+    /* MPOL_MF_MOVE takes along the pages that are already there */
+    (void)mbind(addr, bytes, MPOL_BIND, mask->maskp, mask->size + 1, MPOL_MF_MOVE);
+    numa_free_nodemask(mask);
+}                                      /*}}} */
+
+int INTERNAL qt_affinity_mem_islocal(const void           *addr,
+                                     qthread_shepherd_id_t shep)
+{                                      /*{{{ */
+    int node = -1;
+
+    if (get_mempolicy(&node, NULL, 0, (void *)addr, MPOL_F_NODE | MPOL_F_ADDR) != 0) {
+        return -1;
+    }
+    return (unsigned int)node == qthread_internal_shep_to_node(shep);
+}                                      /*}}} */
+
 qthread_shepherd_id_t INTERNAL guess_num_shepherds(void)
 {                                      /*{{{ */
     qthread_shepherd_id_t nshepherds = 1;
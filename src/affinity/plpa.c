@@ -100,4 +100,20 @@ int INTERNAL qt_affinity_gendists(qthread_shepherd_t   *sheps,
     return QTHREAD_SUCCESS;
 } /*}}}*/
 
+void INTERNAL qt_affinity_mem_toshep(void                 *Q_UNUSED(addr),
+                                     size_t                Q_UNUSED(bytes),
+                                     qthread_shepherd_id_t Q_UNUSED(shep))
+{}
+
+void INTERNAL qt_affinity_mem_move_toshep(void                 *Q_UNUSED(addr),
+                                          size_t                Q_UNUSED(bytes),
+                                          qthread_shepherd_id_t Q_UNUSED(shep))
+{}
+
+int INTERNAL qt_affinity_mem_islocal(const void           *Q_UNUSED(addr),
+                                     qthread_shepherd_id_t Q_UNUSED(shep))
+{                                      /*{{{ */
+    return -1;
+}                                      /*}}} */
+
 /* vim:set expandtab: */
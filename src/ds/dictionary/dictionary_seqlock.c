@@ -0,0 +1,712 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <stdio.h>  /* for printf() */
+#include <string.h> /* for memset() and memcpy() */
+
+/* Qthreads Headers */
+#include <qthread/qthread.h>
+#include <qthread/dictionary.h>
+
+/* Internal Headers */
+#include "qt_asserts.h"
+#include "qt_atomics.h"
+#include "qt_alloc.h"
+#include "qt_hazardptrs.h"
+#include "qt_debug.h"
+
+/*
+ * A chained hash table whose buckets are sequence locks. Writers take a
+ * bucket by making its sequence number odd and release it by making it even
+ * again; readers never write anything shared: they note the (even) sequence
+ * number, walk the chain, and start over if the number has changed by the
+ * time they look at what they read. Unlinked entries are retired through
+ * the hazard pointers: before a reader reads anything out of an entry, it
+ * publishes a hazard pointer to it and then checks the sequence number, so
+ * the entry was still linked in when it was protected, and can't be freed
+ * under the reader (or under the user's op_equals() on its key).
+ *
+ * The table grows by doubling, a few buckets at a time. Once a new table has
+ * been hung off the current one, every writer that comes through moves up to
+ * DICT_MIGRATE_CHUNK buckets into it, splitting each chain in two; a moved
+ * bucket is left holding DICT_MOVED, which sends readers and writers on to the
+ * new table. Nobody waits for the move to finish. Outgrown tables are kept
+ * until the dictionary is destroyed (they add up to less than the current
+ * one), so a reader holding a stale table pointer is always safe.
+ */
+
+#define DICT_INITIAL_BUCKETS 256
+#define DICT_MAX_LOAD        2  /* entries per bucket before growing */
+#define DICT_MIGRATE_CHUNK   16 /* buckets moved per writer while growing */
+#define DICT_COUNT_STRIPES   16
+#define DICT_BATCH           32 /* hashes computed ahead in *_many() */
+
+#define DICT_MOVED ((list_entry *)(uintptr_t)1)
+
+#if (QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA32)
+/* loads are not reordered with loads, nor stores with stores */
+# define DICT_READ_FENCE()  COMPILER_FENCE
+# define DICT_WRITE_FENCE() COMPILER_FENCE
+#else
+# define DICT_READ_FENCE()  MACHINE_FENCE
+# define DICT_WRITE_FENCE() MACHINE_FENCE
+#endif
+
+typedef struct dict_bucket {
+    volatile aligned_t  seq;  /* odd while a writer has the bucket */
+    list_entry *volatile head;
+} dict_bucket;
+
+typedef struct dict_table {
+    size_t                      mask;
+    struct dict_table *volatile next;            /* the table we are growing into */
+    volatile aligned_t          migrate_claimed; /* buckets handed out to movers */
+    volatile aligned_t          migrate_done;    /* buckets moved */
+    struct dict_table          *retired;         /* older tables, see above */
+    dict_bucket                 buckets[];
+} dict_table;
+
+typedef struct dict_count {
+    volatile saligned_t count;
+    uint8_t             pad[CACHELINE_WIDTH - sizeof(saligned_t)];
+} dict_count;
+
+/* iterators hand out the list_entry; the cleanup function rides along so that
+ * a deferred free does not need the dictionary to still exist */
+typedef struct dict_entry {
+    list_entry        le;
+    qt_dict_cleanup_f cleanup;
+} dict_entry;
+
+struct qt_dictionary {
+    qt_dict_key_equals_f op_equals;
+    qt_dict_hash_f       op_hash;
+    qt_dict_cleanup_f    op_cleanup;
+    dict_table *volatile table;
+    dict_table          *retired;
+    dict_count          *counts;
+};
+
+/* a depth-first walk over the buckets of the table the iterator started on,
+ * descending into the tables that moved buckets went to */
+#define DICT_ITER_DEPTH 64
+struct qt_dictionary_iterator {
+    qt_dictionary *dict;
+    list_entry    *crt;
+    size_t         bkt;   /* next bucket of the root table */
+    dict_table    *root;
+    unsigned       depth;
+    struct {
+        dict_table *t;
+        size_t      bkt;
+    }              stack[DICT_ITER_DEPTH];
+};
+
+#define PUT_ALWAYS    0
+#define PUT_IF_ABSENT 1
+
+#ifndef QTHREAD_NO_ASSERTS
+extern int qthread_library_initialized;
+#endif
+
+static QINLINE uint64_t dict_hash(const qt_dictionary *d,
+                                  void                *key)
+{   /*{{{*/
+    /* users' hashes are only ints and are often poor in the low bits, which
+     * are the ones that pick buckets; finish them with a 64-bit mixer */
+    uint64_t h = (uint64_t)(uint32_t)d->op_hash(key);
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+} /*}}}*/
+
+static dict_table *dict_table_create(size_t buckets)
+{   /*{{{*/
+    dict_table *t = qt_internal_aligned_alloc(sizeof(dict_table) + buckets * sizeof(dict_bucket),
+                                              CACHELINE_WIDTH);
+
+    if (t != NULL) {
+        t->mask            = buckets - 1;
+        t->next            = NULL;
+        t->migrate_claimed = 0;
+        t->migrate_done    = 0;
+        t->retired         = NULL;
+        memset(t->buckets, 0, buckets * sizeof(dict_bucket));
+    }
+    return t;
+} /*}}}*/
+
+static void dict_table_free(dict_table *t)
+{   /*{{{*/
+    qt_internal_aligned_free(t, sizeof(dict_table) + (t->mask + 1) * sizeof(dict_bucket));
+} /*}}}*/
+
+static void dict_entry_free(void *ptr)
+{   /*{{{*/
+    dict_entry *e = (dict_entry *)ptr;
+
+    if (e->cleanup != NULL) {
+        e->cleanup(e->le.key, NULL);
+    }
+    FREE(e, sizeof(dict_entry));
+} /*}}}*/
+
+static QINLINE aligned_t dict_bucket_lock(dict_bucket *b)
+{   /*{{{*/
+    for (;;) {
+        const aligned_t s = b->seq;
+
+        if (!(s & 1) && (qthread_cas(&b->seq, s, s + 1) == s)) {
+            return s + 1;
+        }
+        SPINLOCK_BODY();
+    }
+} /*}}}*/
+
+static QINLINE void dict_bucket_unlock(dict_bucket *b,
+                                       aligned_t    s)
+{   /*{{{*/
+    DICT_WRITE_FENCE();
+    b->seq = s + 1;
+} /*}}}*/
+
+/* Locks the bucket that hash belongs in, in whichever table currently has
+ * it, and returns it; *tp is set to that table and *seqp to the lock's
+ * sequence number, for dict_bucket_unlock(). */
+static dict_bucket *dict_lock_bucket(qt_dictionary *d,
+                                     uint64_t       hash,
+                                     dict_table   **tp,
+                                     aligned_t     *seqp)
+{   /*{{{*/
+    dict_table *t = d->table;
+
+    for (;;) {
+        dict_bucket    *b = &t->buckets[hash & t->mask];
+        const aligned_t s = dict_bucket_lock(b);
+
+        if (b->head != DICT_MOVED) {
+            *tp   = t;
+            *seqp = s;
+            return b;
+        }
+        dict_bucket_unlock(b, s);
+        t = t->next;
+    }
+} /*}}}*/
+
+static QINLINE void dict_count_add(qt_dictionary *d,
+                                   saligned_t     n)
+{   /*{{{*/
+    (void)qthread_incr(&d->counts[qthread_worker_unique(NULL) % DICT_COUNT_STRIPES].count, n);
+} /*}}}*/
+
+static saligned_t dict_count_sum(const qt_dictionary *d)
+{   /*{{{*/
+    saligned_t sum = 0;
+
+    for (size_t i = 0; i < DICT_COUNT_STRIPES; i++) {
+        sum += d->counts[i].count;
+    }
+    return sum;
+} /*}}}*/
+
+/* Called by a writer that found a long chain in t: hangs a table twice the
+ * size off t if t is the current table, is not already growing, and is
+ * actually full. */
+static void dict_maybe_grow(qt_dictionary *d,
+                            dict_table    *t)
+{   /*{{{*/
+    dict_table *bigger;
+
+    if ((t != d->table) || (t->next != NULL) ||
+        (dict_count_sum(d) <= (saligned_t)((t->mask + 1) * DICT_MAX_LOAD))) {
+        return;
+    }
+    bigger = dict_table_create((t->mask + 1) * 2);
+    if (bigger == NULL) {
+        return; /* we can live with long chains */
+    }
+    if (qthread_cas_ptr(&t->next, NULL, bigger) != NULL) {
+        dict_table_free(bigger);
+    }
+} /*}}}*/
+
+static void dict_migrate_bucket(dict_table *t,
+                                size_t      i)
+{   /*{{{*/
+    dict_table     *n    = t->next;
+    const size_t    size = t->mask + 1;
+    dict_bucket    *ob   = &t->buckets[i];
+    const aligned_t s    = dict_bucket_lock(ob);
+    list_entry     *lo   = NULL, *hi = NULL;
+    list_entry    **lot  = &lo, **hit = &hi;
+
+    /* nobody uses n's buckets i and i+size until ob says DICT_MOVED, so they
+     * can be filled in without their locks; keep the chains' order */
+    for (list_entry *e = ob->head; e != NULL; e = e->next) {
+        if (e->hashed_key & size) {
+            *hit = e;
+            hit  = &e->next;
+        } else {
+            *lot = e;
+            lot  = &e->next;
+        }
+    }
+    *lot                    = NULL;
+    *hit                    = NULL;
+    n->buckets[i].head      = lo;
+    n->buckets[i + size].head = hi;
+    DICT_WRITE_FENCE();
+    ob->head = DICT_MOVED;
+    dict_bucket_unlock(ob, s);
+} /*}}}*/
+
+/* Every writer calls this on its way out: if the current table is growing,
+ * move a chunk of it, and if that was the last chunk, retire it. */
+static void dict_help_grow(qt_dictionary *d)
+{   /*{{{*/
+    dict_table  *t = d->table;
+    const size_t size = t->mask + 1;
+    size_t       first, last;
+
+    if (t->next == NULL) {
+        return;
+    }
+    first = qthread_incr(&t->migrate_claimed, DICT_MIGRATE_CHUNK);
+    if (first >= size) {
+        return;
+    }
+    last = (first + DICT_MIGRATE_CHUNK < size) ? (first + DICT_MIGRATE_CHUNK) : size;
+    for (size_t i = first; i < last; i++) {
+        dict_migrate_bucket(t, i);
+    }
+    if (qthread_incr(&t->migrate_done, last - first) + (last - first) == size) {
+        /* only one mover gets here for a given table, and no other table can
+         * start growing until this one is retired */
+        t->retired = d->retired;
+        d->retired = t;
+        MACHINE_FENCE;
+        d->table = t->next;
+    }
+} /*}}}*/
+
+qt_dictionary *qt_dictionary_create(qt_dict_key_equals_f eq,
+                                    qt_dict_hash_f       hash,
+                                    qt_dict_cleanup_f    cleanup)
+{   /*{{{*/
+    assert(qthread_library_initialized && "Need to initialize qthreads before using the dictionary");
+    qt_dictionary *ret = (qt_dictionary *)MALLOC(sizeof(qt_dictionary));
+
+    if (ret == NULL) {
+        return NULL;
+    }
+    ret->op_equals  = eq;
+    ret->op_hash    = hash;
+    ret->op_cleanup = cleanup;
+    ret->retired    = NULL;
+    ret->table      = dict_table_create(DICT_INITIAL_BUCKETS);
+    ret->counts     = qt_internal_aligned_alloc(DICT_COUNT_STRIPES * sizeof(dict_count), CACHELINE_WIDTH);
+    if ((ret->table == NULL) || (ret->counts == NULL)) {
+        if (ret->table) { dict_table_free(ret->table); }
+        if (ret->counts) { qt_internal_aligned_free(ret->counts, DICT_COUNT_STRIPES * sizeof(dict_count)); }
+        FREE(ret, sizeof(qt_dictionary));
+        return NULL;
+    }
+    memset(ret->counts, 0, DICT_COUNT_STRIPES * sizeof(dict_count));
+    return ret;
+} /*}}}*/
+
+static void dict_free_chains(qt_dictionary *d,
+                             dict_table    *t)
+{   /*{{{*/
+    for (size_t i = 0; i <= t->mask; i++) {
+        list_entry *e = t->buckets[i].head;
+
+        if (e == DICT_MOVED) {
+            continue;
+        }
+        while (e != NULL) {
+            list_entry *next = e->next;
+
+            if (d->op_cleanup) {
+                d->op_cleanup(e->key, e->value);
+            }
+            FREE(e, sizeof(dict_entry));
+            e = next;
+        }
+    }
+} /*}}}*/
+
+void qt_dictionary_destroy(qt_dictionary *d)
+{   /*{{{*/
+    dict_table *t = d->table;
+
+    /* every entry is in exactly one bucket that has not moved, either in the
+     * current table or in the one it is growing into */
+    dict_free_chains(d, t);
+    if (t->next != NULL) {
+        dict_free_chains(d, t->next);
+        dict_table_free(t->next);
+    }
+    dict_table_free(t);
+    while (d->retired != NULL) {
+        t          = d->retired;
+        d->retired = t->retired;
+        dict_table_free(t);
+    }
+    qt_internal_aligned_free(d->counts, DICT_COUNT_STRIPES * sizeof(dict_count));
+    FREE(d, sizeof(qt_dictionary));
+} /*}}}*/
+
+static void *dict_put(qt_dictionary *dict,
+                      void          *key,
+                      void          *value,
+                      const uint64_t hash,
+                      const char     put_type)
+{   /*{{{*/
+    dict_table  *t;
+    aligned_t    s;
+    dict_bucket *b   = dict_lock_bucket(dict, hash, &t, &s);
+    size_t       len = 0;
+    dict_entry  *toadd;
+
+    for (list_entry *e = b->head; e != NULL; e = e->next, len++) {
+        if ((e->hashed_key == hash) && dict->op_equals(e->key, key)) {
+            void *ret;
+
+            if (put_type == PUT_ALWAYS) {
+                e->value = value;
+            }
+            ret = e->value;
+            dict_bucket_unlock(b, s);
+            return ret;
+        }
+    }
+    toadd = (dict_entry *)MALLOC(sizeof(dict_entry));
+    if (toadd == NULL) {
+        dict_bucket_unlock(b, s);
+        return NULL;
+    }
+    toadd->le.key        = key;
+    toadd->le.value      = value;
+    toadd->le.hashed_key = hash;
+    toadd->le.next       = b->head;
+    toadd->cleanup       = dict->op_cleanup;
+    b->head              = &toadd->le;
+    dict_bucket_unlock(b, s);
+    dict_count_add(dict, 1);
+    if (len >= DICT_MAX_LOAD) {
+        dict_maybe_grow(dict, t);
+    }
+    return value;
+} /*}}}*/
+
+void *qt_dictionary_put(qt_dictionary *dict,
+                        void          *key,
+                        void          *value)
+{   /*{{{*/
+    void *ret = dict_put(dict, key, value, dict_hash(dict, key), PUT_ALWAYS);
+
+    dict_help_grow(dict);
+    return ret;
+} /*}}}*/
+
+void *qt_dictionary_put_if_absent(qt_dictionary *dict,
+                                  void          *key,
+                                  void          *value)
+{   /*{{{*/
+    void *ret = dict_put(dict, key, value, dict_hash(dict, key), PUT_IF_ABSENT);
+
+    dict_help_grow(dict);
+    return ret;
+} /*}}}*/
+
+static void *dict_get(qt_dictionary *dict,
+                      void          *key,
+                      const uint64_t hash)
+{   /*{{{*/
+    dict_table *t = dict->table;
+
+    for (;;) {
+        dict_bucket *b = &t->buckets[hash & t->mask];
+        aligned_t    s;
+        list_entry  *e;
+
+retry:
+        s = b->seq;
+        if (s & 1) {
+            SPINLOCK_BODY();
+            goto retry;
+        }
+        DICT_READ_FENCE();
+        e = b->head;
+        DICT_READ_FENCE();
+        if (b->seq != s) { goto retry; }
+        if (e == DICT_MOVED) {
+            t = t->next;
+            continue;
+        }
+        while (e != NULL) {
+            list_entry *next;
+
+            /* e can be unlinked and retired as soon as b->seq moves on, so
+             * hold on to it before reading anything out of it (op_equals()
+             * may take a while, too) */
+            hazardous_ptr(0, e);
+            MACHINE_FENCE;
+            if (b->seq != s) {
+                hazardous_ptr(0, NULL);
+                goto retry;
+            }
+            next = e->next;
+            if ((e->hashed_key == hash) && dict->op_equals(e->key, key)) {
+                void *ret = e->value;
+
+                hazardous_ptr(0, NULL);
+                DICT_READ_FENCE();
+                if (b->seq != s) { goto retry; }
+                return ret;
+            }
+            e = next;
+        }
+        hazardous_ptr(0, NULL);
+        return NULL;
+    }
+} /*}}}*/
+
+void *qt_dictionary_get(qt_dictionary *dict,
+                        void          *key)
+{   /*{{{*/
+    return dict_get(dict, key, dict_hash(dict, key));
+} /*}}}*/
+
+void *qt_dictionary_delete(qt_dictionary *dict,
+                           void          *key)
+{   /*{{{*/
+    const uint64_t hash = dict_hash(dict, key);
+    dict_table    *t;
+    aligned_t      s;
+    dict_bucket   *b      = dict_lock_bucket(dict, hash, &t, &s);
+    list_entry    *to_free = NULL;
+    void          *to_ret  = NULL;
+
+    for (list_entry *volatile *prev = &b->head; *prev != NULL; prev = &(*prev)->next) {
+        list_entry *e = *prev;
+
+        if ((e->hashed_key == hash) && dict->op_equals(e->key, key)) {
+            *prev   = e->next;
+            to_free = e;
+            to_ret  = e->value;
+            break;
+        }
+    }
+    dict_bucket_unlock(b, s);
+    if (to_free != NULL) {
+        dict_count_add(dict, -1);
+        hazardous_release_node(dict_entry_free, to_free);
+    }
+    dict_help_grow(dict);
+    return to_ret;
+} /*}}}*/
+
+size_t qt_dictionary_put_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void *const   *values,
+                              size_t         count,
+                              void         **results)
+{   /*{{{*/
+    size_t done = 0;
+
+    for (size_t base = 0; base < count; base += DICT_BATCH) {
+        const size_t n = (count - base < DICT_BATCH) ? (count - base) : DICT_BATCH;
+        uint64_t     hashes[DICT_BATCH];
+        dict_table  *t = dict->table;
+
+        /* hash the whole batch first, and get its buckets on their way in */
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = dict_hash(dict, keys[base + i]);
+            __builtin_prefetch(&t->buckets[hashes[i] & t->mask], 1);
+        }
+        for (size_t i = 0; i < n; i++) {
+            void *ret = dict_put(dict, keys[base + i], values[base + i], hashes[i], PUT_ALWAYS);
+
+            if (results != NULL) {
+                results[base + i] = ret;
+            }
+            done += (ret != NULL);
+        }
+        /* one growing step per batch, rather than per element */
+        dict_help_grow(dict);
+    }
+    return done;
+} /*}}}*/
+
+size_t qt_dictionary_get_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void         **values,
+                              size_t         count)
+{   /*{{{*/
+    size_t found = 0;
+
+    for (size_t base = 0; base < count; base += DICT_BATCH) {
+        const size_t n = (count - base < DICT_BATCH) ? (count - base) : DICT_BATCH;
+        uint64_t     hashes[DICT_BATCH];
+        dict_table  *t = dict->table;
+
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = dict_hash(dict, keys[base + i]);
+            __builtin_prefetch(&t->buckets[hashes[i] & t->mask], 0);
+        }
+        for (size_t i = 0; i < n; i++) {
+            values[base + i] = dict_get(dict, keys[base + i], hashes[i]);
+            found           += (values[base + i] != NULL);
+        }
+    }
+    return found;
+} /*}}}*/
+
+qt_dictionary_iterator *qt_dictionary_iterator_create(qt_dictionary *dict)
+{   /*{{{*/
+    if(dict == NULL) {
+        return ERROR;
+    }
+    qt_dictionary_iterator *it = (qt_dictionary_iterator *)MALLOC(sizeof(qt_dictionary_iterator));
+    if(it == NULL) {
+        return ERROR; // out of memory
+    }
+    it->dict  = dict;
+    it->crt   = NULL;
+    it->bkt   = 0;
+    it->root  = dict->table;
+    it->depth = 0;
+    return it;
+} /*}}}*/
+
+void qt_dictionary_iterator_destroy(qt_dictionary_iterator *it)
+{   /*{{{*/
+    if(it == NULL) { return; }
+    FREE(it, sizeof(qt_dictionary_iterator));
+} /*}}}*/
+
+list_entry *qt_dictionary_iterator_next(qt_dictionary_iterator *it)
+{   /*{{{*/
+    if((it == NULL) || (it->dict == NULL)) {
+        return ERROR;
+    }
+    if(it->crt != NULL) {
+        it->crt = it->crt->next;
+        if(it->crt != NULL) {
+            return it->crt;
+        }
+    }
+    for(;;) {
+        dict_table *t;
+        size_t      bkt;
+        list_entry *head;
+
+        if(it->depth == 0) {
+            if(it->bkt > it->root->mask) {
+                return NULL;
+            }
+            it->stack[0].t   = it->root;
+            it->stack[0].bkt = it->bkt++;
+            it->depth        = 1;
+        }
+        it->depth--;
+        t    = it->stack[it->depth].t;
+        bkt  = it->stack[it->depth].bkt;
+        head = t->buckets[bkt].head;
+        if(head == DICT_MOVED) {
+            /* the bucket was split in two in the next table */
+            assert(it->depth + 2 <= DICT_ITER_DEPTH);
+            it->stack[it->depth].t       = t->next;
+            it->stack[it->depth].bkt     = bkt + t->mask + 1;
+            it->stack[it->depth + 1].t   = t->next;
+            it->stack[it->depth + 1].bkt = bkt;
+            it->depth                   += 2;
+        } else if(head != NULL) {
+            it->crt = head;
+            return head;
+        }
+    }
+} /*}}}*/
+
+list_entry *qt_dictionary_iterator_get(const qt_dictionary_iterator *it)
+{   /*{{{*/
+    if((it == NULL) || (it->dict == NULL)) {
+        printf(" Inside dictionary get, found NULL, will return ERROR\n");
+        return ERROR;
+    }
+
+    return it->crt;
+} /*}}}*/
+
+qt_dictionary_iterator *qt_dictionary_end(qt_dictionary *dict)
+{   /*{{{*/
+    if(dict == NULL) {
+        return NULL;
+    }
+    qt_dictionary_iterator *it = qt_dictionary_iterator_create(dict);
+    if(it == ERROR) {
+        return NULL;
+    }
+    it->bkt = it->root->mask + 1;
+    return it;
+} /*}}}*/
+
+int qt_dictionary_iterator_equals(qt_dictionary_iterator *a,
+                                  qt_dictionary_iterator *b)
+{   /*{{{*/
+    if ((a == NULL) || (b == NULL)) {
+        return a == b;
+    }
+    return (a->crt == b->crt) && (a->dict == b->dict) && (a->bkt == b->bkt) && (a->depth == b->depth);
+} /*}}}*/
+
+qt_dictionary_iterator *qt_dictionary_iterator_copy(qt_dictionary_iterator *b)
+{   /*{{{*/
+    if(b == NULL) {
+        return NULL;
+    }
+    qt_dictionary_iterator *ret = qt_dictionary_iterator_create(b->dict);
+    if((ret == NULL) || (ret == ERROR)) {
+        return NULL;
+    }
+    memcpy(ret, b, sizeof(qt_dictionary_iterator));
+    return ret;
+} /*}}}*/
+
+void qt_dictionary_printbuckets(qt_dictionary *dict)
+{   /*{{{*/
+    int         total        = 0;
+    int         used_buckets = 0;
+    dict_table *t            = dict->table;
+
+    for(; t != NULL; t = t->next) {
+        for(size_t bucket = 0; bucket <= t->mask; bucket++) {
+            int         no_el = 0;
+            list_entry *walk  = t->buckets[bucket].head;
+
+            if(walk == DICT_MOVED) {
+                continue;
+            }
+            for(; walk != NULL; walk = walk->next) {
+                no_el++;
+            }
+            if (no_el > 0) {
+                printf("Bucket %d has %d elements.\n", (int)bucket, no_el);
+                used_buckets++;
+            }
+            total += no_el;
+        }
+    }
+    printf("used_buckets = %d; total elements = %d;\n", used_buckets, total);
+} /*}}}*/
+
+/* vim:set expandtab: */
@@ -398,6 +398,39 @@ void *qt_dictionary_delete(qt_dictionary *dict,
     if(ret) { return val; } else { return NULL; }
 }
 
+size_t qt_dictionary_put_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void *const   *values,
+                              size_t         count,
+                              void         **results)
+{
+    size_t done = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        void *ret = qt_dictionary_put(dict, keys[i], values[i]);
+
+        if (results != NULL) {
+            results[i] = ret;
+        }
+        done += (ret != NULL);
+    }
+    return done;
+}
+
+size_t qt_dictionary_get_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void         **values,
+                              size_t         count)
+{
+    size_t found = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        values[i] = qt_dictionary_get(dict, keys[i]);
+        found    += (values[i] != NULL);
+    }
+    return found;
+}
+
 static inline size_t GET_PARENT(uint64_t bucket)
 {
     uint64_t t = bucket;
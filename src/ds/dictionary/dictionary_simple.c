@@ -365,6 +365,39 @@ void *qt_dictionary_delete(qt_dictionary *dict,
     return to_ret;
 }
 
+size_t qt_dictionary_put_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void *const   *values,
+                              size_t         count,
+                              void         **results)
+{
+    size_t done = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        void *ret = qt_dictionary_put(dict, keys[i], values[i]);
+
+        if (results != NULL) {
+            results[i] = ret;
+        }
+        done += (ret != NULL);
+    }
+    return done;
+}
+
+size_t qt_dictionary_get_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void         **values,
+                              size_t         count)
+{
+    size_t found = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        values[i] = qt_dictionary_get(dict, keys[i]);
+        found    += (values[i] != NULL);
+    }
+    return found;
+}
+
 qt_dictionary_iterator *qt_dictionary_iterator_create(qt_dictionary *dict)
 {
     if((dict == NULL) || (dict->content == NULL)) {
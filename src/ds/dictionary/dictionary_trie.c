@@ -104,6 +104,9 @@ static inline qt_hash qt_hash_create(qt_dict_key_equals_f eq,
     tmp->op_cleanup = cleanup;
 
     assert(tmp);
+    memset(tmp->base, 0, sizeof(tmp->base));
+    tmp->count     = 0;
+    tmp->numspines = 0;
     tmp->maxspines = getpagesize() / sizeof(spine_element_t *);
     tmp->spines    = (spine_t **) qt_calloc(tmp->maxspines,
                                             sizeof(spine_element_t *));
@@ -526,6 +529,39 @@ void *qt_dictionary_delete(qt_dictionary *dict,
     if(ret) { return val; } else { return NULL; }
 }
 
+size_t qt_dictionary_put_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void *const   *values,
+                              size_t         count,
+                              void         **results)
+{
+    size_t done = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        void *ret = qt_dictionary_put(dict, keys[i], values[i]);
+
+        if (results != NULL) {
+            results[i] = ret;
+        }
+        done += (ret != NULL);
+    }
+    return done;
+}
+
+size_t qt_dictionary_get_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void         **values,
+                              size_t         count)
+{
+    size_t found = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        values[i] = qt_dictionary_get(dict, keys[i]);
+        found    += (values[i] != NULL);
+    }
+    return found;
+}
+
 void *qt_dictionary_get(qt_dictionary *h,
                         const qt_key_t key)
 {
@@ -24,9 +24,19 @@
 #include "qt_alloc.h"
 #include "qt_gcd.h"                    /* for qt_lcm() */
 #include "qt_int_ceil.h"
+#include "qt_affinity.h"               /* for qt_affinity_mem_toshep() */
+#include "qt_envariables.h"
+
+#ifndef MAP_ANONYMOUS
+# define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* the usual transparent huge page size; see QTHREAD_QARRAY_HUGEPAGES */
+#define QARRAY_HUGEPAGE ((size_t)2 << 20)
 
 static unsigned short pageshift                  = 0;
 static aligned_t     *chunk_distribution_tracker = NULL;
+static int            qarray_hugepages           = -1;
 
 /* local funcs */
 /* this function is for DIST *ONLY*; it returns a pointer to the location that
@@ -136,6 +146,148 @@ static inline qthread_shepherd_id_t qarray_internal_shepof_ch(const qarray *a,
     }
 }                                      /*}}} */
 
+/* Which segments each shepherd owns, as runs of consecutive segments, grouped
+ * by shepherd and in order within each shepherd, so that iterating over part
+ * of an array only looks at the segments that are to be visited. It is built
+ * when the array is created; qarray_set_shepof() marks it stale when it moves
+ * a segment, and it is rebuilt by the next iteration (or by
+ * qarray_dist_like(), once it has moved everything). Like the rest of the
+ * distribution, it must not be changed while the array is being iterated
+ * over; but two iterations can both find it stale, and one of them may still
+ * be walking the index that the other replaces, so replaced indices are kept
+ * (chained off the current one) until the array is destroyed. */
+struct qarray_seg_run {
+    size_t start, stop;                /* segments [start, stop) */
+};
+struct qarray_seg_index_s {
+    size_t                     bytes;      /* of the whole allocation */
+    struct qarray_seg_index_s *replaced;   /* the index this one replaced */
+    size_t                    *shep_first; /* shepherd s's runs are runs[shep_first[s]] up to runs[shep_first[s+1]] */
+    struct qarray_seg_run     *runs;
+};
+
+static struct qarray_seg_index_s *qarray_internal_index_build(const qarray *a)
+{                                      /*{{{ */
+    const qthread_shepherd_id_t maxsheps      = qthread_num_shepherds();
+    const size_t                segment_count = QT_CEIL_RATIO(a->count, a->segment_size);
+    size_t                     *cursor        = qt_calloc(maxsheps + 1, sizeof(size_t));
+    struct qarray_seg_index_s  *idx           = NULL;
+    size_t                      nruns         = 0, bytes;
+
+    assert(cursor);
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t seg = 0, end; seg < segment_count; seg = end) {
+            const qthread_shepherd_id_t shep = qarray_internal_shepof_segidx(a, seg);
+
+            assert(shep < maxsheps);
+            end = seg + 1;
+            while (end < segment_count && qarray_internal_shepof_segidx(a, end) == shep) {
+                end++;
+            }
+            if (pass == 0) {
+                cursor[shep]++;
+                nruns++;
+            } else {
+                idx->runs[cursor[shep]].start = seg;
+                idx->runs[cursor[shep]].stop  = end;
+                cursor[shep]++;
+            }
+        }
+        if (pass == 0) {
+            bytes = sizeof(struct qarray_seg_index_s) + (maxsheps + 1) * sizeof(size_t) +
+                    nruns * sizeof(struct qarray_seg_run);
+            idx = MALLOC(bytes);
+            assert(idx);
+            idx->bytes      = bytes;
+            idx->shep_first = (size_t *)(idx + 1);
+            idx->runs       = (struct qarray_seg_run *)(idx->shep_first + maxsheps + 1);
+            for (qthread_shepherd_id_t s = 0, sum = 0; s <= maxsheps; s++) {
+                const size_t n = cursor[s];
+
+                idx->shep_first[s] = cursor[s] = sum;
+                sum                += n;
+            }
+        }
+    }
+    FREE(cursor, (maxsheps + 1) * sizeof(size_t));
+    return idx;
+}                                      /*}}} */
+
+static const struct qarray_seg_index_s *qarray_internal_index(const qarray *ca)
+{                                      /*{{{ */
+    qarray                    *a   = (qarray *)ca; /* the index is only a cache */
+    struct qarray_seg_index_s *idx = a->seg_index;
+
+    if ((idx == NULL) || a->seg_index_stale) {
+        struct qarray_seg_index_s *fresh;
+
+        /* clear it first, so that a move made while rebuilding isn't lost */
+        (void)qthread_cas(&a->seg_index_stale, 1, 0);
+        fresh           = qarray_internal_index_build(a);
+        fresh->replaced = idx;
+        if (qthread_cas_ptr(&a->seg_index, idx, fresh) == idx) {
+            idx = fresh;
+        } else {
+            FREE(fresh, fresh->bytes);
+            idx = a->seg_index;
+        }
+    }
+    return idx;
+}                                      /*}}} */
+
+static QINLINE size_t qarray_internal_body_bytes(const qarray *a)
+{                                      /*{{{ */
+    return QT_CEIL_RATIO(a->count, a->segment_size) * a->segment_bytes;
+}                                      /*}}} */
+
+/* The body of an array is mapped rather than allocated, so that none of it
+ * has been touched when each segment's pages are bound to its shepherd's
+ * memory. With huge pages, it is aligned to (and segments are a multiple of)
+ * the huge page size, so that binding a segment doesn't split any up. */
+static void *qarray_internal_map(const size_t bytes,
+                                 const int    hugepages)
+{                                      /*{{{ */
+    const size_t align  = hugepages ? QARRAY_HUGEPAGE : pagesize;
+    const size_t maplen = bytes + align - pagesize;
+    char        *map    = mmap(NULL, maplen, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    char        *ret;
+
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    ret = (char *)(((uintptr_t)map + align - 1) & ~(uintptr_t)(align - 1));
+    if (ret > map) {
+        munmap(map, ret - map);
+    }
+    if (map + maplen > ret + bytes) {
+        munmap(ret + bytes, (map + maplen) - (ret + bytes));
+    }
+#ifdef MADV_HUGEPAGE
+    if (hugepages) {
+        (void)madvise(ret, bytes, MADV_HUGEPAGE);
+    }
+#endif
+    return ret;
+}                                      /*}}} */
+
+/* places segments [first, last), all of which belong to shep, before anything
+ * has touched them; DIST segments also get their owner recorded (which is
+ * the first touch) */
+static void qarray_internal_place(qarray                     *a,
+                                  const size_t                first,
+                                  const size_t                last,
+                                  const qthread_shepherd_id_t shep)
+{                                      /*{{{ */
+    qt_affinity_mem_toshep(a->base_ptr + first * a->segment_bytes,
+                           (last - first) * a->segment_bytes, shep);
+    if (a->dist_type == DIST) {
+        for (size_t seg = first; seg < last; seg++) {
+            qarray_internal_segment_shep_write(a, a->base_ptr + seg * a->segment_bytes, shep);
+        }
+    }
+}                                      /*}}} */
+
 static void qarray_free_cdt(void)
 {                                      /*{{{ */
     if (chunk_distribution_tracker != NULL) {
@@ -152,6 +304,7 @@ static qarray *qarray_create_internal(const size_t         count,
 {                               /*{{{ */
     size_t  segment_count;      /* number of segments allocated */
     qarray *ret = NULL;
+    int     hugepages;
 
     qassert_ret((count > 0), NULL);
     qassert_ret((obj_size > 0), NULL);
@@ -173,7 +326,12 @@ static qarray *qarray_create_internal(const size_t         count,
             atexit(qarray_free_cdt);
         }
     }
-    ret = qt_calloc(1, sizeof(qarray));
+    if (qarray_hugepages < 0) {
+        qarray_hugepages = qt_internal_get_env_bool("QARRAY_HUGEPAGES", 0);
+    }
+    /* not worth it unless the array fills at least one */
+    hugepages = qarray_hugepages && (count * obj_size >= QARRAY_HUGEPAGE);
+    ret       = qt_calloc(1, sizeof(qarray));
     qassert_goto((ret != NULL), badret_exit);
 
     ret->count = count;
@@ -205,7 +363,7 @@ static qarray *qarray_create_internal(const size_t         count,
         case FIXED_HASH:
         default:
             if (seg_pages == 0) {
-                ret->segment_bytes = 16 * pagesize;
+                ret->segment_bytes = hugepages ? QARRAY_HUGEPAGE : 16 * pagesize;
                 if (ret->unit_size > ret->segment_bytes) {
                     ret->segment_bytes = qt_lcm(ret->unit_size, pagesize);
                 }
@@ -227,7 +385,7 @@ static qarray *qarray_create_internal(const size_t         count,
              * by 1 (thus providing space for the shepherd identifier, as long
              * as the unit-size is bigger than a shepherd identifier). */
             if (seg_pages == 0) {
-                ret->segment_bytes = 16 * pagesize;
+                ret->segment_bytes = hugepages ? QARRAY_HUGEPAGE : 16 * pagesize;
             } else {
                 ret->segment_bytes = seg_pages * pagesize;
             }
@@ -322,50 +480,14 @@ static qarray *qarray_create_internal(const size_t         count,
         default:
             ret->dist_specific.dist_shep = NO_SHEPHERD;
     }
-#ifdef QTHREAD_HAVE_MEM_AFFINITY
-    switch (d) {
-        case ALL_LOCAL:
-        case ALL_RAND:
-        case ALL_LEAST:
-        case ALL_SAME:
-        default:
-            if (qthread_internal_shep_to_node(ret->dist_specific.dist_shep) ==
-                QTHREAD_NO_NODE) {
-                case DIST_STRIPES:
-                case DIST_FIELDS:
-                case DIST_RAND:
-                case DIST_LEAST:
-                case DIST:
-                case FIXED_FIELDS:
-                case FIXED_HASH:
-                    ret->base_ptr =
-                        (char *)qt_affinity_alloc(segment_count * ret->segment_bytes);
-                    break;
-            } else {
-                ret->base_ptr =
-                    (char *)qt_affinity_alloc_onnode(segment_count *
-                                                     ret->segment_bytes,
-                                                     qthread_internal_shep_to_node
-                                                         (ret->dist_specific.dist_shep));
-            }
-            break;
-    }
-    if (ret->base_ptr == NULL) {
-# ifdef QTHREAD_HAVE_LIBNUMA
-        numa_error("allocating qarray body");
-# endif
-    }
-#else /* ifdef QTHREAD_HAVE_MEM_AFFINITY */
-      /* For speed, we want page-aligned memory, if we can get it */
-    ret->base_ptr = qt_internal_aligned_alloc(segment_count * ret->segment_bytes, pagesize);
-#endif  /* ifdef QTHREAD_HAVE_MEM_AFFINITY */
+    ret->base_ptr = qarray_internal_map(segment_count * ret->segment_bytes, hugepages);
     qassert_goto((ret->base_ptr != NULL), badret_exit);
 
     /********************************************
     * Assign locations, maintain segment_count *
     ********************************************/
     {
-        size_t                      segment, target_shep;
+        size_t                      segment, target_shep, run_start = 0, run_shep = 0;
         const qthread_shepherd_id_t max_sheps = qthread_num_shepherds();
 
         qthread_debug(QARRAY_DETAILS, "qarray_create(): segment_count = %i\n",
@@ -412,31 +534,19 @@ static qarray *qarray_create_internal(const size_t         count,
                     assert(ret->dist_type == ALL_SAME);
                     target_shep = ret->dist_specific.dist_shep;
             }
-            if (ret->dist_type == DIST) {
-                char *seghead =
-                    qarray_elem_nomigrate(ret, segment * ret->segment_size);
-                qarray_internal_segment_shep_write(ret, seghead, target_shep);
-            }
             assert(target_shep < max_sheps);
             qthread_debug(QARRAY_DETAILS,
                           "qarray_create(): segment %i assigned to shep %i\n",
                           segment, target_shep);
-#ifdef QTHREAD_HAVE_MEM_AFFINITY
-            {
-                /* make sure this shep has a node; if it does, put this segment there */
-                unsigned int target_node =
-                    qthread_internal_shep_to_node(target_shep);
-                if (target_node != QTHREAD_NO_NODE) {
-                    char *seghead = qarray_elem_nomigrate(ret,
-                                                          segment *
-                                                          ret->segment_size);
-                    qt_affinity_mem_tonode(seghead, ret->segment_bytes,
-                                           target_node);
-                }
+            /* place the segments a run of them at a time */
+            if ((segment > run_start) && (target_shep != run_shep)) {
+                qarray_internal_place(ret, run_start, segment, run_shep);
+                run_start = segment;
             }
-#endif      /* ifdef QTHREAD_HAVE_MEM_AFFINITY */
+            run_shep = target_shep;
             qthread_incr(&chunk_distribution_tracker[target_shep], 1);
         }
+        qarray_internal_place(ret, run_start, segment_count, run_shep);
     }
 #if defined(HAVE_MADVISE) && HAVE_DECL_MADV_ACCESS_LWP
     madvise(ret->base_ptr, segment_count * ret->segment_bytes, MADV_ACCESS_LWP);
@@ -446,6 +556,7 @@ static qarray *qarray_create_internal(const size_t         count,
                       "qarray_create(): shep %i has %i segments\n", i,
                       chunk_distribution_tracker[i]);
     }
+    qarray_internal_index(ret);
     qthread_debug(QARRAY_DETAILS,
                   "qarray_create(): done assigning segments, returning\n");
     return ret;
@@ -453,7 +564,7 @@ static qarray *qarray_create_internal(const size_t         count,
     qgoto(badret_exit);
     if (ret) {
         if (ret->base_ptr) {
-            qt_free(ret->base_ptr);
+            munmap(ret->base_ptr, qarray_internal_body_bytes(ret));
         }
         FREE(ret, sizeof(qarray));
     }
@@ -535,13 +646,13 @@ void qarray_destroy(qarray *a)
                                ((a->count % a->segment_size) ? 1 : 0)));
             break;
     }
-#ifdef QTHREAD_HAVE_MEM_AFFINITY
-    qt_affinity_free(a->base_ptr,
-                     a->segment_bytes * (a->count / a->segment_size +
-                                         ((a->count % a->segment_size) ? 1 : 0)));
-#else
-    qt_internal_aligned_free(a->base_ptr, pagesize);
-#endif
+    munmap(a->base_ptr, qarray_internal_body_bytes(a));
+    while (a->seg_index != NULL) {
+        struct qarray_seg_index_s *idx = a->seg_index;
+
+        a->seg_index = idx->replaced;
+        FREE(idx, idx->bytes);
+    }
     FREE(a, sizeof(qarray));
 }                                      /*}}} */
 
@@ -591,451 +702,257 @@ void *qarray_elem_migrate(const qarray *a,
     return ret;
 }                                      /*}}} */
 
-struct qarray_func_wrapper_args {
-    union {
-        qa_loop_f ql;
-        qthread_f qt;
-    } func;
-    qarray      *a;
-    void        *arg;
-    aligned_t   *donecount;
-    const size_t startat, stopat;
+/* Iteration hands each shepherd only the segments it owns, straight from the
+ * index, and a shepherd with more than one of them in the range splits them
+ * (at segment boundaries) among its workers. */
+enum qarray_visit_kind {
+    QARRAY_VISIT_ELEMS,                /* func.qt on each element */
+    QARRAY_VISIT_LOOP,                 /* func.ql on ranges */
+    QARRAY_VISIT_ACCUM                 /* func.qlr on ranges, combined with acc */
 };
-struct qarray_accumfunc_wrapper_args {
+struct qarray_visit_args {
     union {
-        qa_loopr_f ql;
-    } func;
-    qt_accum_f acc;
-    qarray    *a;
-    void      *arg;
-    void      *ret;
-    size_t     startat, stopat, retsize;
-};
-struct qarray_constfunc_wrapper_args {
-    const union {
-        qa_cloop_f ql;
         qthread_f  qt;
+        qa_loop_f  ql;
+        qa_loopr_f qlr;
     } func;
-    const qarray *a;
-    void         *arg;
-    aligned_t    *donecount;
-    const size_t  startat, stopat;
+    enum qarray_visit_kind           kind;
+    qarray                          *a;
+    void                            *arg;
+    qt_accum_f                       acc;
+    size_t                           retsize;
+    size_t                           startat, stopat;
+    size_t                           startseg, stopseg;
+    const struct qarray_seg_index_s *idx;
+};
+struct qarray_slice_args {
+    const struct qarray_visit_args *v;
+    qthread_shepherd_id_t           shep;
+    size_t                          first_run; /* the shepherd's first run that reaches the range */
+    size_t                          skip, take; /* which of its segments in the range are this slice's */
+    void                           *ret;
 };
 
-static aligned_t qarray_strider(const struct qarray_func_wrapper_args *arg)
-{                                      /*{{{ */
-    const size_t                segment_size = arg->a->segment_size;
-    const distribution_t        dist_type    = arg->a->dist_type;
-    const qthread_shepherd_id_t shep         = qthread_shep();
-    size_t                      max_count    = arg->stopat;
-    size_t                      count        = arg->startat;
-
-    /* all striders get the same count/max_count, so we have to find our own
-     * starting point based on this thread's shep */
-    switch (dist_type) {
-        case ALL_SAME:
-            if (shep != arg->a->dist_specific.dist_shep) {
-                goto qarray_strider_exit;
+static QINLINE void qarray_visit_range(const struct qarray_visit_args *v,
+                                       const size_t                    lo,
+                                       const size_t                    hi,
+                                       void                           *ret,
+                                       char                          **tmpret,
+                                       int                            *first)
+{   /*{{{*/
+    switch (v->kind) {
+        case QARRAY_VISIT_ELEMS:
+            for (size_t i = lo; i < hi; i++) {
+                void *ptr = qarray_elem_nomigrate(v->a, i);
+
+                assert(ptr != NULL);   // aka internal error
+                v->func.qt(ptr);
             }
             break;
-        case FIXED_FIELDS:
-        {
-            qthread_shepherd_id_t start_shep = qarray_shepof(arg->a, count);
-            qthread_shepherd_id_t stop_shep  =
-                qarray_shepof(arg->a, max_count - 1);
-            if ((shep < start_shep) || (shep > stop_shep)) {
-                goto qarray_strider_exit;
-            }
-            if (shep != start_shep) {
-                /* count isn't *my* starting point, but I am within the
-                 * range of interest, so find my starting point. */
-                size_t extras        = arg->a->dist_specific.stripes.extras;
-                size_t segs_per_shep =
-                    arg->a->dist_specific.stripes.segs_per_shep;
-                /* this relies on sheps being zero-indexed */
-                if (shep < extras) {
-                    count = shep * segment_size * (segs_per_shep + 1);
-                } else {
-                    count =
-                        (extras * segment_size * (segs_per_shep + 1)) +
-                        ((shep - extras) * segment_size * segs_per_shep);
-                }
-            }
-            {
-                size_t segs_on_this_shep =
-                    arg->a->dist_specific.stripes.segs_per_shep;
-                size_t last_count_on_this_shep;
-                if (shep < arg->a->dist_specific.stripes.extras) {
-                    segs_on_this_shep++;
-                }
-                last_count_on_this_shep =
-                    count + ((segment_size * segs_on_this_shep) - 1);
-                if (max_count > last_count_on_this_shep) {
-                    max_count = last_count_on_this_shep + 1;
-                }
-            }
+        case QARRAY_VISIT_LOOP:
+            v->func.ql(lo, hi, v->a, v->arg);
             break;
-        }
-        default:                       // use this when our starting point is somewhat unpredictable
-            if ((count > 0) && (qarray_shepof(arg->a, count) != shep)) {
-                /* jump to the next segment boundary */
-                count += segment_size - (count % segment_size);
-                if (count >= max_count) {
-                    goto qarray_strider_exit;
-                }
-            }
-            while (qarray_shepof(arg->a, count) != shep) {
-                count += segment_size;
-                if (count >= max_count) {
-                    goto qarray_strider_exit;
+        case QARRAY_VISIT_ACCUM:
+            if (*first) {
+                v->func.qlr(lo, hi, v->a, v->arg, ret);
+                *first = 0;
+            } else {
+                if (*tmpret == NULL) {
+                    *tmpret = MALLOC(v->retsize);
+                    assert(*tmpret);
                 }
+                v->func.qlr(lo, hi, v->a, v->arg, *tmpret);
+                v->acc(ret, *tmpret);
             }
             break;
     }
-    /* at this point...
-     * 1. cursor points to the first element of the array associated with this CPU
-     * 2. count is the index of that element
-     */
-    while (1) {
-        size_t       inpage_offset;
-        const size_t max_offset =
-            ((max_count - count) >
-             segment_size) ? segment_size : (max_count - count);
-
-        for (inpage_offset = 0; inpage_offset < max_offset; inpage_offset++) {
-            void *ptr = qarray_elem_nomigrate(arg->a, count + inpage_offset);
-
-            assert(ptr != NULL);       // aka internal error
-            arg->func.qt(ptr);
-        }
-        switch (dist_type) {
-            case FIXED_FIELDS:
-            case ALL_SAME:
-                count += segment_size;
-                break;
-            case FIXED_HASH:
-            default:
-                count += segment_size * qthread_num_shepherds();
-                break;
-            case DIST:                 /* XXX: this is awful - slow and bad for cache */
-                count += segment_size;
-                if (count >= max_count) {
-                    goto qarray_strider_exit;
-                }
-                while (qarray_shepof(arg->a, count) != shep) {
-                    count += segment_size;
-                    if (count >= max_count) {
-                        goto qarray_strider_exit;
-                    }
-                }
-                break;
-        }
-        if (count >= max_count) {
-            goto qarray_strider_exit;
-        }
-    }
-qarray_strider_exit:
-    qthread_incr(arg->donecount, 1);
-    return 0;
-}                                      /*}}} */
+} /*}}}*/
 
-static aligned_t qarray_loop_strider(const struct qarray_func_wrapper_args *arg)
-{                                      /*{{{ */
-    const size_t                segment_size = arg->a->segment_size;
-    const distribution_t        dist_type    = arg->a->dist_type;
-    const qthread_shepherd_id_t shep         = qthread_shep();
-    size_t                      max_count    = arg->stopat;
-    size_t                      count        = arg->startat;
-    const qa_loop_f             ql           = arg->func.ql;
-
-    /* all striders get the same count/max_count, so we have to find our own
-     * starting point based on this thread's shep */
-    switch (dist_type) {
-        case ALL_SAME:
-            if (shep != arg->a->dist_specific.dist_shep) {
-                goto qarray_loop_strider_exit;
-            }
-            break;
-        case FIXED_FIELDS:
+static aligned_t qarray_slice(struct qarray_slice_args *arg)
+{   /*{{{*/
+    const struct qarray_visit_args  *v        = arg->v;
+    const struct qarray_seg_index_s *idx      = v->idx;
+    const size_t                     segsize  = v->a->segment_size;
+    const size_t                     last_run = idx->shep_first[arg->shep + 1];
+    size_t                           skip     = arg->skip;
+    size_t                           take     = arg->take;
+    char                            *tmpret   = NULL;
+    int                              first    = 1;
+    /* ALL_SAME and FIXED_FIELDS have always handed loop functions whole
+     * stretches of the array; the others get a segment at a time */
+    const int contiguous = (v->a->dist_type == ALL_SAME ||
+                            v->a->dist_type == FIXED_FIELDS);
+
+    for (size_t r = arg->first_run; take > 0 && r < last_run; r++) {
+        size_t s = idx->runs[r].start, e = idx->runs[r].stop;
+
+        if (s < v->startseg) { s = v->startseg; }
+        if (e > v->stopseg) { e = v->stopseg; }
+        if (s >= e) { break; }         /* runs are in order */
+        if (skip >= e - s) {
+            skip -= e - s;
+            continue;
+        }
+        s   += skip;
+        skip = 0;
+        if (e - s > take) { e = s + take; }
+        take -= e - s;
         {
-            qthread_shepherd_id_t start_shep = qarray_shepof(arg->a, count);
-            qthread_shepherd_id_t stop_shep  =
-                qarray_shepof(arg->a, max_count - 1);
-            if ((shep < start_shep) || (shep > stop_shep)) {
-                goto qarray_loop_strider_exit;
-            }
-            if (shep != start_shep) {
-                /* count isn't *my* starting point, but I am within the
-                 * range of interest, so find my starting point. */
-                /* this relies on sheps being zero-indexed */
-                count =
-                    shep * segment_size *
-                    arg->a->dist_specific.stripes.segs_per_shep;
-            }
-            {
-                size_t last_count_on_my_shep =
-                    ((shep +
-                      1) * segment_size *
-                     arg->a->dist_specific.stripes.segs_per_shep) - 1;
-                if (max_count > last_count_on_my_shep) {
-                    max_count = last_count_on_my_shep;
+            size_t       lo = s * segsize;
+            const size_t hi = (e * segsize < v->stopat) ? e * segsize : v->stopat;
+
+            if (lo < v->startat) { lo = v->startat; }
+            if (contiguous) {
+                qarray_visit_range(v, lo, hi, arg->ret, &tmpret, &first);
+            } else {
+                while (lo < hi) {
+                    const size_t segend = (lo / segsize + 1) * segsize;
+                    const size_t stop   = (segend < hi) ? segend : hi;
+
+                    qarray_visit_range(v, lo, stop, arg->ret, &tmpret, &first);
+                    lo = stop;
                 }
             }
-            break;
         }
-        default:
-            if ((count > 0) && (qarray_shepof(arg->a, count) != shep)) {
-                /* jump to the next segment boundary */
-                count += segment_size - (count % segment_size);
-                if (count >= max_count) {
-                    goto qarray_loop_strider_exit;
-                }
-            }
-            while (qarray_shepof(arg->a, count) != shep) {
-                count += segment_size;
-                if (count >= max_count) {
-                    goto qarray_loop_strider_exit;
-                }
-            }
     }
-    assert(count < max_count);
-    /* at this point...
-     * 1. cursor points to the first element of the array associated with this CPU
-     * 2. count is the index of that element
-     */
-    switch (dist_type) {
-        /* special case: all the work is contiguous, so we can hand it to the
-         * loop function directly */
-        case ALL_SAME:
-        case FIXED_FIELDS:
-            ql(count, max_count, arg->a, arg->arg);
-            goto qarray_loop_strider_exit;
-        default:                       /* aka NOT the special case */
-            break;
+    if (tmpret != NULL) {
+        FREE(tmpret, v->retsize);
     }
-    while (1) {
-        {
-            const size_t max_offset =
-                ((max_count - count) >
-                 segment_size) ? segment_size : (max_count - count);
-            ql(count, count + max_offset, arg->a, arg->arg);
+    return 0;
+} /*}}}*/
+
+/* runs on the shepherd whose segments these are */
+static aligned_t qarray_shep_visit(struct qarray_slice_args *arg)
+{   /*{{{*/
+    const struct qarray_visit_args  *v        = arg->v;
+    const struct qarray_seg_index_s *idx      = v->idx;
+    const size_t                     last_run = idx->shep_first[arg->shep + 1];
+    size_t                           nsegs    = 0;
+    size_t                           nslices  = qthread_num_workers_local(arg->shep);
+
+    for (size_t r = arg->first_run; r < last_run; r++) {
+        const size_t s = (idx->runs[r].start > v->startseg) ? idx->runs[r].start : v->startseg;
+        const size_t e = (idx->runs[r].stop < v->stopseg) ? idx->runs[r].stop : v->stopseg;
+
+        if (s >= e) { break; }
+        nsegs += e - s;
+    }
+    if (nslices > nsegs) { nslices = nsegs; }
+    if (nslices <= 1) {
+        arg->skip = 0;
+        arg->take = nsegs;
+        return qarray_slice(arg);
+    } else {
+        struct qarray_slice_args *slices = MALLOC(sizeof(struct qarray_slice_args) * nslices);
+        aligned_t                *rv     = MALLOC(sizeof(aligned_t) * nslices);
+        char                     *rets   = NULL;
+
+        assert(slices && rv);
+        if (v->kind == QARRAY_VISIT_ACCUM) {
+            rets = MALLOC(v->retsize * (nslices - 1));
+            assert(rets);
         }
-        switch (dist_type) {
-            default:
-                QTHREAD_TRAP();
-                break;
-            case FIXED_HASH:
-                count += segment_size * qthread_num_shepherds();
-                break;
-            case DIST:                 /* XXX: this is awful - slow and bad for cache */
-                count += segment_size;
-                if (count >= max_count) {
-                    goto qarray_loop_strider_exit;
-                }
-                while (qarray_shepof(arg->a, count) != shep) {
-                    count += segment_size;
-                    if (count >= max_count) {
-                        goto qarray_loop_strider_exit;
-                    }
-                }
-                break;
+        for (size_t i = 0; i < nslices; i++) {
+            slices[i]      = *arg;
+            slices[i].skip = nsegs * i / nslices;
+            slices[i].take = nsegs * (i + 1) / nslices - slices[i].skip;
+            if (i > 0) {
+                if (rets) { slices[i].ret = rets + (i - 1) * v->retsize; }
+                qthread_fork_to((qthread_f)qarray_slice, slices + i, rv + i, arg->shep);
+            }
         }
-        if (count >= max_count) {
-            goto qarray_loop_strider_exit;
+        qarray_slice(slices);
+        for (size_t i = 1; i < nslices; i++) {
+            qthread_readFF(NULL, rv + i);
+            if (rets) { v->acc(arg->ret, slices[i].ret); }
         }
+        if (rets) { FREE(rets, v->retsize * (nslices - 1)); }
+        FREE(rv, sizeof(aligned_t) * nslices);
+        FREE(slices, sizeof(struct qarray_slice_args) * nslices);
     }
-qarray_loop_strider_exit:
-    qthread_incr(arg->donecount, 1);
     return 0;
-}                                      /*}}} */
+} /*}}}*/
 
-static aligned_t qarray_loopaccum_strider(const struct qarray_accumfunc_wrapper_args *arg)
-{                                      /*{{{ */
-    const size_t                segment_size = arg->a->segment_size;
-    const distribution_t        dist_type    = arg->a->dist_type;
-    const qthread_shepherd_id_t shep         = qthread_shep();
-    const qt_accum_f            acc          = arg->acc;
-    const qa_loopr_f            ql           = arg->func.ql;
-    size_t                      max_count    = arg->stopat;
-    size_t                      count        = arg->startat;
-    char                       *myret        = arg->ret;
-    char                       *tmpret       = NULL;
-    char                        first        = 1;
-
-    switch (dist_type) {
-        case ALL_SAME:
-            if (shep != arg->a->dist_specific.dist_shep) {
-                goto qarray_loop_strider_exit;
-            }
-            break;
-        case FIXED_FIELDS:
-        {
-            qthread_shepherd_id_t start_shep = qarray_shepof(arg->a, count);
-            qthread_shepherd_id_t stop_shep  =
-                qarray_shepof(arg->a, max_count - 1);
-            if ((shep < start_shep) || (shep > stop_shep)) {
-                goto qarray_loop_strider_exit;
-            }
-            if (shep != start_shep) {
-                /* count isn't *my* starting point, but I am within the
-                 * range of interest, so find my starting point. */
-                /* this relies on sheps being zero-indexed */
-                count =
-                    shep * segment_size *
-                    arg->a->dist_specific.stripes.segs_per_shep;
-            }
-            {
-                size_t last_count_on_my_shep =
-                    ((shep +
-                      1) * segment_size *
-                     arg->a->dist_specific.stripes.segs_per_shep) - 1;
-                if (max_count > last_count_on_my_shep) {
-                    max_count = last_count_on_my_shep;
-                }
+/* Spawns to each shepherd that owns part of [startat, stopat), and waits.
+ * For QARRAY_VISIT_ACCUM, ret receives the shepherds' results, combined in
+ * shepherd order. */
+static void qarray_visit(struct qarray_visit_args *v,
+                         void                     *ret)
+{   /*{{{*/
+    const qthread_shepherd_id_t      maxsheps = qthread_num_shepherds();
+    const struct qarray_seg_index_s *idx;
+    struct qarray_slice_args        *sheps;
+    aligned_t                       *rv;
+    char                            *rets = NULL;
+    int                              first = 1;
+
+    if (v->startat >= v->stopat) { return; }
+    idx         = qarray_internal_index(v->a);
+    v->idx      = idx;
+    v->startseg = v->startat / v->a->segment_size;
+    v->stopseg  = QT_CEIL_RATIO(v->stopat, v->a->segment_size);
+    sheps       = MALLOC(sizeof(struct qarray_slice_args) * maxsheps);
+    rv          = MALLOC(sizeof(aligned_t) * maxsheps);
+    assert(sheps && rv);
+    if (v->kind == QARRAY_VISIT_ACCUM) {
+        rets = MALLOC(v->retsize * maxsheps);
+        assert(rets);
+    }
+    for (qthread_shepherd_id_t s = 0; s < maxsheps; s++) {
+        /* find the first of this shepherd's runs that ends after startseg */
+        size_t lo = idx->shep_first[s], hi = idx->shep_first[s + 1];
+
+        while (lo < hi) {
+            const size_t mid = lo + (hi - lo) / 2;
+
+            if (idx->runs[mid].stop <= v->startseg) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
             }
-            break;
         }
-        default:
-            if ((count > 0) && (qarray_shepof(arg->a, count) != shep)) {
-                /* jump to the next segment boundary */
-                count += segment_size - (count % segment_size);
-                if (count >= max_count) {
-                    goto qarray_loop_strider_exit;
-                }
-            }
-            while (qarray_shepof(arg->a, count) != shep) {
-                count += segment_size;
-                if (count >= max_count) {
-                    goto qarray_loop_strider_exit;
-                }
-            }
-    }
-    assert(count < max_count);
-    /* at this point...
-     * 1. cursor points to the first element of the array associated with this CPU
-     * 2. count is the index of that element
-     */
-    switch (dist_type) {
-        /* special case: all the work is contiguous, so we can hand it to the
-         * loop function directly */
-        case ALL_SAME:
-        case FIXED_FIELDS:
-            ql(count, max_count, arg->a, arg->arg, arg->ret);
-            goto qarray_loop_strider_exit;
-        default:                       /* aka NOT the special case */
-            break;
+        sheps[s].v = NULL;
+        if ((lo < idx->shep_first[s + 1]) && (idx->runs[lo].start < v->stopseg)) {
+            sheps[s].v         = v;
+            sheps[s].shep      = s;
+            sheps[s].first_run = lo;
+            sheps[s].ret       = rets ? rets + s * v->retsize : NULL;
+            qthread_fork_to((qthread_f)qarray_shep_visit, sheps + s, rv + s, s);
+        }
     }
-    tmpret = MALLOC(arg->retsize);
-    assert(tmpret);
-    while (1) {
-        {
-            const size_t max_offset =
-                ((max_count - count) >
-                 segment_size) ? segment_size : (max_count - count);
+    for (qthread_shepherd_id_t s = 0; s < maxsheps; s++) {
+        if (sheps[s].v == NULL) { continue; }
+        qthread_readFF(NULL, rv + s);
+        if (rets) {
             if (first) {
-                ql(count, count + max_offset, arg->a, arg->arg, myret);
+                memcpy(ret, sheps[s].ret, v->retsize);
                 first = 0;
             } else {
-                ql(count, count + max_offset, arg->a, arg->arg, tmpret);
-                acc(myret, tmpret);
+                v->acc(ret, sheps[s].ret);
             }
         }
-        switch (dist_type) {
-            default:
-                /* This should never happen, so deliberately cause a seg fault
-                 * for corefile analysis */
-                QTHREAD_TRAP();
-                break;
-            case FIXED_HASH:
-                count += segment_size * qthread_num_shepherds();
-                break;
-            case DIST:                 /* XXX: this is awful - slow and bad for cache */
-                count += segment_size;
-                if (count >= max_count) {
-                    goto qarray_loop_strider_exit;
-                }
-                while (qarray_shepof(arg->a, count) != shep) {
-                    count += segment_size;
-                    if (count >= max_count) {
-                        goto qarray_loop_strider_exit;
-                    }
-                }
-                break;
-        }
-        if (count >= max_count) {
-            goto qarray_loop_strider_exit;
-        }
-    }
-qarray_loop_strider_exit:
-    if (tmpret != NULL) {
-        FREE(tmpret, arg->retsize);
     }
-    return 0;
-}                                      /*}}} */
+    if (rets) { FREE(rets, v->retsize * maxsheps); }
+    FREE(rv, sizeof(aligned_t) * maxsheps);
+    FREE(sheps, sizeof(struct qarray_slice_args) * maxsheps);
+} /*}}}*/
 
 void qarray_iter(qarray      *a,
                  const size_t startat,
                  const size_t stopat,
                  qthread_f    func)
 {                                      /*{{{ */
-    aligned_t                       donecount = 0;
-    struct qarray_func_wrapper_args qfwa      = { { NULL }, a, NULL, &donecount, startat, stopat };
+    struct qarray_visit_args v = { 0 };
 
     qassert_retvoid((a != NULL));
     qassert_retvoid((func != NULL));
     qassert_retvoid((startat <= stopat));
-    qfwa.func.qt = func;
-    switch (a->dist_type) {
-        case ALL_SAME:
-            qthread_fork_to((qthread_f)qarray_strider, &qfwa, NULL,
-                            a->dist_specific.dist_shep);
-            while (donecount == 0) {
-                qthread_yield();
-            }
-            break;
-        case FIXED_FIELDS:
-        {
-            qthread_shepherd_id_t start_shep = qarray_shepof(a, startat);
-            qthread_shepherd_id_t stop_shep  = qarray_shepof(a, stopat - 1);
-            size_t                num_spawns = 0;
-            for (qthread_shepherd_id_t s = start_shep; s <= stop_shep; s++) {
-                qthread_fork_to((qthread_f)qarray_strider, &qfwa, NULL, s);
-                num_spawns++;
-            }
-            while (donecount < num_spawns) {
-                qthread_yield();
-            }
-            break;
-        }
-        default:
-            /* it'd be NICE to avoid spawning if not all sheps are represented
-             * in the range (esp if the range is small), but because of
-             * DIST_RAND, that's impossible to do without checking all the
-             * ranges ahead of time. By spawning threads that check their own
-             * ranges, we essentially parallelize the task of figuring out
-             * which threads to spawn (bizarre way of thinking about it, I
-             * know). */
-            if (stopat - startat < a->segment_size) {
-                qthread_fork_to((qthread_f)qarray_strider, &qfwa, NULL,
-                                qarray_shepof(a, startat));
-                while (donecount == 0) {
-                    qthread_yield();
-                }
-            } else {
-                qthread_shepherd_id_t       i;
-                const qthread_shepherd_id_t maxsheps =
-                    qthread_num_shepherds();
-
-                for (i = 0; i < maxsheps; i++) {
-                    qthread_fork_to((qthread_f)qarray_strider, &qfwa, NULL,
-                                    i);
-                }
-                while (donecount < maxsheps) {
-                    qthread_yield();
-                }
-            }
-            break;
-    }
+    v.func.qt = func;
+    v.kind    = QARRAY_VISIT_ELEMS;
+    v.a       = a;
+    v.startat = startat;
+    v.stopat  = stopat;
+    qarray_visit(&v, NULL);
 }                                      /*}}} */
 
 void qarray_iter_loop(qarray      *a,
@@ -1044,64 +961,18 @@ void qarray_iter_loop(qarray      *a,
                       qa_loop_f    func,
                       void        *arg)
 {                                      /*{{{ */
-    aligned_t                       donecount = 0;
-    struct qarray_func_wrapper_args qfwa      = { { func }, a, arg, &donecount, startat, stopat };
+    struct qarray_visit_args v = { 0 };
 
     qassert_retvoid((a != NULL));
     qassert_retvoid((func != NULL));
     qassert_retvoid((startat <= stopat));
-    switch (a->dist_type) {
-        case ALL_SAME:
-            qthread_fork_to((qthread_f)qarray_loop_strider, &qfwa, NULL,
-                            a->dist_specific.dist_shep);
-            while (donecount == 0) {
-                qthread_yield();
-            }
-            break;
-        case FIXED_FIELDS:
-        {
-            qthread_shepherd_id_t start_shep = qarray_shepof(a, startat);
-            qthread_shepherd_id_t stop_shep  = qarray_shepof(a, stopat - 1);
-            size_t                num_spawns = 0;
-            for (qthread_shepherd_id_t s = start_shep; s <= stop_shep; s++) {
-                qthread_fork_to((qthread_f)qarray_loop_strider, &qfwa, NULL,
-                                s);
-                num_spawns++;
-            }
-            while (donecount < num_spawns) {
-                qthread_yield();
-            }
-            break;
-        }
-        default:
-            /* it'd be NICE to avoid spawning if not all sheps are represented
-             * in the range (esp if the range is small), but because of
-             * DIST_RAND, that's impossible to do without checking all the
-             * ranges ahead of time. By spawning threads that check their own
-             * ranges, we essentially parallelize the task of figuring out
-             * which threads to spawn (bizarre way of thinking about it, I
-             * know). */
-            if (stopat - startat < a->segment_size) {
-                qthread_fork_to((qthread_f)qarray_loop_strider, &qfwa, NULL,
-                                qarray_shepof(a, startat));
-                while (donecount == 0) {
-                    qthread_yield();
-                }
-            } else {
-                qthread_shepherd_id_t       i;
-                const qthread_shepherd_id_t maxsheps =
-                    qthread_num_shepherds();
-
-                for (i = 0; i < maxsheps; i++) {
-                    qthread_fork_to((qthread_f)qarray_loop_strider, &qfwa,
-                                    NULL, i);
-                }
-                while (donecount < maxsheps) {
-                    qthread_yield();
-                }
-            }
-            break;
-    }
+    v.func.ql = func;
+    v.kind    = QARRAY_VISIT_LOOP;
+    v.a       = a;
+    v.arg     = arg;
+    v.startat = startat;
+    v.stopat  = stopat;
+    qarray_visit(&v, NULL);
 }                                      /*}}} */
 
 struct qarray_ilnb_args {
@@ -1144,63 +1015,18 @@ void qarray_iter_constloop(const qarray *a,
                            qa_cloop_f    func,
                            void         *arg)
 {                                      /*{{{ */
-    aligned_t                                  donecount = 0;
-    const struct qarray_constfunc_wrapper_args qfwa      = { { func }, a, arg, &donecount, startat, stopat };
+    struct qarray_visit_args v = { 0 };
 
     qassert_retvoid((a != NULL));
     qassert_retvoid((func != NULL));
     qassert_retvoid((startat <= stopat));
-    switch (a->dist_type) {
-        case ALL_SAME:
-            qthread_fork_to((qthread_f)qarray_loop_strider, &qfwa, NULL, a->dist_specific.dist_shep);
-            while (donecount == 0) {
-                qthread_yield();
-            }
-            break;
-        case FIXED_FIELDS:
-        {
-            qthread_shepherd_id_t start_shep = qarray_shepof(a, startat);
-            qthread_shepherd_id_t stop_shep  = qarray_shepof(a, stopat - 1);
-            size_t                num_spawns = 0;
-            for (qthread_shepherd_id_t s = start_shep; s <= stop_shep; s++) {
-                qthread_fork_to((qthread_f)qarray_loop_strider, &qfwa, NULL,
-                                s);
-                num_spawns++;
-            }
-            while (donecount < num_spawns) {
-                qthread_yield();
-            }
-            break;
-        }
-        default:
-            /* it'd be NICE to avoid spawning if not all sheps are represented
-             * in the range (esp if the range is small), but because of
-             * DIST_RAND, that's impossible to do without checking all the
-             * ranges ahead of time. By spawning threads that check their own
-             * ranges, we essentially parallelize the task of figuring out
-             * which threads to spawn (bizarre way of thinking about it, I
-             * know). */
-            if (stopat - startat < a->segment_size) {
-                qthread_fork_to((qthread_f)qarray_loop_strider, &qfwa, NULL,
-                                qarray_shepof(a, startat));
-                while (donecount == 0) {
-                    qthread_yield();
-                }
-            } else {
-                qthread_shepherd_id_t       i;
-                const qthread_shepherd_id_t maxsheps =
-                    qthread_num_shepherds();
-
-                for (i = 0; i < maxsheps; i++) {
-                    qthread_fork_to((qthread_f)qarray_loop_strider, &qfwa,
-                                    NULL, i);
-                }
-                while (donecount < maxsheps) {
-                    qthread_yield();
-                }
-            }
-            break;
-    }
+    v.func.ql = (qa_loop_f)func;
+    v.kind    = QARRAY_VISIT_LOOP;
+    v.a       = (qarray *)a;
+    v.arg     = arg;
+    v.startat = startat;
+    v.stopat  = stopat;
+    qarray_visit(&v, NULL);
 }                                      /*}}} */
 
 void qarray_iter_loopaccum(qarray      *a,
@@ -1212,160 +1038,20 @@ void qarray_iter_loopaccum(qarray      *a,
                            const size_t retsize,
                            qt_accum_f   acc)
 {                                      /*{{{ */
+    struct qarray_visit_args v = { 0 };
+
     qassert_retvoid((a != NULL));
     qassert_retvoid((func != NULL));
     qassert_retvoid((startat <= stopat));
-    switch (a->dist_type) {
-        case ALL_SAME:
-        {
-            struct qarray_accumfunc_wrapper_args qfwa =
-            { { func }, acc, a, arg, ret, startat, stopat, retsize };
-            aligned_t r;
-            qthread_fork_to((qthread_f)qarray_loopaccum_strider, &qfwa, &r,
-                            a->dist_specific.dist_shep);
-            qthread_readFF(&r, &r);
-            break;
-        }
-        case FIXED_FIELDS:
-        {
-            qthread_shepherd_id_t                 start_shep = qarray_shepof(a, startat);
-            qthread_shepherd_id_t                 stop_shep  = qarray_shepof(a, stopat - 1);
-            const size_t                          num_spawns = (stop_shep - start_shep) + 1;
-            struct qarray_accumfunc_wrapper_args *qfwa       =
-                MALLOC(sizeof(struct qarray_accumfunc_wrapper_args) *
-                       num_spawns);
-            char        *rets = MALLOC(retsize * (num_spawns - 1));
-            aligned_t   *rv   = MALLOC(sizeof(aligned_t) * num_spawns);
-            unsigned int i;
-
-            assert(qfwa);
-            assert(rets);
-            assert(rv);
-            qfwa[0].ret = ret;
-            for (qthread_shepherd_id_t s = start_shep; s <= stop_shep; s++) {
-                i               = s - start_shep;
-                qfwa[i].func.ql = func;
-                qfwa[i].acc     = acc;
-                qfwa[i].a       = a;
-                qfwa[i].arg     = arg;
-                qfwa[i].startat = startat;
-                qfwa[i].stopat  = stopat;
-                qfwa[i].retsize = retsize;
-                if (s > start_shep) {
-                    qfwa[i].ret = rets + ((i - 1) * retsize);
-                }
-                qthread_fork_to((qthread_f)qarray_loopaccum_strider,
-                                &qfwa[i], &rv[i], s);
-            }
-            for (i = 0; i < num_spawns; i++) {
-                qthread_readFF(NULL, &(rv[i]));
-                if (i > 0) {
-                    acc(ret, &rets[i - 1]);
-                }
-            }
-            FREE(qfwa, sizeof(struct qarray_accumfunc_wrapper_args) * num_spawns);
-            FREE(rets, retsize * (num_spawns - 1));
-            FREE(rv, sizeof(aligned_t) * num_spawns);
-            break;
-        }
-        default:
-            /* it'd be NICE to avoid spawning if not all sheps are represented
-             * in the range (esp if the range is small), but because of
-             * DIST_RAND, that's impossible to do without checking all the
-             * ranges ahead of time. By spawning threads that check their own
-             * ranges, we essentially parallelize the task of figuring out
-             * which threads to spawn (bizarre way of thinking about it, I
-             * know). */
-        {
-            qthread_shepherd_id_t                 i;
-            const size_t                          segsize  = a->segment_size;
-            const qthread_shepherd_id_t           maxsheps = qthread_num_shepherds();
-            struct qarray_accumfunc_wrapper_args *qfwa     =
-                MALLOC(sizeof(struct qarray_accumfunc_wrapper_args) * maxsheps);
-            char      *rets = qt_calloc(maxsheps - 1, retsize);
-            aligned_t *rv   = MALLOC(sizeof(aligned_t) * maxsheps);
-
-            assert(qfwa);
-            assert(rets);
-            assert(rv);
-            qfwa[0].ret = ret;
-            if ((QT_CEIL_RATIO(a->count, segsize) /*tot_segs*/ /
-                 maxsheps) > /*range_segs*/ ((stopat - startat) / segsize)) {
-                /* If we have a small(ish) range, try to figure out which
-                 * shepherds need to be spawned to rather than spawning to
-                 * everyone */
-                memset(rv, 1, sizeof(aligned_t) * maxsheps);
-                size_t count_marked = 0;
-                size_t start        = (startat / segsize) * segsize;
-                for (size_t idx = start; idx < stopat; idx += segsize) {
-                    qthread_shepherd_id_t shepof = qarray_shepof(a, idx);
-                    if (rv[shepof]) {
-                        rv[shepof] = 0;     // mark to spawn
-                        count_marked++;
-                    }
-                    if(count_marked == maxsheps) { break; }
-                }
-                for (i = 0; i < maxsheps; i++) {
-                    if(rv[i] == 0) {
-                        qfwa[i].func.ql = func;
-                        qfwa[i].acc     = acc;
-                        qfwa[i].a       = a;
-                        qfwa[i].arg     = arg;
-                        qfwa[i].startat = startat;
-                        qfwa[i].stopat  = stopat;
-                        qfwa[i].retsize = retsize;
-                        if (i > 0) {
-                            qfwa[i].ret = rets + ((i - 1) * retsize);
-                        }
-                        qthread_fork_to((qthread_f)qarray_loopaccum_strider,
-                                        &qfwa[i], &rv[i], i);
-                    }
-                }
-                {
-                    int first = 1;
-                    for (i = 0; i < maxsheps; i++) {
-                        if (rv[i] == 0) {
-                            qthread_readFF(NULL, &(rv[i]));
-                            if (first) {
-                                first = 0;
-                                if (i > 0) {
-                                    memcpy(ret, rets + ((i - 1) * retsize), retsize);
-                                }
-                            } else {
-                                acc(ret, rets + ((i - 1) * retsize));
-                            }
-                        }
-                    }
-                }
-            } else {
-                /* spawn to everyone, and let them sort it out */
-                for (i = 0; i < maxsheps; i++) {
-                    qfwa[i].func.ql = func;
-                    qfwa[i].acc     = acc;
-                    qfwa[i].a       = a;
-                    qfwa[i].arg     = arg;
-                    qfwa[i].startat = startat;
-                    qfwa[i].stopat  = stopat;
-                    qfwa[i].retsize = retsize;
-                    if (i > 0) {
-                        qfwa[i].ret = rets + ((i - 1) * retsize);
-                    }
-                    qthread_fork_to((qthread_f)qarray_loopaccum_strider,
-                                    &qfwa[i], &rv[i], i);
-                }
-                for (i = 0; i < maxsheps; i++) {
-                    qthread_readFF(NULL, &(rv[i]));
-                    if (i > 0) {
-                        acc(ret, rets + ((i - 1) * retsize));
-                    }
-                }
-            }
-            FREE(qfwa, sizeof(struct qarray_accumfunc_wrapper_args) * maxsheps);
-            FREE(rets, retsize * (maxsheps - 1));
-            FREE(rv, sizeof(aligned_t) * maxsheps);
-            break;
-        }
-    }
+    v.func.qlr = func;
+    v.kind     = QARRAY_VISIT_ACCUM;
+    v.a        = a;
+    v.arg      = arg;
+    v.acc      = acc;
+    v.retsize  = retsize;
+    v.startat  = startat;
+    v.stopat   = stopat;
+    qarray_visit(&v, ret);
 }                                      /*}}} */
 
 void qarray_set_shepof(qarray               *a,
@@ -1384,24 +1070,18 @@ void qarray_set_shepof(qarray               *a,
             if (a->dist_specific.dist_shep != shep) {
                 size_t segment_count = (a->count / a->segment_size);
                 segment_count += (a->count % a->segment_size) ? 1 : 0;
-#ifdef QTHREAD_HAVE_MEM_AFFINITY
-                unsigned int target_node =
-                    qthread_internal_shep_to_node(shep);
-                if (target_node != QTHREAD_NO_NODE) {
-                    size_t num_segments = a->count / a->segment_size;
-                    size_t array_size   = a->segment_bytes * num_segments;
-                    qt_affinity_mem_tonode(a->base_ptr, array_size, target_node);
-                }
-#elif defined(HAVE_MADVISE) && HAVE_DECL_MADV_ACCESS_LWP
-                madvise(a->base_ptr,
-                        (a->count / a->segment_size) * a->segment_bytes, MADV_ACCESS_LWP);
-#endif      /* ifdef QTHREAD_HAVE_MEM_AFFINITY */
+                /* the pages move with it */
+                qt_affinity_mem_move_toshep(a->base_ptr, qarray_internal_body_bytes(a), shep);
+#if defined(HAVE_MADVISE) && HAVE_DECL_MADV_ACCESS_LWP
+                madvise(a->base_ptr, qarray_internal_body_bytes(a), MADV_ACCESS_LWP);
+#endif
                 qthread_incr(&chunk_distribution_tracker[shep],
                              segment_count);
                 qthread_incr(&chunk_distribution_tracker
                              [a->dist_specific.dist_shep],
                              -1 * segment_count);
                 a->dist_specific.dist_shep = shep;
+                a->seg_index_stale         = 1;
             }
             return;
 
@@ -1414,21 +1094,16 @@ void qarray_set_shepof(qarray               *a,
                 qarray_internal_segment_shep_read(a, seghead);
             assert(cur_shep < qthread_num_shepherds());
             if (cur_shep != shep) {
-#ifdef QTHREAD_HAVE_MEM_AFFINITY
-                unsigned int target_node =
-                    qthread_internal_shep_to_node(shep);
-                if (target_node != QTHREAD_NO_NODE) {
-                    qt_affinity_mem_tonode(a->base_ptr +
-                                           (a->segment_bytes * segment),
-                                           a->segment_bytes, target_node);
-                }
-#elif defined(HAVE_MADVISE) && HAVE_DECL_MADV_ACCESS_LWP
-                madvise(a->base_ptr + (a->segment_bytes * (i / a->segment_size)),
+                qt_affinity_mem_move_toshep(a->base_ptr + (a->segment_bytes * segment),
+                                            a->segment_bytes, shep);
+#if defined(HAVE_MADVISE) && HAVE_DECL_MADV_ACCESS_LWP
+                madvise(a->base_ptr + (a->segment_bytes * segment),
                         a->segment_bytes, MADV_ACCESS_LWP);
-#endif          /* ifdef QTHREAD_HAVE_MEM_AFFINITY */
+#endif
                 qthread_incr(&chunk_distribution_tracker[shep], 1);
                 qthread_incr(&chunk_distribution_tracker[cur_shep], -1);
                 qarray_internal_segment_shep_write(a, seghead, shep);
+                a->seg_index_stale = 1;
             }
         }
             return;
@@ -1466,6 +1141,7 @@ void qarray_dist_like(const qarray *ref,
                 default:               /* should not happen *ever*, so trigger a segfault for corefile analysis */
                     QTHREAD_TRAP();
             }
+            qarray_internal_index(mod);
             break;
         }
         case DIST:
@@ -1478,6 +1154,7 @@ void qarray_dist_like(const qarray *ref,
                 for (i = 0; i < mod->count; i += mod->segment_size) {
                     qarray_set_shepof(mod, i, qarray_shepof(ref, i));
                 }
+                qarray_internal_index(mod);
             } else {
                 /* should not happen *ever*, so trigger a segfault for corefile analysis */
                 QTHREAD_TRAP();
@@ -3,152 +3,64 @@
 #endif
 #include <limits.h>                    /* for INT_MAX, per C89 */
 #include <qthread/qthread.h>
-#include <qthread/qlfqueue.h>
 #include <qthread/qdqueue.h>
 #include "qt_alloc.h"
 #include "qt_asserts.h"
-#ifdef HAVE_SYS_LGRP_USER_H
-# include <sys/lgrp_user.h>
-#endif
-#ifdef QTHREAD_HAVE_LIBNUMA
-# include <numa.h>
-#endif
+#include "qt_atomics.h"                /* for SPINLOCK_BODY() */
 #include "qt_debug.h" /* for malloc debug wrappers */
 
-struct qdsubqueue_s;
-
-typedef struct qdqueue_adstruct_s {
-    struct qdsubqueue_s *shep;
-    aligned_t            generation;
-} qdqueue_adstruct_t;
-
-struct qdqueue_adheap_elem_s {
-    int                           inheap;
-    qdqueue_adstruct_t            ad;
-    struct qdqueue_adheap_elem_s *prev;
-    struct qdqueue_adheap_elem_s *next;
-};
-
-struct qdqueue_adheap_s {
-    aligned_t                     gateway_lock; /* unnecessary, but avoids compiler warnings about punning */
-    struct qdqueue_adheap_elem_s *first;
-    struct qdqueue_adheap_elem_s *heap;
-};
+/*
+ * A qdqueue is one FIFO per shepherd. Each FIFO is a list of fixed-size
+ * segments behind a spinlock, so an enqueue or a local dequeue is a couple of
+ * stores, and nothing is allocated until a segment fills up. A dequeue that
+ * finds its own shepherd's FIFO empty steals: it walks the other shepherds
+ * nearest first, and from the first one that is not empty it moves up to half
+ * of the oldest elements (at most QDQUEUE_STEAL_MAX) into its own FIFO, so
+ * that the next several dequeues are local again.
+ *
+ * Which FIFOs are non-empty is kept in a bitmap, one bit per shepherd. A bit
+ * only ever changes when its FIFO goes from empty to non-empty or back, under
+ * that FIFO's lock, so it can be flipped with a plain atomic add and read
+ * without any lock at all; qdqueue_empty() is just a scan of the bitmap.
+ *
+ * The FIFO locks are plain test-and-set locks rather than QTHREAD_FASTLOCKs:
+ * critical sections are a handful of stores, and a ticket lock would make
+ * every worker that re-locks its own FIFO wait for each ticket ahead of it to
+ * be scheduled, which is ruinous once workers outnumber processors.
+ */
+
+#define QDQUEUE_SEGMENT_ELEMS 254
+#define QDQUEUE_STEAL_MAX     64
+#define QDQUEUE_HINT_BITS     (sizeof(aligned_t) * 8)
+
+typedef struct qdqueue_segment_s {
+    struct qdqueue_segment_s *next;
+    void                     *elems[QDQUEUE_SEGMENT_ELEMS];
+} qdqueue_segment_t;
 
 struct qdsubqueue_s {
-    qlfqueue_t             *theQ;
-    void                   *last_consumed;
-
-    struct qdqueue_adheap_s ads;
-    aligned_t               last_ad_issued;
-    aligned_t               last_ad_consumed;
-
-    size_t                  nNeighbors;
-    struct qdsubqueue_s   **neighbors;  /* ordered by distance */
-    struct qdsubqueue_s   **allsheps;   /* ordered by distance */
-};
+    volatile aligned_t     lock;
+    qdqueue_segment_t     *head;
+    qdqueue_segment_t     *tail;
+    size_t                 head_idx;
+    size_t                 tail_idx;
+    volatile size_t        count;
+    qdqueue_segment_t     *spare;       /* one retired segment, kept for reuse */
+
+    qthread_shepherd_id_t  id;
+    struct qdsubqueue_s  **allsheps;    /* ordered by distance */
+} Q_ALIGNED(CACHELINE_WIDTH);
 
 struct qdqueue_s {
     struct qdsubqueue_s *Qs;
+    aligned_t           *nonempty;      /* one bit per shepherd */
 };
 
 static qthread_shepherd_id_t maxsheps = 0;
 
-static qdqueue_adstruct_t qdqueue_adheap_pop(struct qdqueue_adheap_s *heap)
-{   /*{{{ */
-    qdqueue_adstruct_t ret;
-
-    if (heap->first != NULL) {
-        struct qdqueue_adheap_elem_s *tmp;
-
-        qthread_lock(&(heap->gateway_lock));
-        /* pull off "first" */
-        if ((tmp = heap->first) == NULL) {
-            qthread_unlock(&(heap->gateway_lock));
-            goto emptyheap;
-        }
-        ret = tmp->ad;
-        if ((heap->first = tmp->next) != NULL) {
-            heap->first->prev = NULL;
-        }
-        tmp->inheap = 0;
-        qthread_unlock(&(heap->gateway_lock));
-    } else {
-emptyheap:
-        ret.shep       = NULL;
-        ret.generation = 0;
-    }
-    return ret;
-}                                      /*}}} */
-
-/* only push if there are waiters...
- * this function is only used if we can *block* for waiting (not implemented yet) */
-/*static void qdqueue_adheap_pushcond(qlfqueue_t * heap, void *shep, aligned_t gen)
- * {
- *  printf("pushcond\n");
- * }*/
-
-static void qdqueue_adheap_push(struct qdqueue_adheap_s *heap,
-                                void                    *shep,
-                                aligned_t                gen)
-{                                      /*{{{ */
-    size_t i;
-
-    /* search through the heap for a ptr matching shep */
-    for (i = 0; i < maxsheps; i++) {
-        if (heap->heap[i].ad.shep == shep) {
-            break;
-        }
-    }
-    assert(heap->heap[i].ad.shep == shep);
-    qthread_lock(&(heap->gateway_lock));
-    /* update the gen record */
-    if ((heap->heap[i].ad.generation < gen) || (gen == 0)) {
-        if (gen != 0) {
-            heap->heap[i].ad.generation = gen;
-        }
-        if (heap->heap[i].inheap == 1) {
-            goto done_pushing;
-        }
-        heap->heap[i].inheap = 1;
-        if (heap->first == NULL) {
-            heap->heap[i].prev = NULL;
-            heap->heap[i].next = NULL;
-            heap->first        = &(heap->heap[i]);
-        } else {
-            if (&(heap->heap[i]) < heap->first) {
-                /* adding *before* the first */
-                heap->heap[i].next = heap->first;
-                heap->heap[i].prev = NULL;
-                heap->first->prev  = &(heap->heap[i]);
-                heap->first        = &(heap->heap[i]);
-            } else if (&(heap->heap[i]) > heap->first) {
-                size_t j;
-
-                /* adding somewhere *after* the first
-                 * ... so we start here and work backwards until we find some part of the heap */
-                for (j = i - 1;; j--) {
-                    if (heap->heap[j].inheap) {
-                        heap->heap[i].next = heap->heap[j].next;
-                        heap->heap[i].prev = &(heap->heap[j]);
-                        heap->heap[j].next = &(heap->heap[i]);
-                        if (heap->heap[i].next != NULL) {
-                            heap->heap[i].next->prev = heap->heap + i;
-                        }
-                        break;
-                    }
-                }
-            }                          /* else it WAS the first already, and got re-pushed */
-        }
-    }
-done_pushing:
-    qthread_unlock(&(heap->gateway_lock));
-}                                      /*}}} */
-
-static int qdqueue_adheap_empty(struct qdqueue_adheap_s *heap)
-{                                      /*{{{ */
-    return (heap->first == NULL);
-}                                      /*}}} */
+#define QDQUEUE_HINT_WORDS      ((maxsheps + QDQUEUE_HINT_BITS - 1) / QDQUEUE_HINT_BITS)
+#define QDQUEUE_HINT_WORD(q, s) ((q)->nonempty + ((s) / QDQUEUE_HINT_BITS))
+#define QDQUEUE_HINT_BIT(s)     ((aligned_t)1 << ((s) % QDQUEUE_HINT_BITS))
 
 static void qdqueue_internal_gensheparray(int **a)
 {                                      /*{{{ */
@@ -222,76 +134,85 @@ static void qdqueue_internal_sortedsheps(qthread_shepherd_id_t shep,
     }
 }                                      /*}}} */
 
-static struct qdsubqueue_s **qdqueue_internal_getneighbors(qthread_shepherd_id_t     shep,
-                                                           struct qdsubqueue_s      *Qs,
-                                                           size_t *restrict          numNeighbors,
-                                                           const int *const restrict distances) /*{{{ */
-{
-    struct qdsubqueue_s **ret;
-    size_t                i;
-    /* we define a "neighbor" in terms of distance, because that's all we've
-     * got, so, we find the shortest non-me distance (i.e. >10), and anything
-     * that's less than 10 away from that is considered one of my neighbors */
-    qthread_shepherd_id_t *temp;
-    size_t                 j, numN = 0;
-
-#ifdef HAVE_SYS_LGRP_USER_H
-# define NONME_DIST 5
-#else
-# define NONME_DIST 10
-#endif
+static QINLINE void qdqueue_internal_lock(struct qdsubqueue_s *sq)
+{                                      /*{{{ */
+    do {
+        while (sq->lock != 0) SPINLOCK_BODY();
+    } while (qthread_cas(&sq->lock, 0, 1) != 0);
+}                                      /*}}} */
 
-    /* find the smallest non-me distance */
-    int mindist = INT_MAX;
+static QINLINE void qdqueue_internal_unlock(struct qdsubqueue_s *sq)
+{                                      /*{{{ */
+    COMPILER_FENCE;
+    sq->lock = 0;
+}                                      /*}}} */
 
-    for (i = 0; i < maxsheps; i++) {
-        if (i == shep) {
-            continue;
-        }
-        if (mindist > distances[i]) {
-            mindist = distances[i];
-        }
-    }
-    /* count how many neighbors that works out to */
-    for (i = 0; i < maxsheps; i++) {
-        if (i == shep) {
-            continue;
-        }
-        if (distances[i] < (mindist + NONME_DIST)) {
-            numN++;
+/* The following helpers must be called with sq->lock held. */
+
+static QINLINE void qdqueue_internal_push(struct qdsubqueue_s *sq,
+                                          void                *elem)
+{                                      /*{{{ */
+    if (sq->tail_idx == QDQUEUE_SEGMENT_ELEMS) {
+        qdqueue_segment_t *seg = sq->spare;
+
+        if (seg != NULL) {
+            sq->spare = NULL;
+        } else {
+            seg = MALLOC(sizeof(qdqueue_segment_t));
+            assert(seg);
         }
+        seg->next      = NULL;
+        sq->tail->next = seg;
+        sq->tail       = seg;
+        sq->tail_idx   = 0;
     }
-    /* get a list of those neighbors */
-    if (numN == 0) {
-        *numNeighbors = 0;
+    sq->tail->elems[sq->tail_idx++] = elem;
+    sq->count++;
+}                                      /*}}} */
+
+static QINLINE void *qdqueue_internal_pop(struct qdsubqueue_s *sq)
+{                                      /*{{{ */
+    void *ret;
+
+    if (sq->count == 0) {
         return NULL;
     }
-    temp = MALLOC(numN * sizeof(qthread_shepherd_id_t));
-    assert(temp);
-    for (i = j = 0; i < maxsheps; i++) {
-        if (i == shep) {
-            continue;
-        }
-        if (distances[i] < (mindist + NONME_DIST)) {
-            temp[j++] = (qthread_shepherd_id_t)i;
+    if (sq->head_idx == QDQUEUE_SEGMENT_ELEMS) {
+        qdqueue_segment_t *old = sq->head;
+
+        sq->head     = old->next;
+        sq->head_idx = 0;
+        if (sq->spare == NULL) {
+            sq->spare = old;
+        } else {
+            FREE(old, sizeof(qdqueue_segment_t));
         }
     }
-    /* and now randomly append them to the list */
-    ret = MALLOC(numN * sizeof(struct qdsubqueue_s *));
-    assert(ret);
-    for (i = 0; i < numN; i++) {
-        size_t k, randpick = random() % (numN - i);
-
-        ret[i] = &(Qs[temp[randpick]]);
-        for (k = randpick; k < (numN - i - 1); k++) {
-            temp[k] = temp[k + 1];
-        }
+    ret = sq->head->elems[sq->head_idx++];
+    if (--sq->count == 0) {
+        /* head has caught up with tail; start the segment over */
+        assert(sq->head == sq->tail && sq->head_idx == sq->tail_idx);
+        sq->head_idx = sq->tail_idx = 0;
     }
-    FREE(temp, numN * sizeof(qthread_shepherd_id_t));
-    *numNeighbors = numN;
     return ret;
 }                                      /*}}} */
 
+static QINLINE void qdqueue_internal_hint(qdqueue_t           *q,
+                                          struct qdsubqueue_s *sq,
+                                          const int            nonempty)
+{                                      /*{{{ */
+    const aligned_t bit = QDQUEUE_HINT_BIT(sq->id);
+
+    /* only the lock holder flips this bit, so adding is as good as or-ing */
+    (void)qthread_incr(QDQUEUE_HINT_WORD(q, sq->id), nonempty ? bit : -bit);
+}                                      /*}}} */
+
+static QINLINE int qdqueue_internal_hinted(const qdqueue_t            *q,
+                                           const struct qdsubqueue_s *sq)
+{                                      /*{{{ */
+    return (*QDQUEUE_HINT_WORD(q, sq->id) & QDQUEUE_HINT_BIT(sq->id)) != 0;
+}                                      /*}}} */
+
 /* Create a new qdqueue */
 qdqueue_t *qdqueue_create(void)
 {                                      /*{{{ */
@@ -305,7 +226,10 @@ qdqueue_t *qdqueue_create(void)
     assert(maxsheps > 0);
     ret = qt_calloc(1, sizeof(struct qdqueue_s));
     qassert_goto((ret != NULL), erralloc_killq);
-    ret->Qs = MALLOC(maxsheps * sizeof(struct qdsubqueue_s));
+    ret->Qs = qt_internal_aligned_alloc(maxsheps * sizeof(struct qdsubqueue_s), CACHELINE_WIDTH);
+    qassert_goto((ret->Qs != NULL), erralloc_killq);
+    ret->nonempty = qt_calloc(QDQUEUE_HINT_WORDS, sizeof(aligned_t));
+    qassert_goto((ret->nonempty != NULL), erralloc_killq);
 
     sheparray = MALLOC(maxsheps * sizeof(int *));
     qassert_goto((sheparray != NULL), erralloc_killq);
@@ -315,32 +239,26 @@ qdqueue_t *qdqueue_create(void)
     }
     qdqueue_internal_gensheparray(sheparray);
     for (curshep = 0; curshep < maxsheps; curshep++) {
-        ret->Qs[curshep].theQ             = qlfqueue_create();
-        ret->Qs[curshep].last_consumed    = NULL;
-        ret->Qs[curshep].last_ad_issued   = 1;
-        ret->Qs[curshep].last_ad_consumed = 1;
+        struct qdsubqueue_s *sq = &(ret->Qs[curshep]);
+
+        sq->lock = 0;
+        sq->head = sq->tail = MALLOC(sizeof(qdqueue_segment_t));
+        assert(sq->head);
+        sq->head->next = NULL;
+        sq->head_idx   = sq->tail_idx = 0;
+        sq->count      = 0;
+        sq->spare      = NULL;
+        sq->id         = curshep;
         if (maxsheps == 1) {
-            ret->Qs[curshep].allsheps     = NULL;
+            sq->allsheps = NULL;
         } else {
-            ret->Qs[curshep].allsheps     =
+            sq->allsheps =
                 qt_calloc((maxsheps - 1), sizeof(struct qdsubqueue_s *));
         }
         /* yes, I could get this information from qthreads, but I'm adding a
          * little bit of randomnes to the list when the distances are equal */
-        qdqueue_internal_sortedsheps(curshep, ret->Qs[curshep].allsheps,
+        qdqueue_internal_sortedsheps(curshep, sq->allsheps,
                                      ret->Qs, sheparray[curshep]);
-        ret->Qs[curshep].neighbors =
-            qdqueue_internal_getneighbors(curshep, ret->Qs,
-                                          &(ret->Qs[curshep].nNeighbors),
-                                          sheparray[curshep]);
-        ret->Qs[curshep].ads.heap =
-            qt_calloc(maxsheps, sizeof(struct qdqueue_adheap_elem_s));
-        ret->Qs[curshep].ads.heap[0].ad.shep = &(ret->Qs[curshep]);
-        for (qthread_shepherd_id_t i = 0; i < (maxsheps - 1); i++) {
-            ret->Qs[curshep].ads.heap[i + 1].ad.shep =
-                ret->Qs[curshep].allsheps[i];
-        }
-        ret->Qs[curshep].ads.first = NULL;
     }
     for (curshep = 0; curshep < maxsheps; curshep++) {
         FREE(sheparray[curshep], maxsheps * sizeof(int));
@@ -357,7 +275,10 @@ qdqueue_t *qdqueue_create(void)
     qgoto(erralloc_killq);
     if (ret) {
         if (ret->Qs) {
-            FREE(ret->Qs, maxsheps * sizeof(struct qdsubqueue_s));
+            qt_internal_aligned_free(ret->Qs, maxsheps * sizeof(struct qdsubqueue_s));
+        }
+        if (ret->nonempty) {
+            FREE(ret->nonempty, QDQUEUE_HINT_WORDS * sizeof(aligned_t));
         }
         FREE(ret, sizeof(struct qdqueue_s));
     }
@@ -371,58 +292,49 @@ int qdqueue_destroy(qdqueue_t *q)
 
     qassert_ret((q != NULL), QTHREAD_BADARGS);
     for (i = 0; i < maxsheps; i++) {
-        if (q->Qs[i].theQ) {
-            qlfqueue_destroy(q->Qs[i].theQ);
-        }
-        if (q->Qs[i].ads.heap != NULL) {
-            FREE(q->Qs[i].ads.heap, maxsheps * sizeof(struct qdqueue_adheap_elem_s));
+        struct qdsubqueue_s *sq  = &(q->Qs[i]);
+        qdqueue_segment_t   *seg = sq->head;
+
+        while (seg != NULL) {
+            qdqueue_segment_t *next = seg->next;
+
+            FREE(seg, sizeof(qdqueue_segment_t));
+            seg = next;
         }
-        if (q->Qs[i].neighbors != NULL) {
-            FREE(q->Qs[i].neighbors, q->Qs[i].nNeighbors * sizeof(struct qdsubqueue_s *));
+        if (sq->spare != NULL) {
+            FREE(sq->spare, sizeof(qdqueue_segment_t));
         }
-        if (q->Qs[i].allsheps != NULL) {
-            FREE(q->Qs[i].allsheps, (maxsheps - 1) * sizeof(struct qdsubqueue_s *));
+        if (sq->allsheps != NULL) {
+            FREE(sq->allsheps, (maxsheps - 1) * sizeof(struct qdsubqueue_s *));
         }
     }
-    FREE(q->Qs, maxsheps * sizeof(struct qdsubqueue_s));
+    qt_internal_aligned_free(q->Qs, maxsheps * sizeof(struct qdsubqueue_s));
+    FREE(q->nonempty, QDQUEUE_HINT_WORDS * sizeof(aligned_t));
     FREE(q, sizeof(struct qdqueue_s));
     return QTHREAD_SUCCESS;
 }                                      /*}}} */
 
+static int qdqueue_internal_enqueue(qdqueue_t           *q,
+                                    struct qdsubqueue_s *sq,
+                                    void                *elem)
+{                                      /*{{{ */
+    qdqueue_internal_lock(sq);
+    qdqueue_internal_push(sq, elem);
+    if (sq->count == 1) {
+        qdqueue_internal_hint(q, sq, 1);
+    }
+    qdqueue_internal_unlock(sq);
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
 /* enqueue something in the queue */
 int qdqueue_enqueue(qdqueue_t *q,
                     void      *elem)
 {                                      /*{{{ */
-    int                  stat;
-    struct qdsubqueue_s *myq;
-
     qassert_ret((q != NULL), QTHREAD_BADARGS);
     qassert_ret((elem != NULL), QTHREAD_BADARGS);
 
-    myq = &(q->Qs[qthread_shep()]);
-
-    stat = qlfqueue_empty(myq->theQ);
-    qlfqueue_enqueue(myq->theQ, elem);
-    if (stat) {
-        /* the queue was empty, so we may have to wake up waiters */
-        /*qdqueue_adheap_pushcond(myq->ads, myq, 0); */
-    } else {
-        aligned_t             generation;
-        qthread_shepherd_id_t shep;
-
-        /* the queue had stuff in it already, so we advertise */
-        if (myq->last_ad_issued <= myq->last_ad_consumed) {
-            /* only advertise if our existing ads are stale */
-            generation = qthread_incr(&(myq->last_ad_issued), 1);
-            for (shep = 0; shep < myq->nNeighbors; shep++) {
-                struct qdsubqueue_s *neighbor = myq->neighbors[shep];
-
-                qdqueue_adheap_push(&(neighbor->ads), myq, generation);
-            }
-        }
-    }
-
-    return QTHREAD_SUCCESS;
+    return qdqueue_internal_enqueue(q, &(q->Qs[qthread_shep()]), elem);
 }                                      /*}}} */
 
 /* enqueue something in the queue at a given location */
@@ -430,37 +342,54 @@ int qdqueue_enqueue_there(qdqueue_t            *q,
                           void                 *elem,
                           qthread_shepherd_id_t there)
 {                                      /*{{{ */
-    int                  stat;
-    struct qdsubqueue_s *myq;
-
     qassert_ret((q != NULL), QTHREAD_BADARGS);
     qassert_ret((elem != NULL), QTHREAD_BADARGS);
     qassert_ret((there < qthread_num_shepherds()), QTHREAD_BADARGS);
 
-    myq = &(q->Qs[there]);
-
-    stat = qlfqueue_empty(myq->theQ);
-    qlfqueue_enqueue(myq->theQ, elem);
-    if (stat) {
-        /* the queue was empty, so we may have to wake up waiters */
-        /* qdqueue_adheap_pushcond(myq->ads, myq, 0); */
-    } else {
-        aligned_t             generation;
-        qthread_shepherd_id_t shep;
-
-        /* the queue had stuff in it already, so we advertise */
-        if (myq->last_ad_issued <= myq->last_ad_consumed) {
-            /* only advertise if our existing ads are stale */
-            generation = qthread_incr(&(myq->last_ad_issued), 1);
-            for (shep = 0; shep < myq->nNeighbors; shep++) {
-                struct qdsubqueue_s *neighbor = myq->neighbors[shep];
-
-                qdqueue_adheap_push(&(neighbor->ads), myq, generation);
+    return qdqueue_internal_enqueue(q, &(q->Qs[there]), elem);
+}                                      /*}}} */
+
+/* Moves a batch of victim's oldest elements into myq, in order, and returns
+ * the first of them (or NULL, if victim turned out to be empty). Both locks
+ * are held for the move, so the batch is never invisible to other dequeuers;
+ * they are always taken in shepherd order, so two thieves robbing each other
+ * cannot deadlock. */
+static void *qdqueue_internal_steal(qdqueue_t           *q,
+                                    struct qdsubqueue_s *myq,
+                                    struct qdsubqueue_s *victim)
+{                                      /*{{{ */
+    struct qdsubqueue_s *first  = (myq->id < victim->id) ? myq : victim;
+    struct qdsubqueue_s *second = (myq->id < victim->id) ? victim : myq;
+    void                *ret    = NULL;
+
+    qdqueue_internal_lock(first);
+    qdqueue_internal_lock(second);
+    if ((ret = qdqueue_internal_pop(myq)) == NULL) {
+        size_t batch = (victim->count + 1) / 2;
+
+        if (batch > QDQUEUE_STEAL_MAX) {
+            batch = QDQUEUE_STEAL_MAX;
+        }
+        if ((ret = qdqueue_internal_pop(victim)) != NULL) {
+            for (size_t i = 1; i < batch; i++) {
+                qdqueue_internal_push(myq, qdqueue_internal_pop(victim));
+            }
+            /* hint the new home before clearing the old one, so that
+             * qdqueue_empty() never sees the batch in neither */
+            if (myq->count > 0) {
+                qdqueue_internal_hint(q, myq, 1);
+            }
+            if (victim->count == 0) {
+                qdqueue_internal_hint(q, victim, 0);
             }
         }
+    } else if (myq->count == 0) {
+        /* someone refilled (and re-hinted) our queue in the meantime */
+        qdqueue_internal_hint(q, myq, 0);
     }
-
-    return QTHREAD_SUCCESS;
+    qdqueue_internal_unlock(second);
+    qdqueue_internal_unlock(first);
+    return ret;
 }                                      /*}}} */
 
 /* dequeue something from the queue (returns NULL for an empty queue) */
@@ -472,92 +401,38 @@ void *qdqueue_dequeue(qdqueue_t *q)
     qassert_ret((q != NULL), NULL);
 
     myq = &(q->Qs[qthread_shep()]);
-    if ((ret = qlfqueue_dequeue(myq->theQ)) != NULL) {
-        /* this write MUST be atomic */
-        myq->last_consumed = myq;
-        return ret;
-    } else {
-        /* this write MUST be atomic */
-        myq->last_consumed = NULL;
-checkads:
-        {
-            qdqueue_adstruct_t ad;
-
-            while ((ad = qdqueue_adheap_pop(&myq->ads)).shep != NULL) {
-                struct qdsubqueue_s *lc = (struct qdsubqueue_s *)ad.shep->last_consumed;
-
-                if (lc == ad.shep) {
-                    /* it's working on its own queue */
-                    aligned_t last_ad = ad.shep->last_ad_consumed;
-
-                    while (last_ad < ad.generation) {
-                        last_ad =
-                            qthread_cas(&(ad.shep->last_ad_consumed), last_ad,
-                                        ad.generation);
-                    }
-                    if ((ret = qlfqueue_dequeue(ad.shep->theQ)) != NULL) {
-                        myq->last_consumed = ad.shep;
-                        return ret;
-                    }
-                } else if (lc != NULL) {
-                    /* it got work from somewhere! */
-                    qdqueue_adheap_push(&myq->ads, lc, 0);
-                    /* reset the remote host's last_consumed counter, to avoid infinite loops */
-                    (void)qthread_cas_ptr(&(ad.shep->last_consumed), (void *)lc, NULL);
-                }
-            }
+    if (myq->count > 0) {
+        qdqueue_internal_lock(myq);
+        ret = qdqueue_internal_pop(myq);
+        if ((ret != NULL) && (myq->count == 0)) {
+            qdqueue_internal_hint(q, myq, 0);
         }
-        {
-            qthread_shepherd_id_t shep;
-
-            for (shep = 0; shep < (maxsheps - 1); shep++) {
-                struct qdsubqueue_s *remoteshep = myq->allsheps[shep];
-                struct qdsubqueue_s *lc         = remoteshep->last_consumed;
-
-                if ((ret = qlfqueue_dequeue(remoteshep->theQ)) != NULL) {
-                    myq->last_consumed = remoteshep;
-                    return ret;
-                } else if ((lc != NULL) && (lc != remoteshep)) {
-                    /* it got work from somewhere! */
-                    if ((ret = qlfqueue_dequeue(lc->theQ)) != NULL) {
-                        myq->last_consumed = lc;
-                        return ret;
-                    }
-                }
-                if (!qdqueue_adheap_empty(&myq->ads)) {
-                    goto checkads;
-                }
-            }
+        qdqueue_internal_unlock(myq);
+        if (ret != NULL) {
+            return ret;
         }
-        return NULL;
     }
+    for (qthread_shepherd_id_t shep = 0; shep < (maxsheps - 1); shep++) {
+        struct qdsubqueue_s *victim = myq->allsheps[shep];
+
+        if (qdqueue_internal_hinted(q, victim) &&
+            ((ret = qdqueue_internal_steal(q, myq, victim)) != NULL)) {
+            return ret;
+        }
+    }
+    return NULL;
 }                                      /*}}} */
 
 /* returns 1 if the queue is empty, 0 otherwise */
 int qdqueue_empty(qdqueue_t *q)
 {                                      /*{{{ */
-    struct qdsubqueue_s *myq;
-
     qassert_ret(q, 0);
-    myq = &(q->Qs[qthread_shep()]);
-    if (!qlfqueue_empty(myq->theQ)) {
-        return 0;
-    } else {
-        qthread_shepherd_id_t shep;
-
-        for (shep = 0; shep < (maxsheps - 1); shep++) {
-            struct qdsubqueue_s *remoteshep = myq->allsheps[shep];
-
-            assert(remoteshep);
-            if (remoteshep->last_consumed == remoteshep) {
-                /* it's working on its own queue */
-                if (!qlfqueue_empty(remoteshep->theQ)) {
-                    return 0;
-                }
-            }
+    for (size_t i = 0; i < QDQUEUE_HINT_WORDS; i++) {
+        if (q->nonempty[i] != 0) {
+            return 0;
         }
-        return 1;                      /* we searched everywhere, and every queue was empty */
     }
+    return 1;                          /* we searched everywhere, and every queue was empty */
 }                                      /*}}} */
 
 /* vim:set expandtab: */
@@ -0,0 +1,291 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* API */
+#include <qthread/qthread.h>
+#include <qthread/qmpmcqueue.h>
+
+/* Internal Headers */
+#include "qt_asserts.h"
+#include "qt_alloc.h"          /* for aligned alloc */
+
+/*
+ * A bounded multi-producer/multi-consumer ring, after Dmitry Vyukov's
+ * "Bounded MPMC queue" (1024cores.net). Every cell carries a sequence number
+ * that says whose turn it is: a producer at position pos may fill the cell
+ * when its sequence is pos, and publishes it by setting it to pos + 1; a
+ * consumer at pos may empty it when its sequence is pos + 1, and hands it back
+ * for the next lap by setting it to pos + size. Producers and consumers only
+ * contend on their own position counter, and nothing is allocated after
+ * qmpmcqueue_create().
+ *
+ * The blocking variants park the calling qthread on a FEB (not_empty or
+ * not_full) after registering in the matching waiter count. Every operation
+ * that makes progress checks the opposite waiter count after publishing and
+ * fills the FEB if anyone is waiting; since a fill that happens before the
+ * waiter gets to its readFE leaves the word full, no wakeup is lost.
+ */
+
+typedef struct {
+    volatile aligned_t seq;
+    void *volatile     data;
+} qmpmcqueue_cell_t;
+
+struct qmpmcqueue_s {             /* typedef'd to qmpmcqueue_t */
+    volatile aligned_t enqueue_pos;
+    uint8_t            pad1[CACHELINE_WIDTH - sizeof(aligned_t)];
+    volatile aligned_t dequeue_pos;
+    uint8_t            pad2[CACHELINE_WIDTH - sizeof(aligned_t)];
+    /* read-mostly from here on */
+    aligned_t          mask;
+    volatile aligned_t empty_waiters;
+    volatile aligned_t full_waiters;
+    aligned_t          not_empty;
+    aligned_t          not_full;
+    uint8_t            pad3[CACHELINE_WIDTH - (5 * sizeof(aligned_t))];
+    qmpmcqueue_cell_t  cells[];
+};
+
+#define QMPMCQUEUE_BYTES(q) (sizeof(struct qmpmcqueue_s) + (((q)->mask + 1) * sizeof(qmpmcqueue_cell_t)))
+
+qmpmcqueue_t *qmpmcqueue_create(size_t elements)
+{                                      /*{{{ */
+    qmpmcqueue_t *q;
+    size_t        size = 2;
+
+    while (size < elements) {
+        size <<= 1;
+        if (size == 0) {
+            return NULL;
+        }
+    }
+    q = qt_internal_aligned_alloc(sizeof(struct qmpmcqueue_s) + (size * sizeof(qmpmcqueue_cell_t)), CACHELINE_WIDTH);
+    if (q != NULL) {
+        q->enqueue_pos   = 0;
+        q->dequeue_pos   = 0;
+        q->mask          = size - 1;
+        q->empty_waiters = 0;
+        q->full_waiters  = 0;
+        for (size_t i = 0; i < size; i++) {
+            q->cells[i].seq  = i;
+            q->cells[i].data = NULL;
+        }
+        qthread_empty(&q->not_empty);
+        qthread_empty(&q->not_full);
+    }
+    return q;
+}                                      /*}}} */
+
+int qmpmcqueue_destroy(qmpmcqueue_t *q)
+{                                      /*{{{ */
+    qassert_ret((q != NULL), QTHREAD_BADARGS);
+    qassert_ret((q->empty_waiters == 0 && q->full_waiters == 0), QTHREAD_BADARGS);
+    /* full is the default state, so this drops any FEB bookkeeping */
+    qthread_fill(&q->not_empty);
+    qthread_fill(&q->not_full);
+    qt_internal_aligned_free(q, QMPMCQUEUE_BYTES(q));
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
+/* Claims up to count consecutive positions whose cells are in state want
+ * relative to their position (0 for producers, 1 for consumers), advancing
+ * *posp past them. Returns the number claimed and their first position. */
+static size_t qmpmcqueue_internal_claim(qmpmcqueue_t       *q,
+                                        volatile aligned_t *posp,
+                                        const aligned_t     want,
+                                        const size_t        count,
+                                        aligned_t          *first)
+{                                      /*{{{ */
+    const aligned_t mask = q->mask;
+    aligned_t       pos  = *posp;
+
+    for (;;) {
+        aligned_t seq = q->cells[pos & mask].seq;
+        saligned_t dif;
+
+        COMPILER_FENCE;
+        dif = (saligned_t)(seq - (pos + want));
+        if (dif == 0) {
+            size_t    n = 1;
+            aligned_t oldpos;
+
+            while (n < count && n <= mask &&
+                   q->cells[(pos + n) & mask].seq == pos + n + want) {
+                n++;
+            }
+            oldpos = qthread_cas(posp, pos, pos + n);
+            if (oldpos == pos) {
+                *first = pos;
+                return n;
+            }
+            pos = oldpos;
+        } else if (dif < 0) {
+            /* the cell has not come around yet: full (or empty) */
+            return 0;
+        } else {
+            /* someone else claimed this position already */
+            pos = *posp;
+        }
+    }
+}                                      /*}}} */
+
+static QINLINE void qmpmcqueue_internal_wake(volatile aligned_t *waiters,
+                                             aligned_t          *feb)
+{                                      /*{{{ */
+    if (*waiters) {
+        qthread_fill(feb);
+    }
+}                                      /*}}} */
+
+int qmpmcqueue_enqueue(qmpmcqueue_t *q,
+                       void         *elem)
+{                                      /*{{{ */
+    aligned_t pos;
+
+    qassert_ret((q != NULL), QTHREAD_BADARGS);
+    if (qmpmcqueue_internal_claim(q, &q->enqueue_pos, 0, 1, &pos) == 0) {
+        return QTHREAD_OPFAIL;
+    }
+    q->cells[pos & q->mask].data = elem;
+    /* publish; the atomic also orders the store before the waiter check */
+    (void)qthread_incr(&q->cells[pos & q->mask].seq, 1);
+    qmpmcqueue_internal_wake(&q->empty_waiters, &q->not_empty);
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
+size_t qmpmcqueue_enqueue_many(qmpmcqueue_t *q,
+                               void *const  *elems,
+                               size_t        count)
+{                                      /*{{{ */
+    aligned_t pos;
+    size_t    n;
+
+    qassert_ret((q != NULL), 0);
+    if (count == 0) {
+        return 0;
+    }
+    n = qmpmcqueue_internal_claim(q, &q->enqueue_pos, 0, count, &pos);
+    if (n == 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        q->cells[(pos + i) & q->mask].data = elems[i];
+    }
+    MACHINE_FENCE;
+    for (size_t i = 0; i < n; i++) {
+        q->cells[(pos + i) & q->mask].seq = pos + i + 1;
+    }
+    MACHINE_FENCE;
+    qmpmcqueue_internal_wake(&q->empty_waiters, &q->not_empty);
+    return n;
+}                                      /*}}} */
+
+int qmpmcqueue_enqueue_blocking(qmpmcqueue_t *q,
+                                void         *elem)
+{                                      /*{{{ */
+    qassert_ret((q != NULL), QTHREAD_BADARGS);
+    if (qmpmcqueue_enqueue(q, elem) == QTHREAD_SUCCESS) {
+        return QTHREAD_SUCCESS;
+    }
+    for (;;) {
+        int ret;
+
+        (void)qthread_incr(&q->full_waiters, 1);
+        ret = qmpmcqueue_enqueue(q, elem);
+        if (ret != QTHREAD_SUCCESS) {
+            qthread_readFE(NULL, &q->not_full);
+            ret = qmpmcqueue_enqueue(q, elem);
+        }
+        (void)qthread_incr(&q->full_waiters, -1);
+        if (ret == QTHREAD_SUCCESS) {
+            /* pass the wakeup on, in case several slots were freed at once */
+            qmpmcqueue_internal_wake(&q->full_waiters, &q->not_full);
+            return QTHREAD_SUCCESS;
+        }
+    }
+}                                      /*}}} */
+
+void *qmpmcqueue_dequeue(qmpmcqueue_t *q)
+{                                      /*{{{ */
+    aligned_t pos;
+    void     *item;
+
+    qassert_ret((q != NULL), NULL);
+    if (qmpmcqueue_internal_claim(q, &q->dequeue_pos, 1, 1, &pos) == 0) {
+        return NULL;
+    }
+    item = q->cells[pos & q->mask].data;
+    COMPILER_FENCE;
+    (void)qthread_incr(&q->cells[pos & q->mask].seq, q->mask);
+    qmpmcqueue_internal_wake(&q->full_waiters, &q->not_full);
+    return item;
+}                                      /*}}} */
+
+size_t qmpmcqueue_dequeue_many(qmpmcqueue_t *q,
+                               void        **elems,
+                               size_t        count)
+{                                      /*{{{ */
+    aligned_t pos;
+    size_t    n;
+
+    qassert_ret((q != NULL), 0);
+    if (count == 0) {
+        return 0;
+    }
+    n = qmpmcqueue_internal_claim(q, &q->dequeue_pos, 1, count, &pos);
+    if (n == 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        elems[i] = q->cells[(pos + i) & q->mask].data;
+    }
+    MACHINE_FENCE;
+    for (size_t i = 0; i < n; i++) {
+        q->cells[(pos + i) & q->mask].seq = pos + i + q->mask + 1;
+    }
+    MACHINE_FENCE;
+    qmpmcqueue_internal_wake(&q->full_waiters, &q->not_full);
+    return n;
+}                                      /*}}} */
+
+void *qmpmcqueue_dequeue_blocking(qmpmcqueue_t *q)
+{                                      /*{{{ */
+    aligned_t pos;
+    void     *item;
+
+    qassert_ret((q != NULL), NULL);
+    if (qmpmcqueue_internal_claim(q, &q->dequeue_pos, 1, 1, &pos) == 0) {
+        size_t got;
+
+        for (;;) {
+            (void)qthread_incr(&q->empty_waiters, 1);
+            got = qmpmcqueue_internal_claim(q, &q->dequeue_pos, 1, 1, &pos);
+            if (got == 0) {
+                qthread_readFE(NULL, &q->not_empty);
+                got = qmpmcqueue_internal_claim(q, &q->dequeue_pos, 1, 1, &pos);
+            }
+            (void)qthread_incr(&q->empty_waiters, -1);
+            if (got) {
+                /* pass the wakeup on, in case several elements arrived at once */
+                qmpmcqueue_internal_wake(&q->empty_waiters, &q->not_empty);
+                break;
+            }
+        }
+    }
+    item = q->cells[pos & q->mask].data;
+    COMPILER_FENCE;
+    (void)qthread_incr(&q->cells[pos & q->mask].seq, q->mask);
+    qmpmcqueue_internal_wake(&q->full_waiters, &q->not_full);
+    return item;
+}                                      /*}}} */
+
+/* returns 1 if the queue is empty, 0 otherwise */
+int qmpmcqueue_empty(qmpmcqueue_t *q)
+{                                      /*{{{ */
+    const aligned_t pos = q->dequeue_pos;
+
+    return (q->cells[pos & q->mask].seq != pos + 1);
+}                                      /*}}} */
+
+/* vim:set expandtab: */
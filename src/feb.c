@@ -4,8 +4,10 @@
 #include<qthread/performance.h>
 /* The API */
 #include "qthread/qthread.h"
+#include "qthread/qtimer.h"
 
 /* System Headers */
+#include <stddef.h>                    /* for offsetof() */
 
 /* Qthread Headers */
 #include <qthread/hash.h>
@@ -27,6 +29,9 @@
 #include "qt_addrstat.h"
 #include "qt_threadqueues.h"
 #include "qt_debug.h"
+#include "qt_envariables.h"
+#include "qt_hazardptrs.h"
+#include "qt_timers.h"
 #ifdef QTHREAD_USE_EUREKAS
 #include "qt_eurekas.h" // for qthread_internal_assassinate() (used in taskfilter)
 #endif /* QTHREAD_USE_EUREKAS */
@@ -36,6 +41,49 @@
  * Local Variables
  *********************************************************************/
 static qt_hash *FEBs;
+
+/* The FEB table is open-addressed and keyed by aligned address. An address
+ * with no slot is full and has no waiters, so a slot that is in that state
+ * belongs to nobody in particular, and can be given to another address when
+ * that address's probe window has no unclaimed slot left. Claiming a slot
+ * (0 -> addr, or taking one over) is done under a claim lock chosen by the
+ * address's home slot, so that two claims of one address can't pick two
+ * slots; lookups take no lock, and can still stop at the first unclaimed
+ * slot, because a slot is never given back. An address whose whole probe
+ * window is in use lives in the FEBs[] stripes instead, until it is removed
+ * from them; it is created there under its claim lock too.
+ *
+ * The state word holds the FEB bit inline (FEB_FULL or FEB_EMPTY) while nobody
+ * is waiting on the address, FEB_BUSY while an inline transition copies the
+ * data, and otherwise a pointer to the address's addrstat. A slot's key only
+ * changes while its state is FEB_BUSY (or an unclaimed slot's key is claimed,
+ * whose state is FEB_FULL), so anything that holds the state busy, or holds a
+ * valid addrstat's lock, can check that the slot still belongs to its
+ * address; anything that acts on a slot does so. Seeing a slot full needs no
+ * such check: if it has changed hands since, the address was full when it
+ * did. Addrstats are retired through the hazard pointers, so readers never
+ * take a table lock. */
+typedef struct {
+    volatile uintptr_t key;
+    volatile uintptr_t state;
+} qt_feb_slot_t;
+
+#define FEB_FULL             ((uintptr_t)0)
+#define FEB_EMPTY            ((uintptr_t)1)
+#define FEB_BUSY             ((uintptr_t)3)
+#define FEB_MOVED            ((uintptr_t)5) /* returned, never stored: the slot changed hands */
+#define FEB_IS_ADDRSTAT(s)   ((s) != FEB_FULL && (((s) & 1) == 0))
+#define FEB_SLOT_KEY(sp)     (((qt_feb_slot_t *)((char *)(sp) - offsetof(qt_feb_slot_t, state)))->key)
+#define FEB_PROBE_WINDOW     32
+#define FEB_TABLE_SIZE_DFLT  16384
+#define FEB_CLAIM_LOCKS      256
+#define FEB_SWEEP_RATIO      4 /* a table sweep costs about this many lookups per slot */
+
+static qt_feb_slot_t     *feb_table      = NULL;
+static size_t             feb_table_mask = 0;
+static volatile uintptr_t feb_absent     = FEB_FULL; /* never written */
+static volatile aligned_t feb_claim_locks[FEB_CLAIM_LOCKS];
+static aligned_t          feb_overflowed = 0;        /* addrstats in the stripes */
 #ifdef QTHREAD_COUNT_THREADS
 aligned_t *febs_stripes;
 # ifdef QTHREAD_MUTEX_INCREMENT
@@ -56,6 +104,8 @@ typedef enum bt {
     READFF_NB,
     READFE,
     READFE_NB,
+    READFF_TIMED,
+    READFE_TIMED,
     FILL,
     EMPTY
 } blocker_type;
@@ -65,8 +115,29 @@ typedef struct {
     void           *b;
     blocker_type    type;
     int             retval;
+    uint64_t        usecs;
 } qthread_feb_blocker_t;
 
+#ifdef QTHREAD_USE_TIMER_WHEEL
+/* A task blocked in a timed read, which lives on its stack. The X it queued
+ * points here; whoever moves state away from TIMED_WAITING, a waker holding
+ * m->lock or the timer, is the one that wakes the task. A waker leaves an X
+ * that has timed out in its queue, for the timer to take out, so m stays put
+ * until then. */
+# define TIMED_WAITING 0
+# define TIMED_WOKEN   1
+# define TIMED_OUT     2
+typedef struct qt_feb_timed_s {
+    qt_timer_t          timer;
+    qthread_t          *waiter;
+    qthread_addrstat_t *m;
+    void               *maddr;
+    qthread_addrres_t  *X;
+    volatile aligned_t  state;
+    volatile aligned_t  done; /* the timer is finished with this */
+} qt_feb_timed_t;
+#endif
+
 /********************************************************************
  * Local Prototypes
  *********************************************************************/
@@ -121,6 +192,15 @@ static void qt_feb_subsystem_shutdown(void)
 #endif
     }
     FREE(FEBs, sizeof(qt_hash) * QTHREAD_LOCKING_STRIPES);
+    if (feb_table) {
+        for (size_t i = 0; i <= feb_table_mask; i++) {
+            if (FEB_IS_ADDRSTAT(feb_table[i].state)) {
+                qthread_addrstat_delete((qthread_addrstat_t *)feb_table[i].state);
+            }
+        }
+        FREE(feb_table, (feb_table_mask + 1) * sizeof(qt_feb_slot_t));
+        feb_table = NULL;
+    }
 #ifdef QTHREAD_COUNT_THREADS
     FREE(febs_stripes, sizeof(aligned_t) * QTHREAD_LOCKING_STRIPES);
 # ifdef QTHREAD_MUTEX_INCREMENT
@@ -142,7 +222,9 @@ static void qt_feb_subsystem_shutdown(void)
 void INTERNAL qt_feb_subsystem_init(uint_fast8_t need_sync)
 {
 #if !defined(UNPOOLED_ADDRSTAT) && !defined(UNPOOLED)
-    generic_addrstat_pool = qt_mpool_create(sizeof(qthread_addrstat_t));
+    /* addrstats are often freed by whoever empties the address, not by
+     * whoever first waited on it */
+    generic_addrstat_pool = qt_mpool_create_slab(sizeof(qthread_addrstat_t), 0, "addrstat");
 #endif
 #if !defined(UNPOOLED_ADDRRES) && !defined(UNPOOLED)
     generic_addrres_pool = qt_mpool_create(sizeof(qthread_addrres_t));
@@ -167,6 +249,18 @@ void INTERNAL qt_feb_subsystem_init(uint_fast8_t need_sync)
         FEBs[i] = qt_hash_create(need_sync);
         assert(FEBs[i]);
     }
+    {
+        size_t slots = qt_internal_get_env_num("FEB_TABLE_SIZE", FEB_TABLE_SIZE_DFLT, 0);
+
+        if (slots > 0) {
+            size_t pow2 = FEB_PROBE_WINDOW;
+            while (pow2 < slots) pow2 <<= 1;
+            feb_table = qt_calloc(pow2, sizeof(qt_feb_slot_t));
+            assert(feb_table);
+            feb_table_mask = pow2 - 1;
+        }
+        qthread_debug(FEB_DETAILS, "FEB table has %lu slots\n", (unsigned long)(feb_table ? feb_table_mask + 1 : 0));
+    }
     qthread_internal_cleanup_late(qt_feb_subsystem_shutdown);
 }
 
@@ -179,6 +273,8 @@ static inline void qt_feb_schedule(qthread_t          *waiter,
     if ((waiter->flags & QTHREAD_UNSTEALABLE) && (waiter->rdata->shepherd_ptr != shep)) {
         qthread_debug(FEB_DETAILS, "waiter(%p:%i), shep(%p:%i): enqueueing waiter in target_shep's ready queue (%p:%i)\n", waiter, (int)waiter->thread_id, shep, (int)shep->shepherd_id, waiter->rdata->shepherd_ptr, waiter->rdata->shepherd_ptr->shepherd_id);
         qt_threadqueue_enqueue(waiter->rdata->shepherd_ptr->ready, waiter);
+    } else if (qthread_internal_handoff_offer(waiter, shep)) {
+        qthread_debug(FEB_DETAILS, "waiter(%p:%i), shep(%p:%i): waiter will run next, on this worker\n", waiter, (int)waiter->thread_id, shep, (int)shep->shepherd_id);
     } else
 #ifdef QTHREAD_USE_SPAWNCACHE
     if (!qt_spawncache_spawn(waiter, shep->ready))
@@ -208,6 +304,12 @@ static aligned_t qthread_feb_blocker_thread(void *arg)
         case READFF_NB:
             a->retval = qthread_readFF_nb(a->a, a->b);
             break;
+        case READFF_TIMED:
+            a->retval = qthread_readFF_timed(a->a, a->b, a->usecs);
+            break;
+        case READFE_TIMED:
+            a->retval = qthread_readFE_timed(a->a, a->b, a->usecs);
+            break;
         case PURGE:
             a->retval = qthread_purge_to(a->a, a->b);
             break;
@@ -234,11 +336,12 @@ static aligned_t qthread_feb_blocker_thread(void *arg)
     return 0;
 }                                      /*}}} */
 
-static int qthread_feb_blocker_func(void        *dest,
-                                    void        *src,
-                                    blocker_type t)
+static int qthread_feb_blocker_timed(void        *dest,
+                                     void        *src,
+                                     blocker_type t,
+                                     uint64_t     usecs)
 {   /*{{{*/
-    qthread_feb_blocker_t args = { PTHREAD_MUTEX_INITIALIZER, dest, src, t, QTHREAD_SUCCESS };
+    qthread_feb_blocker_t args = { PTHREAD_MUTEX_INITIALIZER, dest, src, t, QTHREAD_SUCCESS, usecs };
 
     pthread_mutex_lock(&args.lock);
     qthread_fork(qthread_feb_blocker_thread, &args, NULL);
@@ -248,6 +351,13 @@ static int qthread_feb_blocker_func(void        *dest,
     return args.retval;
 } /*}}}*/
 
+static int qthread_feb_blocker_func(void        *dest,
+                                    void        *src,
+                                    blocker_type t)
+{   /*{{{*/
+    return qthread_feb_blocker_timed(dest, src, t, 0);
+} /*}}}*/
+
 #define QTHREAD_CHOOSE_STRIPE2(addr) (qt_hash64((uint64_t)(uintptr_t)addr) & (QTHREAD_LOCKING_STRIPES - 1))
 // #define QTHREAD_CHOOSE_STRIPE2(addr) QTHREAD_CHOOSE_STRIPE(addr)
 /* The lock ordering in these functions is very particular, and is designed to
@@ -256,6 +366,306 @@ static int qthread_feb_blocker_func(void        *dest,
  * may need to move to a new mechanism.
  */
 
+static QINLINE void qt_feb_claim_lock(volatile aligned_t *lock)
+{   /*{{{*/
+    do {
+        while (*lock != 0) SPINLOCK_BODY();
+    } while (qthread_cas(lock, 0, 1) != 0);
+} /*}}}*/
+
+static QINLINE void qt_feb_claim_unlock(volatile aligned_t *lock)
+{   /*{{{*/
+    COMPILER_FENCE;
+    *lock = 0;
+} /*}}}*/
+
+static QINLINE volatile aligned_t *qt_feb_claim_lock_of(const aligned_t *addr)
+{   /*{{{*/
+    return &feb_claim_locks[qt_hash64((uint64_t)(uintptr_t)addr) & (FEB_CLAIM_LOCKS - 1)];
+} /*}}}*/
+
+/* Returns nonzero if addr has an addrstat in the overflow stripes. */
+static int qt_feb_in_stripes(const aligned_t *addr)
+{   /*{{{*/
+    const int lockbin = QTHREAD_CHOOSE_STRIPE2(addr);
+    int       found;
+
+    if (!feb_overflowed) { return 0; }
+#ifdef LOCK_FREE_FEBS
+    found = (qt_hash_get(FEBs[lockbin], addr) != NULL);
+#else
+    qt_hash_lock(FEBs[lockbin]);
+    found = (qt_hash_get_locked(FEBs[lockbin], addr) != NULL);
+    qt_hash_unlock(FEBs[lockbin]);
+#endif
+    return found;
+} /*}}}*/
+
+/* Gives addr a slot in the FEB table, with addr's claim lock held: the slot it
+ * already has, an unclaimed one, or failing those, the first slot in its
+ * probe window that is full and has no waiters. Returns NULL if addr lives in
+ * the overflow stripes, or has to. */
+static volatile uintptr_t *qt_feb_claim(const aligned_t *addr)
+{   /*{{{*/
+    const uintptr_t key = (uintptr_t)addr;
+
+    for (;;) {
+        size_t         i      = qt_hash64((uint64_t)key) & feb_table_mask;
+        qt_feb_slot_t *victim = NULL;
+        qt_feb_slot_t *unused = NULL;
+
+        for (unsigned int probe = 0; probe < FEB_PROBE_WINDOW; ++probe) {
+            const uintptr_t k = feb_table[i].key;
+
+            if (k == key) { return &feb_table[i].state; }
+            if (k == 0) {
+                unused = &feb_table[i];
+                break;
+            }
+            if ((victim == NULL) && (feb_table[i].state == FEB_FULL)) {
+                victim = &feb_table[i];
+            }
+            i = (i + 1) & feb_table_mask;
+        }
+        if (qt_feb_in_stripes(addr)) { return NULL; }
+        if (unused != NULL) {
+            if (qthread_cas(&unused->key, (uintptr_t)0, key) == 0) {
+                return &unused->state;
+            }
+        } else if (victim == NULL) {
+            return NULL;
+        } else if (qthread_cas(&victim->state, FEB_FULL, FEB_BUSY) == FEB_FULL) {
+            /* whoever had it is full, and now has no slot, which is the same */
+            victim->key = key;
+            MACHINE_FENCE;
+            victim->state = FEB_FULL;
+            return &victim->state;
+        }
+        /* someone else took it first */
+    }
+} /*}}}*/
+
+/* Finds addr's slot in the FEB table. Returns NULL if addr lives in the
+ * overflow stripes, and &feb_absent if claim is zero and addr has no slot
+ * (which means it is full, and has no waiters). */
+static QINLINE volatile uintptr_t *qt_feb_slot(const aligned_t *addr,
+                                               const int        claim)
+{   /*{{{*/
+    const uintptr_t     key = (uintptr_t)addr;
+    size_t              i   = qt_hash64((uint64_t)key) & feb_table_mask;
+    unsigned int        probe;
+    volatile aligned_t *lock;
+    volatile uintptr_t *slot;
+
+    if (feb_table == NULL) { return NULL; }
+    for (probe = 0; probe < FEB_PROBE_WINDOW; ++probe) {
+        const uintptr_t k = feb_table[i].key;
+
+        if (k == key) { return &feb_table[i].state; }
+        if (k == 0) { break; }
+        i = (i + 1) & feb_table_mask;
+    }
+    if (!claim) {
+        /* only an unclaimed slot inside the window means addr never got one;
+         * with the whole window claimed, addr may be in the stripes */
+        return (probe < FEB_PROBE_WINDOW) ? &feb_absent : NULL;
+    }
+    lock = qt_feb_claim_lock_of(addr);
+    qt_feb_claim_lock(lock);
+    slot = qt_feb_claim(addr);
+    qt_feb_claim_unlock(lock);
+    return slot;
+} /*}}}*/
+
+/* Returns the slot's state once nobody is in the middle of an inline
+ * transition on it. */
+static QINLINE uintptr_t qt_feb_peek(volatile uintptr_t *slot)
+{   /*{{{*/
+    uintptr_t s;
+
+    while ((s = *slot) == FEB_BUSY) SPINLOCK_BODY();
+    return s;
+} /*}}}*/
+
+/* Moves addr's inline state from `from` to `to`, copying *src to *dest while
+ * the slot is held busy. Returns `from` if it did so, FEB_MOVED if the slot no
+ * longer belongs to addr, and otherwise whatever state the slot was in
+ * instead; a state of empty is only returned once it has been checked to be
+ * addr's. */
+static QINLINE uintptr_t qt_feb_fast(volatile uintptr_t *slot,
+                                     const aligned_t    *addr,
+                                     const uintptr_t     from,
+                                     const uintptr_t     to,
+                                     aligned_t          *dest,
+                                     const aligned_t    *src)
+{   /*{{{*/
+    uintptr_t s;
+
+    for (;;) {
+        s = qt_feb_peek(slot);
+
+        if ((s != from) && ((s != FEB_EMPTY) || (slot == &feb_absent))) { return s; }
+        if (qthread_cas(slot, s, FEB_BUSY) == s) { break; }
+    }
+    if (FEB_SLOT_KEY(slot) != (uintptr_t)addr) {
+        *slot = s;
+        return FEB_MOVED;
+    }
+    if (s != from) {
+        *slot = s;
+        return s;
+    }
+    if (dest && (dest != src)) {
+        *dest = *src;
+    }
+    MACHINE_FENCE;
+    *slot = to;
+    return from;
+} /*}}}*/
+
+/* Finds and locks the addrstat for addr, whose table slot (or NULL, for the
+ * overflow stripes) is given. If addr has no addrstat, one is created when
+ * create is set; otherwise *mp is set to NULL, which means addr is full. An
+ * inline empty state always gets an addrstat, so that callers can keep
+ * treating "no addrstat" as "full". If the slot has changed hands since it was
+ * looked up, addr is looked up again. */
+static int qt_feb_acquire(volatile uintptr_t  *slot,
+                          const aligned_t     *addr,
+                          const int            create,
+                          qthread_addrstat_t **mp)
+{   /*{{{*/
+    qthread_addrstat_t *m;
+    volatile aligned_t *claim_lock = NULL;
+
+    while (slot) {
+        const uintptr_t s = qt_feb_peek(slot);
+
+        if ((s == FEB_FULL) || (s == FEB_EMPTY)) {
+            if ((s == FEB_FULL) && !create) {
+                *mp = NULL;
+                return QTHREAD_SUCCESS;
+            }
+            m = qthread_addrstat_new();
+            if (!m) { return QTHREAD_MALLOC_ERROR; }
+            assert(FEB_IS_ADDRSTAT((uintptr_t)m));
+            if (s == FEB_EMPTY) {
+                m->full = 0;
+                QTHREAD_EMPTY_TIMER_START(m);
+            }
+            QTHREAD_FASTLOCK_LOCK(&m->lock);
+            if (qthread_cas(slot, s, FEB_BUSY) == s) {
+                if (FEB_SLOT_KEY(slot) == (uintptr_t)addr) {
+                    MACHINE_FENCE;
+                    *slot = (uintptr_t)m;
+                    *mp   = m;
+                    return QTHREAD_SUCCESS;
+                }
+                *slot = s;
+                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+                qthread_addrstat_delete(m);
+                slot = qt_feb_slot(addr, create);
+                continue;
+            }
+            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+            qthread_addrstat_delete(m);
+        } else {
+            m = (qthread_addrstat_t *)s;
+            hazardous_ptr(0, m);
+            MACHINE_FENCE;
+            if (*slot != s) { continue; }
+            QTHREAD_FASTLOCK_LOCK(&m->lock);
+            if (m->valid) {
+                /* m cannot be retired while we hold its lock, and the slot
+                 * can't change hands while m is in it */
+                hazardous_ptr(0, NULL);
+                if (FEB_SLOT_KEY(slot) == (uintptr_t)addr) {
+                    *mp = m;
+                    return QTHREAD_SUCCESS;
+                }
+                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+                slot = qt_feb_slot(addr, create);
+                continue;
+            }
+            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+        }
+    }
+
+    /* An address only goes into the stripes under its claim lock, when it
+     * still can't get a slot, so that it can't end up in both places. */
+    if (feb_table && create) {
+        claim_lock = qt_feb_claim_lock_of(addr);
+        qt_feb_claim_lock(claim_lock);
+        if ((slot = qt_feb_claim(addr)) != NULL) {
+            qt_feb_claim_unlock(claim_lock);
+            return qt_feb_acquire(slot, addr, create, mp);
+        }
+    }
+    {
+        const int lockbin = QTHREAD_CHOOSE_STRIPE2(addr);
+
+        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
+#ifdef LOCK_FREE_FEBS
+        do {
+            qthread_addrstat_t *m2;
+            m = qt_hash_get(FEBs[lockbin], addr);
+got_m:
+            if (!m) {
+                if (!create) { break; }
+                m = qthread_addrstat_new();
+                if (!m) {
+                    if (claim_lock) { qt_feb_claim_unlock(claim_lock); }
+                    return QTHREAD_MALLOC_ERROR;
+                }
+                QTHREAD_FASTLOCK_LOCK(&m->lock);
+                if (!qt_hash_put(FEBs[lockbin], addr, m)) {
+                    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+                    qthread_addrstat_delete(m);
+                    continue;
+                }
+                if (feb_table) { qthread_incr(&feb_overflowed, 1); }
+                break;
+            }
+            hazardous_ptr(0, m);
+            MACHINE_FENCE;
+            if (m != (m2 = qt_hash_get(FEBs[lockbin], addr))) {
+                m = m2;
+                goto got_m;
+            }
+            if (!m->valid) { continue; }
+            QTHREAD_FASTLOCK_LOCK(&m->lock);
+            if (!m->valid) {
+                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+                continue;
+            }
+            hazardous_ptr(0, NULL);
+            break;
+        } while (1);
+#else   /* ifdef LOCK_FREE_FEBS */
+        qt_hash_lock(FEBs[lockbin]);
+        {
+            m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], addr);
+            if (!m && create) {
+                m = qthread_addrstat_new();
+                if (!m) {
+                    qt_hash_unlock(FEBs[lockbin]);
+                    if (claim_lock) { qt_feb_claim_unlock(claim_lock); }
+                    return QTHREAD_MALLOC_ERROR;
+                }
+                if (feb_table) { qthread_incr(&feb_overflowed, 1); }
+                qassertnot(qt_hash_put_locked(FEBs[lockbin], addr, m), 0);
+            }
+            if (m) {
+                QTHREAD_FASTLOCK_LOCK(&m->lock);
+            }
+        }
+        qt_hash_unlock(FEBs[lockbin]);
+#endif  /* ifdef LOCK_FREE_FEBS */
+    }
+    if (claim_lock) { qt_feb_claim_unlock(claim_lock); }
+    *mp = m;
+    return QTHREAD_SUCCESS;
+} /*}}}*/
+
 /* This is just a little function that should help in debugging */
 int API_FUNC qthread_feb_status(const aligned_t *addr)
 {                      /*{{{ */
@@ -266,52 +676,79 @@ int API_FUNC qthread_feb_status(const aligned_t *addr)
         return 1;
     }
     qthread_addrstat_t *m;
-    int                 status  = 1; /* full */
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE2(addr);
+    volatile uintptr_t *slot;
+    int                 status = 1; /* full */
 
     QALIGN(addr, alignedaddr);
-    QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-#ifdef LOCK_FREE_FEBS
-    do {
-        m = qt_hash_get(FEBs[lockbin], (void *)alignedaddr);
-        if (!m) { break; }
-        hazardous_ptr(0, m);
-        if (m != qt_hash_get(FEBs[lockbin], (void *)alignedaddr)) { continue; }
-        if (!m->valid) { continue; }
-        QTHREAD_FASTLOCK_LOCK(&m->lock);
-        if (!m->valid) {
-            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-            continue;
-        }
+    slot = qt_feb_slot(alignedaddr, 0);
+    if (slot) {
+        const uintptr_t s = qt_feb_fast(slot, alignedaddr, FEB_EMPTY, FEB_EMPTY, NULL, NULL);
+        if (s == FEB_FULL) { return 1; }
+        if (s == FEB_EMPTY) { return 0; }
+    }
+    if (qt_feb_acquire(slot, alignedaddr, 0, &m) != QTHREAD_SUCCESS) {
+        return status;
+    }
+    if (m) {
         status = m->full;
         QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-        break;
-    } while (1);
-#else  /* ifdef LOCK_FREE_FEBS */
-    qt_hash_lock(FEBs[lockbin]); {
-        m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin],
-                                                     (void *)alignedaddr);
-        if (m) {
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
-            status = m->full;
-            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-        }
     }
-    qt_hash_unlock(FEBs[lockbin]);
-#endif  /* ifdef LOCK_FREE_FEBS */
     qthread_debug(FEB_BEHAVIOR, "addr %p is %i\n", addr, status);
     return status;
 }                      /*}}} */
 
 /* this function removes the FEB data structure for the address maddr from the
- * hash table */
+ * hash table (or puts its state back inline, if maddr has a table slot) */
 static QINLINE void qthread_FEB_remove(void *maddr)
 {                      /*{{{ */
     qthread_addrstat_t *m;
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE2(maddr);
+    volatile uintptr_t *slot = qt_feb_slot(maddr, 0);
 
     // qthread_debug(ALWAYS_OUTPUT, "Attempting removal of addr %p\n", maddr);
     qthread_debug(FEB_BEHAVIOR, "maddr=%p: attempting removal\n", maddr);
+    if (slot) {
+        uintptr_t s;
+        do {
+            s = qt_feb_peek(slot);
+            if (!FEB_IS_ADDRSTAT(s)) {
+                qthread_debug(FEB_DETAILS, "maddr=%p: addrstat already gone; someone else removed it!\n", maddr);
+                return;
+            }
+            m = (qthread_addrstat_t *)s;
+            hazardous_ptr(0, m);
+            MACHINE_FENCE;
+        } while (*slot != s);
+        QTHREAD_FASTLOCK_LOCK(&m->lock);
+        if (!m->valid) {
+            /* already retired: m stays hazardous until we let go of it */
+            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+            hazardous_ptr(0, NULL);
+            qthread_debug(FEB_DETAILS, "maddr=%p: addrstat invalid; someone else invalidated it!\n", maddr);
+            return;
+        }
+        /* m cannot be retired while we hold its lock */
+        hazardous_ptr(0, NULL);
+        if (FEB_SLOT_KEY(slot) != (uintptr_t)maddr) {
+            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+            qthread_debug(FEB_DETAILS, "maddr=%p: slot changed hands; someone else removed it!\n", maddr);
+            return;
+        }
+        if ((m->FEQ == NULL) && (m->EFQ == NULL) && (m->FFQ == NULL) && (m->FFWQ == NULL)) {
+            qthread_debug(FEB_DETAILS, "maddr=%p: lists are empty; invalidating and going back inline (m:%p)\n", maddr, m);
+            m->valid = 0;
+            MACHINE_FENCE;
+            *slot = m->full ? FEB_FULL : FEB_EMPTY;
+        } else {
+            QTHREAD_FASTLOCK_UNLOCK(&(m->lock));
+            qthread_debug(FEB_DETAILS, "maddr=%p: addrstat cannot be removed; in use\n", maddr);
+            return;
+        }
+        QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+        hazardous_release_node((hazardous_free_f)qthread_addrstat_delete, m);
+        return;
+    }
+
+    const int lockbin = QTHREAD_CHOOSE_STRIPE2(maddr);
     QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
 #ifdef LOCK_FREE_FEBS
     {
@@ -323,6 +760,7 @@ got_m:
             return;
         }
         hazardous_ptr(0, m);
+        MACHINE_FENCE;
         if (m != (m2 = qt_hash_get(FEBs[lockbin], maddr))) {
             m = m2;
             goto got_m;
@@ -342,6 +780,7 @@ got_m:
             qthread_debug(FEB_DETAILS, "maddr=%p: lists are empty, status is full; invalidating and removing (m:%p)\n", maddr, m);
             m->valid = 0;
             qassertnot(qt_hash_remove(FEBs[lockbin], maddr), 0);
+            if (feb_table) { qthread_incr(&feb_overflowed, -1); }
         } else {
             QTHREAD_FASTLOCK_UNLOCK(&(m->lock));
             qthread_debug(FEB_DETAILS, "maddr=%p: addrstat cannot be removed; in use\n", maddr);
@@ -357,6 +796,7 @@ got_m:
                 (m->full == 1)) {
                 qthread_debug(FEB_DETAILS, "maddr=%p: lists are empty, status is full; invalidating and removing\n", maddr);
                 qassertnot(qt_hash_remove_locked(FEBs[lockbin], maddr), 0);
+                if (feb_table) { qthread_incr(&feb_overflowed, -1); }
             } else {
                 QTHREAD_FASTLOCK_UNLOCK(&(m->lock));
                 qthread_debug(FEB_DETAILS, "maddr=%p: addrstat cannot be removed; in use\n", maddr);
@@ -376,6 +816,77 @@ got_m:
     }
 }                      /*}}} */
 
+/* Unlinks and returns the first waiter in *q that can still be woken, passing
+ * over timed reads that have timed out (their timers take them out). */
+static QINLINE qthread_addrres_t *qt_feb_dequeue(qthread_addrres_t **q)
+{   /*{{{*/
+    qthread_addrres_t *X;
+
+    while ((X = *q) != NULL) {
+#ifdef QTHREAD_USE_TIMER_WHEEL
+        if ((X->timed != NULL) &&
+            (qthread_cas(&X->timed->state, TIMED_WAITING, TIMED_WOKEN) != TIMED_WAITING)) {
+            q = &X->next;
+            continue;
+        }
+#endif
+        *q = X->next;
+        return X;
+    }
+    return NULL;
+} /*}}}*/
+
+#ifdef QTHREAD_USE_TIMER_WHEEL
+static QINLINE int qt_feb_unlink(qthread_addrres_t **q,
+                                 qthread_addrres_t  *X)
+{   /*{{{*/
+    for (; *q != NULL; q = &(*q)->next) {
+        if (*q == X) {
+            *q = X->next;
+            return 1;
+        }
+    }
+    return 0;
+} /*}}}*/
+
+/* The timer of a timed read: unless a waker got there first, take the task's
+ * X back out of m's queue, and wake the task up empty-handed. */
+static void qt_feb_timed_out(qt_timer_t *timer)
+{   /*{{{*/
+    qt_feb_timed_t     *tw = (qt_feb_timed_t *)timer->arg;
+    qthread_t          *waiter;
+    qthread_addrstat_t *m;
+    void               *maddr;
+    int                 removeable;
+
+    if (qthread_cas(&tw->state, TIMED_WAITING, TIMED_OUT) != TIMED_WAITING) {
+        /* the task has been woken, and is waiting for us to let go of tw */
+        MACHINE_FENCE;
+        tw->done = 1;
+        return;
+    }
+    waiter = tw->waiter;
+    m      = tw->m;
+    maddr  = tw->maddr;
+    /* X is still queued, so m is still there */
+    QTHREAD_FASTLOCK_LOCK(&m->lock);
+    if (!qt_feb_unlink(&m->FEQ, tw->X)) {
+        (void)qt_feb_unlink(&m->FFQ, tw->X);
+    }
+    FREE_ADDRRES(tw->X);
+    removeable = (m->EFQ == NULL) && (m->FEQ == NULL) && (m->FFQ == NULL) && (m->FFWQ == NULL);
+    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+    qthread_debug(FEB_DETAILS, "m(%p), maddr(%p): tid %u timed out\n", m, maddr, waiter->thread_id);
+    /* once the task is queued, tw may be gone */
+    waiter->thread_state = QTHREAD_STATE_RUNNING;
+    QTPERF_QTHREAD_ENTER_STATE(waiter->rdata->performance_data, QTHREAD_STATE_RUNNING);
+    qt_threadqueue_enqueue(waiter->rdata->shepherd_ptr->ready, waiter);
+    if (removeable) {
+        qthread_FEB_remove(maddr);
+    }
+} /*}}}*/
+#endif /* ifdef QTHREAD_USE_TIMER_WHEEL */
+
 static QINLINE void qthread_precond_launch(qthread_shepherd_t *shep,
                                            qthread_addrres_t  *precond_tasks)
 {   /*{{{*/
@@ -510,10 +1021,7 @@ static QINLINE void qthread_gotlock_fill_inner(qthread_shepherd_t *shep,
         }
     }
     /* dequeue all FFQ, do their operation, and schedule them */
-    while (m->FFQ != NULL) {
-        /* dQ */
-        X      = m->FFQ;
-        m->FFQ = X->next;
+    while ((X = qt_feb_dequeue(&m->FFQ)) != NULL) {
         /* op */
         if (X->addr && (X->addr != maddr)) {
             *(aligned_t *)(X->addr) = *(aligned_t *)maddr;
@@ -535,10 +1043,8 @@ static QINLINE void qthread_gotlock_fill_inner(qthread_shepherd_t *shep,
             FREE_ADDRRES(X);
         }
     }
-    if (m->FEQ != NULL) {
+    if ((X = qt_feb_dequeue(&m->FEQ)) != NULL) {
         /* dequeue one FEQ, do their operation, and schedule them */
-        X      = m->FEQ;
-        m->FEQ = X->next;
         /* op */
         if (X->addr && (X->addr != maddr)) {
             *(aligned_t *)(X->addr) = *(aligned_t *)maddr;
@@ -578,12 +1084,13 @@ static QINLINE void qthread_gotlock_fill(qthread_shepherd_t *shep,
     qthread_gotlock_fill_inner(shep, m, maddr, 0, &tmp);
 }
 
+
 int API_FUNC qthread_empty(const aligned_t *dest)
 {                      /*{{{ */
     const aligned_t *alignedaddr;
 
     qthread_addrstat_t *m;
-    qt_hash             FEBbin;
+    volatile uintptr_t *slot;
     qthread_shepherd_t *shep = qthread_internal_getshep();
 
     assert(qthread_library_initialized);
@@ -592,74 +1099,24 @@ int API_FUNC qthread_empty(const aligned_t *dest)
         return qthread_feb_blocker_func((void *)dest, NULL, EMPTY);
     }
     QALIGN(dest, alignedaddr);
-    {
-        const int lockbin = QTHREAD_CHOOSE_STRIPE2(alignedaddr);
-        FEBbin = FEBs[lockbin];
-        qthread_debug(FEB_CALLS, "dest=%p (tid=%i lockbin=%u)\n", dest, qthread_id(), lockbin);
-
-        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-    }
-#ifdef LOCK_FREE_FEBS
-    do {
-        m = qt_hash_get(FEBbin, (void *)alignedaddr);
-        if (!m) {
-            /* currently full, and must be added to the hash to empty */
-            m = qthread_addrstat_new();
-            if (!m) { return QTHREAD_MALLOC_ERROR; }
-            m->full = 0;
-            MACHINE_FENCE;
-            QTHREAD_EMPTY_TIMER_START(m);
-            if (!qt_hash_put(FEBbin, (void *)alignedaddr, m)) {
-                qthread_addrstat_delete(m);
-                continue;
-            }
-            m = NULL;
-            break;
-        } else {
-            /* it could be either full or not, don't know */
-            hazardous_ptr(0, m);
-            if (m != qt_hash_get(FEBbin, (void *)alignedaddr)) { continue; }
-            if (!m->valid) { continue; }
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
-            if (!m->valid) {
-                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                continue;
-            }
-            if (!m->full) {
-                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                m = NULL;
-            }
-            break;
-        }
-    } while (1);
-#else  /* ifdef LOCK_FREE_FEBS */
-    qt_hash_lock(FEBbin);
-    {                      /* BEGIN CRITICAL SECTION */
-        m = (qthread_addrstat_t *)qt_hash_get_locked(FEBbin, (void *)alignedaddr);
-        if (!m) {
-            /* currently full, and must be added to the hash to empty */
-            m = qthread_addrstat_new();
-            if (!m) {
-                qt_hash_unlock(FEBbin);
-                return QTHREAD_MALLOC_ERROR;
-            }
-            m->full = 0;
-            QTHREAD_EMPTY_TIMER_START(m);
-            COMPILER_FENCE;
-            qassertnot(qt_hash_put_locked(FEBbin, (void *)alignedaddr, m), 0);
-            qthread_debug(FEB_DETAILS, "dest=%p (tid=%i): inserted m=%p\n", dest, qthread_id(), m);
-            m = NULL;
-        } else {
-            /* it could be either full or not, don't know */
-            qthread_debug(FEB_DETAILS, "dest=%p (tid=%i): found m=%p\n", dest, qthread_id(), m);
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
+    qthread_debug(FEB_CALLS, "dest=%p (tid=%i)\n", dest, qthread_id());
+    slot = qt_feb_slot(alignedaddr, 1);
+    if (slot) {
+        const uintptr_t s = qt_feb_fast(slot, alignedaddr, FEB_FULL, FEB_EMPTY, NULL, NULL);
+        if ((s == FEB_FULL) || (s == FEB_EMPTY)) {
+            qthread_debug(FEB_BEHAVIOR, "dest=%p (tid=%i): success (inline)\n", dest, qthread_id());
+            return QTHREAD_SUCCESS;
         }
-    }                      /* END CRITICAL SECTION */
-    qt_hash_unlock(FEBbin);
-#endif  /* ifdef LOCK_FREE_FEBS */
-    if (m) {
+    }
+    if (qt_feb_acquire(slot, alignedaddr, 1, &m) != QTHREAD_SUCCESS) {
+        return QTHREAD_MALLOC_ERROR;
+    }
+    assert(m);
+    if (m->full) {
         qthread_debug(FEB_BEHAVIOR, "dest=%p (tid=%i): waking waiters\n", dest, qthread_id());
         qthread_gotlock_empty(shep, m, (void *)alignedaddr);
+    } else {
+        QTHREAD_FASTLOCK_UNLOCK(&m->lock);
     }
     qthread_debug(FEB_BEHAVIOR, "dest=%p (tid=%i): success\n", dest, qthread_id());
     return QTHREAD_SUCCESS;
@@ -673,8 +1130,8 @@ int API_FUNC qthread_fill(const aligned_t *dest)
         return QTHREAD_SUCCESS;
     }
     qthread_addrstat_t *m;
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE2(dest);
-    qthread_shepherd_t *shep    = qthread_internal_getshep();
+    volatile uintptr_t *slot;
+    qthread_shepherd_t *shep = qthread_internal_getshep();
 
     assert(qthread_library_initialized);
 
@@ -683,35 +1140,17 @@ int API_FUNC qthread_fill(const aligned_t *dest)
     }
     qthread_debug(FEB_CALLS, "dest=%p (tid=%i)\n", dest, qthread_id());
     QALIGN(dest, alignedaddr);
-    /* lock hash */
-    QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-#ifdef LOCK_FREE_FEBS
-    do {
-        m = qt_hash_get(FEBs[lockbin], (void *)alignedaddr);
-        if (!m) {
-            /* already full */
-            break;
-        }
-        hazardous_ptr(0, m);
-        if (m != qt_hash_get(FEBs[lockbin], (void *)alignedaddr)) { continue; }
-        if (!m->valid) { continue; }
-        QTHREAD_FASTLOCK_LOCK(&m->lock);
-        if (!m->valid) {
-            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-            continue;
-        }
-        break;
-    } while (1);
-#else  /* ifdef LOCK_FREE_FEBS */
-    qt_hash_lock(FEBs[lockbin]);
-    {                      /* BEGIN CRITICAL SECTION */
-        m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], (void *)alignedaddr);
-        if (m) {
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
+    slot = qt_feb_slot(alignedaddr, 0);
+    if (slot) {
+        const uintptr_t s = qt_feb_fast(slot, alignedaddr, FEB_EMPTY, FEB_FULL, NULL, NULL);
+        if ((s == FEB_FULL) || (s == FEB_EMPTY)) {
+            qthread_debug(FEB_DETAILS, "dest=%p (tid=%i): success (inline)\n", dest, qthread_id());
+            return QTHREAD_SUCCESS;
         }
-    }                              /* END CRITICAL SECTION */
-    qt_hash_unlock(FEBs[lockbin]); /* unlock hash */
-#endif  /* ifdef LOCK_FREE_FEBS */
+    }
+    if (qt_feb_acquire(slot, alignedaddr, 0, &m) != QTHREAD_SUCCESS) {
+        return QTHREAD_MALLOC_ERROR;
+    }
     if (m) {
         /* if dest wasn't in the hash, it was already full. Since it was,
          * we need to fill it. */
@@ -734,8 +1173,8 @@ int API_FUNC qthread_writeF(aligned_t *restrict       dest,
 
     qthread_debug(FEB_CALLS, "dest=%p, src=%p\n", dest, src);
     qthread_addrstat_t *m;
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE2(dest);
-    qthread_shepherd_t *shep    = qthread_internal_getshep();
+    volatile uintptr_t *slot;
+    qthread_shepherd_t *shep = qthread_internal_getshep();
 
     assert(qthread_library_initialized);
 
@@ -745,35 +1184,20 @@ int API_FUNC qthread_writeF(aligned_t *restrict       dest,
     qthread_debug(FEB_BEHAVIOR, "tid %u dest=%p src=%p...\n", (shep->current) ? (shep->current->thread_id) : UINT_MAX, dest, src);
     QALIGN(dest, alignedaddr);
     QTHREAD_FEB_UNIQUERECORD2(feb, dest, shep);
-    QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-#ifdef LOCK_FREE_FEBS
-    do {
-        qthread_addrstat_t *m2;
-        m = qt_hash_get(FEBs[lockbin], (void *)alignedaddr);
-got_m:
-        if (!m) { /* already full */ break; }
-        hazardous_ptr(0, m);
-        if (m != (m2 = qt_hash_get(FEBs[lockbin], (void *)alignedaddr))) {
-            m = m2;
-            goto got_m;
-        }
-        if (!m->valid) { continue; }
-        QTHREAD_FASTLOCK_LOCK(&m->lock);
-        if (!m->valid) {
-            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-            continue;
-        }
-        break;
-    } while (1);
-#else  /* ifdef LOCK_FREE_FEBS */
-    qt_hash_lock(FEBs[lockbin]); {    /* lock hash */
-        m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], (void *)alignedaddr);
-        if (m) {
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
+    slot = qt_feb_slot(alignedaddr, 0);
+    if (slot) {
+        const uintptr_t s = qt_feb_fast(slot, alignedaddr, FEB_EMPTY, FEB_FULL, dest, src);
+        if (s == FEB_EMPTY) { return QTHREAD_SUCCESS; }
+        if (s == FEB_FULL) {
+            if (dest && (dest != src)) {
+                memcpy(dest, src, sizeof(aligned_t));
+            }
+            return QTHREAD_SUCCESS;
         }
     }
-    qt_hash_unlock(FEBs[lockbin]);    /* unlock hash */
-#endif  /* ifdef LOCK_FREE_FEBS */
+    if (qt_feb_acquire(slot, alignedaddr, 0, &m) != QTHREAD_SUCCESS) {
+        return QTHREAD_MALLOC_ERROR;
+    }
     /* we have the lock on m, so... */
     if (dest && (dest != src)) {
         memcpy(dest, src, sizeof(aligned_t));
@@ -802,7 +1226,7 @@ int API_FUNC qthread_purge_to(aligned_t *restrict       dest,
     const aligned_t *alignedaddr;
 
     qthread_addrstat_t *m;
-    qt_hash             FEBbin;
+    volatile uintptr_t *slot;
     qthread_shepherd_t *shep = qthread_internal_getshep();
 
     assert(qthread_library_initialized);
@@ -812,78 +1236,30 @@ int API_FUNC qthread_purge_to(aligned_t *restrict       dest,
     }
     QALIGN(dest, alignedaddr);
     QTHREAD_FEB_UNIQUERECORD2(feb, dest, shep);
-    {
-        const int lockbin = QTHREAD_CHOOSE_STRIPE2(alignedaddr);
-        FEBbin = FEBs[lockbin];
-        qthread_debug(FEB_CALLS, "dest=%p src=%p (tid=%i lockbin=%u)\n", dest, src, qthread_id(), lockbin);
-
-        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-    }
-#ifdef LOCK_FREE_FEBS
-    do {
-        m = qt_hash_get(FEBbin, (void *)alignedaddr);
-        if (!m) {
-            /* currently full, and must be added to the hash to empty */
-            m = qthread_addrstat_new();
-            if (!m) { return QTHREAD_MALLOC_ERROR; }
-            m->full = 0;
-            MACHINE_FENCE;
-            QTHREAD_EMPTY_TIMER_START(m);
-            if (!qt_hash_put(FEBbin, (void *)alignedaddr, m)) {
-                qthread_addrstat_delete(m);
-                continue;
-            }
-            m = NULL;
-            break;
-        } else {
-            /* it could be either full or not, don't know */
-            hazardous_ptr(0, m);
-            if (m != qt_hash_get(FEBbin, (void *)alignedaddr)) { continue; }
-            if (!m->valid) { continue; }
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
-            if (!m->valid) {
-                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                continue;
-            }
-            if (!m->full) {
-                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                m = NULL;
-            }
-            break;
-        }
-    } while (1);
-#else  /* ifdef LOCK_FREE_FEBS */
-    qt_hash_lock(FEBbin);
-    {                      /* BEGIN CRITICAL SECTION */
-        m = (qthread_addrstat_t *)qt_hash_get_locked(FEBbin, (void *)alignedaddr);
-        if (!m) {
-            /* currently full, and must be added to the hash to empty */
-            m = qthread_addrstat_new();
-            if (!m) {
-                qt_hash_unlock(FEBbin);
-                return QTHREAD_MALLOC_ERROR;
+    qthread_debug(FEB_CALLS, "dest=%p src=%p (tid=%i)\n", dest, src, qthread_id());
+    slot = qt_feb_slot(alignedaddr, 1);
+    if (slot) {
+        uintptr_t s;
+        while ((s = qt_feb_fast(slot, alignedaddr, FEB_FULL, FEB_EMPTY, dest, src)) == FEB_EMPTY) {
+            if (qt_feb_fast(slot, alignedaddr, FEB_EMPTY, FEB_EMPTY, dest, src) == FEB_EMPTY) {
+                return QTHREAD_SUCCESS;
             }
-            m->full = 0;
-            QTHREAD_EMPTY_TIMER_START(m);
-            COMPILER_FENCE;
-            qassertnot(qt_hash_put_locked(FEBbin, (void *)alignedaddr, m), 0);
-            qthread_debug(FEB_DETAILS, "dest=%p src=%p (tid=%i): inserted m=%p\n", dest, src, qthread_id(), m);
-            m = NULL;
-        } else {
-            /* it could be either full or not, don't know */
-            qthread_debug(FEB_DETAILS, "dest=%p src=%p (tid=%i): found m=%p\n", dest, src, qthread_id(), m);
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
         }
-    }                      /* END CRITICAL SECTION */
-    qt_hash_unlock(FEBbin);
-#endif  /* ifdef LOCK_FREE_FEBS */
+        if (s == FEB_FULL) { return QTHREAD_SUCCESS; }
+    }
+    if (qt_feb_acquire(slot, alignedaddr, 1, &m) != QTHREAD_SUCCESS) {
+        return QTHREAD_MALLOC_ERROR;
+    }
+    assert(m);
     if (dest && (dest != src)) {
-	*(aligned_t *)dest = *(aligned_t *)src;
-	MACHINE_FENCE;
+        *(aligned_t *)dest = *(aligned_t *)src;
+        MACHINE_FENCE;
     }
-    if (m) {
+    if (m->full) {
         qthread_debug(FEB_BEHAVIOR, "dest=%p src=%p (tid=%i): waking waiters\n", dest, src, qthread_id());
         qthread_gotlock_empty(shep, m, (void *)alignedaddr);
+    } else {
+        QTHREAD_FASTLOCK_UNLOCK(&m->lock);
     }
     qthread_debug(FEB_BEHAVIOR, "dest=%p src=%p (tid=%i): success\n", dest, src, qthread_id());
     return QTHREAD_SUCCESS;
@@ -913,9 +1289,9 @@ int API_FUNC qthread_writeEF(aligned_t *restrict       dest,
     aligned_t *alignedaddr;
 
     qthread_addrstat_t *m;
-    qthread_addrres_t  *X       = NULL;
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE2(dest);
-    qthread_t          *me      = qthread_internal_self();
+    qthread_addrres_t  *X = NULL;
+    volatile uintptr_t *slot;
+    qthread_t          *me = qthread_internal_self();
 
     QTHREAD_FEB_TIMER_DECLARATION(febblock);
 
@@ -928,65 +1304,15 @@ int API_FUNC qthread_writeEF(aligned_t *restrict       dest,
     QTHREAD_FEB_UNIQUERECORD(feb, dest, me);
     QTHREAD_FEB_TIMER_START(febblock);
     QALIGN(dest, alignedaddr);
-    QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-#ifdef LOCK_FREE_FEBS
-    do {
-        m = qt_hash_get(FEBs[lockbin], (void *)alignedaddr);
-got_m:
-        if (!m) {
-            /* currently full, must add to hash to wait */
-            m = qthread_addrstat_new();
-            if (!m) {
-                // qthread_debug(FEB_DETAILS, "dest=%p, src=%p (tid=%i): MALLOC FAILURE!!!!!!!!!!\n", dest, src, me->thread_id);
-                return QTHREAD_MALLOC_ERROR;
-            }
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
-            if (!qt_hash_put(FEBs[lockbin], (void *)alignedaddr, m)) {
-                // qthread_debug(FEB_DETAILS, "dest=%p, src=%p (tid=%i): put failure\n", dest, src, me->thread_id);
-                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                qthread_addrstat_delete(m);
-                continue;
-            }
-            break;
-        } else {
-            qthread_addrstat_t *m2;
-
-            /* could be either full or not, don't know */
-            hazardous_ptr(0, m);
-            if ((m2 = qt_hash_get(FEBs[lockbin], (void *)alignedaddr)) != m) {
-                // qthread_debug(FEB_DETAILS, "dest=%p, src=%p (tid=%i): pointer changed! (%p != %p)\n", dest, src, me->thread_id, m, m2);
-                m = m2;
-                goto got_m;
-            }
-            if (!m->valid) {
-                // qthread_debug(FEB_DETAILS, "dest=%p, src=%p (tid=%i): m(%p) invalid!\n", dest, src, me->thread_id, m);
-                continue;
-            }
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
-            if (!m->valid) {
-                // qthread_debug(FEB_DETAILS, "dest=%p, src=%p (tid=%i): m(%p) invalid!\n", dest, src, me->thread_id, m);
-                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                continue;
-            }
-            break;
-        }
-    } while(1);
-#else  /* ifdef LOCK_FREE_FEBS */
-    qt_hash_lock(FEBs[lockbin]);
-    {
-        m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], (void *)alignedaddr);
-        if (!m) {
-            m = qthread_addrstat_new();
-            if (!m) {
-                qt_hash_unlock(FEBs[lockbin]);
-                return QTHREAD_MALLOC_ERROR;
-            }
-            qassertnot(qt_hash_put_locked(FEBs[lockbin], alignedaddr, m), 0);
-        }
-        QTHREAD_FASTLOCK_LOCK(&(m->lock));
+    slot = qt_feb_slot(alignedaddr, 1);
+    if (slot && (qt_feb_fast(slot, alignedaddr, FEB_EMPTY, FEB_FULL, dest, src) == FEB_EMPTY)) {
+        qthread_debug(FEB_BEHAVIOR, "dest=%p, src=%p (tid=%i): succeeded inline\n", dest, src, me->thread_id);
+        QTHREAD_FEB_TIMER_STOP(febblock, me);
+        return QTHREAD_SUCCESS;
+    }
+    if (qt_feb_acquire(slot, alignedaddr, 1, &m) != QTHREAD_SUCCESS) {
+        return QTHREAD_MALLOC_ERROR;
     }
-    qt_hash_unlock(FEBs[lockbin]);
-#endif  /* ifdef LOCK_FREE_FEBS */
     assert(m);
     qthread_debug(FEB_DETAILS, "dest=%p, src=%p (tid=%i): data structure locked, m(%p)->full = %i\n", dest, src, me->thread_id, m, m->full);
     /* by this point m is locked */
@@ -1001,8 +1327,9 @@ got_m:
         X->addr   = (aligned_t *)src;
         X->waiter = me;
         X->next   = m->EFQ;
+        X->timed  = NULL;
         m->EFQ    = X;
-        qthread_debug(FEB_DETAILS, "dest=%p, src=%p (tid=%i): back to parent (m=%p, X=%p, slice=%u)\n", dest, src, me->thread_id, m, X, lockbin);
+        qthread_debug(FEB_DETAILS, "dest=%p, src=%p (tid=%i): back to parent (m=%p, X=%p)\n", dest, src, me->thread_id, m, X);
         me->thread_state          = QTHREAD_STATE_FEB_BLOCKED;
         me->rdata->blockedon.addr = m;
         QTHREAD_WAIT_TIMER_START();
@@ -1037,8 +1364,8 @@ int API_FUNC qthread_writeEF_nb(aligned_t *restrict       dest,
 
     qthread_debug(FEB_CALLS, "dest=%p, src=%p\n", dest, src);
     qthread_addrstat_t *m;
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE2(dest);
-    qthread_t          *me      = qthread_internal_self();
+    volatile uintptr_t *slot;
+    qthread_t          *me = qthread_internal_self();
 
     if (!me) {
         return qthread_feb_blocker_func(dest, (void *)src, WRITEEF);
@@ -1046,36 +1373,20 @@ int API_FUNC qthread_writeEF_nb(aligned_t *restrict       dest,
     qthread_debug(FEB_BEHAVIOR, "tid %u dest=%p src=%p...\n", me->thread_id, dest, src);
     QTHREAD_FEB_UNIQUERECORD(feb, dest, me);
     QALIGN(dest, alignedaddr);
-    QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-# ifdef LOCK_FREE_FEBS
-    do {
-        m = qt_hash_get(FEBs[lockbin], (void *)alignedaddr);
-        if (m) {
-            /* could be either full or not, don't know */
-            hazardous_ptr(0, m);
-            if (m != qt_hash_get(FEBs[lockbin], (void *)alignedaddr)) { continue; }
-            if (!m->valid) { continue; }
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
-            if (!m->valid) {
-                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                continue;
-            }
-            break;
-        }
-    } while (1);
-# else /* ifdef LOCK_FREE_FEBS */
-    qt_hash_lock(FEBs[lockbin]);
-    {
-        m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], (void *)alignedaddr);
-        if (m) {
-            QTHREAD_FASTLOCK_LOCK(&(m->lock));
+    slot = qt_feb_slot(alignedaddr, 0);
+    if (slot) {
+        const uintptr_t s = qt_feb_fast(slot, alignedaddr, FEB_EMPTY, FEB_FULL, dest, src);
+        if (s == FEB_EMPTY) { return QTHREAD_SUCCESS; }
+        if (s == FEB_FULL) {
+            qthread_debug(FEB_BEHAVIOR, "tid %u non-blocking fail\n", me->thread_id);
+            return QTHREAD_OPFAIL;
         }
     }
-    qt_hash_unlock(FEBs[lockbin]);
-# endif /* ifdef LOCK_FREE_FEBS */
-    qthread_debug(FEB_DETAILS, "data structure locked\n");
+    if (qt_feb_acquire(slot, alignedaddr, 0, &m) != QTHREAD_SUCCESS) {
+        return QTHREAD_MALLOC_ERROR;
+    }
+    qthread_debug(FEB_DETAILS, "data structure locked or null (m=%p)\n", m);
     /* by this point m is locked */
-    qthread_debug(FEB_DETAILS, "m->full == %i\n", m->full);
     if ((m == NULL) || (m->full == 1)) {            /* full, thus, we must block */
         qthread_debug(FEB_BEHAVIOR, "tid %u non-blocking fail\n", me->thread_id);
         if (m) { QTHREAD_FASTLOCK_UNLOCK(&(m->lock)); }
@@ -1107,10 +1418,10 @@ int API_FUNC qthread_writeFF(aligned_t *restrict       dest,
 {                      /*{{{ */
     const aligned_t *alignedaddr;
 
-    qthread_addrstat_t *m       = NULL;
-    qthread_addrres_t  *X       = NULL;
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE2(dest);
-    qthread_t          *me      = qthread_internal_self();
+    qthread_addrstat_t *m = NULL;
+    qthread_addrres_t  *X = NULL;
+    volatile uintptr_t *slot;
+    qthread_t          *me = qthread_internal_self();
 
     QTHREAD_FEB_TIMER_DECLARATION(febblock);
 
@@ -1123,31 +1434,12 @@ int API_FUNC qthread_writeFF(aligned_t *restrict       dest,
     QTHREAD_FEB_UNIQUERECORD(feb, dest, me);
     QTHREAD_FEB_TIMER_START(febblock);
     QALIGN(dest, alignedaddr);
-    QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-# ifdef LOCK_FREE_FEBS
-    do {
-        m = qt_hash_get(FEBs[lockbin], (void *)alignedaddr);
-        if (!m) { break; }
-        hazardous_ptr(0, m);
-        if (m != qt_hash_get(FEBs[lockbin], (void *)alignedaddr)) { continue; }
-        if (!m->valid) { continue; }
-        QTHREAD_FASTLOCK_LOCK(&m->lock);
-        if (!m->valid) {
-            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-            continue;
-        }
-        break;
-    } while(1);
-# else /* ifdef LOCK_FREE_FEBS */
-    qt_hash_lock(FEBs[lockbin]);
-    {
-        m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], (void *)alignedaddr);
-        if (m) {
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
+    slot = qt_feb_slot(alignedaddr, 0);
+    if ((slot == NULL) || (qt_feb_peek(slot) != FEB_FULL)) {
+        if (qt_feb_acquire(slot, alignedaddr, 0, &m) != QTHREAD_SUCCESS) {
+            return QTHREAD_MALLOC_ERROR;
         }
     }
-    qt_hash_unlock(FEBs[lockbin]);
-# endif /* ifdef LOCK_FREE_FEBS */
     qthread_debug(FEB_DETAILS, "dest=%p, src=%p (tid=%u): data structure locked or null (m=%p)\n", dest, src, me->thread_id, m);
     /* now m, if it exists, is locked - if m is NULL, then we're done! */
     if (m == NULL) {               /* already full! */
@@ -1166,6 +1458,7 @@ int API_FUNC qthread_writeFF(aligned_t *restrict       dest,
         X->addr   = (aligned_t *)src;
         X->waiter = me;
         X->next   = m->FFWQ;
+        X->timed  = NULL;
         m->FFWQ   = X;
         qthread_debug(FEB_DETAILS, "dest=%p, src=%p (tid=%u): back to parent\n", dest, src, me->thread_id);
         me->thread_state          = QTHREAD_STATE_FEB_BLOCKED;
@@ -1206,10 +1499,10 @@ int API_FUNC qthread_readFF(aligned_t *restrict       dest,
 {                      /*{{{ */
     const aligned_t *alignedaddr;
 
-    qthread_addrstat_t *m       = NULL;
-    qthread_addrres_t  *X       = NULL;
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE2(src);
-    qthread_t          *me      = qthread_internal_self();
+    qthread_addrstat_t *m = NULL;
+    qthread_addrres_t  *X = NULL;
+    volatile uintptr_t *slot;
+    qthread_t          *me = qthread_internal_self();
 
     QTHREAD_FEB_TIMER_DECLARATION(febblock);
 
@@ -1222,31 +1515,12 @@ int API_FUNC qthread_readFF(aligned_t *restrict       dest,
     QTHREAD_FEB_UNIQUERECORD(feb, src, me);
     QTHREAD_FEB_TIMER_START(febblock);
     QALIGN(src, alignedaddr);
-    QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-# ifdef LOCK_FREE_FEBS
-    do {
-        m = qt_hash_get(FEBs[lockbin], (void *)alignedaddr);
-        if (!m) { break; }
-        hazardous_ptr(0, m);
-        if (m != qt_hash_get(FEBs[lockbin], (void *)alignedaddr)) { continue; }
-        if (!m->valid) { continue; }
-        QTHREAD_FASTLOCK_LOCK(&m->lock);
-        if (!m->valid) {
-            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-            continue;
-        }
-        break;
-    } while(1);
-# else /* ifdef LOCK_FREE_FEBS */
-    qt_hash_lock(FEBs[lockbin]);
-    {
-        m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], (void *)alignedaddr);
-        if (m) {
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
+    slot = qt_feb_slot(alignedaddr, 0);
+    if ((slot == NULL) || (qt_feb_peek(slot) != FEB_FULL)) {
+        if (qt_feb_acquire(slot, alignedaddr, 0, &m) != QTHREAD_SUCCESS) {
+            return QTHREAD_MALLOC_ERROR;
         }
     }
-    qt_hash_unlock(FEBs[lockbin]);
-# endif /* ifdef LOCK_FREE_FEBS */
     qthread_debug(FEB_DETAILS, "dest=%p, src=%p (tid=%u): data structure locked or null (m=%p)\n", dest, src, me->thread_id, m);
     /* now m, if it exists, is locked - if m is NULL, then we're done! */
     if (m == NULL) {               /* already full! */
@@ -1265,6 +1539,7 @@ int API_FUNC qthread_readFF(aligned_t *restrict       dest,
         X->addr   = (aligned_t *)dest;
         X->waiter = me;
         X->next   = m->FFQ;
+        X->timed  = NULL;
         m->FFQ    = X;
         qthread_debug(FEB_DETAILS, "dest=%p, src=%p (tid=%u): back to parent\n", dest, src, me->thread_id);
         me->thread_state          = QTHREAD_STATE_FEB_BLOCKED;
@@ -1288,15 +1563,50 @@ int API_FUNC qthread_readFF(aligned_t *restrict       dest,
     return QTHREAD_SUCCESS;
 }                      /*}}} */
 
+/* Waits until each of the count words starting at addr has been seen full,
+ * for callers that are about to read a whole range of them. A word that has
+ * no slot in the FEB table, and no addrstat in the overflow stripes, is
+ * full; so as long as nothing is in the stripes and the range is large next
+ * to the table, one sweep over the table turns up every word of the range
+ * that might not be full. Otherwise
+ * each word is looked up on its own, which still takes no locks unless the
+ * word turns out not to be full. Either way, only the words that are not
+ * full go through qthread_readFF(). */
+void INTERNAL qt_feb_wait_full(const aligned_t *addr,
+                               const size_t     count)
+{   /*{{{*/
+    if (feb_table && !feb_overflowed &&
+        (count * FEB_SWEEP_RATIO >= feb_table_mask + 1)) {
+        const uintptr_t lo = (uintptr_t)addr;
+        const uintptr_t hi = (uintptr_t)(addr + count);
+
+        for (size_t i = 0; i <= feb_table_mask; i++) {
+            const uintptr_t k = feb_table[i].key;
+
+            if ((k >= lo) && (k < hi) && (qt_feb_peek(&feb_table[i].state) != FEB_FULL)) {
+                qthread_readFF(NULL, (const aligned_t *)k);
+            }
+        }
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        volatile uintptr_t *slot = qt_feb_slot(addr + i, 0);
+
+        if ((slot == NULL) || (qt_feb_peek(slot) != FEB_FULL)) {
+            qthread_readFF(NULL, addr + i);
+        }
+    }
+} /*}}}*/
+
 int API_FUNC qthread_readFF_nb(aligned_t *restrict       dest,
                                const aligned_t *restrict src)
 {                      /*{{{ */
     const aligned_t *alignedaddr;
 
     qthread_debug(FEB_CALLS, "dest=%p, src=%p\n", dest, src);
-    qthread_addrstat_t *m       = NULL;
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE2(src);
-    qthread_t          *me      = qthread_internal_self();
+    qthread_addrstat_t *m = NULL;
+    volatile uintptr_t *slot;
+    qthread_t          *me = qthread_internal_self();
 
     if (!me) {
         return qthread_feb_blocker_func(dest, (void *)src, READFF_NB);
@@ -1304,37 +1614,20 @@ int API_FUNC qthread_readFF_nb(aligned_t *restrict       dest,
     qthread_debug(FEB_BEHAVIOR, "tid %u dest=%p src=%p...\n", me->thread_id, dest, src);
     QTHREAD_FEB_UNIQUERECORD(feb, src, me);
     QALIGN(src, alignedaddr);
-    QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-# ifdef LOCK_FREE_FEBS
-    do {
-        qthread_addrstat_t *m2;
-        m = qt_hash_get(FEBs[lockbin], (void *)alignedaddr);
-got_m:
-        if (!m) { break; }
-        hazardous_ptr(0, m);
-        if (m != (m2 = qt_hash_get(FEBs[lockbin], (void *)alignedaddr))) {
-            m = m2;
-            goto got_m;
+    slot = qt_feb_slot(alignedaddr, 0);
+    if (slot) {
+        const uintptr_t s = qt_feb_fast(slot, alignedaddr, FEB_EMPTY, FEB_EMPTY, NULL, NULL);
+        if (s == FEB_EMPTY) {
+            qthread_debug(FEB_BEHAVIOR, "tid %u non-blocking fail\n", me->thread_id);
+            return QTHREAD_OPFAIL;
         }
-        if (!m->valid) { continue; }
-        QTHREAD_FASTLOCK_LOCK(&m->lock);
-        if (!m->valid) {
-            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-            continue;
-        }
-        break;
-    } while(1);
-# else /* ifdef LOCK_FREE_FEBS */
-    qt_hash_lock(FEBs[lockbin]);
-    {
-        m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], (void *)alignedaddr);
-        if (m) {
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
+    }
+    if ((slot == NULL) || (qt_feb_peek(slot) != FEB_FULL)) {
+        if (qt_feb_acquire(slot, alignedaddr, 0, &m) != QTHREAD_SUCCESS) {
+            return QTHREAD_MALLOC_ERROR;
         }
     }
-    qt_hash_unlock(FEBs[lockbin]);
-# endif /* ifdef LOCK_FREE_FEBS */
-    qthread_debug(FEB_DETAILS, "data structure locked\n");
+    qthread_debug(FEB_DETAILS, "data structure locked or null (m=%p)\n", m);
     /* now m, if it exists, is locked - if m is NULL, then we're done! */
     if (m == NULL) {               /* already full! */
         if (dest && (dest != src)) {
@@ -1369,8 +1662,8 @@ int API_FUNC qthread_readFE(aligned_t *restrict       dest,
     const aligned_t *alignedaddr;
 
     qthread_addrstat_t *m;
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE2(src);
-    qthread_t          *me      = qthread_internal_self();
+    volatile uintptr_t *slot;
+    qthread_t          *me = qthread_internal_self();
 
     QTHREAD_FEB_TIMER_DECLARATION(febblock);
 
@@ -1384,55 +1677,15 @@ int API_FUNC qthread_readFE(aligned_t *restrict       dest,
     QTHREAD_FEB_UNIQUERECORD(feb, src, me);
     QTHREAD_FEB_TIMER_START(febblock);
     QALIGN(src, alignedaddr);
-    QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-# ifdef LOCK_FREE_FEBS
-    do {
-        m = qt_hash_get(FEBs[lockbin], alignedaddr);
-got_m:
-        if (!m) {
-            /* currently full; need to set to empty */
-            m = qthread_addrstat_new();
-            if (!m) { return QTHREAD_MALLOC_ERROR; }
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
-            if (!qt_hash_put(FEBs[lockbin], alignedaddr, m)) {
-                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                qthread_addrstat_delete(m);
-                continue;
-            }
-            break;
-        } else {
-            qthread_addrstat_t *m2;
-            /* could be full or not, don't know */
-            hazardous_ptr(0, m);
-            if (m != (m2 = qt_hash_get(FEBs[lockbin], (void *)alignedaddr))) {
-                m = m2;
-                goto got_m;
-            }
-            if (!m->valid) { continue; }
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
-            if (!m->valid) {
-                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                continue;
-            }
-            break;
-        }
-    } while (1);
-# else /* ifdef LOCK_FREE_FEBS */
-    qt_hash_lock(FEBs[lockbin]);
-    {
-        m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], alignedaddr);
-        if (!m) {
-            m = qthread_addrstat_new();
-            if (!m) {
-                qt_hash_unlock(FEBs[lockbin]);
-                return QTHREAD_MALLOC_ERROR;
-            }
-            qassertnot(qt_hash_put_locked(FEBs[lockbin], alignedaddr, m), 0);
-        }
-        QTHREAD_FASTLOCK_LOCK(&(m->lock));
+    slot = qt_feb_slot(alignedaddr, 1);
+    if (slot && (qt_feb_fast(slot, alignedaddr, FEB_FULL, FEB_EMPTY, dest, src) == FEB_FULL)) {
+        qthread_debug(FEB_BEHAVIOR, "tid %u succeeded on %p=%p inline\n", me->thread_id, dest, src);
+        QTHREAD_FEB_TIMER_STOP(febblock, me);
+        return QTHREAD_SUCCESS;
+    }
+    if (qt_feb_acquire(slot, alignedaddr, 1, &m) != QTHREAD_SUCCESS) {
+        return QTHREAD_MALLOC_ERROR;
     }
-    qt_hash_unlock(FEBs[lockbin]);
-# endif /* ifdef LOCK_FREE_FEBS */
     assert(m);
     qthread_debug(FEB_DETAILS, "data structure locked\n");
     /* by this point m is locked */
@@ -1447,6 +1700,7 @@ got_m:
         X->addr   = (aligned_t *)dest;
         X->waiter = me;
         X->next   = m->FEQ;
+        X->timed  = NULL;
         m->FEQ    = X;
         qthread_debug(FEB_DETAILS, "back to parent\n");
         me->thread_state = QTHREAD_STATE_FEB_BLOCKED;
@@ -1496,8 +1750,8 @@ int API_FUNC qthread_readFE_nb(aligned_t *restrict       dest,
 
     qthread_debug(FEB_CALLS, "dest=%p, src=%p\n", dest, src);
     qthread_addrstat_t *m;
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE2(src);
-    qthread_t          *me      = qthread_internal_self();
+    volatile uintptr_t *slot;
+    qthread_t          *me = qthread_internal_self();
 
     if (!me) {
         return qthread_feb_blocker_func(dest, (void *)src, READFE_NB);
@@ -1505,50 +1759,19 @@ int API_FUNC qthread_readFE_nb(aligned_t *restrict       dest,
     qthread_debug(FEB_BEHAVIOR, "tid %u dest=%p src=%p...\n", me->thread_id, dest, src);
     QTHREAD_FEB_UNIQUERECORD(feb, src, me);
     QALIGN(src, alignedaddr);
-    QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-# ifdef LOCK_FREE_FEBS
-    do {
-        m = qt_hash_get(FEBs[lockbin], alignedaddr);
-        if (!m) {
-            /* currently full; need to set to empty */
-            m = qthread_addrstat_new();
-            if (!m) { return QTHREAD_MALLOC_ERROR; }
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
-            if (!qt_hash_put(FEBs[lockbin], alignedaddr, m)) {
-                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                qthread_addrstat_delete(m);
-                continue;
-            }
-            break;
-        } else {
-            /* could be full or not, don't know */
-            hazardous_ptr(0, m);
-            if (m != qt_hash_get(FEBs[lockbin], (void *)alignedaddr)) { continue; }
-            if (!m->valid) { continue; }
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
-            if (!m->valid) {
-                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                continue;
-            }
-            break;
-        }
-    } while (1);
-# else /* ifdef LOCK_FREE_FEBS */
-    qt_hash_lock(FEBs[lockbin]);
-    {
-        m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], alignedaddr);
-        if (!m) {
-            m = qthread_addrstat_new();
-            if (!m) {
-                qt_hash_unlock(FEBs[lockbin]);
-                return QTHREAD_MALLOC_ERROR;
-            }
-            qassertnot(qt_hash_put_locked(FEBs[lockbin], alignedaddr, m), 0);
+    slot = qt_feb_slot(alignedaddr, 1);
+    if (slot) {
+        const uintptr_t s = qt_feb_fast(slot, alignedaddr, FEB_FULL, FEB_EMPTY, dest, src);
+        if (s == FEB_FULL) { return QTHREAD_SUCCESS; }
+        if (s == FEB_EMPTY) {
+            qthread_debug(FEB_BEHAVIOR, "tid %u non-blocking fail\n", me->thread_id);
+            return QTHREAD_OPFAIL;
         }
-        QTHREAD_FASTLOCK_LOCK(&(m->lock));
     }
-    qt_hash_unlock(FEBs[lockbin]);
-# endif /* ifdef LOCK_FREE_FEBS */
+    if (qt_feb_acquire(slot, alignedaddr, 1, &m) != QTHREAD_SUCCESS) {
+        return QTHREAD_MALLOC_ERROR;
+    }
+    assert(m);
     qthread_debug(FEB_DETAILS, "data structure locked\n");
     /* by this point m is locked */
     if (m->full == 0) {            /* empty, thus, we must fail */
@@ -1566,6 +1789,133 @@ int API_FUNC qthread_readFE_nb(aligned_t *restrict       dest,
     return QTHREAD_SUCCESS;
 }                      /*}}} */
 
+/* The timed versions of readFF and readFE give up, and return
+ * QTHREAD_TIMEOUT, if src has not been filled within usecs microseconds. */
+static int qt_feb_read_timed(aligned_t *restrict       dest,
+                             const aligned_t *restrict src,
+                             uint64_t                  usecs,
+                             const int                 fe)
+{                      /*{{{ */
+    const aligned_t *alignedaddr;
+
+    qthread_addrstat_t *m = NULL;
+    volatile uintptr_t *slot;
+    qthread_t          *me = qthread_internal_self();
+
+    assert(qthread_library_initialized);
+
+    if (!me) {
+        return qthread_feb_blocker_timed(dest, (void *)src, fe ? READFE_TIMED : READFF_TIMED, usecs);
+    }
+    qthread_debug(FEB_CALLS, "dest=%p, src=%p, usecs=%lu (tid=%u)\n", dest, src, (unsigned long)usecs, me->thread_id);
+    QALIGN(src, alignedaddr);
+    slot = qt_feb_slot(alignedaddr, fe);
+    if (slot && fe && (qt_feb_fast(slot, alignedaddr, FEB_FULL, FEB_EMPTY, dest, src) == FEB_FULL)) {
+        return QTHREAD_SUCCESS;
+    }
+    if (fe || (slot == NULL) || (qt_feb_peek(slot) != FEB_FULL)) {
+        if (qt_feb_acquire(slot, alignedaddr, fe, &m) != QTHREAD_SUCCESS) {
+            return QTHREAD_MALLOC_ERROR;
+        }
+    }
+    if ((m == NULL) || (m->full == 1)) {
+        if (dest && (dest != src)) {
+            *(aligned_t *)dest = *(aligned_t *)src;
+            MACHINE_FENCE;
+        }
+        if (m == NULL) {
+            /* already full, and nothing to change */
+        } else if (fe) {
+            qthread_gotlock_empty(me->rdata->shepherd_ptr, m, (void *)alignedaddr);
+        } else {
+            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+        }
+        return QTHREAD_SUCCESS;
+    }
+    if (usecs == 0) {
+        QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+        return QTHREAD_TIMEOUT;
+    }
+#ifdef QTHREAD_USE_TIMER_WHEEL
+    {
+        qt_feb_timed_t     tw;
+        qthread_addrres_t *X = ALLOC_ADDRRES();
+
+        if (X == NULL) {
+            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+            return QTHREAD_MALLOC_ERROR;
+        }
+        tw.waiter         = me;
+        tw.m              = m;
+        tw.maddr          = (void *)alignedaddr;
+        tw.X              = X;
+        tw.state          = TIMED_WAITING;
+        tw.done           = 0;
+        tw.timer.deadline = qt_timer_now() + usecs * 1000;
+        tw.timer.fire     = qt_feb_timed_out;
+        tw.timer.arg      = &tw;
+        X->addr           = (aligned_t *)dest;
+        X->waiter         = me;
+        X->timed          = &tw;
+        if (fe) {
+            X->next = m->FEQ;
+            m->FEQ  = X;
+        } else {
+            X->next = m->FFQ;
+            m->FFQ  = X;
+        }
+        /* the timer can't do anything until the shepherd lets go of m */
+        qt_timer_start(&tw.timer, me->rdata->shepherd_ptr->shepherd_id);
+        me->thread_state = QTHREAD_STATE_FEB_BLOCKED;
+        QTPERF_QTHREAD_ENTER_STATE(me->rdata->performance_data, QTHREAD_STATE_FEB_BLOCKED);
+        me->rdata->blockedon.addr = m;
+        qthread_back_to_master(me);
+#ifdef QTHREAD_USE_EUREKAS
+        qt_eureka_check(0);
+#endif /* QTHREAD_USE_EUREKAS */
+        if (tw.state == TIMED_OUT) {
+            qthread_debug(FEB_BEHAVIOR, "tid %u timed out on %p\n", me->thread_id, src);
+            return QTHREAD_TIMEOUT;
+        }
+        if (!qt_timer_cancel(&tw.timer)) {
+            /* it is firing right now; it won't be long */
+            while (!tw.done) SPINLOCK_BODY();
+        }
+        qthread_debug(FEB_BEHAVIOR, "tid %u succeeded on %p=%p after waiting\n", me->thread_id, dest, src);
+        return QTHREAD_SUCCESS;
+    }
+#else /* ifdef QTHREAD_USE_TIMER_WHEEL */
+    /* without a timer wheel, nothing will come and wake us up when time runs
+     * out; so poll */
+    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+    {
+        const double deadline = qtimer_wtime() + usecs * 1e-6;
+
+        do {
+            const int ret = fe ? qthread_readFE_nb(dest, src) : qthread_readFF_nb(dest, src);
+
+            if (ret != QTHREAD_OPFAIL) { return ret; }
+            qthread_yield();
+        } while (qtimer_wtime() < deadline);
+        return QTHREAD_TIMEOUT;
+    }
+#endif /* ifdef QTHREAD_USE_TIMER_WHEEL */
+}                      /*}}} */
+
+int API_FUNC qthread_readFF_timed(aligned_t *restrict       dest,
+                                  const aligned_t *restrict src,
+                                  uint64_t                  usecs)
+{                      /*{{{ */
+    return qt_feb_read_timed(dest, src, usecs, 0);
+}                      /*}}} */
+
+int API_FUNC qthread_readFE_timed(aligned_t *restrict       dest,
+                                  const aligned_t *restrict src,
+                                  uint64_t                  usecs)
+{                      /*{{{ */
+    return qt_feb_read_timed(dest, src, usecs, 1);
+}                      /*}}} */
+
 #ifdef QTHREAD_COUNT_THREADS
 extern aligned_t             threadcount;
 extern aligned_t             maxconcurrentthreads;
@@ -1600,39 +1950,21 @@ int INTERNAL qthread_check_feb_preconds(qthread_t *t)
     // Process input preconds
     while (these_preconds && (these_preconds[0] != NULL)) {
         aligned_t          *this_sync = these_preconds[(uintptr_t)these_preconds[0]];
-        const int           lockbin   = QTHREAD_CHOOSE_STRIPE2(this_sync);
         const aligned_t    *alignedaddr;
         qthread_addrstat_t *m = NULL;
+        volatile uintptr_t *slot;
 
         QTHREAD_FEB_UNIQUERECORD2(feb, this_sync, curshep);
         QTHREAD_FEB_TIMER_START(febblock);
         QALIGN(this_sync, alignedaddr);
-        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-#ifdef LOCK_FREE_FEBS
-        do {
-            m = qt_hash_get(FEBs[lockbin], (void *)alignedaddr);
-            if (!m) { break; }
-            hazardous_ptr(0, m);
-            if (m != qt_hash_get(FEBs[lockbin], (void *)alignedaddr)) { continue; }
-            if (!m->valid) { continue; }
-            QTHREAD_FASTLOCK_LOCK(&m->lock);
-            if (!m->valid) {
-                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                continue;
-            }
-            break;
-        } while(1);
-#else   /* ifdef LOCK_FREE_FEBS */
-        qt_hash_lock(FEBs[lockbin]);
-        {
-            m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], (void *)alignedaddr);
-            if (m) {
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
+        slot = qt_feb_slot(alignedaddr, 0);
+        if ((slot == NULL) || (qt_feb_peek(slot) != FEB_FULL)) {
+            if (qt_feb_acquire(slot, alignedaddr, 0, &m) != QTHREAD_SUCCESS) {
+                abort();
+                return QTHREAD_MALLOC_ERROR;
             }
         }
-        qt_hash_unlock(FEBs[lockbin]);
-#endif  /* ifdef LOCK_FREE_FEBS */
-        qthread_debug(FEB_DETAILS, "precond=%p (tid=%u): data structure locked or null (m=%p, lockbin=%u)\n", this_sync, t->thread_id, m, lockbin);
+        qthread_debug(FEB_DETAILS, "precond=%p (tid=%u): data structure locked or null (m=%p)\n", this_sync, t->thread_id, m);
         if (m == NULL) { /* already full! */
             these_preconds[0] = (aligned_t *)(((uintptr_t)these_preconds[0]) - 1);
         } else if (m->full == 1) {
@@ -1651,6 +1983,7 @@ int INTERNAL qthread_check_feb_preconds(qthread_t *t)
             X->addr         = NULL;
             X->waiter       = t;
             X->next         = m->FFQ;
+            X->timed        = NULL;
             m->FFQ          = X;
             t->thread_state = QTHREAD_STATE_NASCENT;
             QTPERF_QTHREAD_ENTER_STATE(t->rdata->performance_data, QTHREAD_STATE_NASCENT);
@@ -1739,6 +2072,20 @@ static void qt_feb_call_tf(const qt_key_t      addr,
                     break;
                 case REMOVE_AND_CONTINUE: // remove, move to the next one
                 {
+#ifdef QTHREAD_USE_TIMER_WHEEL
+                    if (curs->timed) {
+                        qt_feb_timed_t *tw = curs->timed;
+
+                        if (qthread_cas(&tw->state, TIMED_WAITING, TIMED_WOKEN) != TIMED_WAITING) {
+                            /* timed out; its timer will take it out */
+                            base = &curs->next;
+                            break;
+                        }
+                        if (!qt_timer_cancel(&tw->timer)) {
+                            while (!tw->done) SPINLOCK_BODY();
+                        }
+                    }
+#endif
 #ifdef QTHREAD_USE_EUREKAS
                     qthread_internal_assassinate(waiter);
 #endif /* QTHREAD_USE_EUREKAS */
@@ -1756,11 +2103,27 @@ static void qt_feb_call_tf(const qt_key_t      addr,
     }
 } /*}}}*/
 
+static void qt_feb_table_call_tf(void **pass)
+{   /*{{{*/
+    if (feb_table == NULL) { return; }
+    for (size_t i = 0; i <= feb_table_mask; i++) {
+        const uintptr_t s = feb_table[i].state;
+
+        if (!FEB_IS_ADDRSTAT(s)) { continue; }
+        hazardous_ptr(0, (void *)s);
+        MACHINE_FENCE;
+        if (feb_table[i].state != s) { continue; }
+        qt_feb_call_tf((qt_key_t)feb_table[i].key, (qthread_addrstat_t *)s, pass);
+    }
+    hazardous_ptr(0, NULL);
+} /*}}}*/
+
 void INTERNAL qthread_feb_taskfilter_serial(qt_feb_taskfilter_f tf,
                                             void               *arg)
 {   /*{{{*/
     void *pass[3] = { tf, arg, NULL };
 
+    qt_feb_table_call_tf(pass);
     for (unsigned int i = 0; i < QTHREAD_LOCKING_STRIPES; i++) {
         qt_hash_callback(FEBs[i], (qt_hash_callback_fn)qt_feb_call_tf, pass);
     }
@@ -1771,6 +2134,7 @@ void INTERNAL qthread_feb_taskfilter(qt_feb_taskfilter_f tf,
 {   /*{{{*/
     void *pass[3] = { tf, arg, (void *)(uintptr_t)1 };
 
+    qt_feb_table_call_tf(pass);
     for (unsigned int i = 0; i < QTHREAD_LOCKING_STRIPES; i++) {
         qt_hash_callback(FEBs[i], (qt_hash_callback_fn)qt_feb_call_tf, pass);
     }
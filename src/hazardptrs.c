@@ -92,33 +92,46 @@ void INTERNAL hazardous_ptr(unsigned int which,
 static int void_cmp(const void *a,
                     const void *b)
 {/*{{{*/
-    return (*(intptr_t *)a) - (*(intptr_t *)b);
+    const uintptr_t x = *(const uintptr_t *)a;
+    const uintptr_t y = *(const uintptr_t *)b;
+
+    /* not x - y: truncated to an int, that misorders pointers */
+    return (x > y) - (x < y);
 }/*}}}*/
 
 static int binary_search(uintptr_t *list,
                          uintptr_t  findme,
                          size_t     len)
 {/*{{{*/
-    size_t max  = len;
-    size_t min  = 0;
-    size_t curs = max / 2;
+    size_t min = 0;
+    size_t max = len;
+
+    while (min < max) {
+        const size_t curs = min + (max - min) / 2;
 
-    while (list[curs] != findme) {
-        if (list[curs] > findme) {
+        if (list[curs] < findme) {
+            min = curs + 1;
+        } else {
             max = curs;
-        } else if (list[curs] < findme) {
-            min = curs;
         }
-        if (max == min + 1) { break; }
-        curs = (max + min) / 2;
     }
-    return (list[curs] == findme);
+    return (min < len) && (list[min] == findme);
 }/*}}}*/
 
 static void hazardous_scan(hazard_freelist_t *hfl)
 {/*{{{*/
     const size_t num_hps = qthread_num_workers() * HAZARD_PTRS_PER_SHEP;
-    void            **plist = MALLOC(sizeof(void *) * (num_hps + hzptr_list_len));
+    /* non-worker threads' lists are only ever pushed on the front, so the
+     * list from here on cannot change under us */
+    uintptr_t *const  extra_head = QTHREAD_CASLOCK_READ(hzptr_list);
+    size_t            num_extra  = 0;
+    void            **plist;
+    size_t            plist_len;
+
+    for (uintptr_t *p = extra_head; p != NULL; p = (uintptr_t *)p[HAZARD_PTRS_PER_SHEP]) {
+        num_extra++;
+    }
+    plist = MALLOC(sizeof(void *) * (num_hps + num_extra * HAZARD_PTRS_PER_SHEP));
     hazard_freelist_t tmpfreelist;
 
     assert(plist);
@@ -142,24 +155,26 @@ static void hazardous_scan(hazard_freelist_t *hfl)
                     }
                 }
             }
-            uintptr_t *hzptr_tmp = QTHREAD_CASLOCK_READ(hzptr_list);
+            uintptr_t *hzptr_tmp = extra_head;
+            plist_len = num_hps;
             while (hzptr_tmp != NULL) {
-                memcpy(plist + (i * qlib->nworkerspershep * HAZARD_PTRS_PER_SHEP),
+                memcpy(plist + plist_len,
                        hzptr_tmp,
                        sizeof(uintptr_t) * HAZARD_PTRS_PER_SHEP);
-                hzptr_tmp = (uintptr_t *)hzptr_tmp[HAZARD_PTRS_PER_SHEP];
+                plist_len += HAZARD_PTRS_PER_SHEP;
+                hzptr_tmp  = (uintptr_t *)hzptr_tmp[HAZARD_PTRS_PER_SHEP];
             }
         }
 
         /* Stage 2: free pointers that are not in the set of hazardous pointers */
         tmpfreelist.count = 0;
-        qsort(plist, num_hps, sizeof(void *), void_cmp);
+        qsort(plist, plist_len, sizeof(void *), void_cmp);
         assert(hfl->count == freelist_max);
         for (size_t i = 0; i < freelist_max; ++i) {
             const uintptr_t ptr = (uintptr_t)hfl->freelist[i].ptr;
             if (ptr == 0) { break; }
             /* look for this ptr in the plist */
-            if (binary_search((uintptr_t *)plist, ptr, num_hps)) {
+            if (binary_search((uintptr_t *)plist, ptr, plist_len)) {
                 /* if found, cannot free it */
                 tmpfreelist.freelist[tmpfreelist.count] = hfl->freelist[i];
                 tmpfreelist.count++;
@@ -177,7 +192,7 @@ static void hazardous_scan(hazard_freelist_t *hfl)
     memcpy(hfl->freelist, tmpfreelist.freelist, tmpfreelist.count * sizeof(hazard_freelist_entry_t));
     hfl->count = tmpfreelist.count;
     FREE(tmpfreelist.freelist, sizeof(hazard_freelist_entry_t));
-    FREE(plist, sizeof(void *) * (num_hps + hzptr_list_len));
+    FREE(plist, sizeof(void *) * (num_hps + num_extra * HAZARD_PTRS_PER_SHEP));
 }/*}}}*/
 
 void INTERNAL hazardous_release_node(void  (*freefunc)(void *),
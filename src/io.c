@@ -6,7 +6,12 @@
 #include <qthread/qthread-int.h>       /* for uint64_t */
 #include <stdio.h>                     /* for fprintf() */
 #include <stdlib.h>                    /* for abort() */
+#include <string.h>                    /* for memset() */
 #include <sys/time.h>                  /* for gettimeofday() */
+#include <pthread.h>
+#include <sched.h>                     /* for cpu_set_t */
+#include <fcntl.h>                     /* for fcntl() */
+#include <sys/stat.h>                  /* for fstat() */
 #ifdef HAVE_SYS_SYSCALL_H
 /* - syscall(2) */
 # include <sys/syscall.h>
@@ -30,9 +35,15 @@
 #include <sys/resource.h>
 #include <sys/wait.h>
 
+/* Public Headers */
+#include "qthread/qt_syscalls.h"      /* for qt_poll() */
+#include "qthread/qtimer.h"
+
 /* Internal Headers */
 #include "qt_io.h"
+#include "qt_timers.h"
 #include "qt_macros.h"
+#include "qt_alloc.h"
 #include "qt_asserts.h"
 #include "qthread_innards.h" /* for qthread_exec() */
 #include "qt_threadqueues.h"
@@ -40,31 +51,193 @@
 #include "qt_envariables.h"
 #include "qt_subsystems.h"
 
+/* Each shepherd has its own queue of jobs for the proxy threads. Tasks on any
+ * of the shepherd's workers push onto it without taking a lock (it is an
+ * intrusive MPSC queue, after Vyukov's); the shepherd's proxies take turns
+ * being its single consumer, under consumer_lock, which is only held while
+ * jobs are taken off. Proxies stay around until the library shuts down: one
+ * with nothing to do keeps looking for QTHREAD_IO_TIMEOUT microseconds (none,
+ * by default), and then parks on its spot until a submission claims it. */
+typedef struct qt_blocking_queue_s qt_blocking_queue_t;
+
 typedef struct {
-    qt_blocking_queue_node_t *head;
-    qt_blocking_queue_node_t *tail;
-    saligned_t                length;
-    pthread_mutex_t           lock;
-    pthread_cond_t            notempty;
-} qt_blocking_queue_t;
-
-static qt_blocking_queue_t theQueue;
-static saligned_t          io_worker_count = -1;
-static saligned_t          io_worker_max   = 10;
+    qt_park_spot_t       spot;
+    qt_blocking_queue_t *queue;
+} Q_ALIGNED(CACHELINE_WIDTH) qt_io_proxy_t;
+
+struct qt_blocking_queue_s {
+    /* producers only touch the tail */
+    qt_blocking_queue_node_t *volatile tail;
+    uint8_t                            pad[CACHELINE_WIDTH - sizeof(qt_blocking_queue_node_t *)];
+    /* the consumer side */
+    volatile aligned_t                 consumer_lock;
+    qt_blocking_queue_node_t          *head;
+    qt_blocking_queue_node_t           stub;
+    /* jobs pushed and not yet taken off */
+    volatile saligned_t                length;
+    /* proxies started, how many are not busy with a job, and how many of
+     * those are parked */
+    volatile saligned_t                nproxies;
+    volatile saligned_t                nidle;
+    volatile saligned_t                nparked;
+    qt_io_proxy_t                     *proxies; /* io_worker_max of them */
+    qthread_shepherd_id_t              shep;
+} Q_ALIGNED(CACHELINE_WIDTH);
+
+static qt_blocking_queue_t *queues          = NULL;
+static saligned_t           io_worker_count = -1; /* live proxies, all told */
+static saligned_t           io_worker_max   = 10; /* per shepherd */
 #if !defined(UNPOOLED)
 qt_mpool syscall_job_pool = NULL;
 #endif
-static unsigned long timeout    = 100; // in microseconds
+/* the most jobs a proxy thread takes off the queue at once */
+#define QT_IO_BATCH_MAX 64
+/* a parked proxy gets up this often (in microseconds) regardless */
+#define QT_IO_PARK_USECS 1000000
+static size_t        batch_max  = 32;
+static unsigned long timeout    = 0; // in microseconds
 static int           proxy_exit = 0;
 TLS_DECL_INIT(qthread_t *, IO_task_struct);
 
+static int qt_process_blocking_call(qt_blocking_queue_t *q);
+
+static QINLINE void qt_blocking_queue_lock(volatile aligned_t *lock)
+{   /*{{{*/
+    do {
+        while (*lock != 0) SPINLOCK_BODY();
+    } while (qthread_cas(lock, 0, 1) != 0);
+} /*}}}*/
+
+static QINLINE void qt_blocking_queue_unlock(volatile aligned_t *lock)
+{   /*{{{*/
+    COMPILER_FENCE;
+    *lock = 0;
+} /*}}}*/
+
+static void qt_blocking_queue_push(qt_blocking_queue_t      *q,
+                                   qt_blocking_queue_node_t *job)
+{   /*{{{*/
+    qt_blocking_queue_node_t *prev;
+
+    job->next = NULL;
+    do {
+        prev = q->tail;
+    } while (qthread_cas_ptr((void **)&q->tail, prev, job) != prev);
+    /* until this store lands, the consumer can't get past prev */
+    prev->next = job;
+} /*}}}*/
+
+/* Returns the oldest job on q without taking it off; consumer only. */
+static QINLINE qt_blocking_queue_node_t *qt_blocking_queue_peek(qt_blocking_queue_t *q)
+{   /*{{{*/
+    qt_blocking_queue_node_t *head = q->head;
+
+    return (head == &q->stub) ? head->next : head;
+} /*}}}*/
+
+/* Takes the oldest job off q; consumer only. Returns NULL if there is none,
+ * or if the only one there is still being pushed. */
+static qt_blocking_queue_node_t *qt_blocking_queue_pop(qt_blocking_queue_t *q)
+{   /*{{{*/
+    qt_blocking_queue_node_t *head = q->head;
+    qt_blocking_queue_node_t *next = head->next;
+
+    if (head == &q->stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        q->head = head = next;
+        next    = next->next;
+    }
+    if (next == NULL) {
+        if (q->tail != head) {
+            return NULL;
+        }
+        /* head is the last job; put the stub behind it, so it can go */
+        qt_blocking_queue_push(q, &q->stub);
+        next = head->next;
+        if (next == NULL) {
+            return NULL;
+        }
+    }
+    q->head = next;
+    (void)qthread_incr(&q->length, -1);
+    return head;
+} /*}}}*/
+
+/* Runs the calling proxy on the processors its shepherd's workers run on, so
+ * that the tasks it hands back, and their data, stay close by. */
+static void qt_blocking_subsystem_pin(qthread_shepherd_id_t shep)
+{   /*{{{*/
+#if defined(HAVE_PTHREAD_GETAFFINITY_NP) && defined(HAVE_PTHREAD_SETAFFINITY_NP)
+    qthread_shepherd_t *s = &qlib->shepherds[shep];
+    cpu_set_t           near, w;
+
+    CPU_ZERO(&near);
+    for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; i++) {
+        if (pthread_getaffinity_np(s->workers[i].worker, sizeof(w), &w) == 0) {
+            CPU_OR(&near, &near, &w);
+        }
+    }
+    if (CPU_COUNT(&near) > 0) {
+        (void)pthread_setaffinity_np(pthread_self(), sizeof(near), &near);
+    }
+#endif
+} /*}}}*/
+
+/* Wakes one of q's parked proxies, if there is one. */
+static int qt_blocking_subsystem_unpark_proxy(qt_blocking_queue_t *q)
+{   /*{{{*/
+    for (saligned_t i = 0; i < q->nproxies && i < io_worker_max; i++) {
+        qt_park_spot_t *spot = &q->proxies[i].spot;
+
+        if ((spot->state == QT_PARK_PARKED) && qt_park_claim(spot)) {
+            (void)qthread_incr(&q->nparked, -1);
+            qt_park_wake(spot);
+            return 1;
+        }
+    }
+    return 0;
+} /*}}}*/
+
+/* Called by a proxy that found nothing to do. */
+static void qt_blocking_subsystem_idle(qt_io_proxy_t *me)
+{   /*{{{*/
+    qt_blocking_queue_t *q = me->queue;
+
+    if (timeout > 0) {
+        const double until = qtimer_wtime() + timeout * 1e-6;
+
+        /* work tends to come in bursts, so keep looking for a while */
+        while ((q->length <= 0) && (proxy_exit == 0) && (qtimer_wtime() < until)) {
+            SPINLOCK_BODY();
+        }
+    }
+    if ((q->length > 0) || (proxy_exit != 0)) {
+        /* there may be a job that's still being pushed */
+        SPINLOCK_BODY();
+        return;
+    }
+    me->spot.state = QT_PARK_PARKED;
+    (void)qthread_incr(&q->nparked, 1);
+    /* pairs with the submitter: either it sees this proxy parked, or this
+     * proxy sees the job */
+    if ((q->length <= 0) && (proxy_exit == 0)) {
+        qt_park_wait(&me->spot, QT_IO_PARK_USECS);
+    }
+    if (qt_park_claim(&me->spot)) {
+        (void)qthread_incr(&q->nparked, -1);
+    }
+} /*}}}*/
+
 static void qt_blocking_subsystem_internal_stopwork(void)
 {   /*{{{*/
     proxy_exit = 1;
     MACHINE_FENCE;
+    for (qthread_shepherd_id_t s = 0; s < qlib->nshepherds; s++) {
+        while (qt_blocking_subsystem_unpark_proxy(&queues[s])) ;
+    }
     while (io_worker_count != 0) SPINLOCK_BODY();
-    QTHREAD_LOCK(&theQueue.lock);
-    QTHREAD_UNLOCK(&theQueue.lock);
 } /*}}}*/
 
 static void qt_blocking_subsystem_internal_freemem(void)
@@ -72,35 +245,53 @@ static void qt_blocking_subsystem_internal_freemem(void)
 #if !defined(UNPOOLED)
     qt_mpool_destroy(syscall_job_pool);
 #endif
-    QTHREAD_DESTROYLOCK(&theQueue.lock);
-    QTHREAD_DESTROYCOND(&theQueue.notempty);
+    for (qthread_shepherd_id_t s = 0; s < qlib->nshepherds; s++) {
+        for (saligned_t i = 0; i < io_worker_max; i++) {
+            qt_park_destroy(&queues[s].proxies[i].spot);
+        }
+        qt_internal_aligned_free(queues[s].proxies, io_worker_max * sizeof(qt_io_proxy_t));
+    }
+    qt_internal_aligned_free(queues, qlib->nshepherds * sizeof(qt_blocking_queue_t));
+    queues = NULL;
 } /*}}}*/
 
-static void *qt_blocking_subsystem_proxy_thread(void *QUNUSED(arg))
+static void *qt_blocking_subsystem_proxy_thread(void *arg)
 {   /*{{{*/
+    qt_io_proxy_t *me = (qt_io_proxy_t *)arg;
+
+    qt_blocking_subsystem_pin(me->queue->shep);
     while (proxy_exit == 0) {
-        if (qt_process_blocking_call()) {
-            break;
+        if (!qt_process_blocking_call(me->queue)) {
+            qt_blocking_subsystem_idle(me);
         }
         COMPILER_FENCE;
     }
     qthread_debug(IO_DETAILS, "proxy_exit = %i, exiting\n", proxy_exit);
+    (void)qthread_incr(&io_worker_count, -1);
     pthread_exit(NULL);
     return 0;
 } /*}}}*/
 
-static void qt_blocking_subsystem_spawnworker(void)
+/* Starts another proxy for q, unless it already has as many as it may. */
+static int qt_blocking_subsystem_spawnworker(qt_blocking_queue_t *q)
 {   /*{{{*/
-    int       r;
-    pthread_t thr;
+    int        r;
+    pthread_t  thr;
+    saligned_t slot = qthread_incr(&q->nproxies, 1);
 
-    if ((r = pthread_create(&thr, NULL, qt_blocking_subsystem_proxy_thread, NULL)) != 0) {
+    if (slot >= io_worker_max) {
+        (void)qthread_incr(&q->nproxies, -1);
+        return 0;
+    }
+    (void)qthread_incr(&q->nidle, 1);
+    (void)qthread_incr(&io_worker_count, 1);
+    if ((r = pthread_create(&thr, NULL, qt_blocking_subsystem_proxy_thread, &q->proxies[slot])) != 0) {
         fprintf(stderr, "qt_blocking_subsystem_init: pthread_create() failed (%d)\n", r);
         perror("qt_blocking_subsystem_init spawning proxy thread");
         abort();
     }
-    (void)qthread_incr(&io_worker_count, 1);
     pthread_detach(thr);
+    return 1;
 } /*}}}*/
 
 void INTERNAL qt_blocking_subsystem_init(void)
@@ -108,14 +299,40 @@ void INTERNAL qt_blocking_subsystem_init(void)
 #if !defined(UNPOOLED)
     syscall_job_pool = qt_mpool_create(sizeof(qt_blocking_queue_node_t));
 #endif
-    theQueue.head   = NULL;
-    theQueue.tail   = NULL;
     io_worker_count = 0;
     io_worker_max   = qt_internal_get_env_num("MAX_IO_WORKERS", 10, 1);
-    timeout         = qt_internal_get_env_num("IO_TIMEOUT", 100, 100);
+    timeout         = qt_internal_get_env_num("IO_TIMEOUT", 0, 0);
+    batch_max       = qt_internal_get_env_num("IO_BATCH", 32, 1);
+    if (batch_max > QT_IO_BATCH_MAX) {
+        batch_max = QT_IO_BATCH_MAX;
+    }
+    queues = qt_internal_aligned_alloc(qlib->nshepherds * sizeof(qt_blocking_queue_t), CACHELINE_WIDTH);
+    assert(queues);
+    for (qthread_shepherd_id_t s = 0; s < qlib->nshepherds; s++) {
+        qt_blocking_queue_t *q = &queues[s];
+
+        memset(q, 0, sizeof(qt_blocking_queue_t));
+        q->head    = &q->stub;
+        q->tail    = &q->stub;
+        q->shep    = s;
+        q->proxies = qt_internal_aligned_alloc(io_worker_max * sizeof(qt_io_proxy_t), CACHELINE_WIDTH);
+        assert(q->proxies);
+        for (saligned_t i = 0; i < io_worker_max; i++) {
+            qt_park_init(&q->proxies[i].spot);
+            q->proxies[i].queue = q;
+        }
+    }
+#if defined(QTHREAD_USE_IO_URING) && defined(QTHREAD_USE_EPOLL)
+    /* io_uring can wait for descriptors itself */
+    if (!qt_io_uring_init()) {
+        (void)qt_io_epoll_init();
+    }
+#elif defined(QTHREAD_USE_IO_URING)
+    (void)qt_io_uring_init();
+#elif defined(QTHREAD_USE_EPOLL)
+    (void)qt_io_epoll_init();
+#endif
     TLS_INIT(IO_task_struct);
-    qassert(pthread_mutex_init(&theQueue.lock, NULL), 0);
-    qassert(pthread_cond_init(&theQueue.notempty, NULL), 0);
     /* thread(s) must be stopped *before* shepherds die, to keep them from
      * trying to push orphan threads into shepherd queues */
     qthread_internal_cleanup_early(qt_blocking_subsystem_internal_stopwork);
@@ -124,59 +341,30 @@ void INTERNAL qt_blocking_subsystem_init(void)
     qthread_internal_cleanup(qt_blocking_subsystem_internal_freemem);
 } /*}}}*/
 
-int INTERNAL qt_process_blocking_call(void)
+/* pread and pwrite work on seekable files, which don't keep a call waiting for
+ * long, so a proxy can take a run of them off the queue at once without
+ * holding anything else up */
+#define QT_IO_POSITIONAL(op) (((op) == PREAD) || ((op) == PWRITE))
+
+static QINLINE int qt_blocking_job_fd(const qt_blocking_queue_node_t *job)
 {   /*{{{*/
-    qt_blocking_queue_node_t *item;
+    int fd;
 
-    QTHREAD_LOCK(&theQueue.lock);
-    while (theQueue.head == NULL) {
-        struct timeval  tv;
-        struct timespec ts;
-        int             ret;
+    memcpy(&fd, &job->args[0], sizeof(int));
+    return fd;
+} /*}}}*/
 
-        COMPILER_FENCE;
-        gettimeofday(&tv, NULL);
-        ts.tv_sec  = tv.tv_sec;
-        ts.tv_nsec = (tv.tv_usec + timeout) * 1000;
-        ret        = pthread_cond_timedwait(&theQueue.notempty, &theQueue.lock, &ts);
-        switch(ret) {
-            case ETIMEDOUT:
-                qthread_debug(IO_BEHAVIOR, "condwait timed out\n");
-                if (theQueue.head == NULL) {
-                    qthread_debug(IO_BEHAVIOR, "------------------------------------- exit()\n");
-#ifdef QTHREAD_DEBUG
-                    unsigned ct = qthread_incr(&io_worker_count, -1);
-                    qthread_debug(IO_BEHAVIOR, "worker_count post exit is %u\n", (unsigned)ct - 1);
-#else
-                    (void)qthread_incr(&io_worker_count, -1);
-#endif
-                    QTHREAD_UNLOCK(&theQueue.lock);
-                    return 1;
-                } else {
-                    QTHREAD_UNLOCK(&theQueue.lock);
-                    return 0;
-                }
-
-            case EINVAL:
-                /* chances are, this is because ts is in the past */
-                qthread_debug(IO_DETAILS, "condwait returned EINVAL\n");
-                break;
+static QINLINE off_t qt_blocking_job_offset(const qt_blocking_queue_node_t *job)
+{   /*{{{*/
+    off_t offset;
 
-            default:
-                break;
-        }
-    }
-    item = theQueue.head;
-    assert(item != NULL);
-    theQueue.head = item->next;
-    if (theQueue.tail == item) {
-        theQueue.tail = theQueue.head;
-    }
-    theQueue.length--;
-    qthread_debug(IO_DETAILS, "dequeue... theQueue.head = %p, .tail = %p, item:%p, thread:%p, rdata:%p\n", theQueue.head, theQueue.tail, item, item->thread, item->thread->rdata);
-    QTHREAD_UNLOCK(&theQueue.lock);
-    item->next = NULL;
-    /* do something with <item> */
+    memcpy(&offset, &job->args[3], sizeof(off_t));
+    return offset;
+} /*}}}*/
+
+/* performs the call described by <item>, leaving its result in <item> */
+static void qt_blocking_subsystem_perform(qt_blocking_queue_node_t *item)
+{   /*{{{*/
     switch(item->op) {
         default:
             fprintf(stderr, "Unhandled syscall: %u\n", (unsigned int)item->op);
@@ -331,20 +519,27 @@ int INTERNAL qt_process_blocking_call(void)
                               (const void *)item->args[1],
                               (size_t)item->args[2]);
 #endif
+            break;
         case PWRITE:
+        {
+            int   fd;
+            off_t offset;
+            memcpy(&fd, &item->args[0], sizeof(int));
+            memcpy(&offset, &item->args[3], sizeof(off_t));
 #if HAVE_SYSCALL && HAVE_DECL_SYS_PWRITE
             item->ret = syscall(SYS_pwrite,
-                                (int)item->args[0],
+                                fd,
                                 (const void *)item->args[1],
                                 (size_t)item->args[2],
-                                (off_t)item->args[3]);
+                                offset);
 #else
-            item->ret = pwrite((int)item->args[0],
+            item->ret = pwrite(fd,
                                (const void *)item->args[1],
                                (size_t)item->args[2],
-                               (off_t)item->args[3]);
+                               offset);
 #endif
             break;
+        }
         case USER_DEFINED:
         {
             qt_context_t my_context;
@@ -359,41 +554,303 @@ int INTERNAL qt_process_blocking_call(void)
     }
     /* preserve errno in item */
     item->err = errno;
-    /* and now, re-queue */
-    qt_threadqueue_enqueue(item->thread->rdata->shepherd_ptr->ready, item->thread);
-    FREE_SYSCALLJOB(item);
-    return 0;
+} /*}}}*/
+
+#if defined(HAVE_PREADV) && defined(HAVE_PWRITEV)
+/* performs n positional calls on the same descriptor, whose buffers sit end to
+ * end in the file, as a single preadv() or pwritev(); if that comes up short,
+ * whatever it didn't get to is done one call at a time */
+static void qt_blocking_subsystem_vectored(qt_blocking_queue_node_t **jobs,
+                                           size_t                     n)
+{   /*{{{*/
+    struct iovec iov[QT_IO_BATCH_MAX];
+    ssize_t      ret;
+    size_t       i;
+
+    assert(n <= QT_IO_BATCH_MAX);
+    for (i = 0; i < n; i++) {
+        iov[i].iov_base = (void *)jobs[i]->args[1];
+        iov[i].iov_len  = (size_t)jobs[i]->args[2];
+    }
+    if (jobs[0]->op == PREAD) {
+        ret = preadv(qt_blocking_job_fd(jobs[0]), iov, (int)n, qt_blocking_job_offset(jobs[0]));
+    } else {
+        ret = pwritev(qt_blocking_job_fd(jobs[0]), iov, (int)n, qt_blocking_job_offset(jobs[0]));
+    }
+    qthread_debug(IO_DETAILS, "coalesced %u calls into one, which returned %li\n", (unsigned)n, (long)ret);
+    if (ret < 0) {
+        /* let each call find out for itself what's wrong */
+        ret = 0;
+    }
+    for (i = 0; i < n && (size_t)ret >= iov[i].iov_len; i++) {
+        jobs[i]->ret = iov[i].iov_len;
+        jobs[i]->err = 0;
+        ret         -= iov[i].iov_len;
+    }
+    if ((i < n) && (ret > 0)) {
+        /* a short count is a perfectly good answer for this one */
+        jobs[i]->ret = ret;
+        jobs[i]->err = 0;
+        i++;
+    }
+    for (; i < n; i++) {
+        qt_blocking_subsystem_perform(jobs[i]);
+    }
+} /*}}}*/
+#endif /* if defined(HAVE_PREADV) && defined(HAVE_PWRITEV) */
+
+/* performs a batch of positional calls, merging the ones that can be merged */
+static void qt_blocking_subsystem_perform_positional(qt_blocking_queue_node_t **jobs,
+                                                     size_t                     n)
+{   /*{{{*/
+    /* sort by call, descriptor, and offset, so mergeable calls are adjacent;
+     * batches are small, so insertion sort is plenty */
+    for (size_t i = 1; i < n; i++) {
+        qt_blocking_queue_node_t *job = jobs[i];
+        size_t                    j   = i;
+
+        while (j > 0) {
+            const qt_blocking_queue_node_t *prev = jobs[j - 1];
+
+            if ((prev->op < job->op) ||
+                ((prev->op == job->op) && (qt_blocking_job_fd(prev) < qt_blocking_job_fd(job))) ||
+                ((prev->op == job->op) && (qt_blocking_job_fd(prev) == qt_blocking_job_fd(job)) &&
+                 (qt_blocking_job_offset(prev) <= qt_blocking_job_offset(job)))) {
+                break;
+            }
+            jobs[j] = jobs[j - 1];
+            j--;
+        }
+        jobs[j] = job;
+    }
+    for (size_t i = 0, run; i < n; i += run) {
+        for (run = 1; i + run < n; run++) {
+            const qt_blocking_queue_node_t *prev = jobs[i + run - 1];
+            const qt_blocking_queue_node_t *next = jobs[i + run];
+
+            if ((next->op != prev->op) ||
+                (qt_blocking_job_fd(next) != qt_blocking_job_fd(prev)) ||
+                (qt_blocking_job_offset(next) != qt_blocking_job_offset(prev) + (off_t)prev->args[2])) {
+                break;
+            }
+        }
+#if defined(HAVE_PREADV) && defined(HAVE_PWRITEV)
+        if (run > 1) {
+            qt_blocking_subsystem_vectored(&jobs[i], run);
+            continue;
+        }
+#endif
+        for (size_t j = i; j < i + run; j++) {
+            qt_blocking_subsystem_perform(jobs[j]);
+        }
+    }
+} /*}}}*/
+
+/* hands the tasks back to their shepherds, each shepherd's all at once */
+static void qt_blocking_subsystem_requeue(qthread_t **t,
+                                          size_t      n)
+{   /*{{{*/
+    while (n > 0) {
+        qt_threadqueue_t *q    = t[0]->rdata->shepherd_ptr->ready;
+        size_t            same = 1;
+
+        for (size_t i = 1; i < n; i++) {
+            if (t[i]->rdata->shepherd_ptr->ready == q) {
+                qthread_t *tmp = t[same];
+
+                t[same++] = t[i];
+                t[i]      = tmp;
+            }
+        }
+        qt_threadqueue_enqueue_batch(q, t, same);
+        t += same;
+        n -= same;
+    }
+} /*}}}*/
+
+/* Takes jobs off q and performs them; returns zero if there were none. */
+static int qt_process_blocking_call(qt_blocking_queue_t *q)
+{   /*{{{*/
+    qt_blocking_queue_node_t *item;
+    qt_blocking_queue_node_t *next;
+    qt_blocking_queue_node_t *jobs[QT_IO_BATCH_MAX];
+    size_t                    n = 0;
+
+    if (q->length <= 0) {
+        return 0;
+    }
+    qt_blocking_queue_lock(&q->consumer_lock);
+    item = qt_blocking_queue_pop(q);
+    if (item == NULL) {
+        qt_blocking_queue_unlock(&q->consumer_lock);
+        return 0;
+    }
+    /* take a run of positional calls at the front of the queue together */
+    jobs[n++] = item;
+    while (QT_IO_POSITIONAL(item->op) && (n < batch_max) &&
+           ((next = qt_blocking_queue_peek(q)) != NULL) && QT_IO_POSITIONAL(next->op) &&
+           ((item = qt_blocking_queue_pop(q)) != NULL)) {
+        jobs[n++] = item;
+    }
+    qt_blocking_queue_unlock(&q->consumer_lock);
+    (void)qthread_incr(&q->nidle, -1);
+    for (size_t i = 0; i < n; i++) {
+        qthread_debug(IO_DETAILS, "dequeue... shep %u, item:%p, thread:%p, rdata:%p\n", (unsigned)q->shep, jobs[i], jobs[i]->thread, jobs[i]->thread->rdata);
+        jobs[i]->next = NULL;
+    }
+    if (n > 1) {
+        qthread_t *threads[QT_IO_BATCH_MAX];
+
+        qt_blocking_subsystem_perform_positional(jobs, n);
+        /* the jobs belong to their callers as soon as they're requeued */
+        for (size_t i = 0; i < n; i++) {
+            threads[i] = jobs[i]->thread;
+        }
+        qt_blocking_subsystem_requeue(threads, n);
+    } else {
+        item = jobs[0];
+        qt_blocking_subsystem_perform(item);
+        /* and now, re-queue; the caller frees the job when it wakes up,
+         * except for a user-defined action, whose caller has long since
+         * moved on */
+        if (item->op == USER_DEFINED) {
+            qthread_t *t = item->thread;
+
+            FREE_SYSCALLJOB(item);
+            qt_threadqueue_enqueue(t->rdata->shepherd_ptr->ready, t);
+        } else {
+            qt_threadqueue_enqueue(item->thread->rdata->shepherd_ptr->ready, item->thread);
+        }
+    }
+    (void)qthread_incr(&q->nidle, 1);
+    return 1;
 } /*}}}*/
 
 void INTERNAL qt_blocking_subsystem_enqueue(qt_blocking_queue_node_t *job)
 {   /*{{{*/
-    qt_blocking_queue_node_t *prev;
+    qt_blocking_queue_t *q;
+    saligned_t           len;
 
     qthread_debug(IO_FUNCTIONS, "entering, job = %p, thread:%p, rdata:%p\n", job, job->thread, job->thread->rdata);
     assert(job->next == NULL);
     assert(job->thread->rdata);
-    QTHREAD_LOCK(&theQueue.lock);
-    qthread_debug(IO_DETAILS, "1) theQueue.head = %p, .tail = %p, job = %p\n", theQueue.head, theQueue.tail, job);
-    prev          = theQueue.tail;
-    theQueue.tail = job;
-    if (prev == NULL) {
-        theQueue.head = job;
-    } else {
-        prev->next = job;
-    }
-    theQueue.length++;
-    qthread_debug(IO_DETAILS, "2) theQueue.head = %p, .tail = %p, job = %p\n", theQueue.head, theQueue.tail, job);
-    if (io_worker_count < theQueue.length) {
-        if (io_worker_count < io_worker_max) {
-            qthread_debug(IO_DETAILS, "++++++++++++++++++++ I think I oughta spawn a worker\n");
-            qt_blocking_subsystem_spawnworker();
+#ifdef QTHREAD_USE_TIMER_WHEEL
+    if ((job->op == NANOSLEEP) || (job->op == USLEEP) || (job->op == SLEEP)) {
+        qt_timer_start((qt_timer_t *)job->args[0], qthread_internal_getshep()->shepherd_id);
+        return;
+    }
+#endif
+#ifdef QTHREAD_USE_IO_URING
+    if (qt_io_uring_submit(job)) {
+        return;
+    }
+#endif
+#ifdef QTHREAD_USE_EPOLL
+    if (qt_io_epoll_submit(job)) {
+        return;
+    }
+#endif
+    q = &queues[job->thread->rdata->shepherd_ptr->shepherd_id];
+    qt_blocking_queue_push(q, job);
+    len = qthread_incr(&q->length, 1) + 1;
+    /* if the proxies that are up and looking can't keep up, wake another,
+     * or failing that, start one */
+    if (len > q->nidle - q->nparked) {
+        if (!qt_blocking_subsystem_unpark_proxy(q) && qt_blocking_subsystem_spawnworker(q)) {
+            qthread_debug(IO_DETAILS, "started proxy %u for shep %u\n", (unsigned)q->nproxies, (unsigned)q->shep);
         }
-    } else {
-        qthread_debug(IO_DETAILS, "Queue is %u long, there are %u workers\n", (unsigned)theQueue.length, (unsigned)io_worker_count);
-        QTHREAD_COND_SIGNAL(theQueue.notempty);
     }
-    QTHREAD_UNLOCK(&theQueue.lock);
     qthread_debug(IO_FUNCTIONS, "exiting, job = %p\n", job);
 } /*}}}*/
 
+/* Waits, as a blocking call would, until fd is ready for events; for the
+ * syscall wrappers, which try sockets without blocking first. */
+int INTERNAL qt_blocking_subsystem_wait(int   fd,
+                                        short events)
+{   /*{{{*/
+    struct pollfd pfd;
+
+    pfd.fd      = fd;
+    pfd.events  = events;
+    pfd.revents = 0;
+    return qt_poll(&pfd, 1, -1);
+} /*}}}*/
+
+/* Says how the read or write wrappers should make a call on fd. Whatever the
+ * program made non-blocking can't block, and is called right away; a ring
+ * would wait on it regardless. Otherwise, a ring waits on whatever it is
+ * given without tying up a thread, so the descriptor isn't looked at any
+ * further if there is one; the proxies can't, so sockets are kept away from
+ * them. Without a ring, only sockets need to know whether they are
+ * non-blocking: a proxy makes any other call just as the program would. */
+int INTERNAL qt_blocking_subsystem_fdmode(int       fd,
+                                          syscall_t op)
+{   /*{{{*/
+    struct stat st;
+    int         flags;
+
+#ifdef QTHREAD_USE_IO_URING
+    if (qt_io_uring_takes(op)) {
+        if ((flags = fcntl(fd, F_GETFL)) < 0) {
+            return QT_IO_FD_PROXY;
+        }
+        return (flags & O_NONBLOCK) ? QT_IO_FD_INLINE : QT_IO_FD_PROXY;
+    }
+#endif
+    if ((fstat(fd, &st) != 0) || !S_ISSOCK(st.st_mode) ||
+        ((flags = fcntl(fd, F_GETFL)) < 0)) {
+        return QT_IO_FD_PROXY;
+    }
+    return (flags & O_NONBLOCK) ? QT_IO_FD_INLINE : QT_IO_FD_WAIT;
+} /*}}}*/
+
+#if defined(QTHREAD_USE_IO_URING) || defined(QTHREAD_USE_EPOLL)
+/* Requeues the tasks whose calls on shep's ring or set have finished;
+ * returns how many there were. */
+int INTERNAL qt_blocking_subsystem_poll(qthread_shepherd_id_t shep,
+                                        int                   idle)
+{   /*{{{*/
+    int n = 0;
+
+# ifdef QTHREAD_USE_IO_URING
+    n += qt_io_uring_poll(shep);
+# endif
+# ifdef QTHREAD_USE_EPOLL
+    n += qt_io_epoll_poll(shep, idle);
+# endif
+    return n;
+} /*}}}*/
+
+/* Called by an idle worker of shep, in place of qt_park_wait(spot); returns
+ * zero if there was nothing in flight to wait for instead. */
+int INTERNAL qt_blocking_subsystem_park(qthread_shepherd_id_t shep,
+                                        qt_park_spot_t       *spot,
+                                        unsigned long         usec)
+{   /*{{{*/
+# ifdef QTHREAD_USE_IO_URING
+    if (qt_io_uring_park(shep, spot, usec)) {
+        return 1;
+    }
+# endif
+# ifdef QTHREAD_USE_EPOLL
+    if (qt_io_epoll_park(shep, spot, usec)) {
+        return 1;
+    }
+# endif
+    return 0;
+} /*}}}*/
+
+/* Called after claiming spot, in case its worker is parked in the kernel. */
+void INTERNAL qt_blocking_subsystem_unpark(qt_park_spot_t *spot)
+{   /*{{{*/
+# ifdef QTHREAD_USE_IO_URING
+    qt_io_uring_unpark(spot);
+# endif
+# ifdef QTHREAD_USE_EPOLL
+    qt_io_epoll_unpark(spot);
+# endif
+} /*}}}*/
+
+#endif /* if defined(QTHREAD_USE_IO_URING) || defined(QTHREAD_USE_EPOLL) */
+
 /* vim:set expandtab: */
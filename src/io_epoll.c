@@ -0,0 +1,417 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <qthread/qthread-int.h>       /* for uint64_t */
+#include <errno.h>
+#include <string.h>                    /* for memset() */
+#include <unistd.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+/* Internal Headers */
+#include "qt_io.h"
+#include "qt_macros.h"
+#include "qt_asserts.h"
+#include "qt_alloc.h"
+#include "qt_atomics.h"
+#include "qthread_innards.h"           /* for qlib */
+#include "qt_threadqueues.h"
+#include "qt_envariables.h"
+#include "qt_subsystems.h"
+#include "qt_debug.h"
+#include "qt_expect.h"
+#include "qt_park.h"
+
+/* Each shepherd gets an epoll set, used (where io_uring is not) to wait for
+ * descriptors to become ready. The syscall wrappers try socket operations
+ * without blocking first, and only when they would block do they wait, with
+ * qt_poll(), for the descriptor; that single-descriptor poll is a job the
+ * shepherd registers in its set rather than handing it to a proxy pthread.
+ * So a parked task costs a list node instead of a thread, and the proxies are
+ * left for calls that really have to block. The shepherd's workers collect
+ * ready descriptors when they have nothing else to do, and an idle worker
+ * that would otherwise park waits in epoll_wait() instead. */
+
+/* Every task waiting on a descriptor, whatever for. Descriptors are
+ * registered EPOLLONESHOT, for the union of their waiters' events, so an
+ * event is only reported once, to whichever worker gets it, and is re-armed
+ * (under the set's lock) for the waiters it did not satisfy. */
+typedef struct {
+    qt_blocking_queue_node_t *waiters; /* linked through next */
+    uint32_t                  armed;   /* events asked for; 0 once reported */
+    uint8_t                   registered;
+} qt_epoll_fd_t;
+
+typedef struct {
+    int                      epfd;
+    int                      wakefd; /* an eventfd in the set, for unpark */
+    volatile aligned_t       lock;
+    qt_epoll_fd_t           *fds;    /* indexed by descriptor */
+    size_t                   nfds;
+    volatile aligned_t       waiting; /* jobs registered */
+    volatile aligned_t       reaping;
+    unsigned                 ticks;
+    /* the park spot of the worker waiting in epoll_wait(), if any */
+    qt_park_spot_t *volatile waiter;
+} Q_ALIGNED(CACHELINE_WIDTH) qt_epoll_t;
+
+/* a busy worker only looks at the set every EPOLL_INTERVAL scheduling
+ * decisions */
+#define EPOLL_INTERVAL 32
+#define EPOLL_EVENTS   64
+
+static qt_epoll_t           *sets          = NULL;
+static qthread_shepherd_id_t nsets         = 0;
+static saligned_t            epoll_waiters = 0;
+
+static QINLINE void qt_epoll_lock(volatile aligned_t *lock)
+{   /*{{{*/
+    do {
+        while (*lock != 0) SPINLOCK_BODY();
+    } while (qthread_cas(lock, 0, 1) != 0);
+} /*}}}*/
+
+static QINLINE void qt_epoll_unlock(volatile aligned_t *lock)
+{   /*{{{*/
+    COMPILER_FENCE;
+    *lock = 0;
+} /*}}}*/
+
+static int qt_epoll_setup(qt_epoll_t *e)
+{   /*{{{*/
+    struct epoll_event ev;
+
+    memset(e, 0, sizeof(qt_epoll_t));
+    e->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (e->epfd < 0) {
+        qthread_debug(IO_BEHAVIOR, "epoll_create1() failed (%i)\n", errno);
+        return 0;
+    }
+    e->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (e->wakefd < 0) {
+        close(e->epfd);
+        return 0;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events  = EPOLLIN;
+    ev.data.fd = e->wakefd;
+    if (epoll_ctl(e->epfd, EPOLL_CTL_ADD, e->wakefd, &ev) != 0) {
+        close(e->wakefd);
+        close(e->epfd);
+        return 0;
+    }
+    return 1;
+} /*}}}*/
+
+static void qt_epoll_teardown(qt_epoll_t *e)
+{   /*{{{*/
+    if (e->fds) {
+        FREE(e->fds, e->nfds * sizeof(qt_epoll_fd_t));
+    }
+    close(e->wakefd);
+    close(e->epfd);
+} /*}}}*/
+
+static void qt_io_epoll_internal_freemem(void)
+{   /*{{{*/
+    for (qthread_shepherd_id_t i = 0; i < nsets; i++) {
+        qt_epoll_teardown(&sets[i]);
+    }
+    qt_internal_aligned_free(sets, nsets * sizeof(qt_epoll_t));
+    sets  = NULL;
+    nsets = 0;
+} /*}}}*/
+
+/* Returns nonzero if every shepherd got an epoll set. */
+int INTERNAL qt_io_epoll_init(void)
+{   /*{{{*/
+    if (!qt_internal_get_env_bool("IO_EPOLL", 1)) {
+        return 0;
+    }
+    sets = qt_internal_aligned_alloc(qlib->nshepherds * sizeof(qt_epoll_t), CACHELINE_WIDTH);
+    if (sets == NULL) {
+        return 0;
+    }
+    for (qthread_shepherd_id_t i = 0; i < qlib->nshepherds; i++) {
+        if (!qt_epoll_setup(&sets[i])) {
+            while (i-- > 0) {
+                qt_epoll_teardown(&sets[i]);
+            }
+            qt_internal_aligned_free(sets, qlib->nshepherds * sizeof(qt_epoll_t));
+            sets = NULL;
+            return 0;
+        }
+    }
+    nsets = qlib->nshepherds;
+    qthread_debug(IO_BEHAVIOR, "using epoll\n");
+    qthread_internal_cleanup(qt_io_epoll_internal_freemem);
+    return 1;
+} /*}}}*/
+
+/* Returns the entry for fd, growing the table if need be; must be called
+ * with e->lock held. */
+static qt_epoll_fd_t *qt_epoll_entry(qt_epoll_t *e,
+                                     int         fd)
+{   /*{{{*/
+    if ((size_t)fd >= e->nfds) {
+        size_t         n   = e->nfds ? e->nfds : 64;
+        qt_epoll_fd_t *fds;
+
+        while (n <= (size_t)fd) n *= 2;
+        fds = qt_realloc(e->fds, n * sizeof(qt_epoll_fd_t));
+        if (fds == NULL) { return NULL; }
+        memset(fds + e->nfds, 0, (n - e->nfds) * sizeof(qt_epoll_fd_t));
+        e->fds  = fds;
+        e->nfds = n;
+    }
+    return &e->fds[fd];
+} /*}}}*/
+
+/* Asks for events on fd, for entry f; must be called with e->lock held.
+ * Returns zero if fd can't be waited on this way. */
+static int qt_epoll_arm(qt_epoll_t    *e,
+                        int            fd,
+                        qt_epoll_fd_t *f,
+                        uint32_t       events)
+{   /*{{{*/
+    struct epoll_event ev;
+    int                op = f->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events  = events | EPOLLONESHOT;
+    ev.data.fd = fd;
+    if (epoll_ctl(e->epfd, op, fd, &ev) != 0) {
+        /* the descriptor was closed (and maybe reopened) since we saw it */
+        if ((errno == ENOENT) && (op == EPOLL_CTL_MOD)) {
+            op = EPOLL_CTL_ADD;
+        } else if ((errno == EEXIST) && (op == EPOLL_CTL_ADD)) {
+            op = EPOLL_CTL_MOD;
+        } else {
+            return 0;
+        }
+        if (epoll_ctl(e->epfd, op, fd, &ev) != 0) {
+            return 0;
+        }
+    }
+    f->registered = 1;
+    f->armed      = events;
+    return 1;
+} /*}}}*/
+
+/* Called by a worker, in the shepherd loop, for a task that has just switched
+ * out to make a blocking call. Returns nonzero if the job went in the set. */
+int INTERNAL qt_io_epoll_submit(qt_blocking_queue_node_t *job)
+{   /*{{{*/
+    qt_epoll_t    *e;
+    qt_epoll_fd_t *f;
+    struct pollfd *pfd;
+    nfds_t         nfds;
+    int            timeout;
+    uint32_t       want;
+
+    if ((sets == NULL) || (job->op != POLL)) { return 0; }
+    pfd = (struct pollfd *)job->args[0];
+    memcpy(&nfds, &job->args[1], sizeof(nfds_t));
+    memcpy(&timeout, &job->args[2], sizeof(int));
+    /* a single descriptor, waited on without a timeout */
+    if ((nfds != 1) || (timeout >= 0) || (pfd->fd < 0)) {
+        return 0;
+    }
+    e = &sets[qthread_internal_getshep()->shepherd_id];
+    qt_epoll_lock(&e->lock);
+    f = qt_epoll_entry(e, pfd->fd);
+    if (f == NULL) {
+        qt_epoll_unlock(&e->lock);
+        return 0;
+    }
+    /* the poll(2) and epoll(7) event bits are the same */
+    want = f->armed | (uint16_t)pfd->events;
+    if ((want != f->armed) || (f->waiters == NULL)) {
+        if (!qt_epoll_arm(e, pfd->fd, f, want)) {
+            qt_epoll_unlock(&e->lock);
+            return 0;
+        }
+    }
+    job->next  = f->waiters;
+    f->waiters = job;
+    (void)qthread_incr(&e->waiting, 1);
+    qt_epoll_unlock(&e->lock);
+    qthread_debug(IO_DETAILS, "epoll %i: job %p, fd %i\n", e->epfd, job, pfd->fd);
+    return 1;
+} /*}}}*/
+
+/* Wakes the waiters on ev's descriptor that it satisfies, and re-arms it for
+ * the rest. Returns how many were woken. */
+static int qt_epoll_dispatch(qt_epoll_t               *e,
+                             const struct epoll_event *ev)
+{   /*{{{*/
+    const int                  fd    = ev->data.fd;
+    qt_blocking_queue_node_t  *ready = NULL;
+    qt_blocking_queue_node_t **prev;
+    qt_epoll_fd_t             *f;
+    uint32_t                   want  = 0;
+    int                        n     = 0;
+
+    qt_epoll_lock(&e->lock);
+    assert((size_t)fd < e->nfds);
+    f        = &e->fds[fd];
+    f->armed = 0; /* EPOLLONESHOT */
+    prev     = &f->waiters;
+    while (*prev != NULL) {
+        qt_blocking_queue_node_t *job = *prev;
+        struct pollfd            *pfd = (struct pollfd *)job->args[0];
+        const uint32_t            got = ev->events & ((uint16_t)pfd->events | EPOLLERR | EPOLLHUP);
+
+        if (got) {
+            *prev        = job->next;
+            pfd->revents = (short)got;
+            job->ret     = 1;
+            job->err     = 0;
+            job->next    = ready;
+            ready        = job;
+            n++;
+        } else {
+            want |= (uint16_t)pfd->events;
+            prev  = &job->next;
+        }
+    }
+    if (f->waiters != NULL) {
+        if (!qt_epoll_arm(e, fd, f, want)) {
+            /* can't happen, short of running out of memory; let the rest
+             * find out for themselves */
+            while (f->waiters != NULL) {
+                qt_blocking_queue_node_t *job = f->waiters;
+
+                f->waiters                                 = job->next;
+                ((struct pollfd *)job->args[0])->revents = POLLERR;
+                job->ret                                   = 1;
+                job->err                                   = 0;
+                job->next                                  = ready;
+                ready                                      = job;
+                n++;
+            }
+        }
+    }
+    qt_epoll_unlock(&e->lock);
+    (void)qthread_incr(&e->waiting, -n);
+    while (ready != NULL) {
+        qt_blocking_queue_node_t *job = ready;
+
+        ready     = job->next;
+        job->next = NULL;
+        qt_threadqueue_enqueue(job->thread->rdata->shepherd_ptr->ready, job->thread);
+    }
+    return n;
+} /*}}}*/
+
+/* Collects whatever epoll_wait() reports within timeout msecs; returns how
+ * many tasks it woke, and sets *woken if it saw the wakeup descriptor. */
+static int qt_epoll_reap(qt_epoll_t *e,
+                         int         timeout,
+                         int        *woken)
+{   /*{{{*/
+    struct epoll_event evs[EPOLL_EVENTS];
+    int                nev, n = 0;
+
+    nev = epoll_wait(e->epfd, evs, EPOLL_EVENTS, timeout);
+    for (int i = 0; i < nev; i++) {
+        if (evs[i].data.fd == e->wakefd) {
+            /* only the parked worker clears it, so it can't be lost */
+            if (woken) { *woken = 1; }
+        } else {
+            n += qt_epoll_dispatch(e, &evs[i]);
+        }
+    }
+    return n;
+} /*}}}*/
+
+static int qt_epoll_tryreap(qt_epoll_t *e)
+{   /*{{{*/
+    int n;
+
+    if ((e->waiting == 0) || (e->reaping != 0) ||
+        (qthread_cas(&e->reaping, 0, 1) != 0)) {
+        return 0;
+    }
+    n = qt_epoll_reap(e, 0, NULL);
+    qt_epoll_unlock(&e->reaping);
+    return n;
+} /*}}}*/
+
+/* Requeues the tasks waiting in shep's set whose descriptors are ready;
+ * returns how many there were. A busy worker only looks now and then; an
+ * idle one also looks in the other shepherds' sets, since their workers may
+ * be too busy to. */
+int INTERNAL qt_io_epoll_poll(qthread_shepherd_id_t shep,
+                              int                   idle)
+{   /*{{{*/
+    int n;
+
+    if (sets == NULL) { return 0; }
+    if (!idle) {
+        if ((sets[shep].waiting == 0) || ((++sets[shep].ticks % EPOLL_INTERVAL) != 0)) {
+            return 0;
+        }
+        return qt_epoll_tryreap(&sets[shep]);
+    }
+    n = qt_epoll_tryreap(&sets[shep]);
+    for (qthread_shepherd_id_t i = 1; n == 0 && i < nsets; i++) {
+        n = qt_epoll_tryreap(&sets[(shep + i) % nsets]);
+    }
+    return n;
+} /*}}}*/
+
+/* Called by an idle worker of shep, in place of qt_park_wait(spot), when it
+ * has nothing else to do. If tasks are waiting in shep's set, and nobody else
+ * is waiting for them, wait for a descriptor (or for somebody to claim spot,
+ * or for usec to pass) and return nonzero; otherwise return zero. */
+int INTERNAL qt_io_epoll_park(qthread_shepherd_id_t shep,
+                              qt_park_spot_t       *spot,
+                              unsigned long         usec)
+{   /*{{{*/
+    qt_epoll_t *e;
+    int         woken = 0;
+
+    if (sets == NULL) { return 0; }
+    e = &sets[shep];
+    if ((e->waiting == 0) || (e->waiter != NULL) ||
+        (qthread_cas_ptr((void **)&e->waiter, NULL, spot) != NULL)) {
+        return 0;
+    }
+    (void)qthread_incr(&epoll_waiters, 1);
+    /* pairs with the claim in qt_io_epoll_unpark(): either the waker sees us
+     * in the set, or we see that the spot was claimed */
+    MACHINE_FENCE;
+    if ((spot->state == QT_PARK_PARKED) && (qt_epoll_reap(e, 0, &woken) == 0) && !woken) {
+        (void)qt_epoll_reap(e, (int)((usec + 999) / 1000), &woken);
+    }
+    (void)qthread_cas_ptr((void **)&e->waiter, spot, NULL);
+    (void)qthread_incr(&epoll_waiters, -1);
+    if (woken) {
+        eventfd_t junk;
+
+        (void)eventfd_read(e->wakefd, &junk);
+    }
+    return 1;
+} /*}}}*/
+
+/* Called after claiming spot: if its worker is waiting in epoll_wait() rather
+ * than on the spot, poke the set's eventfd to wake it. */
+void INTERNAL qt_io_epoll_unpark(qt_park_spot_t *spot)
+{   /*{{{*/
+    if (QTHREAD_LIKELY(epoll_waiters == 0)) { return; }
+    for (qthread_shepherd_id_t i = 0; i < nsets; i++) {
+        qt_epoll_t *e = &sets[i];
+
+        if ((e->waiter == spot) &&
+            (qthread_cas_ptr((void **)&e->waiter, spot, NULL) == spot)) {
+            (void)eventfd_write(e->wakefd, 1);
+            return;
+        }
+    }
+} /*}}}*/
+
+/* vim:set expandtab: */
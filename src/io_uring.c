@@ -0,0 +1,475 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <qthread/qthread-int.h>       /* for uint64_t */
+#include <errno.h>
+#include <string.h>                    /* for memset() */
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+
+/* Internal Headers */
+#include "qt_io.h"
+#include "qt_macros.h"
+#include "qt_asserts.h"
+#include "qt_alloc.h"
+#include "qt_atomics.h"
+#include "qthread_innards.h"           /* for qlib */
+#include "qt_threadqueues.h"
+#include "qt_envariables.h"
+#include "qt_subsystems.h"
+#include "qt_debug.h"
+#include "qt_expect.h"
+#include "qt_park.h"
+
+/* Each shepherd gets its own io_uring. A task that makes a blocking call
+ * switches back to its worker, which (in the shepherd loop) turns the job
+ * into a submission on that shepherd's ring instead of handing it to a proxy
+ * pthread. The shepherd's workers pick up completions whenever they look for
+ * work, and an idle worker that would otherwise park waits on the ring
+ * instead, so that a completion wakes it. Jobs the ring cannot do, or cannot
+ * take right now, go to the proxy threads as before. */
+
+typedef struct {
+    int                  fd;
+    unsigned             features;
+    /* submission side; only touched under sq_lock */
+    volatile aligned_t   sq_lock;
+    unsigned            *sq_head;
+    unsigned            *sq_tail;
+    unsigned             sq_mask;
+    struct io_uring_sqe *sqes;
+    /* completion side; one reaper at a time */
+    volatile aligned_t   cq_lock;
+    unsigned            *cq_head;
+    unsigned            *cq_tail;
+    unsigned             cq_mask;
+    struct io_uring_cqe *cqes;
+    /* submissions not yet reaped; kept below cq_entries, so the completion
+     * queue can never overflow */
+    volatile aligned_t   inflight;
+    aligned_t            cq_entries;
+    /* the park spot of the worker waiting in io_uring_enter(), if any */
+    qt_park_spot_t *volatile waiter;
+    void                *sq_map;
+    size_t               sq_map_size;
+    void                *cq_map;
+    size_t               cq_map_size;
+    size_t               sqes_size;
+} Q_ALIGNED(CACHELINE_WIDTH) qt_io_ring_t;
+
+static qt_io_ring_t         *rings        = NULL;
+static qthread_shepherd_id_t nrings       = 0;
+static saligned_t            ring_waiters = 0;
+static uint8_t               supported[IORING_OP_LAST];
+static uint8_t               rw_cur_pos = 0; /* reads and writes can use the file position */
+
+static QINLINE void qt_io_ring_lock(volatile aligned_t *lock)
+{   /*{{{*/
+    do {
+        while (*lock != 0) SPINLOCK_BODY();
+    } while (qthread_cas(lock, 0, 1) != 0);
+} /*}}}*/
+
+static QINLINE void qt_io_ring_unlock(volatile aligned_t *lock)
+{   /*{{{*/
+    COMPILER_FENCE;
+    *lock = 0;
+} /*}}}*/
+
+static int qt_io_ring_enter(int       fd,
+                            unsigned  to_submit,
+                            unsigned  min_complete,
+                            unsigned  flags,
+                            void     *arg,
+                            size_t    argsz)
+{   /*{{{*/
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+} /*}}}*/
+
+static int qt_io_ring_setup(qt_io_ring_t *r,
+                            unsigned      entries)
+{   /*{{{*/
+    struct io_uring_params p;
+    char                  *sq, *cq;
+
+    memset(&p, 0, sizeof(p));
+    r->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) {
+        qthread_debug(IO_BEHAVIOR, "io_uring_setup() failed (%i)\n", errno);
+        return 0;
+    }
+    r->features    = p.features;
+    r->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_map_size > r->sq_map_size) {
+            r->sq_map_size = r->cq_map_size;
+        }
+    }
+    r->sq_map = mmap(NULL, r->sq_map_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_map == MAP_FAILED) {
+        close(r->fd);
+        return 0;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_map      = NULL;
+        r->cq_map_size = 0;
+        cq             = r->sq_map;
+    } else {
+        r->cq_map = mmap(NULL, r->cq_map_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_map == MAP_FAILED) {
+            munmap(r->sq_map, r->sq_map_size);
+            close(r->fd);
+            return 0;
+        }
+        cq = r->cq_map;
+    }
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes      = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        if (r->cq_map) { munmap(r->cq_map, r->cq_map_size); }
+        munmap(r->sq_map, r->sq_map_size);
+        close(r->fd);
+        return 0;
+    }
+    sq         = r->sq_map;
+    r->sq_head = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+    /* entry i of the indirection array always names sqe i */
+    for (unsigned i = 0; i < p.sq_entries; i++) {
+        ((unsigned *)(sq + p.sq_off.array))[i] = i;
+    }
+    r->cq_head    = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail    = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask    = *(unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes       = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    r->cq_entries = p.cq_entries;
+    r->inflight   = 0;
+    r->sq_lock    = 0;
+    r->cq_lock    = 0;
+    r->waiter     = NULL;
+    return 1;
+} /*}}}*/
+
+static void qt_io_ring_teardown(qt_io_ring_t *r)
+{   /*{{{*/
+    munmap(r->sqes, r->sqes_size);
+    if (r->cq_map) { munmap(r->cq_map, r->cq_map_size); }
+    munmap(r->sq_map, r->sq_map_size);
+    close(r->fd);
+} /*}}}*/
+
+static void qt_io_uring_internal_freemem(void)
+{   /*{{{*/
+    for (qthread_shepherd_id_t i = 0; i < nrings; i++) {
+        qt_io_ring_teardown(&rings[i]);
+    }
+    qt_internal_aligned_free(rings, nrings * sizeof(qt_io_ring_t));
+    rings  = NULL;
+    nrings = 0;
+} /*}}}*/
+
+/* Finds out which operations the kernel can do asynchronously. */
+static void qt_io_uring_probe(qt_io_ring_t *r)
+{   /*{{{*/
+    const size_t           len   = sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = MALLOC(len);
+
+    memset(supported, 0, sizeof(supported));
+    if (probe == NULL) { return; }
+    memset(probe, 0, len);
+    if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == 0) {
+        for (unsigned i = 0; i < probe->ops_len && i < IORING_OP_LAST; i++) {
+            supported[i] = (probe->ops[i].flags & IO_URING_OP_SUPPORTED) ? 1 : 0;
+        }
+    }
+    FREE(probe, len);
+    rw_cur_pos = (r->features & IORING_FEAT_RW_CUR_POS) ? 1 : 0;
+} /*}}}*/
+
+/* Returns nonzero if every shepherd got a ring. */
+int INTERNAL qt_io_uring_init(void)
+{   /*{{{*/
+    const unsigned entries = qt_internal_get_env_num("IO_URING_ENTRIES", 128, 128);
+
+    if (!qt_internal_get_env_bool("IO_URING", 1)) {
+        return 0;
+    }
+    rings = qt_internal_aligned_alloc(qlib->nshepherds * sizeof(qt_io_ring_t), CACHELINE_WIDTH);
+    if (rings == NULL) {
+        return 0;
+    }
+    for (qthread_shepherd_id_t i = 0; i < qlib->nshepherds; i++) {
+        if (!qt_io_ring_setup(&rings[i], entries)) {
+            while (i-- > 0) {
+                qt_io_ring_teardown(&rings[i]);
+            }
+            qt_internal_aligned_free(rings, qlib->nshepherds * sizeof(qt_io_ring_t));
+            rings = NULL;
+            return 0;
+        }
+    }
+    nrings = qlib->nshepherds;
+    qt_io_uring_probe(&rings[0]);
+    qthread_debug(IO_BEHAVIOR, "using io_uring, %u entries per shepherd\n", entries);
+    qthread_internal_cleanup(qt_io_uring_internal_freemem);
+    return 1;
+} /*}}}*/
+
+/* Fills in sqe for job; returns zero if the ring can't do it. */
+static int qt_io_uring_prep(struct io_uring_sqe      *sqe,
+                            qt_blocking_queue_node_t *job)
+{   /*{{{*/
+    int fd;
+
+    memcpy(&fd, &job->args[0], sizeof(int));
+    sqe->fd        = fd;
+    sqe->user_data = (uintptr_t)job;
+    switch(job->op) {
+        case READ:
+        case WRITE:
+            sqe->opcode = (job->op == READ) ? IORING_OP_READ : IORING_OP_WRITE;
+            sqe->addr   = job->args[1];
+            sqe->len    = (unsigned)job->args[2];
+            sqe->off    = (uint64_t)-1; /* the current position */
+            return rw_cur_pos && (job->args[2] == sqe->len);
+
+        case PREAD:
+        case PWRITE:
+        {
+            off_t offset;
+            memcpy(&offset, &job->args[3], sizeof(off_t));
+            sqe->opcode = (job->op == PREAD) ? IORING_OP_READ : IORING_OP_WRITE;
+            sqe->addr   = job->args[1];
+            sqe->len    = (unsigned)job->args[2];
+            sqe->off    = offset;
+            return job->args[2] == sqe->len;
+        }
+        case ACCEPT:
+            sqe->opcode = IORING_OP_ACCEPT;
+            sqe->addr   = job->args[1];
+            sqe->addr2  = job->args[2];
+            return 1;
+
+        case CONNECT:
+            sqe->opcode = IORING_OP_CONNECT;
+            sqe->addr   = job->args[1];
+            sqe->off    = job->args[2];
+            return 1;
+
+        case POLL:
+        {
+            struct pollfd *fds = (struct pollfd *)job->args[0];
+            nfds_t         nfds;
+            int            timeout;
+            memcpy(&nfds, &job->args[1], sizeof(nfds_t));
+            memcpy(&timeout, &job->args[2], sizeof(int));
+            /* a single descriptor, waited on without a timeout */
+            if ((nfds != 1) || (timeout >= 0)) {
+                return 0;
+            }
+            sqe->opcode      = IORING_OP_POLL_ADD;
+            sqe->fd          = fds[0].fd;
+            sqe->poll_events = fds[0].events;
+            return 1;
+        }
+        default:
+            return 0;
+    }
+} /*}}}*/
+
+/* Returns nonzero if the rings are up and make op's calls, which they can wait
+ * on without tying up a thread; the syscall wrappers leave sockets to them
+ * then. A ring waits even on a descriptor the program made non-blocking, so
+ * those calls must not be given to it. */
+int INTERNAL qt_io_uring_takes(syscall_t op)
+{   /*{{{*/
+    if (rings == NULL) { return 0; }
+    switch(op) {
+        case READ:
+            return rw_cur_pos && supported[IORING_OP_READ];
+
+        case WRITE:
+            return rw_cur_pos && supported[IORING_OP_WRITE];
+
+        default:
+            return 0;
+    }
+} /*}}}*/
+
+/* Puts one prepared entry on r's submission queue and tells the kernel;
+ * must be called with r->sq_lock held. */
+static void qt_io_ring_push(qt_io_ring_t              *r,
+                            const struct io_uring_sqe *sqe)
+{   /*{{{*/
+    const unsigned tail = *r->sq_tail;
+
+    r->sqes[tail & r->sq_mask] = *sqe;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    /* anything an earlier enter left behind goes too */
+    while ((qt_io_ring_enter(r->fd, tail + 1 - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE), 0, 0, NULL, 0) < 0) &&
+           (errno == EINTR)) ;
+} /*}}}*/
+
+/* Called by a worker, in the shepherd loop, for a task that has just switched
+ * out to make a blocking call. Returns nonzero if the job went on the ring. */
+int INTERNAL qt_io_uring_submit(qt_blocking_queue_node_t *job)
+{   /*{{{*/
+    qt_io_ring_t       *r;
+    struct io_uring_sqe sqe;
+
+    if (rings == NULL) { return 0; }
+    memset(&sqe, 0, sizeof(sqe));
+    if (!qt_io_uring_prep(&sqe, job) || !supported[sqe.opcode]) {
+        return 0;
+    }
+    r = &rings[qthread_internal_getshep()->shepherd_id];
+    if (qthread_incr(&r->inflight, 1) >= r->cq_entries) {
+        (void)qthread_incr(&r->inflight, -1);
+        return 0;
+    }
+    qthread_debug(IO_DETAILS, "ring %i: job %p, op %i\n", r->fd, job, (int)sqe.opcode);
+    qt_io_ring_lock(&r->sq_lock);
+    qt_io_ring_push(r, &sqe);
+    qt_io_ring_unlock(&r->sq_lock);
+    return 1;
+} /*}}}*/
+
+static void qt_io_uring_complete(qt_blocking_queue_node_t *job,
+                                 int                       res)
+{   /*{{{*/
+    if (res < 0) {
+        job->ret = -1;
+        job->err = -res;
+    } else if (job->op == POLL) {
+        ((struct pollfd *)job->args[0])->revents = res;
+        job->ret = 1;
+        job->err = 0;
+    } else {
+        job->ret = res;
+        job->err = 0;
+    }
+    qt_threadqueue_enqueue(job->thread->rdata->shepherd_ptr->ready, job->thread);
+} /*}}}*/
+
+static int qt_io_ring_reap(qt_io_ring_t *r)
+{   /*{{{*/
+    unsigned head, tail;
+    int      n = 0;
+
+    if ((r->inflight == 0) || (r->cq_lock != 0) || (qthread_cas(&r->cq_lock, 0, 1) != 0)) {
+        return 0;
+    }
+    head = *r->cq_head;
+    tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        const struct io_uring_cqe *cqe = &r->cqes[head & r->cq_mask];
+        qt_blocking_queue_node_t  *job = (qt_blocking_queue_node_t *)(uintptr_t)cqe->user_data;
+        const int                  res = cqe->res;
+
+        head++;
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+        (void)qthread_incr(&r->inflight, -1);
+        if (job != NULL) { /* NULL is a wakeup */
+            qt_io_uring_complete(job, res);
+            n++;
+        }
+        if (head == tail) {
+            tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        }
+    }
+    qt_io_ring_unlock(&r->cq_lock);
+    return n;
+} /*}}}*/
+
+/* Requeues the tasks whose calls on shep's ring have finished; returns how
+ * many there were. */
+int INTERNAL qt_io_uring_poll(qthread_shepherd_id_t shep)
+{   /*{{{*/
+    if (rings == NULL) { return 0; }
+    return qt_io_ring_reap(&rings[shep]);
+} /*}}}*/
+
+/* Called by an idle worker of shep, in place of qt_park_wait(spot), when it
+ * has nothing else to do. If shep has calls in flight, and nobody else is
+ * waiting for them, wait for one of them to finish (or for somebody to claim
+ * spot, or for usec to pass) and return nonzero; otherwise return zero. */
+int INTERNAL qt_io_uring_park(qthread_shepherd_id_t shep,
+                              qt_park_spot_t       *spot,
+                              unsigned long         usec)
+{   /*{{{*/
+    qt_io_ring_t *r;
+
+    if (rings == NULL) { return 0; }
+    r = &rings[shep];
+    if ((r->inflight == 0) || (r->waiter != NULL) ||
+        (qthread_cas_ptr((void **)&r->waiter, NULL, spot) != NULL)) {
+        return 0;
+    }
+    (void)qthread_incr(&ring_waiters, 1);
+    /* pairs with the claim in qt_io_uring_unpark(): either the
+     * waker sees us on the ring, or we see that the spot was claimed */
+    MACHINE_FENCE;
+    if ((spot->state == QT_PARK_PARKED) && (qt_io_ring_reap(r) == 0)) {
+#ifdef IORING_FEAT_EXT_ARG
+        if (r->features & IORING_FEAT_EXT_ARG) {
+            struct __kernel_timespec       ts;
+            struct io_uring_getevents_arg  arg;
+
+            ts.tv_sec      = usec / 1000000;
+            ts.tv_nsec     = (usec % 1000000) * 1000;
+            memset(&arg, 0, sizeof(arg));
+            arg.ts = (uintptr_t)&ts;
+            (void)qt_io_ring_enter(r->fd, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+        } else
+#endif
+        {
+            /* no way to bound the wait in the kernel; poll briskly instead */
+            qt_park_wait(spot, (usec < 1000) ? usec : 1000);
+        }
+    }
+    (void)qthread_cas_ptr((void **)&r->waiter, spot, NULL);
+    (void)qthread_incr(&ring_waiters, -1);
+    (void)qt_io_ring_reap(r);
+    return 1;
+} /*}}}*/
+
+/* Called after claiming spot: if its worker is waiting on a ring rather than
+ * on the spot, post a no-op there to wake it. */
+void INTERNAL qt_io_uring_unpark(qt_park_spot_t *spot)
+{   /*{{{*/
+    if (QTHREAD_LIKELY(ring_waiters == 0)) { return; }
+    for (qthread_shepherd_id_t i = 0; i < nrings; i++) {
+        qt_io_ring_t *r = &rings[i];
+
+        if ((r->waiter == spot) &&
+            (qthread_cas_ptr((void **)&r->waiter, spot, NULL) == spot)) {
+            struct io_uring_sqe sqe;
+
+            if (qthread_incr(&r->inflight, 1) >= r->cq_entries) {
+                /* the ring is busy enough to wake the waiter by itself */
+                (void)qthread_incr(&r->inflight, -1);
+                return;
+            }
+            memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode    = IORING_OP_NOP;
+            sqe.user_data = 0;
+            qt_io_ring_lock(&r->sq_lock);
+            qt_io_ring_push(r, &sqe);
+            qt_io_ring_unlock(&r->sq_lock);
+            return;
+        }
+    }
+} /*}}}*/
+
+/* vim:set expandtab: */
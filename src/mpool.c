@@ -8,6 +8,9 @@
 #include <stddef.h>                    /* for size_t (according to C89) */
 #include <stdlib.h>                    /* for calloc() and malloc() */
 #include <string.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>                 /* for mmap() and madvise() */
+#endif
 
 /* External Headers */
 #ifdef QTHREAD_USE_VALGRIND
@@ -24,6 +27,7 @@
 
 /* Internal Includes */
 #include <qthread/qthread-int.h>       /* for uintptr_t */
+#include "qthread/qthread.h"           /* for qthread_readstate() */
 #include "qt_envariables.h"
 #include "qt_mpool.h"
 #include "qt_atomics.h"
@@ -35,6 +39,8 @@
 #include "qt_visibility.h"
 #include "qt_alloc.h"
 #include "qt_subsystems.h"
+#include "qt_affinity.h"
+#include "qt_output_macros.h"
 
 /* Seems SLIGHTLY faster without TLS, and a whole lot safer and cleaner */
 #ifdef TLS
@@ -42,6 +48,16 @@
 #endif
 
 typedef struct threadlocal_cache_s qt_mpool_threadlocal_cache_t;
+typedef struct worker_slab_s       qt_mpool_worker_slab_t;
+typedef struct shep_reuse_s        qt_mpool_shep_reuse_t;
+
+typedef struct qt_mpool_reuse_s {
+    QTHREAD_FASTLOCK_TYPE lock;
+    void                 *list;
+} qt_mpool_reuse_t;
+
+/* should slab pools count where their items live (LOCALITY_REPORT)? */
+static int locality_report = 0;
 
 #ifdef TLS
 static TLS_DECL_INIT(qt_mpool_threadlocal_cache_t *, pool_caches);
@@ -63,12 +79,29 @@ struct qt_mpool_s {
 #endif
     qt_mpool_threadlocal_cache_t *caches;  // for cleanup
 
-    QTHREAD_FASTLOCK_TYPE         reuse_lock;
-    void                         *reuse_pool;
+    qt_mpool_reuse_t              reuse;
+
+    size_t                        block_alignment;
 
     QTHREAD_FASTLOCK_TYPE         pool_lock;
     void                        **alloc_list;
     size_t                        alloc_list_pos;
+
+    /* per-worker slabs (see qt_mpool_create_slab()); NULL otherwise */
+    qt_mpool_worker_slab_t       *slabs;
+    size_t                        nslabs;
+    qt_mpool_shep_reuse_t        *homes;  /* one reuse list per shepherd */
+    size_t                        slabs_per_home;
+    const char                   *name;
+
+    /* paged pools (see qt_mpool_create_paged()); all zero otherwise */
+    int                           paged;
+    qt_mpool_paging_t             paging;
+    uint8_t                      *arena;
+    size_t                        arena_size;
+    void                         *arena_map;  /* what to munmap() */
+    size_t                        arena_map_size;
+    aligned_t                     arena_used;
 };
 
 typedef struct qt_mpool_cache_entry_s {
@@ -77,6 +110,26 @@ typedef struct qt_mpool_cache_entry_s {
     uint8_t                        data[];
 } qt_mpool_cache_t;
 
+/* A free item is kept on its lists through a qt_mpool_cache_t at
+ * paging.link_offset into the item, which is 0 unless the pool is paged. */
+#define QT_MPOOL_LINK(pool, item) ((qt_mpool_cache_t *)((uint8_t *)(item) + (pool)->paging.link_offset))
+#define QT_MPOOL_ITEM(pool, link) ((void *)((uint8_t *)(link) - (pool)->paging.link_offset))
+
+/* the owner of a paged item may have made some of its pages inaccessible */
+#define QT_MPOOL_ALLOC_SCRIBBLE(pool, item) do {       \
+        if (!(pool)->paged) {                          \
+            ALLOC_SCRIBBLE((item), (pool)->item_size); \
+        }                                              \
+} while (0)
+#define QT_MPOOL_FREE_SCRIBBLE(pool, item, size) do { \
+        if (!(pool)->paged) {                         \
+            FREE_SCRIBBLE((item), (size));            \
+        }                                             \
+} while (0)
+
+/* the usual transparent huge page size, which a hugepage arena is aligned to */
+#define QT_MPOOL_HUGEPAGE ((size_t)2 << 20)
+
 struct threadlocal_cache_s {
     qt_mpool_cache_t             *cache;
     uint_fast16_t                 count;
@@ -85,6 +138,44 @@ struct threadlocal_cache_s {
     qt_mpool_threadlocal_cache_t *next;  // for cleanup
 };
 
+/* In a slab pool, every worker carves its own blocks and every item
+ * remembers which worker it was handed to, in a tag at the very end of its
+ * slot. An item freed by its owner goes back on the owner's private cache;
+ * one freed by anybody else is pushed onto the owner's remote list, which the
+ * owner takes over wholesale the next time its cache runs dry. Neither path
+ * takes a lock.
+ *
+ * Blocks are bound to the memory of the carving worker's shepherd (or left to
+ * first touch, where the affinity layer cannot bind), and the overflow from a
+ * worker's cache goes to a reuse list shared only with the other workers of
+ * the same shepherd. An item therefore never leaves the shepherd whose
+ * memory it was carved from. */
+typedef uint32_t qt_mpool_owner_t;
+#define QT_MPOOL_NO_OWNER ((size_t)UINT32_MAX)
+
+typedef struct {
+    qt_mpool_threadlocal_cache_t local;
+    qthread_shepherd_id_t        home;      /* whose memory this slab carves */
+    qt_mpool_reuse_t            *reuse;     /* &pool->homes[home].r */
+    /* for the locality report */
+    size_t                       nallocs;
+    size_t                       nremote;   /* landed on another node */
+    size_t                       nunknown;  /* the OS would not say */
+    size_t                       nstrays;   /* freed here, owned by another shepherd */
+} qt_mpool_slab_owned_t;
+
+struct worker_slab_s {
+    qt_mpool_slab_owned_t        owned;   /* only touched by the owner */
+    uint8_t                      pad1[CACHELINE_WIDTH - (sizeof(qt_mpool_slab_owned_t) % CACHELINE_WIDTH)];
+    qt_mpool_cache_t *volatile   remote;  /* pushed onto by everybody else */
+    uint8_t                      pad2[CACHELINE_WIDTH - sizeof(void *)];
+};
+
+struct shep_reuse_s {
+    qt_mpool_reuse_t r;
+    uint8_t          pad[CACHELINE_WIDTH - (sizeof(qt_mpool_reuse_t) % CACHELINE_WIDTH)];
+};
+
 #ifdef TLS
 static void qt_mpool_subsystem_shutdown(void)
 {
@@ -102,6 +193,7 @@ static void qt_mpool_subsystem_shutdown(void)
 
 void INTERNAL qt_mpool_subsystem_init(void)
 {
+    locality_report = qt_internal_get_env_bool("LOCALITY_REPORT", 0);
 #ifdef TLS
     assert(TLS_GET(pool_caches) == NULL);
     assert(TLS_GET(pool_cache_count) == 0);
@@ -127,11 +219,82 @@ static QINLINE void qt_mpool_internal_aligned_free(void  *freeme,
     qt_internal_aligned_free(freeme, alignment);
 }                                      /*}}} */
 
+#ifdef HAVE_SYS_MMAN_H
+# ifndef MAP_ANONYMOUS
+#  define MAP_ANONYMOUS MAP_ANON
+# endif
+# ifndef MAP_NORESERVE
+#  define MAP_NORESERVE 0
+# endif
+/* address space that gets memory only as it is touched */
+static void *qt_mpool_internal_map(size_t size,
+                                   int    hugepages)
+{                                      /*{{{ */
+    void *ret = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (ret == MAP_FAILED) {
+        return NULL;
+    }
+# ifdef MADV_HUGEPAGE
+    if (hugepages) {
+        (void)madvise(ret, size, MADV_HUGEPAGE);
+    }
+# endif
+    return ret;
+}                                      /*}}} */
+#endif /* ifdef HAVE_SYS_MMAN_H */
+
+/* A paged pool carves its blocks out of its arena for as long as that
+ * lasts, and maps each one separately after that. */
+static void *qt_mpool_internal_block_alloc(qt_mpool pool)
+{                                      /*{{{ */
+#ifdef HAVE_SYS_MMAN_H
+    if (pool->paged) {
+        void *ret = NULL;
+
+        if (pool->arena) {
+            const size_t off = qthread_incr(&pool->arena_used, pool->alloc_size);
+
+            if (off + pool->alloc_size <= pool->arena_size) {
+                ret = pool->arena + off;
+            }
+        }
+        if (ret == NULL) {
+            ret = qt_mpool_internal_map(pool->alloc_size, pool->paging.hugepages);
+        }
+        VALGRIND_MAKE_MEM_NOACCESS(ret, pool->alloc_size);
+        return ret;
+    }
+#endif
+    return qt_mpool_internal_aligned_alloc(pool->alloc_size,
+                                           pool->block_alignment);
+}                                      /*}}} */
+
+static void qt_mpool_internal_block_free(qt_mpool pool,
+                                         void    *block)
+{                                      /*{{{ */
+#ifdef HAVE_SYS_MMAN_H
+    if (pool->paged) {
+        const uint8_t *b = block;
+
+        /* the arena goes all at once */
+        if ((pool->arena == NULL) || (b < pool->arena) ||
+            (b >= pool->arena + pool->arena_size)) {
+            munmap(block, pool->alloc_size);
+        }
+        return;
+    }
+#endif
+    qt_mpool_internal_aligned_free(block, pool->block_alignment);
+}                                      /*}}} */
+
 // sync means lock-protected
 // item_size is how many bytes to return
 // ...memory is always allocated in multiples of getpagesize()
-qt_mpool INTERNAL qt_mpool_create_aligned(size_t item_size,
-                                          size_t alignment)
+static qt_mpool qt_mpool_internal_create(size_t      item_size,
+                                         size_t      alignment,
+                                         const char *slab_name)
 {                                      /*{{{ */
     qt_mpool pool = (qt_mpool)MALLOC(sizeof(struct qt_mpool_s));
 
@@ -153,6 +316,9 @@ qt_mpool INTERNAL qt_mpool_create_aligned(size_t item_size,
     if (item_size < sizeof(qt_mpool_cache_t)) {
         item_size = sizeof(qt_mpool_cache_t);
     }
+    if (slab_name) {
+        item_size += sizeof(qt_mpool_owner_t);
+    }
     if (item_size % sizeof(void *)) {
         item_size += (sizeof(void *)) - (item_size % sizeof(void *));
     }
@@ -202,8 +368,8 @@ qt_mpool INTERNAL qt_mpool_create_aligned(size_t item_size,
     }
     pool->alloc_size      = alloc_size;
     pool->items_per_alloc = alloc_size / item_size;
-    pool->reuse_pool      = NULL;
-    QTHREAD_FASTLOCK_INIT(pool->reuse_lock);
+    pool->reuse.list      = NULL;
+    QTHREAD_FASTLOCK_INIT(pool->reuse.lock);
     QTHREAD_FASTLOCK_INIT(pool->pool_lock);
 #ifdef TLS
     pool->offset = qthread_incr(&pool_cache_global_max, 1);
@@ -217,7 +383,46 @@ qt_mpool INTERNAL qt_mpool_create_aligned(size_t item_size,
     memset(pool->alloc_list, 0, pagesize);
     pool->alloc_list_pos = 0;
 
-    pool->caches = NULL;
+    pool->caches          = NULL;
+    pool->slabs           = NULL;
+    pool->nslabs          = 0;
+    pool->homes           = NULL;
+    pool->slabs_per_home  = 0;
+    pool->name            = slab_name;
+    pool->block_alignment = alignment;
+    pool->paged           = 0;
+    memset(&pool->paging, 0, sizeof(qt_mpool_paging_t));
+    pool->arena           = NULL;
+    pool->arena_size      = 0;
+    pool->arena_map       = NULL;
+    pool->arena_map_size  = 0;
+    pool->arena_used      = 0;
+    if (slab_name) {
+        const size_t nsheps = qthread_readstate(TOTAL_SHEPHERDS);
+
+        pool->nslabs = qthread_readstate(TOTAL_WORKERS);
+        pool->slabs  = qt_internal_aligned_alloc(pool->nslabs * sizeof(qt_mpool_worker_slab_t),
+                                                 CACHELINE_WIDTH);
+        qassert_goto((pool->slabs != NULL), errexit);
+        memset(pool->slabs, 0, pool->nslabs * sizeof(qt_mpool_worker_slab_t));
+        /* unique worker IDs are packed shepherd-major */
+        pool->slabs_per_home = pool->nslabs / nsheps;
+        pool->homes          = qt_internal_aligned_alloc(nsheps * sizeof(qt_mpool_shep_reuse_t),
+                                                         CACHELINE_WIDTH);
+        qassert_goto((pool->homes != NULL), errexit);
+        for (size_t i = 0; i < nsheps; ++i) {
+            pool->homes[i].r.list = NULL;
+            QTHREAD_FASTLOCK_INIT(pool->homes[i].r.lock);
+        }
+        for (size_t w = 0; w < pool->nslabs; ++w) {
+            pool->slabs[w].owned.home  = (qthread_shepherd_id_t)(w / pool->slabs_per_home);
+            pool->slabs[w].owned.reuse = &pool->homes[pool->slabs[w].owned.home].r;
+        }
+        /* blocks get bound to a shepherd's memory, which works in pages */
+        if (pool->block_alignment < pagesize) {
+            pool->block_alignment = pagesize;
+        }
+    }
     return pool;
 
     qgoto(errexit);
@@ -227,6 +432,72 @@ qt_mpool INTERNAL qt_mpool_create_aligned(size_t item_size,
     return NULL;
 }                                      /*}}} */
 
+qt_mpool INTERNAL qt_mpool_create_aligned(size_t item_size,
+                                          size_t alignment)
+{                                      /*{{{ */
+    return qt_mpool_internal_create(item_size, alignment, NULL);
+}                                      /*}}} */
+
+/* Like qt_mpool_create_aligned(), but with per-worker slabs and remote-free
+ * lists; for pools whose items are routinely freed on another worker than
+ * the one that allocated them (tasks, stacks). Must be created after the
+ * number of workers is known. The name is only used by the locality report. */
+qt_mpool INTERNAL qt_mpool_create_slab(size_t      item_size,
+                                       size_t      alignment,
+                                       const char *name)
+{                                      /*{{{ */
+    assert(name);
+    return qt_mpool_internal_create(item_size, alignment, name);
+}                                      /*}}} */
+
+/* A slab pool of items that the caller may partly protect or discard the
+ * pages of, such as stacks (with alignment as big as pagesize if there are
+ * guard pages). Blocks are mapped rather than malloc()ed, and
+ * come out of a single reserved arena when paging->arena_size is non-zero.
+ * Since the start of an item may be a guard page, a free item is linked
+ * through paging->link_offset instead. Each item is passed to
+ * paging->prepare the first time it is carved from a block (and never again,
+ * so whatever that sets up survives reuse), and to paging->trim whenever a
+ * worker's cache overflows to its shepherd's reuse list; trim must leave the
+ * links and the end of the item alone. */
+qt_mpool INTERNAL qt_mpool_create_paged(size_t                   item_size,
+                                        size_t                   alignment,
+                                        const char              *name,
+                                        const qt_mpool_paging_t *paging)
+{                                      /*{{{ */
+    qt_mpool pool;
+
+    assert(name);
+    assert(paging);
+    pool = qt_mpool_internal_create(item_size, alignment, name);
+    qassert_ret((pool != NULL), NULL);
+    assert(paging->link_offset + sizeof(qt_mpool_cache_t) <=
+           pool->item_size - sizeof(qt_mpool_owner_t));
+    pool->paged  = 1;
+    pool->paging = *paging;
+#ifdef HAVE_SYS_MMAN_H
+    if (paging->arena_size >= pool->alloc_size) {
+        const size_t align = paging->hugepages ? QT_MPOOL_HUGEPAGE : pagesize;
+        const size_t size  = paging->arena_size - (paging->arena_size % pool->alloc_size);
+
+        pool->arena_map_size = size + align - pagesize;
+        pool->arena_map      = qt_mpool_internal_map(pool->arena_map_size,
+                                                     paging->hugepages);
+        if (pool->arena_map) {
+            uintptr_t base = (uintptr_t)pool->arena_map;
+
+            base            += (align - (base % align)) % align;
+            pool->arena      = (uint8_t *)base;
+            pool->arena_size = size;
+        } else {
+            qthread_debug(MPOOL_BEHAVIOR, "could not reserve a %lu-byte arena for the %s pool\n",
+                          (unsigned long)size, name);
+        }
+    }
+#endif
+    return pool;
+}                                      /*}}} */
+
 static qt_mpool_threadlocal_cache_t *qt_mpool_internal_getcache(qt_mpool pool)
 {
     qt_mpool_threadlocal_cache_t *tc;
@@ -311,30 +582,33 @@ static qt_mpool_threadlocal_cache_t *qt_mpool_internal_getcache(qt_mpool pool)
     return tc;
 }
 
-void INTERNAL *qt_mpool_alloc(qt_mpool pool)
+/* reuse is where full chunks of freed items are traded; home is the shepherd
+ * whose memory new blocks should come from, or NO_SHEPHERD */
+static void *qt_mpool_internal_alloc(qt_mpool                      pool,
+                                     qt_mpool_threadlocal_cache_t *tc,
+                                     qt_mpool_reuse_t             *reuse,
+                                     qthread_shepherd_id_t         home)
 {   /*{{{*/
-    qt_mpool_threadlocal_cache_t *tc;
-    size_t                        cnt;
-
-    qthread_debug(MPOOL_CALLS, "pool:%p\n", pool);
-    qassert_ret((pool != NULL), NULL);
+    size_t cnt;
 
-    tc = qt_mpool_internal_getcache(pool);
     qthread_debug(MPOOL_BEHAVIOR, "->tc:%p cache:%p (bt:%p) cnt:%u\n", tc, tc->cache, tc->cache ? tc->cache->block_tail : NULL, (unsigned int)tc->count);
     if (tc->cache) {
         qt_mpool_cache_t *cache = tc->cache;
         qthread_debug(MPOOL_DETAILS, "->...cached count:%zu\n", (size_t)tc->count - 1);
         tc->cache = cache->next;
         --tc->count;
-        ALLOC_SCRIBBLE(cache, pool->item_size);
-        return cache;
+        QT_MPOOL_ALLOC_SCRIBBLE(pool, QT_MPOOL_ITEM(pool, cache));
+        return QT_MPOOL_ITEM(pool, cache);
     } else if (tc->block) {
         void *ret = &(tc->block[tc->i * pool->item_size]);
         qthread_debug(MPOOL_DETAILS, "->...block count:%zu\n", (size_t)tc->i);
         if (++tc->i == pool->items_per_alloc) {
             tc->block = NULL;
         }
-        ALLOC_SCRIBBLE(ret, pool->item_size);
+        if (pool->paging.prepare) {
+            pool->paging.prepare(ret);
+        }
+        QT_MPOOL_ALLOC_SCRIBBLE(pool, ret);
         return ret;
     } else {
         const size_t      items_per_alloc = pool->items_per_alloc;
@@ -342,16 +616,16 @@ void INTERNAL *qt_mpool_alloc(qt_mpool pool)
 
         cnt = 0;
         /* cache is empty; need to fill it */
-        if (pool->reuse_pool) { // global cache
+        if (reuse->list) { // global (or per-shepherd) cache
             qthread_debug(MPOOL_BEHAVIOR, "->...pull from reuse\n");
-            QTHREAD_FASTLOCK_LOCK(&pool->reuse_lock);
-            if (pool->reuse_pool) {
-                cache                   = pool->reuse_pool;
-                pool->reuse_pool        = cache->block_tail->next;
+            QTHREAD_FASTLOCK_LOCK(&reuse->lock);
+            if (reuse->list) {
+                cache                   = reuse->list;
+                reuse->list             = cache->block_tail->next;
                 cache->block_tail->next = NULL;
                 cnt                     = items_per_alloc;
             }
-            QTHREAD_FASTLOCK_UNLOCK(&pool->reuse_lock);
+            QTHREAD_FASTLOCK_UNLOCK(&reuse->lock);
         }
         if (NULL == cache) {
             uint8_t *p;
@@ -359,11 +633,13 @@ void INTERNAL *qt_mpool_alloc(qt_mpool pool)
 
             /* need to allocate a new block and record that I did so in the central pool */
             qthread_debug(MPOOL_BEHAVIOR, "->...allocating new block\n");
-            p = qt_mpool_internal_aligned_alloc(pool->alloc_size,
-                                                pool->alignment);
+            p = qt_mpool_internal_block_alloc(pool);
             qassert_ret((p != NULL), NULL);
             assert(pool->alignment == 0 ||
                    (((uintptr_t)p) & (pool->alignment - 1)) == 0);
+            if (home != NO_SHEPHERD) {
+                qt_affinity_mem_toshep(p, pool->alloc_size, home);
+            }
             QTHREAD_FASTLOCK_LOCK(&pool->pool_lock);
             if (pool->alloc_list_pos == (pagesize / sizeof(void *) - 1)) {
                 void **tmp = qt_internal_aligned_alloc(pagesize, pagesize);
@@ -379,7 +655,10 @@ void INTERNAL *qt_mpool_alloc(qt_mpool pool)
             /* store the block for later allocation */
             tc->block = p;
             tc->i     = 1;
-            ALLOC_SCRIBBLE(p, pool->item_size);
+            if (pool->paging.prepare) {
+                pool->paging.prepare(p);
+            }
+            QT_MPOOL_ALLOC_SCRIBBLE(pool, p);
             return p;
         } else {
             qthread_debug(MPOOL_BEHAVIOR, "->...from_global_pool count:%zu\n", (size_t)(cnt - 1));
@@ -387,26 +666,22 @@ void INTERNAL *qt_mpool_alloc(qt_mpool pool)
             tc->count = cnt - 1;
             // cache->next       = NULL; // unnecessary
             // cache->block_tail = NULL; // unnecessary
-            ALLOC_SCRIBBLE(cache, pool->item_size);
-            return cache;
+            QT_MPOOL_ALLOC_SCRIBBLE(pool, QT_MPOOL_ITEM(pool, cache));
+            return QT_MPOOL_ITEM(pool, cache);
         }
     }
 } /*}}}*/
 
-void INTERNAL qt_mpool_free(qt_mpool pool,
-                            void    *mem)
+static void qt_mpool_internal_free(qt_mpool                      pool,
+                                   qt_mpool_threadlocal_cache_t *tc,
+                                   qt_mpool_reuse_t             *reuse,
+                                   void                         *mem)
 {   /*{{{*/
-    qt_mpool_threadlocal_cache_t *tc;
-    qt_mpool_cache_t             *cache = NULL;
-    qt_mpool_cache_t             *n     = (qt_mpool_cache_t *)mem;
-    size_t                        cnt;
-    const size_t                  items_per_alloc = pool->items_per_alloc;
+    qt_mpool_cache_t *cache = NULL;
+    qt_mpool_cache_t *n     = QT_MPOOL_LINK(pool, mem);
+    size_t            cnt;
+    const size_t      items_per_alloc = pool->items_per_alloc;
 
-    qthread_debug(MPOOL_CALLS, "pool=%p mem=%p\n", pool, mem);
-    qassert_retvoid((mem != NULL));
-    qassert_retvoid((pool != NULL));
-    FREE_SCRIBBLE(mem, pool->item_size);
-    tc    = qt_mpool_internal_getcache(pool);
     cache = tc->cache;
     cnt   = tc->count;
     qthread_debug(MPOOL_DETAILS, "->cache:%p (bt:%p) cnt:%u\n", cache, cache ? cache->block_tail : NULL, (unsigned int)cnt);
@@ -430,10 +705,21 @@ void INTERNAL qt_mpool_free(qt_mpool pool,
         n->block_tail->next = NULL;
         assert(toglobal);
         assert(toglobal->block_tail);
-        QTHREAD_FASTLOCK_LOCK(&pool->reuse_lock);
-        toglobal->block_tail->next = pool->reuse_pool;
-        pool->reuse_pool           = toglobal;
-        QTHREAD_FASTLOCK_UNLOCK(&pool->reuse_lock);
+        if (pool->paging.trim && reuse->list) {
+            /* these are the coldest items this worker has, and its shepherd
+             * already has items to spare */
+            qt_mpool_cache_t *c = toglobal;
+
+            while (1) {
+                pool->paging.trim(QT_MPOOL_ITEM(pool, c));
+                if (c == toglobal->block_tail) { break; }
+                c = c->next;
+            }
+        }
+        QTHREAD_FASTLOCK_LOCK(&reuse->lock);
+        toglobal->block_tail->next = reuse->list;
+        reuse->list                = toglobal;
+        QTHREAD_FASTLOCK_UNLOCK(&reuse->lock);
         cnt -= items_per_alloc;
     } else if (cnt == items_per_alloc + 1) {
         qthread_debug(MPOOL_BEHAVIOR, "->chop_block\n");
@@ -442,21 +728,158 @@ void INTERNAL qt_mpool_free(qt_mpool pool,
     tc->cache = n;
     tc->count = cnt;
     qthread_debug(MPOOL_DETAILS, "->free count = %zu\n", (size_t)cnt);
+} /*}}}*/
+
+static QINLINE qt_mpool_owner_t *qt_mpool_internal_owner(qt_mpool pool,
+                                                         void    *mem)
+{   /*{{{*/
+    return (qt_mpool_owner_t *)((uint8_t *)mem + pool->item_size - sizeof(qt_mpool_owner_t));
+} /*}}}*/
+
+static QINLINE size_t qt_mpool_internal_slab_id(qt_mpool pool)
+{   /*{{{*/
+    size_t w = qthread_readstate(CURRENT_UNIQUE_WORKER);
+
+    return (w < pool->nslabs) ? w : QT_MPOOL_NO_OWNER;
+} /*}}}*/
+
+/* take everything other workers have returned to this slab */
+static void qt_mpool_internal_drain(qt_mpool                pool,
+                                    qt_mpool_worker_slab_t *slab)
+{   /*{{{*/
+    qt_mpool_cache_t *n = qt_internal_atomic_swap_ptr((void **)&slab->remote, NULL);
+
+    qthread_debug(MPOOL_BEHAVIOR, "->draining remote frees (%p)\n", n);
+    while (n) {
+        qt_mpool_cache_t *next = n->next;
+        qt_mpool_internal_free(pool, &slab->owned.local, slab->owned.reuse,
+                               QT_MPOOL_ITEM(pool, n));
+        n = next;
+    }
+} /*}}}*/
+
+static void qt_mpool_internal_count(qt_mpool                pool,
+                                    qt_mpool_worker_slab_t *slab,
+                                    void                   *mem)
+{   /*{{{*/
+    /* ask about the tag, because it has certainly been touched by now */
+    switch (qt_affinity_mem_islocal(qt_mpool_internal_owner(pool, mem), slab->owned.home)) {
+        case 0:  slab->owned.nremote++; break;
+        case -1: slab->owned.nunknown++; break;
+    }
+    slab->owned.nallocs++;
+} /*}}}*/
+
+void INTERNAL *qt_mpool_alloc(qt_mpool pool)
+{   /*{{{*/
+    qthread_debug(MPOOL_CALLS, "pool:%p\n", pool);
+    qassert_ret((pool != NULL), NULL);
+
+    if (pool->slabs) {
+        const size_t w = qt_mpool_internal_slab_id(pool);
+        void        *ret;
+
+        if (w != QT_MPOOL_NO_OWNER) {
+            qt_mpool_worker_slab_t *slab = &pool->slabs[w];
+            if ((slab->owned.local.cache == NULL) && (slab->remote != NULL)) {
+                qt_mpool_internal_drain(pool, slab);
+            }
+            ret = qt_mpool_internal_alloc(pool, &slab->owned.local,
+                                          slab->owned.reuse, slab->owned.home);
+            if (ret) {
+                *qt_mpool_internal_owner(pool, ret) = (qt_mpool_owner_t)w;
+                if (QTHREAD_UNLIKELY(locality_report)) {
+                    qt_mpool_internal_count(pool, slab, ret);
+                }
+            }
+        } else {
+            ret = qt_mpool_internal_alloc(pool, qt_mpool_internal_getcache(pool),
+                                          &pool->reuse, NO_SHEPHERD);
+            if (ret) {
+                *qt_mpool_internal_owner(pool, ret) = (qt_mpool_owner_t)w;
+            }
+        }
+        return ret;
+    }
+    return qt_mpool_internal_alloc(pool, qt_mpool_internal_getcache(pool),
+                                   &pool->reuse, NO_SHEPHERD);
+} /*}}}*/
+
+void INTERNAL qt_mpool_free(qt_mpool pool,
+                            void    *mem)
+{   /*{{{*/
+    qthread_debug(MPOOL_CALLS, "pool=%p mem=%p\n", pool, mem);
+    qassert_retvoid((mem != NULL));
+    qassert_retvoid((pool != NULL));
+    if (pool->slabs) {
+        const size_t owner = *qt_mpool_internal_owner(pool, mem);
+        const size_t w     = qt_mpool_internal_slab_id(pool);
+
+        QT_MPOOL_FREE_SCRIBBLE(pool, mem, pool->item_size - sizeof(qt_mpool_owner_t));
+        if (owner == w) {
+            qt_mpool_internal_free(pool, &pool->slabs[w].owned.local,
+                                   pool->slabs[w].owned.reuse, mem);
+        } else if (owner == QT_MPOOL_NO_OWNER) {
+            /* came from a non-worker's cache, which is not tied to any
+             * shepherd; keep it that way */
+            qt_mpool_internal_free(pool, qt_mpool_internal_getcache(pool),
+                                   &pool->reuse, mem);
+        } else {
+            qt_mpool_worker_slab_t *slab = &pool->slabs[owner];
+            qt_mpool_cache_t       *n    = QT_MPOOL_LINK(pool, mem);
+            qt_mpool_cache_t       *head;
+
+            assert(owner < pool->nslabs);
+            qthread_debug(MPOOL_BEHAVIOR, "->remote free to slab %u\n", (unsigned)owner);
+            if (QTHREAD_UNLIKELY(locality_report) && (w != QT_MPOOL_NO_OWNER) &&
+                (pool->slabs[w].owned.home != slab->owned.home)) {
+                pool->slabs[w].owned.nstrays++;
+            }
+            do {
+                head    = slab->remote;
+                n->next = head;
+            } while (qthread_cas_ptr(&slab->remote, head, n) != head);
+        }
+    } else {
+        FREE_SCRIBBLE(mem, pool->item_size);
+        qt_mpool_internal_free(pool, qt_mpool_internal_getcache(pool),
+                               &pool->reuse, mem);
+    }
     VALGRIND_MEMPOOL_FREE(pool, mem);
 } /*}}}*/
 
+static void qt_mpool_internal_report(qt_mpool pool)
+{   /*{{{*/
+    size_t nallocs = 0, nremote = 0, nunknown = 0, nstrays = 0;
+
+    for (size_t w = 0; w < pool->nslabs; ++w) {
+        nallocs  += pool->slabs[w].owned.nallocs;
+        nremote  += pool->slabs[w].owned.nremote;
+        nunknown += pool->slabs[w].owned.nunknown;
+        nstrays  += pool->slabs[w].owned.nstrays;
+    }
+    print_status("%s pool: %lu allocations by workers: %lu local, %lu remote, %lu unknown; "
+                 "%lu freed on another shepherd\n",
+                 pool->name, (unsigned long)nallocs,
+                 (unsigned long)(nallocs - nremote - nunknown),
+                 (unsigned long)nremote, (unsigned long)nunknown,
+                 (unsigned long)nstrays);
+} /*}}}*/
+
 void INTERNAL qt_mpool_destroy(qt_mpool pool)
 {                                      /*{{{ */
     qthread_debug(MPOOL_CALLS, "pool:%p\n", pool);
     qassert_retvoid((pool != NULL));
+    if (pool->slabs && locality_report) {
+        qt_mpool_internal_report(pool);
+    }
     while (pool->alloc_list) {
         unsigned int i = 0;
 
         void *p = pool->alloc_list[0];
 
         while (p && i < (pagesize / sizeof(void *) - 1)) {
-            qt_mpool_internal_aligned_free(p,
-                                           pool->alignment);
+            qt_mpool_internal_block_free(pool, p);
             i++;
             p = pool->alloc_list[i];
         }
@@ -465,6 +888,11 @@ void INTERNAL qt_mpool_destroy(qt_mpool pool)
         FREE_SCRIBBLE(p, pagesize);
         qt_internal_aligned_free(p, pagesize);
     }
+#ifdef HAVE_SYS_MMAN_H
+    if (pool->arena_map) {
+        munmap(pool->arena_map, pool->arena_map_size);
+    }
+#endif
     qthread_debug(MPOOL_DETAILS, "begin free TLS caches\n");
     while (pool->caches) {
         qt_mpool_threadlocal_cache_t *freeme = pool->caches;
@@ -472,11 +900,18 @@ void INTERNAL qt_mpool_destroy(qt_mpool pool)
         qt_internal_aligned_free(freeme, CACHELINE_WIDTH);
     }
     qthread_debug(MPOOL_DETAILS, "done freeing TLS caches\n");
+    if (pool->slabs) {
+        qt_internal_aligned_free(pool->slabs, CACHELINE_WIDTH);
+        for (size_t i = 0; i < pool->nslabs / pool->slabs_per_home; ++i) {
+            QTHREAD_FASTLOCK_DESTROY(pool->homes[i].r.lock);
+        }
+        qt_internal_aligned_free(pool->homes, CACHELINE_WIDTH);
+    }
 #ifndef TLS
     pthread_key_delete(pool->threadlocal_cache);
 #endif
     QTHREAD_FASTLOCK_DESTROY(pool->pool_lock);
-    QTHREAD_FASTLOCK_DESTROY(pool->reuse_lock);
+    QTHREAD_FASTLOCK_DESTROY(pool->reuse.lock);
     VALGRIND_DESTROY_MEMPOOL(pool);
     FREE(pool, sizeof(struct qt_mpool_s));
 }                                      /*}}} */
@@ -4,6 +4,7 @@
 
 /* System Headers */
 #include <stdlib.h>
+#include <string.h>                    /* for memcpy() */
 
 /* Installed Headers */
 #include <qthread/qthread.h>
@@ -20,6 +21,7 @@
 #include "qt_debug.h"
 #include "qt_alloc.h"
 #include "qt_barrier.h"
+#include "qt_int_ceil.h"
 
 
 
@@ -517,19 +519,30 @@ void API_FUNC qt_loop_balance_sinc(const size_t    start,
     qt_loop_balance_inner(start, stop, func, argptr, 0, SINC_T);
 }                                      /*}}} */
 
+/* Each worker's result goes in a cache line (or lines) of its own, and the
+ * results are combined along the same binomial tree that the workers were
+ * spawned along: once a worker is done with its own iterations, it folds in
+ * the result of each of its children's subtrees, smallest first, and only
+ * then reports itself done to its parent. The caller thus waits for worker 0
+ * alone, which has by then accumulated everything into out, and no worker
+ * ever waits on more than log2(workers) others. (The SINC_T flavor leaves all
+ * of this to the sinc, which keeps its own per-worker values.) */
 struct qloopaccum_wrapper_args {
     qt_loopr_f     func;
+    qt_accum_f     acc;
     size_t         startat, stopat, id, level, spawnthreads;
     void *restrict arg;
     void *restrict ret;
     synctype_t     sync_type;
     void          *sync;
+    aligned_t      done; /* for DONECOUNT: this worker's subtree is finished */
 };
 
 static aligned_t qloopaccum_wrapper(struct qloopaccum_wrapper_args *const restrict arg)
 {                                      /*{{{ */
     /* tree-based spawning (credit: AKP) */
     size_t           tot_workers = arg->spawnthreads - 1; // -1 because I already exist
+    const size_t     first_level = arg->level;
     size_t           level       = arg->level;
     size_t           my_id       = arg->id;
     size_t           new_id      = my_id + (1 << level);
@@ -580,8 +593,25 @@ static aligned_t qloopaccum_wrapper(struct qloopaccum_wrapper_args *const restri
         case SINC_T:
             qt_sinc_submit(arg->sync, arg->ret);
             break;
+        case SYNCVAR_T:
+            /* my children are my_id + 2^l, for every level l I spawned at */
+            for (size_t l = first_level; l < level; ++l) {
+                const size_t child = my_id + ((size_t)1 << l);
+
+                qthread_syncvar_readFF(NULL, (syncvar_t *)sync + child);
+                arg->acc(arg->ret, (arg + (child - my_id))->ret);
+            }
+            break;
         case DONECOUNT:
-            qthread_incr((aligned_t *)arg->sync, 1);
+            for (size_t l = first_level; l < level; ++l) {
+                const size_t child = my_id + ((size_t)1 << l);
+
+                while ((arg + (child - my_id))->done == 0) {
+                    qthread_yield();
+                }
+                arg->acc(arg->ret, (arg + (child - my_id))->ret);
+            }
+            qthread_incr(&arg->done, 1);
             break;
     }
     return 0;
@@ -597,25 +627,28 @@ static QINLINE void qt_loopaccum_balance_inner(const size_t       start,
                                                const uint_fast8_t flags,
                                                synctype_t         sync_type)
 {                                      /*{{{ */
-    const qthread_shepherd_id_t           maxworkers  = qthread_num_workers();
+    const qthread_shepherd_id_t           maxworkers  = ((stop - start) > qthread_num_workers()) ? qthread_num_workers() : (stop - start);
     struct qloopaccum_wrapper_args *const qwa         = (struct qloopaccum_wrapper_args *)MALLOC(sizeof(struct qloopaccum_wrapper_args) * maxworkers);
+    const size_t                          stride      = QT_CEIL_RATIO(size, CACHELINE_WIDTH) * CACHELINE_WIDTH;
     uint8_t                              *realrets    = NULL;
-    const size_t                          each        = (stop - start) / maxworkers;
+    const size_t                          each        = (maxworkers > 0) ? (stop - start) / maxworkers : 0;
     size_t                                extra       = (stop - start) - (each * maxworkers);
     size_t                                iterend     = start;
     unsigned                              spawn_flags = 0;
 
-    assert(qwa);
     assert(func);
     assert(acc);
     assert(qthread_library_initialized);
+    if (maxworkers == 0) {
+        return;
+    }
+    assert(qwa);
 
     union {
         void      *ptr;
         syncvar_t *syncvar;
         aligned_t *aligned;
         qt_sinc_t *sinc;
-        aligned_t  dc;
     } Q_ALIGNED(QTHREAD_ALIGNMENT_ALIGNED_T) sync = { NULL };
     switch (sync_type) {
         case SYNCVAR_T:
@@ -640,16 +673,18 @@ static QINLINE void qt_loopaccum_balance_inner(const size_t       start,
     }
 
     if (maxworkers > 1) {
-        realrets = (uint8_t *)MALLOC(size * (maxworkers - 1));
+        /* worker 0 accumulates straight into out */
+        realrets = qt_internal_aligned_alloc(stride * (maxworkers - 1), CACHELINE_WIDTH);
         assert(realrets);
     }
     for (qthread_shepherd_id_t i = 0; i < maxworkers; i++) {
         qwa[i].func = func;
+        qwa[i].acc  = acc;
         qwa[i].arg  = argptr;
         if (i == 0) {
             qwa[0].ret = out;
         } else {
-            qwa[i].ret = realrets + ((i - 1) * size);
+            qwa[i].ret = realrets + ((i - 1) * stride);
         }
         qwa[i].startat      = iterend;
         qwa[i].stopat       = iterend + each;
@@ -657,6 +692,7 @@ static QINLINE void qt_loopaccum_balance_inner(const size_t       start,
         qwa[i].level        = 0;
         qwa[i].spawnthreads = maxworkers;
         qwa[i].sync_type    = sync_type;
+        qwa[i].done         = 0;
         switch (sync_type) {
             case SYNCVAR_T:
                 sync.syncvar[i] = SYNCVAR_EMPTY_INITIALIZER;
@@ -666,7 +702,7 @@ static QINLINE void qt_loopaccum_balance_inner(const size_t       start,
                 qwa[i].sync = sync.sinc;
                 break;
             case DONECOUNT:
-                qwa[i].sync = &sync.dc;
+                qwa[i].sync = NULL;
                 break;
             case ALIGNED:
             case NO_SYNC:
@@ -697,14 +733,10 @@ static QINLINE void qt_loopaccum_balance_inner(const size_t       start,
                                   spawn_flags), QTHREAD_SUCCESS);
             break;
     }
+    /* worker 0 is done only once everybody else's results are in out */
     switch (sync_type) {
         case SYNCVAR_T:
-            for (qthread_shepherd_id_t i = 0; i < maxworkers; i++) {
-                qthread_syncvar_readFF(NULL, sync.syncvar + i);
-                if (i > 0) {
-                    acc(out, realrets + ((i - 1) * size));
-                }
-            }
+            qthread_syncvar_readFF(NULL, sync.syncvar);
             FREE(sync.syncvar, maxworkers * sizeof(syncvar_t));
             break;
         case SINC_T:
@@ -712,22 +744,16 @@ static QINLINE void qt_loopaccum_balance_inner(const size_t       start,
             qt_sinc_destroy(sync.sinc);
             break;
         case DONECOUNT:
-            while (sync.dc != maxworkers) {
+            while (qwa[0].done == 0) {
                 qthread_yield();
             }
-            for (qthread_shepherd_id_t i = 0; i < maxworkers; i++) {
-                if (i > 0) {
-                    acc(out, realrets + ((i - 1) * size));
-                }
-            }
-            qt_internal_aligned_free(sync.aligned, QTHREAD_ALIGNMENT_ALIGNED_T);
             break;
         case ALIGNED:
         case NO_SYNC:
             abort();
     }
     if (realrets) {
-        FREE(realrets, size * (maxworkers - 1));
+        qt_internal_aligned_free(realrets, CACHELINE_WIDTH);
     }
     FREE(qwa, sizeof(struct qloopaccum_wrapper_args) * maxworkers);
 }                                      /*}}} */
@@ -776,6 +802,169 @@ void API_FUNC qt_loopaccum_balance_dc(const size_t     start,
     qt_loopaccum_balance_inner(start, stop, size, out, func, argptr, acc, 0, DONECOUNT);
 }                                      /*}}} */
 
+/* Lazy binary splitting. Rather than cutting the range up front (like
+ * qt_loop_balance()) or handing it out through a shared counter (like
+ * qt_loop_queue_run()), every task works through its own range a grain at a
+ * time, and before each grain, if its shepherd's ready queue has run dry
+ * (which is when thieves start coming up empty), gives the upper half of what
+ * it has left to a new task that anybody can steal. Irregular iterations
+ * thereby get balanced without any shared state beyond the completion sinc. */
+#define QLOOP_SPLIT_GRAINS 64 /* per worker; the finest a range gets cut */
+
+struct qloop_split_shared {
+    qt_loop_f  func;      /* exactly one of func and rfunc is set */
+    qt_loopr_f rfunc;
+    void      *arg;
+    size_t     grain;
+    qt_sinc_t  done;
+    /* for qt_loopaccum_split() */
+    size_t     size;
+    void      *out;
+    qt_accum_f acc;
+    int        have_out;
+    aligned_t  out_lock;
+};
+
+struct qloop_split_args {
+    struct qloop_split_shared *shared;
+    size_t                     startat, stopat;
+};
+
+static aligned_t qloop_split_wrapper(struct qloop_split_args *const restrict arg);
+
+static void qloop_split_spawn(struct qloop_split_shared *shared,
+                              const size_t               startat,
+                              const size_t               stopat)
+{   /*{{{*/
+    struct qloop_split_args a = { shared, startat, stopat };
+
+    qassert(qthread_spawn((qthread_f)qloop_split_wrapper,
+                          &a, sizeof(struct qloop_split_args),
+                          NULL,
+                          0, NULL,
+                          NO_SHEPHERD, 0), QTHREAD_SUCCESS);
+} /*}}}*/
+
+static aligned_t qloop_split_wrapper(struct qloop_split_args *const restrict arg)
+{   /*{{{*/
+    struct qloop_split_shared *const shared = arg->shared;
+    const size_t                     grain  = shared->grain;
+    uint8_t                         *ret    = NULL;
+    int                              have_ret = 0;
+    size_t                           i        = arg->startat;
+
+    if (shared->rfunc) {
+        /* this task's result, and scratch space for each further grain's */
+        ret = MALLOC(2 * shared->size);
+        assert(ret);
+    }
+    while (i < arg->stopat) {
+        size_t end;
+
+        /* BUSYNESS is one more than the length of the local ready queue */
+        if ((arg->stopat - i > 2 * grain) && (qthread_readstate(BUSYNESS) == 1)) {
+            const size_t mid = i + (arg->stopat - i) / 2;
+
+            qt_sinc_expect(&shared->done, 1);
+            qloop_split_spawn(shared, mid, arg->stopat);
+            arg->stopat = mid;
+        }
+        end = (arg->stopat - i > grain) ? (i + grain) : arg->stopat;
+        if (shared->rfunc == NULL) {
+            shared->func(i, end, shared->arg);
+        } else if (have_ret) {
+            shared->rfunc(i, end, shared->arg, ret + shared->size);
+            shared->acc(ret, ret + shared->size);
+        } else {
+            shared->rfunc(i, end, shared->arg, ret);
+            have_ret = 1;
+        }
+        i = end;
+    }
+    if (have_ret) {
+        qthread_lock(&shared->out_lock);
+        if (shared->have_out) {
+            shared->acc(shared->out, ret);
+        } else {
+            memcpy(shared->out, ret, shared->size);
+            shared->have_out = 1;
+        }
+        qthread_unlock(&shared->out_lock);
+    }
+    if (ret) {
+        FREE(ret, 2 * shared->size);
+    }
+    qt_sinc_submit(&shared->done, NULL);
+    return 0;
+} /*}}}*/
+
+static void qt_loop_split_inner(struct qloop_split_shared *shared,
+                                const size_t               start,
+                                const size_t               stop)
+{   /*{{{*/
+    const size_t workers = qthread_num_workers();
+
+    assert(qthread_library_initialized);
+    if (stop <= start) {
+        return;
+    }
+    if (workers > 1) {
+        shared->grain = (stop - start) / (workers * QLOOP_SPLIT_GRAINS);
+        if (shared->grain == 0) {
+            shared->grain = 1;
+        }
+    } else {
+        /* nobody to split for */
+        shared->grain = stop - start;
+    }
+    shared->have_out = 0;
+    shared->out_lock = 0;
+    qt_sinc_init(&shared->done, 0, NULL, NULL, 1);
+    qloop_split_spawn(shared, start, stop);
+    qt_sinc_wait(&shared->done, NULL);
+    qt_sinc_fini(&shared->done);
+} /*}}}*/
+
+void API_FUNC qt_loop_split(const size_t    start,
+                            const size_t    stop,
+                            const qt_loop_f func,
+                            void           *argptr)
+{   /*{{{*/
+    struct qloop_split_shared shared;
+
+    assert(func);
+    shared.func  = func;
+    shared.rfunc = NULL;
+    shared.arg   = argptr;
+    shared.size  = 0;
+    shared.out   = NULL;
+    shared.acc   = NULL;
+    qt_loop_split_inner(&shared, start, stop);
+} /*}}}*/
+
+void API_FUNC qt_loopaccum_split(const size_t     start,
+                                 const size_t     stop,
+                                 const size_t     size,
+                                 void *restrict   out,
+                                 const qt_loopr_f func,
+                                 void *restrict   argptr,
+                                 const qt_accum_f acc)
+{   /*{{{*/
+    struct qloop_split_shared shared;
+
+    assert(func);
+    assert(acc);
+    assert(out);
+    assert(size > 0);
+    shared.func  = NULL;
+    shared.rfunc = func;
+    shared.arg   = argptr;
+    shared.size  = size;
+    shared.out   = out;
+    shared.acc   = acc;
+    qt_loop_split_inner(&shared, start, stop);
+} /*}}}*/
+
 /* Now, the easy option for qt_loop_balance() is... effective, but has a major
  * drawback: if some iterations take longer than others, we will have a laggard
  * thread holding everyone up. Even worse, imagine if a shepherd is disabled
@@ -1211,15 +1400,31 @@ void API_FUNC qt_loop_queue_addworker(qqloop_handle_t            *loop,
         }                                                                                      \
         *(type *)ret = acc;                                                                    \
     }                                                                                          \
+    /* four independent accumulators, so that consecutive elements need not    \
+     * wait on each other's result and the compiler is free to vectorize */   \
     static void qt ## initials ## _worker(const size_t startat, const size_t stopat,           \
                                           void *restrict arg, void *restrict ret)              \
     {                                                                                          \
-        size_t i;                                                                              \
-        type   acc = ((type *)arg)[startat];                                                   \
-        for (i = startat + 1; i < stopat; i++) {                                               \
-            acc = _op_(acc, ((type *)arg)[i]);                                                 \
+        const type *restrict a = (const type *)arg;                                            \
+        size_t               i = startat + 1;                                                  \
+        type                 acc0 = a[startat];                                                \
+        if (i + 4 <= stopat) {                                                                 \
+            type acc1 = a[i], acc2 = a[i + 1], acc3 = a[i + 2];                                \
+            acc0 = _op_(acc0, a[i + 3]);                                                       \
+            for (i += 4; i + 4 <= stopat; i += 4) {                                            \
+                acc0 = _op_(acc0, a[i]);                                                       \
+                acc1 = _op_(acc1, a[i + 1]);                                                   \
+                acc2 = _op_(acc2, a[i + 2]);                                                   \
+                acc3 = _op_(acc3, a[i + 3]);                                                   \
+            }                                                                                  \
+            acc0 = _op_(acc0, acc1);                                                           \
+            acc2 = _op_(acc2, acc3);                                                           \
+            acc0 = _op_(acc0, acc2);                                                           \
         }                                                                                      \
-        *(type *)ret = acc;                                                                    \
+        for (; i < stopat; i++) {                                                              \
+            acc0 = _op_(acc0, a[i]);                                                           \
+        }                                                                                      \
+        *(type *)ret = acc0;                                                                   \
     }                                                                                          \
     static void qt ## initials ## _acc(void *restrict a, const void *restrict b)               \
     {                                                                                          \
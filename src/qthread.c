@@ -67,6 +67,7 @@
 #include "qt_threadqueue_scheduler.h"
 #include "qt_affinity.h"
 #include "qt_io.h"
+#include "qt_timers.h"
 #include "qt_debug.h"
 #include "qt_envariables.h"
 #include "qt_queue.h"
@@ -105,6 +106,7 @@
 /* Shared Globals */
 qlib_t qlib      = NULL;
 int    qaffinity = 1;
+static int direct_handoff = 1;
 QTHREAD_FASTLOCK_ATTRVAR;
 
 struct qt_cleanup_funcs_s {
@@ -154,6 +156,8 @@ static QINLINE qthread_t *qthread_thread_new(qthread_f   f,
 
 /*Make method externally available for the scheduler; to be used when agg tasks*/
 void qthread_thread_free(qthread_t *t);
+static void qthread_thread_release(qthread_t *t,
+                                   void     **spare);
 
 
 #if defined(UNPOOLED_QTHREAD_T) || defined(UNPOOLED)
@@ -221,7 +225,41 @@ static QINLINE void FREE_STACK(void *t)
 # endif /* ifdef QTHREAD_GUARD_PAGES */
 #else /* if defined(UNPOOLED_STACKS) || defined(UNPOOLED) */
 static qt_mpool generic_stack_pool = NULL;
+
+/* Stacks come from a paged pool when they have guard pages or when a stack
+ * arena was asked for. Either way, a stack item is laid out as
+ * [guard][stack][guard][rdata] with guard pages, and [stack][rdata]
+ * without; a free item keeps its pool links in the rdata. */
+static void qthread_stack_trim(void *item)
+{                      /*{{{ */
+    const uintptr_t stack = (uintptr_t)item + (GUARD_PAGES ? getpagesize() : 0);
+    const uintptr_t start = (stack + getpagesize() - 1) & ~(uintptr_t)(getpagesize() - 1);
+    const uintptr_t end   = (stack + qlib->qthread_stack_size) & ~(uintptr_t)(getpagesize() - 1);
+
+    /* only the pages wholly inside the stack; they come back zeroed the next
+     * time the stack is used */
+    if (end > start) {
+        (void)madvise((void *)start, end - start, MADV_DONTNEED);
+    }
+}                      /*}}} */
+
 # ifdef QTHREAD_GUARD_PAGES
+/* The guard pages go up once, when a stack is first carved, and stay up
+ * while the stack sits in the pool. */
+static void qthread_stack_prepare(void *item)
+{                      /*{{{ */
+    uint8_t *tmp = item;
+
+    if (mprotect(tmp, getpagesize(), PROT_NONE) != 0) {
+        perror("mprotect in qthread_stack_prepare (1)");
+    }
+    if (mprotect(tmp + qlib->qthread_stack_size + getpagesize(),
+                 getpagesize(),
+                 PROT_NONE) != 0) {
+        perror("mprotect in qthread_stack_prepare (2)");
+    }
+}                      /*}}} */
+
 static QINLINE void *ALLOC_STACK(void)
 {                      /*{{{ */
     if (GUARD_PAGES) {
@@ -231,14 +269,6 @@ static QINLINE void *ALLOC_STACK(void)
         if (tmp == NULL) {
             return NULL;
         }
-        if (mprotect(tmp, getpagesize(), PROT_NONE) != 0) {
-            perror("mprotect in ALLOC_STACK (1)");
-        }
-        if (mprotect(tmp + qlib->qthread_stack_size + getpagesize(),
-                    getpagesize(),
-                    PROT_NONE) != 0) {
-            perror("mprotect in ALLOC_STACK (2)");
-        }
         return tmp + getpagesize();
     } else {
         return qt_mpool_alloc(generic_stack_pool);
@@ -249,15 +279,7 @@ static QINLINE void FREE_STACK(void *t)
 {                      /*{{{ */
     if (GUARD_PAGES) {
         assert(t);
-        t = (uint8_t*)t - getpagesize();
-        if (mprotect(t, getpagesize(), PROT_READ | PROT_WRITE) != 0) {
-            perror("mprotect in FREE_STACK (1)");
-        }
-        if (mprotect(((uint8_t*)t) + qlib->qthread_stack_size + getpagesize(),
-                    getpagesize(),
-                    PROT_READ | PROT_WRITE) != 0) {
-            perror("mprotect in FREE_STACK (2)");
-        }
+        t = (uint8_t *)t - getpagesize();
     }
     qt_mpool_free(generic_stack_pool, t);
 }                      /*}}} */
@@ -334,8 +356,12 @@ int   qthread_library_initialized = 0;
 void *shep0arg                    = NULL;
 #endif
 
+/* When spare is non-NULL, it is the calling worker's spare-stack slot: a task
+ * starting on this worker takes the spare (if there is one) rather than going
+ * to the stack pool. */
 static QINLINE void alloc_rdata(qthread_shepherd_t *me,
-                                qthread_t          *t)
+                                qthread_t          *t,
+                                void              **spare)
 {   /*{{{*/
     void                          *stack = NULL;
     struct qthread_runtime_data_s *rdata;
@@ -343,7 +369,12 @@ static QINLINE void alloc_rdata(qthread_shepherd_t *me,
     if (t->flags & QTHREAD_SIMPLE) {
         rdata = t->rdata = ALLOC_RDATA();
     } else {
-        stack = ALLOC_STACK();
+        if (spare && *spare) {
+            stack  = *spare;
+            *spare = NULL;
+        } else {
+            stack = ALLOC_STACK();
+        }
         assert(stack);
         if (GUARD_PAGES) {
             rdata = t->rdata = (struct qthread_runtime_data_s *)(((uint8_t *)stack) + getpagesize() + qlib->qthread_stack_size);
@@ -370,6 +401,59 @@ static QINLINE void alloc_rdata(qthread_shepherd_t *me,
 #endif
 } /*}}}*/
 
+/* A task may resume on another worker than the one it switched away on, and
+ * the compiler is free to reuse a thread-local address it computed before the
+ * switch; looking the worker up out of line keeps it from doing so. */
+static Q_NOINLINE qthread_worker_t *qthread_internal_resumed_worker(void)
+{                      /*{{{ */
+    return qthread_internal_getworker();
+}                      /*}}} */
+
+/* Takes the task out of w's handoff slot, unless it is empty or someone else
+ * gets there first. */
+static QINLINE qthread_t *qthread_handoff_take(qthread_worker_t *w)
+{                      /*{{{ */
+    qthread_t *t;
+
+    do {
+        t = w->handoff;
+        if (t == NULL) { return NULL; }
+    } while (qthread_cas_ptr(&w->handoff, t, NULL) != t);
+    return t;
+}                      /*}}} */
+
+/* Called by worker me when it has run out of work of its own: takes a task
+ * woken by one of its siblings' current tasks, which would otherwise wait for
+ * that task to block, yield, or exit. */
+static qthread_t *qthread_handoff_steal(qthread_worker_t *me)
+{                      /*{{{ */
+    qthread_shepherd_t *shep = me->shepherd;
+
+    for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; ++i) {
+        qthread_t *t;
+
+        if (&shep->workers[i] == me) { continue; }
+        if ((t = qthread_handoff_take(&shep->workers[i])) != NULL) { return t; }
+    }
+    return NULL;
+}                      /*}}} */
+
+/* Called by task t whenever it resumes. If t was switched to directly by a
+ * task that blocked on a FEB (see qthread_back_to_master()), that task's
+ * context is now saved, so the FEB lock it went to sleep holding can be
+ * released; this is what qthread_master() would otherwise have done. */
+static QINLINE void qthread_handoff_finish(qthread_worker_t *w,
+                                           qthread_t        *t)
+{                      /*{{{ */
+    qthread_t *prev;
+
+    if ((w == NULL) || (w->current != t) || ((prev = w->handoff_from) == NULL)) { return; }
+    w->handoff_from = NULL;
+    assert(prev->thread_state == QTHREAD_STATE_FEB_BLOCKED);
+    qthread_debug(THREAD_DETAILS | FEB_DETAILS, "tid %u: releasing FEB for blocked tid %u (m=%p)\n", t->thread_id, prev->thread_id, prev->rdata->blockedon.addr);
+    QTHREAD_FASTLOCK_UNLOCK(&(prev->rdata->blockedon.addr->lock));
+}                      /*}}} */
+
 
 /* the qthread_master() function is the loop responsible for actually
  * executing the work units
@@ -464,14 +548,40 @@ static void *qthread_master(void *arg)
 #endif
         qthread_debug(SHEPHERD_DETAILS, "id(%i): fetching a thread from my queue...\n", my_id);
 
-        while (!QTHREAD_CASLOCK_READ_UI(me_worker->active)) {
-            SPINLOCK_BODY();
+        if (!QTHREAD_CASLOCK_READ_UI(me_worker->active) &&
+            ((t = qthread_handoff_take(me_worker)) != NULL)) {
+            qt_threadqueue_enqueue(threadqueue, t);
+        }
+        /* a disabled worker spins briefly, then hands its core back to the OS */
+        for (unsigned int spins = 0; !QTHREAD_CASLOCK_READ_UI(me_worker->active); ++spins) {
+            if (spins < 1000) {
+                SPINLOCK_BODY();
+            } else {
+#ifdef HAVE_PTHREAD_YIELD
+                pthread_yield();
+#elif defined(HAVE_SCHED_YIELD)
+                sched_yield();
+#else
+                SPINLOCK_BODY();
+#endif
+            }
         }
+        /* the last task may have woken one but not switched to it */
+        if ((t = qthread_handoff_take(me_worker)) == NULL) {
+            /* pairs with the fence in qthread_internal_handoff_offer(): either
+             * a sibling sees that this worker is idle, or this worker sees
+             * what the sibling's task woke */
+            me_worker->idle = 1;
+            MACHINE_FENCE;
+            if ((t = qthread_handoff_steal(me_worker)) == NULL) {
 #ifdef QTHREAD_LOCAL_PRIORITY
-        t = qt_scheduler_get_thread(threadqueue, localpriorityqueue, localqueue, QTHREAD_CASLOCK_READ_UI(me->active));
+                t = qt_scheduler_get_thread(threadqueue, localpriorityqueue, localqueue, QTHREAD_CASLOCK_READ_UI(me->active));
 #else
-        t = qt_scheduler_get_thread(threadqueue, localqueue, QTHREAD_CASLOCK_READ_UI(me->active));
+                t = qt_scheduler_get_thread(threadqueue, localqueue, QTHREAD_CASLOCK_READ_UI(me->active));
 #endif /* ifdef QTHREAD_LOCAL_PRIORITY */
+            }
+            me_worker->idle = 0;
+        }
         assert(t);
 #ifdef QTHREAD_SHEPHERD_PROFILING
         qtimer_stop(idle);
@@ -510,7 +620,7 @@ static void *qthread_master(void *arg)
 
             assert(t->f != NULL || t->flags & QTHREAD_REAL_MCCOY);
             if (t->rdata == NULL) {
-                alloc_rdata(me, t);
+                alloc_rdata(me, t, &me_worker->spare_stack);
             } else {
                 assert(t->rdata->shepherd_ptr != NULL);
                 if (t->rdata->shepherd_ptr != me) {
@@ -698,9 +808,10 @@ static void *qthread_master(void *arg)
                         qthread_debug(THREAD_DETAILS | SHEPHERD_DETAILS,
                                       "id(%u): thread %i terminated\n",
                                       my_id, t->thread_id);
-                        /* we can remove the stack etc. */
+                        /* we can remove the stack etc.; a task that never
+                         * blocked hands its stack straight back to us */
                         Q_PREFETCH(threadqueue);
-                        qthread_thread_free(t);
+                        qthread_thread_release(t, &me_worker->spare_stack);
                         break;
                 }
             }
@@ -936,6 +1047,7 @@ int API_FUNC qthread_initialize(void)
     }
     qaffinity = qt_internal_get_env_bool("AFFINITY", 1);
     qthread_debug(AFFINITY_DETAILS, "qaffinity = %i\n", qaffinity);
+    direct_handoff = qt_internal_get_env_bool("DIRECT_HANDOFF", 1);
 #ifndef QTHREAD_NO_ASSERTS
     qthread_library_initialized = 1;
     MACHINE_FENCE;
@@ -961,14 +1073,32 @@ int API_FUNC qthread_initialize(void)
     qthread_debug(CORE_DETAILS, "qthread task-local size: %u\n", qlib->qthread_tasklocal_size);
 
 #ifndef UNPOOLED
-    generic_qthread_pool     = qt_mpool_create_aligned(sizeof(qthread_t) + sizeof(void *) + qlib->qthread_tasklocal_size, qthread_cacheline());
-    generic_big_qthread_pool = qt_mpool_create(sizeof(qthread_t) + qlib->qthread_argcopy_size + qlib->qthread_tasklocal_size);
-    if (GUARD_PAGES) {
-        generic_stack_pool =
-            qt_mpool_create_aligned(qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s) +
-                                    (2 * getpagesize()), getpagesize());
-    } else {
-        generic_stack_pool = qt_mpool_create_aligned(qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s), QTHREAD_STACK_ALIGNMENT);     // stacks on most platforms must be 16-byte aligned (or less)
+    /* tasks and stacks are often freed on another worker than the one that
+     * made them (stealing), so they get per-worker slabs */
+    generic_qthread_pool     = qt_mpool_create_slab(sizeof(qthread_t) + sizeof(void *) + qlib->qthread_tasklocal_size, qthread_cacheline(), "task");
+    generic_big_qthread_pool = qt_mpool_create_slab(sizeof(qthread_t) + qlib->qthread_argcopy_size + qlib->qthread_tasklocal_size, 0, "big task");
+    {
+        qt_mpool_paging_t paging;
+
+        paging.arena_size  = qt_internal_get_env_num("STACK_ARENA", 0, 0);
+        paging.hugepages   = qt_internal_get_env_bool("STACK_HUGEPAGES", 0);
+        paging.link_offset = qlib->qthread_stack_size;
+        paging.prepare     = NULL;
+        paging.trim        = qthread_stack_trim;
+# ifdef QTHREAD_GUARD_PAGES
+        if (GUARD_PAGES) {
+            paging.link_offset += 2 * getpagesize();
+            paging.prepare      = qthread_stack_prepare;
+        }
+# endif
+        if (GUARD_PAGES || paging.arena_size) {
+            generic_stack_pool =
+                qt_mpool_create_paged(paging.link_offset + sizeof(struct qthread_runtime_data_s),
+                                      GUARD_PAGES ? getpagesize() : QTHREAD_STACK_ALIGNMENT,
+                                      "stack", &paging);
+        } else {
+            generic_stack_pool = qt_mpool_create_slab(qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s), QTHREAD_STACK_ALIGNMENT, "stack");     // stacks on most platforms must be 16-byte aligned (or less)
+        }
     }
     generic_rdata_pool = qt_mpool_create(sizeof(struct qthread_runtime_data_s));
 #endif /* ifndef UNPOOLED */
@@ -979,6 +1109,7 @@ int API_FUNC qthread_initialize(void)
     qt_syncvar_subsystem_init(need_sync);
     qt_threadqueue_subsystem_init();
     qt_blocking_subsystem_init();
+    qt_timer_subsystem_init();
 
 /* Set up agg methods*/
     qlib->agg_cost = qthread_default_agg_cost;
@@ -1486,10 +1617,16 @@ void API_FUNC qthread_finalize(void)
             }
             FREE(shep->workers[j].nostealbuffer, STEAL_BUFFER_LENGTH * sizeof(qthread_t *));
             FREE(shep->workers[j].stealbuffer, STEAL_BUFFER_LENGTH * sizeof(qthread_t *));
+            if (shep->workers[j].spare_stack) {
+                FREE_STACK(shep->workers[j].spare_stack);
+            }
         }
         if (i == 0) {
             FREE(shep0->workers[0].nostealbuffer, STEAL_BUFFER_LENGTH * sizeof(qthread_t *));
             FREE(shep0->workers[0].stealbuffer, STEAL_BUFFER_LENGTH * sizeof(qthread_t *));
+            if (shep0->workers[0].spare_stack) {
+                FREE_STACK(shep0->workers[0].spare_stack);
+            }
         }
         FREE(qlib->shepherds[i].workers, qlib->nworkerspershep * sizeof(qthread_worker_t));
         if (i == 0) { continue; }
@@ -1999,6 +2136,15 @@ static QINLINE qthread_t *qthread_thread_new(const qthread_f f,
 
 
 void qthread_thread_free(qthread_t *t)
+{                      /*{{{ */
+    qthread_thread_release(t, NULL);
+}                      /*}}} */
+
+/* Like qthread_thread_free(), but if spare points to an empty spare-stack
+ * slot, t's stack is parked there (still guarded, if guard pages are on)
+ * instead of being returned to the pool. */
+static void qthread_thread_release(qthread_t *t,
+                                   void     **spare)
 {                      /*{{{ */
     assert(t != NULL);
 
@@ -2022,8 +2168,13 @@ void qthread_thread_free(qthread_t *t)
             FREE_RDATA(t->rdata);
         } else {
             assert(t->rdata->stack);
-            qthread_debug(THREAD_DETAILS, "t(%p): releasing stack %p\n", t, t->rdata->stack);
-            FREE_STACK(t->rdata->stack);
+            if (spare && (*spare == NULL)) {
+                qthread_debug(THREAD_DETAILS, "t(%p): keeping stack %p as a spare\n", t, t->rdata->stack);
+                *spare = t->rdata->stack;
+            } else {
+                qthread_debug(THREAD_DETAILS, "t(%p): releasing stack %p\n", t, t->rdata->stack);
+                FREE_STACK(t->rdata->stack);
+            }
         }
 
         t->rdata = NULL;
@@ -2328,7 +2479,7 @@ void API_FUNC qthread_yield_(int k)
                             goto basic_yield;
                         }
                         /* Initialize nt's rdata */
-                        alloc_rdata(t->rdata->shepherd_ptr, nt);
+                        alloc_rdata(t->rdata->shepherd_ptr, nt, NULL);
                         nt->thread_state = QTHREAD_STATE_YIELDED; // special indicator state for qthread_wrapper()
                         QTPERF_QTHREAD_ENTER_STATE(nt->rdata->performance_data, QTHREAD_STATE_YIELDED);
                         nt->rdata->blockedon.thread = t;
@@ -2901,12 +3052,72 @@ int API_FUNC qthread_fork_syncvar_to(qthread_f             f,
                          QTHREAD_SPAWN_RET_SYNCVAR_T);
 } /*}}}*/
 
+/* Direct handoff. When a task wakes a FEB or syncvar waiter that could run on
+ * this worker, the waiter is parked in the worker's handoff slot instead of
+ * going through the ready queue (one per worker; any others are enqueued as
+ * usual). It runs as soon as the waker gives up the worker: if the waker
+ * blocks on a FEB, qthread_back_to_master() switches straight into the waiter
+ * and the waiter releases the waker's FEB lock on arrival; otherwise
+ * qthread_master() picks the slot before asking the scheduler for work.
+ *
+ * The waker may keep computing for a long time instead, so the slot is only
+ * offered while every sibling worker is busy: if one is idle, the waiter is
+ * enqueued (which wakes the sibling) as usual, and a sibling that runs out of
+ * work later takes the waiter out of the slot itself. */
+int INTERNAL qthread_internal_handoff_offer(qthread_t          *waiter,
+                                            qthread_shepherd_t *shep)
+{                      /*{{{ */
+    qthread_worker_t *w = qthread_internal_getworker();
+
+    if (!direct_handoff || (w == NULL) || (w->shepherd != shep) ||
+        (w->current == NULL) || (w->handoff != NULL) ||
+        (waiter->flags & (QTHREAD_UNSTEALABLE | QTHREAD_REAL_MCCOY)) ||
+        !QTHREAD_CASLOCK_READ_UI(w->active)) {
+        return 0;
+    }
+    w->handoff = waiter;
+    /* pairs with the fence in qthread_master() */
+    MACHINE_FENCE;
+    for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; ++i) {
+        if ((&shep->workers[i] != w) && shep->workers[i].idle) {
+            /* unless the sibling has taken it already, queue it instead */
+            return (qthread_cas_ptr(&w->handoff, waiter, NULL) != waiter);
+        }
+    }
+    return 1;
+}                      /*}}} */
+
 void INTERNAL qthread_back_to_master(qthread_t *t)
 {                      /*{{{ */
+    qthread_worker_t *w = qthread_internal_getworker();
+    qthread_t        *nt;
+
     assert((t->flags & QTHREAD_SIMPLE) == 0);
+    if ((w != NULL) &&
+        (t->thread_state == QTHREAD_STATE_FEB_BLOCKED) &&
+        ((t->flags & QTHREAD_REAL_MCCOY) == 0) &&
+        ((nt = qthread_handoff_take(w)) != NULL)) {
+        assert(nt->rdata);
+        assert(nt->thread_state == QTHREAD_STATE_RUNNING);
+        qthread_debug(THREAD_BEHAVIOR, "tid %u blocked; switching directly to tid %u\n", t->thread_id, nt->thread_id);
+        nt->rdata->shepherd_ptr   = w->shepherd;
+        nt->rdata->return_context = t->rdata->return_context;
+        w->handoff_from           = t;
+        w->current                = nt;
+        RLIMIT_TO_NORMAL(t);
+        RLIMIT_TO_TASK(nt);
+#ifdef HAVE_NATIVE_MAKECONTEXT
+        qassert(swapcontext(&t->rdata->context, &nt->rdata->context), 0);
+#else
+        qassert(qt_swapctxt(&t->rdata->context, &nt->rdata->context), 0);
+#endif
+        RLIMIT_TO_TASK(t);
+        qthread_handoff_finish(qthread_internal_resumed_worker(), t);
+        return;
+    }
     RLIMIT_TO_NORMAL(t);
 #ifdef QTHREAD_PERFORMANCE
-    QTPERF_WORKER_ENTER_STATE(qthread_internal_getworker()->performance_data, WKR_SHEPHERD);
+    QTPERF_WORKER_ENTER_STATE(w->performance_data, WKR_SHEPHERD);
 #endif /*  QTHREAD_PERFORMANCE */
     /* now back to your regularly scheduled master thread */
 #ifdef QTHREAD_USE_VALGRIND
@@ -2924,6 +3135,7 @@ void INTERNAL qthread_back_to_master(qthread_t *t)
 #ifdef QTHREAD_PERFORMANCE
     QTPERF_WORKER_ENTER_STATE(qthread_internal_getworker()->performance_data, WKR_QTHREAD_ACTIVE);
 #endif /*  QTHREAD_PERFORMANCE */
+    qthread_handoff_finish(qthread_internal_resumed_worker(), t);
 }                      /*}}} */
 
 void INTERNAL qthread_back_to_master2(qthread_t *t)
@@ -5,11 +5,13 @@
 /* System Headers */
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>                  /* for strcasecmp() */
 #include <unistd.h>
 
 /* API Headers */
 #include <qthread/qutil.h>
 #include <qthread/qthread.h>
+#include <qthread/qloop.h>
 #include <qthread/cacheline.h>
 
 /* Internal Headers */
@@ -18,6 +20,13 @@
 #include "qt_visibility.h"
 #include "qt_debug.h"
 #include "qt_int_log.h"
+#include "qt_int_ceil.h"
+#include "qt_envariables.h"
+#include "qt_feb.h"               /* for qt_feb_wait_full() */
+
+#ifdef QTHREAD_SIMD_DISPATCH
+# include <immintrin.h>
+#endif
 
 #ifndef MT_LOOP_CHUNK
 # define MT_LOOP_CHUNK 10000
@@ -25,157 +34,395 @@
 
 extern int qthread_library_initialized;
 
+/* Reduction kernels
+ *
+ * Each chunk of a reduction is folded into its first element by a kernel.
+ * Where the compiler can do so (see QTHREAD_CHECK_SIMD_DISPATCH), the kernels
+ * also come in AVX2 and AVX-512 flavors, built with per-function target
+ * attributes so that the rest of the library is not, and the flavor to use is
+ * picked once, according to CPUID, the first time a kernel is needed. The
+ * vector kernels keep four vectors of partial results going, so floating-point
+ * sums and products are associated differently than by the scalar loop (as
+ * they already are across chunks). */
+enum {
+    QUTIL_SIMD_NONE = 0,
+    QUTIL_SIMD_AVX2,
+    QUTIL_SIMD_AVX512
+};
+
+static int qutil_simd_level = -1;
+
+static int qutil_simd(void)
+{   /*{{{*/
+    int level = qutil_simd_level;
+
+    if (level < 0) {
+        level = QUTIL_SIMD_NONE;
+#ifdef QTHREAD_SIMD_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            level = QUTIL_SIMD_AVX512;
+        } else if (__builtin_cpu_supports("avx2")) {
+            level = QUTIL_SIMD_AVX2;
+        }
+        {
+            const char *cap = qt_internal_get_env_str("SIMD", NULL);
+
+            if (cap && !strcasecmp(cap, "none")) {
+                level = QUTIL_SIMD_NONE;
+            } else if (cap && !strcasecmp(cap, "avx2") && (level > QUTIL_SIMD_AVX2)) {
+                level = QUTIL_SIMD_AVX2;
+            }
+        }
+#endif  /* ifdef QTHREAD_SIMD_DISPATCH */
+        qthread_debug(CORE_BEHAVIOR, "qutil kernels: %s\n",
+                      (level == QUTIL_SIMD_AVX512) ? "AVX-512" :
+                      (level == QUTIL_SIMD_AVX2) ? "AVX2" : "scalar");
+        qutil_simd_level = level;
+    }
+    return level;
+} /*}}}*/
+
+#define SUM_MACRO(sum, add)       sum  += (add)
+#define MULT_MACRO(prod, factor)  prod *= (factor)
+#define MAX_MACRO(max, contender) if (max < (contender)) max = (contender)
+#define MIN_MACRO(max, contender) if (max > (contender)) max = (contender)
+
+#define SCALAR_KERNEL(_kname_, _ctype_, _opmacro_)                          \
+    static _ctype_ _kname_ ## _scalar(const _ctype_ *restrict a,           \
+                                      const size_t            n,           \
+                                      _ctype_                 acc)         \
+    {                                                                       \
+        for (size_t i = 0; i < n; i++) {                                    \
+            _opmacro_(acc, a[i]);                                           \
+        }                                                                   \
+        return acc;                                                         \
+    }
+
+#ifdef QTHREAD_SIMD_DISPATCH
+# define VECTOR_KERNEL(_kname_, _isa_, _target_, _ctype_, _vtype_, _lanes_, _load_, _vop_, _opmacro_) \
+    static __attribute__((target(_target_)))                                               \
+    _ctype_ _kname_ ## _ ## _isa_(const _ctype_ *restrict a,                               \
+                                  const size_t            n,                               \
+                                  _ctype_                 acc)                             \
+    {                                                                                      \
+        size_t i = 0;                                                                      \
+        if (n >= 4 * (_lanes_)) {                                                          \
+            _vtype_ v0 = _load_(a);                                                        \
+            _vtype_ v1 = _load_(a + (_lanes_));                                            \
+            _vtype_ v2 = _load_(a + 2 * (_lanes_));                                        \
+            _vtype_ v3 = _load_(a + 3 * (_lanes_));                                        \
+            _ctype_ lanes[_lanes_];                                                        \
+            for (i = 4 * (_lanes_); i + 4 * (_lanes_) <= n; i += 4 * (_lanes_)) {          \
+                v0 = _vop_(v0, _load_(a + i));                                             \
+                v1 = _vop_(v1, _load_(a + i + (_lanes_)));                                 \
+                v2 = _vop_(v2, _load_(a + i + 2 * (_lanes_)));                             \
+                v3 = _vop_(v3, _load_(a + i + 3 * (_lanes_)));                             \
+            }                                                                              \
+            v0 = _vop_(_vop_(v0, v1), _vop_(v2, v3));                                      \
+            memcpy(lanes, &v0, sizeof(lanes));                                             \
+            for (size_t l = 0; l < (_lanes_); l++) {                                       \
+                _opmacro_(acc, lanes[l]);                                                  \
+            }                                                                              \
+        }                                                                                  \
+        for (; i < n; i++) {                                                               \
+            _opmacro_(acc, a[i]);                                                          \
+        }                                                                                  \
+        return acc;                                                                        \
+    }
+# define KERNEL(_kname_, _ctype_)                                           \
+    static _ctype_ _kname_(const _ctype_ *restrict a,                      \
+                           const size_t            n,                      \
+                           _ctype_                 acc)                    \
+    {                                                                       \
+        switch (qutil_simd()) {                                             \
+            case QUTIL_SIMD_AVX512:                                         \
+                return _kname_ ## _avx512(a, n, acc);                       \
+            case QUTIL_SIMD_AVX2:                                           \
+                return _kname_ ## _avx2(a, n, acc);                         \
+            default:                                                        \
+                return _kname_ ## _scalar(a, n, acc);                       \
+        }                                                                   \
+    }
+
+# define LOAD256_pd(p) _mm256_loadu_pd(p)
+# define LOAD256_ps(p) _mm256_loadu_ps(p)
+# define LOAD256_I(p)  _mm256_loadu_si256((const __m256i *)(p))
+# define LOAD512_pd(p) _mm512_loadu_pd(p)
+# define LOAD512_ps(p) _mm512_loadu_ps(p)
+# define LOAD512_I(p)  _mm512_loadu_si512((const void *)(p))
+
+/* AVX2 has no 64-bit integer min/max; compare and blend instead */
+static QINLINE __attribute__((target("avx2"))) __m256i qutil_avx2_max_epi64(__m256i a,
+                                                                            __m256i b)
+{   /*{{{*/
+    return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b));
+} /*}}}*/
+
+static QINLINE __attribute__((target("avx2"))) __m256i qutil_avx2_min_epi64(__m256i a,
+                                                                            __m256i b)
+{   /*{{{*/
+    return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+} /*}}}*/
+
+static QINLINE __attribute__((target("avx2"))) __m256i qutil_avx2_gt_epu64(__m256i a,
+                                                                           __m256i b)
+{   /*{{{*/
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+
+    return _mm256_cmpgt_epi64(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+} /*}}}*/
+
+static QINLINE __attribute__((target("avx2"))) __m256i qutil_avx2_max_epu64(__m256i a,
+                                                                            __m256i b)
+{   /*{{{*/
+    return _mm256_blendv_epi8(b, a, qutil_avx2_gt_epu64(a, b));
+} /*}}}*/
+
+static QINLINE __attribute__((target("avx2"))) __m256i qutil_avx2_min_epu64(__m256i a,
+                                                                            __m256i b)
+{   /*{{{*/
+    return _mm256_blendv_epi8(a, b, qutil_avx2_gt_epu64(a, b));
+} /*}}}*/
+
+# define FP_KERNELS(_kname_, _ctype_, _sfx_, _v256_, _v512_, _lanes256_, _lanes512_)                                         \
+    SCALAR_KERNEL(_kname_ ## _sum, _ctype_, SUM_MACRO)                                                           \
+    SCALAR_KERNEL(_kname_ ## _mult, _ctype_, MULT_MACRO)                                                         \
+    SCALAR_KERNEL(_kname_ ## _max, _ctype_, MAX_MACRO)                                                           \
+    SCALAR_KERNEL(_kname_ ## _min, _ctype_, MIN_MACRO)                                                           \
+    VECTOR_KERNEL(_kname_ ## _sum, avx2, "avx2", _ctype_, _v256_, _lanes256_, LOAD256_p ## _sfx_,       \
+                  _mm256_add_p ## _sfx_, SUM_MACRO)                                                              \
+    VECTOR_KERNEL(_kname_ ## _mult, avx2, "avx2", _ctype_, _v256_, _lanes256_, LOAD256_p ## _sfx_,      \
+                  _mm256_mul_p ## _sfx_, MULT_MACRO)                                                             \
+    VECTOR_KERNEL(_kname_ ## _max, avx2, "avx2", _ctype_, _v256_, _lanes256_, LOAD256_p ## _sfx_,       \
+                  _mm256_max_p ## _sfx_, MAX_MACRO)                                                              \
+    VECTOR_KERNEL(_kname_ ## _min, avx2, "avx2", _ctype_, _v256_, _lanes256_, LOAD256_p ## _sfx_,       \
+                  _mm256_min_p ## _sfx_, MIN_MACRO)                                                              \
+    VECTOR_KERNEL(_kname_ ## _sum, avx512, "avx512f", _ctype_, _v512_, _lanes512_, LOAD512_p ## _sfx_,  \
+                  _mm512_add_p ## _sfx_, SUM_MACRO)                                                              \
+    VECTOR_KERNEL(_kname_ ## _mult, avx512, "avx512f", _ctype_, _v512_, _lanes512_, LOAD512_p ## _sfx_, \
+                  _mm512_mul_p ## _sfx_, MULT_MACRO)                                                             \
+    VECTOR_KERNEL(_kname_ ## _max, avx512, "avx512f", _ctype_, _v512_, _lanes512_, LOAD512_p ## _sfx_,  \
+                  _mm512_max_p ## _sfx_, MAX_MACRO)                                                              \
+    VECTOR_KERNEL(_kname_ ## _min, avx512, "avx512f", _ctype_, _v512_, _lanes512_, LOAD512_p ## _sfx_,  \
+                  _mm512_min_p ## _sfx_, MIN_MACRO)                                                              \
+    KERNEL(_kname_ ## _sum, _ctype_)                                                                             \
+    KERNEL(_kname_ ## _mult, _ctype_)                                                                            \
+    KERNEL(_kname_ ## _max, _ctype_)                                                                             \
+    KERNEL(_kname_ ## _min, _ctype_)
+
+/* the epi64 flavors only fit when aligned_t is 64 bits wide */
+# if QTHREAD_SIZEOF_ALIGNED_T == 8
+#  define INT_KERNELS(_kname_, _ctype_, _sgn_)                                                         \
+    SCALAR_KERNEL(_kname_ ## _sum, _ctype_, SUM_MACRO)                                                 \
+    SCALAR_KERNEL(_kname_ ## _mult, _ctype_, MULT_MACRO)                                               \
+    SCALAR_KERNEL(_kname_ ## _max, _ctype_, MAX_MACRO)                                                 \
+    SCALAR_KERNEL(_kname_ ## _min, _ctype_, MIN_MACRO)                                                 \
+    VECTOR_KERNEL(_kname_ ## _sum, avx2, "avx2", _ctype_, __m256i, 4, LOAD256_I,                       \
+                  _mm256_add_epi64, SUM_MACRO)                                                         \
+    VECTOR_KERNEL(_kname_ ## _max, avx2, "avx2", _ctype_, __m256i, 4, LOAD256_I,                       \
+                  qutil_avx2_max_ep ## _sgn_ ## 64, MAX_MACRO)                                         \
+    VECTOR_KERNEL(_kname_ ## _min, avx2, "avx2", _ctype_, __m256i, 4, LOAD256_I,                       \
+                  qutil_avx2_min_ep ## _sgn_ ## 64, MIN_MACRO)                                         \
+    VECTOR_KERNEL(_kname_ ## _sum, avx512, "avx512f", _ctype_, __m512i, 8, LOAD512_I,                  \
+                  _mm512_add_epi64, SUM_MACRO)                                                         \
+    VECTOR_KERNEL(_kname_ ## _mult, avx512, "avx512f", _ctype_, __m512i, 8, LOAD512_I,                 \
+                  _mm512_mullox_epi64, MULT_MACRO)                                                     \
+    VECTOR_KERNEL(_kname_ ## _max, avx512, "avx512f", _ctype_, __m512i, 8, LOAD512_I,                  \
+                  _mm512_max_ep ## _sgn_ ## 64, MAX_MACRO)                                             \
+    VECTOR_KERNEL(_kname_ ## _min, avx512, "avx512f", _ctype_, __m512i, 8, LOAD512_I,                  \
+                  _mm512_min_ep ## _sgn_ ## 64, MIN_MACRO)                                             \
+    KERNEL(_kname_ ## _sum, _ctype_)                                                                   \
+    KERNEL(_kname_ ## _max, _ctype_)                                                                   \
+    KERNEL(_kname_ ## _min, _ctype_)                                                                   \
+    /* AVX2 has no 64-bit multiply */                                                                  \
+    static _ctype_ _kname_ ## _mult(const _ctype_ *restrict a,                                        \
+                                    const size_t            n,                                        \
+                                    _ctype_                 acc)                                      \
+    {                                                                                                  \
+        return (qutil_simd() == QUTIL_SIMD_AVX512) ? _kname_ ## _mult_avx512(a, n, acc) :              \
+               _kname_ ## _mult_scalar(a, n, acc);                                                     \
+    }
+# endif /* if QTHREAD_SIZEOF_ALIGNED_T == 8 */
+#endif  /* ifdef QTHREAD_SIMD_DISPATCH */
+
+
+#define SCALAR_ONLY(_kname_, _ctype_, _opmacro_)                            \
+    SCALAR_KERNEL(_kname_, _ctype_, _opmacro_)                              \
+    static QINLINE _ctype_ _kname_(const _ctype_ *restrict a,              \
+                                   const size_t            n,              \
+                                   _ctype_                 acc)            \
+    {                                                                       \
+        return _kname_ ## _scalar(a, n, acc);                               \
+    }
+#define SCALAR_KERNELS(_kname_, _ctype_)                    \
+    SCALAR_ONLY(_kname_ ## _sum, _ctype_, SUM_MACRO)        \
+    SCALAR_ONLY(_kname_ ## _mult, _ctype_, MULT_MACRO)      \
+    SCALAR_ONLY(_kname_ ## _max, _ctype_, MAX_MACRO)        \
+    SCALAR_ONLY(_kname_ ## _min, _ctype_, MIN_MACRO)
+#ifndef FP_KERNELS
+# define FP_KERNELS(_kname_, _ctype_, _sfx_, _v256_, _v512_, _lanes256_, _lanes512_) \
+    SCALAR_KERNELS(_kname_, _ctype_)
+#endif
+#ifndef INT_KERNELS
+# define INT_KERNELS(_kname_, _ctype_, _sgn_) SCALAR_KERNELS(_kname_, _ctype_)
+#endif
+
+/* The array is cut into MT_LOOP_CHUNK-sized chunks, one qthread each, and the
+ * chunks' results are combined pairwise, as a tree: chunk i folds in chunk
+ * i+1, then i+2, then i+4, and so on for as long as i is a multiple of
+ * twice the distance, and only then marks itself done. Chunk 0 (which the
+ * caller does itself) thus ends up with everything, after waiting on
+ * log2(chunks) others rather than on a chain through all of them. Each
+ * chunk's bookkeeping gets cache lines of its own. */
 #define STRUCT(_structname_, _rtype_)                   struct _structname_ \
     {                                                                       \
         const _rtype_       *array;                                         \
+        size_t               start, stop;                                   \
+        size_t               id, nchunks;                                   \
+        struct _structname_ *chunks;                                        \
         syncvar_t            ret_sentinel;                                  \
         _rtype_              ret;                                           \
-        size_t               start, stop;                                   \
-        const _rtype_       *addlast;                                       \
-        syncvar_t           *addlast_sentinel;                              \
-        struct _structname_ *backptr;                                       \
-    }
-#define INNER_LOOP(_fname_, _structtype_, _opmacro_)    static aligned_t _fname_(struct _structtype_ *args) \
-    {                                                                                                       \
-        size_t i;                                                                                           \
-        args->ret = args->array[args->start];                                                               \
-        for (i = args->start + 1; i < args->stop; i++) {                                                    \
-            _opmacro_(args->ret, args->array[i]);                                                           \
-        }                                                                                                   \
-        if (args->addlast) {                                                                                \
-            qthread_syncvar_readFF(NULL, args->addlast_sentinel);                                           \
-            _opmacro_(args->ret, *(args->addlast));                                                         \
-            FREE(args->backptr, sizeof(struct _structtype_));                                               \
-        }                                                                                                   \
-        qthread_syncvar_fill(&(args->ret_sentinel));                                                        \
-        return 0;                                                                                           \
-    }
-#define INNER_LOOP_FF(_fname_, _structtype_, _opmacro_) static aligned_t _fname_(struct _structtype_ *args) \
-    {                                                                                                       \
-        size_t i;                                                                                           \
-        qthread_readFF(NULL, (aligned_t *)(args->array + args->start));                                     \
-        args->ret = args->array[args->start];                                                               \
-        for (i = args->start + 1; i < args->stop; i++) {                                                    \
-            qthread_readFF(NULL, (aligned_t *)(args->array + i));                                           \
-            _opmacro_(args->ret, args->array[i]);                                                           \
-        }                                                                                                   \
-        if (args->addlast) {                                                                                \
-            qthread_syncvar_readFF(NULL, args->addlast_sentinel);                                           \
-            _opmacro_(args->ret, *(args->addlast));                                                         \
-            FREE(args->backptr, sizeof(struct _structtype_));                                               \
-        }                                                                                                   \
-        qthread_syncvar_fill(&(args->ret_sentinel));                                                        \
-        return 0;                                                                                           \
+    } Q_ALIGNED(CACHELINE_WIDTH)
+#define FOLD(_args_, _opmacro_)                                              \
+    for (size_t k = 1; ((_args_)->id & k) == 0 &&                            \
+         (_args_)->id + k < (_args_)->nchunks; k <<= 1) {                    \
+        qthread_syncvar_readFF(NULL, &((_args_)->chunks[(_args_)->id + k].ret_sentinel)); \
+        _opmacro_((_args_)->ret, (_args_)->chunks[(_args_)->id + k].ret);    \
+    }                                                                        \
+    qthread_syncvar_fill(&((_args_)->ret_sentinel))
+#define INNER_LOOP(_fname_, _structtype_, _opmacro_, _kernel_)    static aligned_t _fname_(struct _structtype_ *args) \
+    {                                                                                                                \
+        args->ret = _kernel_(args->array + args->start + 1,                                                          \
+                             (args->stop > args->start) ? args->stop - args->start - 1 : 0,                          \
+                             args->array[args->start]);                                                              \
+        FOLD(args, _opmacro_);                                                                                       \
+        return 0;                                                                                                    \
+    }
+/* all of the chunk has to be full before the kernel can look at any of it */
+#define INNER_LOOP_FF(_fname_, _structtype_, _opmacro_, _kernel_) static aligned_t _fname_(struct _structtype_ *args) \
+    {                                                                                                                \
+        qt_feb_wait_full((const aligned_t *)(args->array + args->start),                                             \
+                         (args->stop > args->start) ? args->stop - args->start : 1);                                 \
+        args->ret = _kernel_(args->array + args->start + 1,                                                          \
+                             (args->stop > args->start) ? args->stop - args->start - 1 : 0,                          \
+                             args->array[args->start]);                                                              \
+        FOLD(args, _opmacro_);                                                                                       \
+        return 0;                                                                                                    \
     }
 #define OUTER_LOOP(_fname_, _structtype_, _opmacro_, _rtype_, _innerfunc_, _innerfuncff_) \
     _rtype_ API_FUNC _fname_(const _rtype_ * array, size_t length, int checkfeb)          \
     {                                                                                     \
-        size_t               i, start = 0;                                                \
-        syncvar_t           *waitfor_sentinel = NULL;                                     \
-        _rtype_             *waitfor          = NULL, myret;                              \
-        struct _structtype_ *bkptr            = NULL;                                     \
+        const size_t         nchunks = (length > MT_LOOP_CHUNK) ?                         \
+                                       QT_CEIL_RATIO(length, MT_LOOP_CHUNK) : 1;          \
+        struct _structtype_ *chunks;                                                      \
+        _rtype_              myret;                                                       \
         /* abort if checkfeb == 1 && aligned_t is too big */                              \
         assert(checkfeb == 0 || sizeof(aligned_t) == sizeof(_rtype_));                    \
-        while (start + MT_LOOP_CHUNK < length) {                                          \
-            /* spawn off an MT_LOOP_CHUNK-sized segment of the first part of the array */ \
-            struct _structtype_ *left_args =                                              \
-                qt_calloc(1, sizeof(struct _structtype_));                                   \
-                                                                                          \
-            left_args->array            = array;                                          \
-            left_args->start            = start;                                          \
-            left_args->stop             = start + MT_LOOP_CHUNK;                          \
-            start                      += MT_LOOP_CHUNK;                                  \
-            left_args->backptr          = bkptr;                                          \
-            bkptr                       = left_args;                                      \
-            left_args->addlast          = waitfor;                                        \
-            left_args->addlast_sentinel = waitfor_sentinel;                               \
-            waitfor                     = &(left_args->ret);                              \
-            waitfor_sentinel            = &(left_args->ret_sentinel);                     \
-            qthread_syncvar_empty(&(left_args->ret_sentinel));                            \
+        chunks = qt_internal_aligned_alloc(nchunks * sizeof(struct _structtype_),         \
+                                           CACHELINE_WIDTH);                              \
+        assert(chunks);                                                                   \
+        /* every sentinel must be empty before anybody can wait on it */                  \
+        for (size_t i = 0; i < nchunks; i++) {                                            \
+            chunks[i].array        = array;                                               \
+            chunks[i].start        = i * MT_LOOP_CHUNK;                                   \
+            chunks[i].stop         = (i + 1 < nchunks) ? (i + 1) * MT_LOOP_CHUNK : length; \
+            chunks[i].id           = i;                                                   \
+            chunks[i].nchunks      = nchunks;                                             \
+            chunks[i].chunks       = chunks;                                              \
+            chunks[i].ret_sentinel = SYNCVAR_EMPTY_INITIALIZER;                           \
+        }                                                                                 \
+        for (size_t i = 1; i < nchunks; i++) {                                            \
             if (checkfeb) {                                                               \
-                qthread_fork((qthread_f)_innerfuncff_, left_args, NULL);                  \
+                qthread_fork((qthread_f)_innerfuncff_, chunks + i, NULL);                 \
             } else {                                                                      \
-                qthread_fork((qthread_f)_innerfunc_, left_args, NULL);                    \
+                qthread_fork((qthread_f)_innerfunc_, chunks + i, NULL);                   \
             }                                                                             \
         }                                                                                 \
         if (checkfeb) {                                                                   \
-            qthread_readFF(NULL, (aligned_t *)(array + start));                           \
-            myret = array[start];                                                         \
-            for (i = start + 1; i < length; i++) {                                        \
-                qthread_readFF(NULL, (aligned_t *)(array + i));                           \
-                _opmacro_(myret, array[i]);                                               \
-            }                                                                             \
+            _innerfuncff_(chunks);                                                        \
         } else {                                                                          \
-            myret = array[start];                                                         \
-            for (i = start + 1; i < length; i++) {                                        \
-                _opmacro_(myret, array[i]);                                               \
-            }                                                                             \
-        }                                                                                 \
-        if (waitfor) {                                                                    \
-            qthread_syncvar_readFF(NULL, waitfor_sentinel);                               \
-            _opmacro_(myret, *waitfor);                                                   \
-            FREE(bkptr, sizeof(struct _structtype_));                                     \
+            _innerfunc_(chunks);                                                          \
         }                                                                                 \
+        myret = chunks[0].ret;                                                            \
+        qt_internal_aligned_free(chunks, CACHELINE_WIDTH);                                \
         return myret;                                                                     \
     }
 
-#define SUM_MACRO(sum, add)       sum  += (add)
-#define MULT_MACRO(prod, factor)  prod *= (factor)
-#define MAX_MACRO(max, contender) if (max < (contender)) max = (contender)
-#define MIN_MACRO(max, contender) if (max > (contender)) max = (contender)
-
 /* These are the functions for computing things about doubles */
+FP_KERNELS(qutil_kd, double, d, __m256d, __m512d, 4, 8)
 STRUCT(qutil_ds_args, double);
-INNER_LOOP(qutil_double_sum_inner, qutil_ds_args, SUM_MACRO)
-INNER_LOOP_FF(qutil_double_FF_sum_inner, qutil_ds_args, SUM_MACRO)
+INNER_LOOP(qutil_double_sum_inner, qutil_ds_args, SUM_MACRO, qutil_kd_sum)
+INNER_LOOP_FF(qutil_double_FF_sum_inner, qutil_ds_args, SUM_MACRO, qutil_kd_sum)
 OUTER_LOOP(qutil_double_sum, qutil_ds_args, SUM_MACRO, double,
            qutil_double_sum_inner, qutil_double_FF_sum_inner)
-INNER_LOOP(qutil_double_mult_inner, qutil_ds_args, MULT_MACRO)
-INNER_LOOP_FF(qutil_double_FF_mult_inner, qutil_ds_args, MULT_MACRO)
+INNER_LOOP(qutil_double_mult_inner, qutil_ds_args, MULT_MACRO, qutil_kd_mult)
+INNER_LOOP_FF(qutil_double_FF_mult_inner, qutil_ds_args, MULT_MACRO, qutil_kd_mult)
 OUTER_LOOP(qutil_double_mult, qutil_ds_args, MULT_MACRO, double,
            qutil_double_mult_inner, qutil_double_FF_mult_inner)
-INNER_LOOP(qutil_double_max_inner, qutil_ds_args, MAX_MACRO)
-INNER_LOOP_FF(qutil_double_FF_max_inner, qutil_ds_args, MAX_MACRO)
+INNER_LOOP(qutil_double_max_inner, qutil_ds_args, MAX_MACRO, qutil_kd_max)
+INNER_LOOP_FF(qutil_double_FF_max_inner, qutil_ds_args, MAX_MACRO, qutil_kd_max)
 OUTER_LOOP(qutil_double_max, qutil_ds_args, MAX_MACRO, double,
            qutil_double_max_inner, qutil_double_FF_max_inner)
-INNER_LOOP(qutil_double_min_inner, qutil_ds_args, MIN_MACRO)
-INNER_LOOP_FF(qutil_double_FF_min_inner, qutil_ds_args, MIN_MACRO)
+INNER_LOOP(qutil_double_min_inner, qutil_ds_args, MIN_MACRO, qutil_kd_min)
+INNER_LOOP_FF(qutil_double_FF_min_inner, qutil_ds_args, MIN_MACRO, qutil_kd_min)
 OUTER_LOOP(qutil_double_min, qutil_ds_args, MIN_MACRO, double,
            qutil_double_min_inner, qutil_double_FF_min_inner)
+/* These are the functions for computing things about floats */
+FP_KERNELS(qutil_kf, float, s, __m256, __m512, 8, 16)
+STRUCT(qutil_fs_args, float);
+INNER_LOOP(qutil_float_sum_inner, qutil_fs_args, SUM_MACRO, qutil_kf_sum)
+INNER_LOOP_FF(qutil_float_FF_sum_inner, qutil_fs_args, SUM_MACRO, qutil_kf_sum)
+OUTER_LOOP(qutil_float_sum, qutil_fs_args, SUM_MACRO, float,
+           qutil_float_sum_inner, qutil_float_FF_sum_inner)
+INNER_LOOP(qutil_float_mult_inner, qutil_fs_args, MULT_MACRO, qutil_kf_mult)
+INNER_LOOP_FF(qutil_float_FF_mult_inner, qutil_fs_args, MULT_MACRO, qutil_kf_mult)
+OUTER_LOOP(qutil_float_mult, qutil_fs_args, MULT_MACRO, float,
+           qutil_float_mult_inner, qutil_float_FF_mult_inner)
+INNER_LOOP(qutil_float_max_inner, qutil_fs_args, MAX_MACRO, qutil_kf_max)
+INNER_LOOP_FF(qutil_float_FF_max_inner, qutil_fs_args, MAX_MACRO, qutil_kf_max)
+OUTER_LOOP(qutil_float_max, qutil_fs_args, MAX_MACRO, float,
+           qutil_float_max_inner, qutil_float_FF_max_inner)
+INNER_LOOP(qutil_float_min_inner, qutil_fs_args, MIN_MACRO, qutil_kf_min)
+INNER_LOOP_FF(qutil_float_FF_min_inner, qutil_fs_args, MIN_MACRO, qutil_kf_min)
+OUTER_LOOP(qutil_float_min, qutil_fs_args, MIN_MACRO, float,
+           qutil_float_min_inner, qutil_float_FF_min_inner)
 /* These are the functions for computing things about unsigned ints */
+INT_KERNELS(qutil_ku, aligned_t, u)
 STRUCT(qutil_uis_args, aligned_t);
-INNER_LOOP(qutil_uint_sum_inner, qutil_uis_args, SUM_MACRO)
-INNER_LOOP_FF(qutil_uint_FF_sum_inner, qutil_uis_args, SUM_MACRO)
+INNER_LOOP(qutil_uint_sum_inner, qutil_uis_args, SUM_MACRO, qutil_ku_sum)
+INNER_LOOP_FF(qutil_uint_FF_sum_inner, qutil_uis_args, SUM_MACRO, qutil_ku_sum)
 OUTER_LOOP(qutil_uint_sum, qutil_uis_args, SUM_MACRO, aligned_t,
            qutil_uint_sum_inner, qutil_uint_FF_sum_inner)
-INNER_LOOP(qutil_uint_mult_inner, qutil_uis_args, MULT_MACRO)
-INNER_LOOP_FF(qutil_uint_FF_mult_inner, qutil_uis_args, MULT_MACRO)
+INNER_LOOP(qutil_uint_mult_inner, qutil_uis_args, MULT_MACRO, qutil_ku_mult)
+INNER_LOOP_FF(qutil_uint_FF_mult_inner, qutil_uis_args, MULT_MACRO, qutil_ku_mult)
 OUTER_LOOP(qutil_uint_mult, qutil_uis_args, MULT_MACRO, aligned_t,
            qutil_uint_mult_inner, qutil_uint_FF_mult_inner)
-INNER_LOOP(qutil_uint_max_inner, qutil_uis_args, MAX_MACRO)
-INNER_LOOP_FF(qutil_uint_FF_max_inner, qutil_uis_args, MAX_MACRO)
+INNER_LOOP(qutil_uint_max_inner, qutil_uis_args, MAX_MACRO, qutil_ku_max)
+INNER_LOOP_FF(qutil_uint_FF_max_inner, qutil_uis_args, MAX_MACRO, qutil_ku_max)
 OUTER_LOOP(qutil_uint_max, qutil_uis_args, MAX_MACRO, aligned_t,
            qutil_uint_max_inner, qutil_uint_FF_max_inner)
-INNER_LOOP(qutil_uint_min_inner, qutil_uis_args, MIN_MACRO)
-INNER_LOOP_FF(qutil_uint_FF_min_inner, qutil_uis_args, MIN_MACRO)
+INNER_LOOP(qutil_uint_min_inner, qutil_uis_args, MIN_MACRO, qutil_ku_min)
+INNER_LOOP_FF(qutil_uint_FF_min_inner, qutil_uis_args, MIN_MACRO, qutil_ku_min)
 OUTER_LOOP(qutil_uint_min, qutil_uis_args, MIN_MACRO, aligned_t,
            qutil_uint_min_inner, qutil_uint_FF_min_inner)
 /* These are the functions for computing things about signed ints */
+INT_KERNELS(qutil_ki, saligned_t, i)
 STRUCT(qutil_is_args, saligned_t);
-INNER_LOOP(qutil_int_sum_inner, qutil_is_args, SUM_MACRO)
-INNER_LOOP_FF(qutil_int_FF_sum_inner, qutil_is_args, SUM_MACRO)
+INNER_LOOP(qutil_int_sum_inner, qutil_is_args, SUM_MACRO, qutil_ki_sum)
+INNER_LOOP_FF(qutil_int_FF_sum_inner, qutil_is_args, SUM_MACRO, qutil_ki_sum)
 OUTER_LOOP(qutil_int_sum, qutil_is_args, SUM_MACRO, saligned_t,
            qutil_int_sum_inner, qutil_int_FF_sum_inner)
-INNER_LOOP(qutil_int_mult_inner, qutil_is_args, MULT_MACRO)
-INNER_LOOP_FF(qutil_int_FF_mult_inner, qutil_is_args, MULT_MACRO)
+INNER_LOOP(qutil_int_mult_inner, qutil_is_args, MULT_MACRO, qutil_ki_mult)
+INNER_LOOP_FF(qutil_int_FF_mult_inner, qutil_is_args, MULT_MACRO, qutil_ki_mult)
 OUTER_LOOP(qutil_int_mult, qutil_is_args, MULT_MACRO, saligned_t,
            qutil_int_mult_inner, qutil_int_FF_mult_inner)
-INNER_LOOP(qutil_int_max_inner, qutil_is_args, MAX_MACRO)
-INNER_LOOP_FF(qutil_int_FF_max_inner, qutil_is_args, MAX_MACRO)
+INNER_LOOP(qutil_int_max_inner, qutil_is_args, MAX_MACRO, qutil_ki_max)
+INNER_LOOP_FF(qutil_int_FF_max_inner, qutil_is_args, MAX_MACRO, qutil_ki_max)
 OUTER_LOOP(qutil_int_max, qutil_is_args, MAX_MACRO, saligned_t,
            qutil_int_max_inner, qutil_int_FF_max_inner)
-INNER_LOOP(qutil_int_min_inner, qutil_is_args, MIN_MACRO)
-INNER_LOOP_FF(qutil_int_FF_min_inner, qutil_is_args, MIN_MACRO)
+INNER_LOOP(qutil_int_min_inner, qutil_is_args, MIN_MACRO, qutil_ki_min)
+INNER_LOOP_FF(qutil_int_FF_min_inner, qutil_is_args, MIN_MACRO, qutil_ki_min)
 OUTER_LOOP(qutil_int_min, qutil_is_args, MIN_MACRO, saligned_t,
            qutil_int_min_inner, qutil_int_FF_min_inner)
 
@@ -1081,4 +1328,1143 @@ void API_FUNC qutil_aligned_qsort(aligned_t   *array,
     qutil_aligned_qsort_inner(&arg);
 } /*}}}*/
 
+/* Blocked primitives
+ *
+ * The sorts, scans, and friends below all cut their array into blocks, one
+ * qthread each (via qt_loop()), and make two parallel sweeps over it separated
+ * by a short serial step over per-block results: first every block reduces
+ * its own records (to a count per bucket, a sum, ...), then the serial step
+ * turns those into per-block starting points, and then every block makes its
+ * second sweep from its own starting point. Scratch buffers are not touched
+ * before the block that owns that part of them does, so that, with
+ * first-touch placement, each block's share lands on its own memory node. */
+#ifndef QUTIL_MIN_BLOCK
+# define QUTIL_MIN_BLOCK 16384         /* records */
+#endif
+#define QUTIL_RADIX_BITS        8
+#define QUTIL_RADIX_BUCKETS     (1 << QUTIL_RADIX_BITS)
+#define QUTIL_RADIX_DIGITS      (64 / QUTIL_RADIX_BITS)
+#define QUTIL_SAMPLE_OVERSAMPLE 32
+#define QUTIL_SAMPLE_MAX_BLOCKS 4096   /* bucket numbers must fit a uint16_t */
+
+#define BLOCK_START(_n_, _nblocks_, _b_) ((size_t)(((uint64_t)(_n_) * (_b_)) / (_nblocks_)))
+
+static size_t qutil_nblocks(const size_t nmemb,
+                            const size_t max)
+{   /*{{{*/
+    size_t nblocks = qthread_num_workers() * 4;
+
+    if (nmemb == 0) { return 1; }
+    if (nblocks > QT_CEIL_RATIO(nmemb, QUTIL_MIN_BLOCK)) {
+        nblocks = QT_CEIL_RATIO(nmemb, QUTIL_MIN_BLOCK);
+    }
+    if (nblocks > max) { nblocks = max; }
+    return (nblocks > 0) ? nblocks : 1;
+} /*}}}*/
+
+/* a single block isn't worth a qthread */
+static void qutil_blocks(const size_t nblocks,
+                         qt_loop_f    func,
+                         void        *arg)
+{   /*{{{*/
+    if (nblocks == 1) {
+        func(0, 1, arg);
+    } else {
+        qt_loop(0, nblocks, func, arg);
+    }
+} /*}}}*/
+
+static void qutil_touch(void        *buf,
+                        const size_t start,
+                        const size_t stop)
+{   /*{{{*/
+    char *b = (char *)buf;
+
+    for (size_t i = (start + pagesize - 1) & ~(pagesize - 1); i < stop; i += pagesize) {
+        b[i] = 0;
+    }
+} /*}}}*/
+
+/* LSD radix sort over (key, index) pairs; the records themselves are only
+ * moved once, at the end. Digits that are the same in every key are
+ * skipped. */
+typedef struct {
+    uint64_t key;
+    size_t   idx;
+} qutil_radix_item_t;
+
+struct qutil_radix_args {
+    char               *array;
+    char               *scratch;
+    size_t              nmemb, size, nblocks;
+    qutil_key_f         key;
+    qutil_radix_item_t *src, *dst;
+    unsigned int        shift;
+    size_t (*digits)[QUTIL_RADIX_DIGITS][QUTIL_RADIX_BUCKETS];
+    size_t (*offsets)[QUTIL_RADIX_BUCKETS];
+};
+
+static void qutil_radix_extract(const size_t startat,
+                                const size_t stopat,
+                                void        *arg_)
+{   /*{{{*/
+    struct qutil_radix_args *arg = (struct qutil_radix_args *)arg_;
+
+    for (size_t b = startat; b < stopat; b++) {
+        const size_t start = BLOCK_START(arg->nmemb, arg->nblocks, b);
+        const size_t stop  = BLOCK_START(arg->nmemb, arg->nblocks, b + 1);
+        size_t (*const digits)[QUTIL_RADIX_BUCKETS] = arg->digits[b];
+
+        memset(digits, 0, sizeof(arg->digits[b]));
+        for (size_t i = start; i < stop; i++) {
+            const uint64_t k = arg->key(arg->array + i * arg->size);
+
+            arg->src[i].key = k;
+            arg->src[i].idx = i;
+            for (unsigned int d = 0; d < QUTIL_RADIX_DIGITS; d++) {
+                digits[d][(k >> (d * QUTIL_RADIX_BITS)) & (QUTIL_RADIX_BUCKETS - 1)]++;
+            }
+        }
+        qutil_touch(arg->dst, start * sizeof(qutil_radix_item_t),
+                         stop * sizeof(qutil_radix_item_t));
+    }
+} /*}}}*/
+
+static void qutil_radix_count(const size_t startat,
+                              const size_t stopat,
+                              void        *arg_)
+{   /*{{{*/
+    struct qutil_radix_args *arg = (struct qutil_radix_args *)arg_;
+
+    for (size_t b = startat; b < stopat; b++) {
+        const size_t start   = BLOCK_START(arg->nmemb, arg->nblocks, b);
+        const size_t stop    = BLOCK_START(arg->nmemb, arg->nblocks, b + 1);
+        size_t      *offsets = arg->offsets[b];
+
+        memset(offsets, 0, sizeof(arg->offsets[b]));
+        for (size_t i = start; i < stop; i++) {
+            offsets[(arg->src[i].key >> arg->shift) & (QUTIL_RADIX_BUCKETS - 1)]++;
+        }
+    }
+} /*}}}*/
+
+static void qutil_radix_scatter(const size_t startat,
+                                const size_t stopat,
+                                void        *arg_)
+{   /*{{{*/
+    struct qutil_radix_args *arg = (struct qutil_radix_args *)arg_;
+
+    for (size_t b = startat; b < stopat; b++) {
+        const size_t start   = BLOCK_START(arg->nmemb, arg->nblocks, b);
+        const size_t stop    = BLOCK_START(arg->nmemb, arg->nblocks, b + 1);
+        size_t      *offsets = arg->offsets[b];
+
+        for (size_t i = start; i < stop; i++) {
+            arg->dst[offsets[(arg->src[i].key >> arg->shift) & (QUTIL_RADIX_BUCKETS - 1)]++] = arg->src[i];
+        }
+    }
+} /*}}}*/
+
+static void qutil_radix_gather(const size_t startat,
+                               const size_t stopat,
+                               void        *arg_)
+{   /*{{{*/
+    struct qutil_radix_args *arg = (struct qutil_radix_args *)arg_;
+
+    for (size_t b = startat; b < stopat; b++) {
+        const size_t start = BLOCK_START(arg->nmemb, arg->nblocks, b);
+        const size_t stop  = BLOCK_START(arg->nmemb, arg->nblocks, b + 1);
+
+        for (size_t i = start; i < stop; i++) {
+            memcpy(arg->scratch + i * arg->size,
+                   arg->array + arg->src[i].idx * arg->size, arg->size);
+        }
+    }
+} /*}}}*/
+
+static void qutil_sort_copyback(const size_t startat,
+                                const size_t stopat,
+                                void        *arg_)
+{   /*{{{*/
+    struct qutil_radix_args *arg = (struct qutil_radix_args *)arg_;
+
+    for (size_t b = startat; b < stopat; b++) {
+        const size_t start = BLOCK_START(arg->nmemb, arg->nblocks, b);
+        const size_t stop  = BLOCK_START(arg->nmemb, arg->nblocks, b + 1);
+
+        memcpy(arg->array + start * arg->size, arg->scratch + start * arg->size,
+               (stop - start) * arg->size);
+    }
+} /*}}}*/
+
+void API_FUNC qutil_radix_sort(void        *array,
+                               const size_t nmemb,
+                               const size_t size,
+                               qutil_key_f  key)
+{   /*{{{*/
+    struct qutil_radix_args arg;
+    size_t (*global)[QUTIL_RADIX_BUCKETS];
+    const size_t            itemsbytes = nmemb * sizeof(qutil_radix_item_t);
+    int                     first      = 1;
+
+    assert(qthread_library_initialized);
+    assert(key);
+    if (nmemb < 2) { return; }
+
+    arg.array   = (char *)array;
+    arg.nmemb   = nmemb;
+    arg.size    = size;
+    arg.key     = key;
+    arg.nblocks = qutil_nblocks(nmemb, SIZE_MAX);
+    arg.src     = MALLOC(itemsbytes);
+    arg.dst     = MALLOC(itemsbytes);
+    arg.digits  = qt_internal_aligned_alloc(arg.nblocks * sizeof(*arg.digits), CACHELINE_WIDTH);
+    arg.offsets = qt_internal_aligned_alloc(arg.nblocks * sizeof(*arg.offsets), CACHELINE_WIDTH);
+    /* not on the stack: that is 16k, and a qthread's stack may be smaller */
+    global      = MALLOC(QUTIL_RADIX_DIGITS * sizeof(*global));
+    assert(arg.src && arg.dst && arg.digits && arg.offsets && global);
+
+    /* one pass to read every key and count every digit at once */
+    qutil_blocks(arg.nblocks, qutil_radix_extract, &arg);
+    memset(global, 0, QUTIL_RADIX_DIGITS * sizeof(*global));
+    for (size_t b = 0; b < arg.nblocks; b++) {
+        for (unsigned int d = 0; d < QUTIL_RADIX_DIGITS; d++) {
+            for (size_t k = 0; k < QUTIL_RADIX_BUCKETS; k++) {
+                global[d][k] += arg.digits[b][d][k];
+            }
+        }
+    }
+
+    for (unsigned int d = 0; d < QUTIL_RADIX_DIGITS; d++) {
+        size_t sum = 0;
+
+        arg.shift = d * QUTIL_RADIX_BITS;
+        if (global[d][(arg.src[0].key >> arg.shift) & (QUTIL_RADIX_BUCKETS - 1)] == nmemb) {
+            continue;                  /* every key has this digit */
+        }
+        if (first) {
+            /* nothing has moved yet, so the blocks' counts are still good */
+            for (size_t b = 0; b < arg.nblocks; b++) {
+                memcpy(arg.offsets[b], arg.digits[b][d], sizeof(arg.offsets[b]));
+            }
+            first = 0;
+        } else {
+            qutil_blocks(arg.nblocks, qutil_radix_count, &arg);
+        }
+        for (size_t k = 0; k < QUTIL_RADIX_BUCKETS; k++) {
+            for (size_t b = 0; b < arg.nblocks; b++) {
+                const size_t count = arg.offsets[b][k];
+
+                arg.offsets[b][k] = sum;
+                sum              += count;
+            }
+        }
+        qutil_blocks(arg.nblocks, qutil_radix_scatter, &arg);
+        {
+            qutil_radix_item_t *tmp = arg.src;
+
+            arg.src = arg.dst;
+            arg.dst = tmp;
+        }
+    }
+
+    /* the records go through a scratch copy; the spare pair buffer does if
+     * the records are no bigger than a pair */
+    arg.scratch = (size <= sizeof(qutil_radix_item_t)) ? (char *)arg.dst : MALLOC(nmemb * size);
+    assert(arg.scratch);
+    qutil_blocks(arg.nblocks, qutil_radix_gather, &arg);
+    qutil_blocks(arg.nblocks, qutil_sort_copyback, &arg);
+
+    if (arg.scratch != (char *)arg.dst) {
+        FREE(arg.scratch, nmemb * size);
+    }
+    FREE(arg.src, itemsbytes);
+    FREE(arg.dst, itemsbytes);
+    FREE(global, QUTIL_RADIX_DIGITS * sizeof(*global));
+    qt_internal_aligned_free(arg.digits, CACHELINE_WIDTH);
+    qt_internal_aligned_free(arg.offsets, CACHELINE_WIDTH);
+} /*}}}*/
+
+/* Sample sort: a sorted sample of the records picks one splitter per block
+ * boundary; every record is moved to its splitters' bucket, and then every
+ * bucket is sorted on its own, in parallel, with the libc qsort(). */
+struct qutil_sample_args {
+    char        *array;
+    char        *scratch;
+    size_t       nmemb, size, nblocks;
+    qutil_cmp_f  cmp;
+    const char  *splitters;            /* nblocks - 1 of them */
+    uint16_t    *bucket_of;
+    size_t      *offsets;              /* nblocks x nblocks */
+    size_t      *bucket_start;         /* nblocks + 1 */
+};
+
+static void qutil_sample_classify(const size_t startat,
+                                  const size_t stopat,
+                                  void        *arg_)
+{   /*{{{*/
+    struct qutil_sample_args *arg = (struct qutil_sample_args *)arg_;
+
+    for (size_t b = startat; b < stopat; b++) {
+        const size_t start   = BLOCK_START(arg->nmemb, arg->nblocks, b);
+        const size_t stop    = BLOCK_START(arg->nmemb, arg->nblocks, b + 1);
+        size_t      *offsets = arg->offsets + b * arg->nblocks;
+
+        memset(offsets, 0, arg->nblocks * sizeof(size_t));
+        for (size_t i = start; i < stop; i++) {
+            const char *rec = arg->array + i * arg->size;
+            size_t      lo  = 0, hi = arg->nblocks - 1;
+
+            /* the bucket is the number of splitters <= rec */
+            while (lo < hi) {
+                const size_t mid = lo + (hi - lo) / 2;
+
+                if (arg->cmp(arg->splitters + mid * arg->size, rec) <= 0) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            arg->bucket_of[i] = (uint16_t)lo;
+            offsets[lo]++;
+        }
+        qutil_touch(arg->scratch, start * arg->size, stop * arg->size);
+    }
+} /*}}}*/
+
+static void qutil_sample_scatter(const size_t startat,
+                                 const size_t stopat,
+                                 void        *arg_)
+{   /*{{{*/
+    struct qutil_sample_args *arg = (struct qutil_sample_args *)arg_;
+
+    for (size_t b = startat; b < stopat; b++) {
+        const size_t start   = BLOCK_START(arg->nmemb, arg->nblocks, b);
+        const size_t stop    = BLOCK_START(arg->nmemb, arg->nblocks, b + 1);
+        size_t      *offsets = arg->offsets + b * arg->nblocks;
+
+        for (size_t i = start; i < stop; i++) {
+            memcpy(arg->scratch + offsets[arg->bucket_of[i]]++ * arg->size,
+                   arg->array + i * arg->size, arg->size);
+        }
+    }
+} /*}}}*/
+
+static void qutil_sample_bucket(const size_t startat,
+                                const size_t stopat,
+                                void        *arg_)
+{   /*{{{*/
+    struct qutil_sample_args *arg = (struct qutil_sample_args *)arg_;
+
+    for (size_t k = startat; k < stopat; k++) {
+        const size_t start = arg->bucket_start[k];
+        const size_t count = arg->bucket_start[k + 1] - start;
+
+        qsort(arg->scratch + start * arg->size, count, arg->size, arg->cmp);
+        memcpy(arg->array + start * arg->size, arg->scratch + start * arg->size,
+               count * arg->size);
+    }
+} /*}}}*/
+
+void API_FUNC qutil_sample_sort(void        *array,
+                                const size_t nmemb,
+                                const size_t size,
+                                qutil_cmp_f  cmp)
+{   /*{{{*/
+    struct qutil_sample_args arg;
+    size_t                   nsamples;
+    char                    *samples;
+    uint64_t                 rng = 0x9E3779B97F4A7C15ULL;
+
+    assert(qthread_library_initialized);
+    assert(cmp);
+    arg.nblocks = qutil_nblocks(nmemb, QUTIL_SAMPLE_MAX_BLOCKS);
+    if (arg.nblocks < 2) {
+        qsort(array, nmemb, size, cmp);
+        return;
+    }
+    arg.array = (char *)array;
+    arg.nmemb = nmemb;
+    arg.size  = size;
+    arg.cmp   = cmp;
+
+    /* one random record out of each of nsamples equal strides */
+    nsamples = arg.nblocks * QUTIL_SAMPLE_OVERSAMPLE;
+    samples  = MALLOC(nsamples * size);
+    assert(samples);
+    for (size_t i = 0; i < nsamples; i++) {
+        const size_t start = BLOCK_START(nmemb, nsamples, i);
+        const size_t width = BLOCK_START(nmemb, nsamples, i + 1) - start;
+
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        memcpy(samples + i * size, arg.array + (start + rng % width) * size, size);
+    }
+    qsort(samples, nsamples, size, cmp);
+    for (size_t i = 1; i < arg.nblocks; i++) {
+        memmove(samples + (i - 1) * size,
+                samples + (i * QUTIL_SAMPLE_OVERSAMPLE) * size, size);
+    }
+    arg.splitters = samples;
+
+    arg.scratch      = MALLOC(nmemb * size);
+    arg.bucket_of    = MALLOC(nmemb * sizeof(uint16_t));
+    arg.offsets      = MALLOC(arg.nblocks * arg.nblocks * sizeof(size_t));
+    arg.bucket_start = MALLOC((arg.nblocks + 1) * sizeof(size_t));
+    assert(arg.scratch && arg.bucket_of && arg.offsets && arg.bucket_start);
+
+    qutil_blocks(arg.nblocks, qutil_sample_classify, &arg);
+    {
+        size_t sum = 0;
+
+        for (size_t k = 0; k < arg.nblocks; k++) {
+            arg.bucket_start[k] = sum;
+            for (size_t b = 0; b < arg.nblocks; b++) {
+                const size_t count = arg.offsets[b * arg.nblocks + k];
+
+                arg.offsets[b * arg.nblocks + k] = sum;
+                sum                             += count;
+            }
+        }
+        arg.bucket_start[arg.nblocks] = sum;
+    }
+    qutil_blocks(arg.nblocks, qutil_sample_scatter, &arg);
+    qutil_blocks(arg.nblocks, qutil_sample_bucket, &arg);
+
+    FREE(samples, nsamples * size);
+    FREE(arg.scratch, nmemb * size);
+    FREE(arg.bucket_of, nmemb * sizeof(uint16_t));
+    FREE(arg.offsets, arg.nblocks * arg.nblocks * sizeof(size_t));
+    FREE(arg.bucket_start, (arg.nblocks + 1) * sizeof(size_t));
+} /*}}}*/
+
+void API_FUNC qutil_sort(void        *array,
+                         const size_t nmemb,
+                         const size_t size,
+                         qutil_key_f  key,
+                         qutil_cmp_f  cmp)
+{   /*{{{*/
+    if (key) {
+        qutil_radix_sort(array, nmemb, size, key);
+    } else {
+        qutil_sample_sort(array, nmemb, size, cmp);
+    }
+} /*}}}*/
+
+
+/* Scans: the first sweep sums each block, the serial step turns the block
+ * sums into each block's carry-in, and the second sweep scans each block
+ * from its carry-in. That reads the input twice and writes the output once,
+ * which is as little as a parallel scan can get away with. */
+#define TYPED_SCAN(_fname_, _prefix_, _rtype_)                                          \
+    struct _prefix_ ## _scan_args {                                                     \
+        const _rtype_ *in;                                                              \
+        _rtype_       *out;                                                             \
+        _rtype_       *sums;                                                            \
+        size_t         length, nblocks;                                                 \
+        int            exclusive;                                                       \
+    };                                                                                  \
+    static void _prefix_ ## _scan_reduce(const size_t startat,                          \
+                                         const size_t stopat,                           \
+                                         void        *arg_)                             \
+    {                                                                                   \
+        struct _prefix_ ## _scan_args *arg = arg_;                                      \
+        for (size_t b = startat; b < stopat; b++) {                                     \
+            const size_t stop = BLOCK_START(arg->length, arg->nblocks, b + 1);          \
+            _rtype_      sum  = 0;                                                      \
+            for (size_t i = BLOCK_START(arg->length, arg->nblocks, b); i < stop; i++) { \
+                sum += arg->in[i];                                                      \
+            }                                                                           \
+            arg->sums[b] = sum;                                                         \
+        }                                                                               \
+    }                                                                                   \
+    static void _prefix_ ## _scan_sweep(const size_t startat,                           \
+                                        const size_t stopat,                            \
+                                        void        *arg_)                              \
+    {                                                                                   \
+        struct _prefix_ ## _scan_args *arg = arg_;                                      \
+        for (size_t b = startat; b < stopat; b++) {                                     \
+            const size_t stop = BLOCK_START(arg->length, arg->nblocks, b + 1);          \
+            _rtype_      acc  = arg->sums[b];                                           \
+            size_t       i    = BLOCK_START(arg->length, arg->nblocks, b);              \
+            if (arg->exclusive) {                                                       \
+                for (; i < stop; i++) {                                                 \
+                    const _rtype_ v = arg->in[i];                                       \
+                    arg->out[i] = acc;                                                  \
+                    acc        += v;                                                    \
+                }                                                                       \
+            } else {                                                                    \
+                for (; i < stop; i++) {                                                 \
+                    acc        += arg->in[i];                                           \
+                    arg->out[i] = acc;                                                  \
+                }                                                                       \
+            }                                                                           \
+            arg->sums[b] = acc;         /* the scan through the end of this block */    \
+        }                                                                               \
+    }                                                                                   \
+    _rtype_ API_FUNC _fname_(const _rtype_ * in, _rtype_ * out, size_t length,          \
+                             int exclusive)                                             \
+    {                                                                                   \
+        struct _prefix_ ## _scan_args arg = { in, out, NULL, length,                    \
+                                              qutil_nblocks(length, SIZE_MAX),          \
+                                              exclusive };                              \
+        _rtype_ carry = 0, total;                                                       \
+        assert(qthread_library_initialized);                                            \
+        arg.sums = MALLOC(arg.nblocks * sizeof(_rtype_));                               \
+        assert(arg.sums);                                                               \
+        if (arg.nblocks > 1) {                                                          \
+            qt_loop(0, arg.nblocks, _prefix_ ## _scan_reduce, &arg);                    \
+        } else {                                                                        \
+            arg.sums[0] = 0;                                                            \
+        }                                                                               \
+        for (size_t b = 0; b < arg.nblocks; b++) {                                      \
+            const _rtype_ sum = arg.sums[b];                                            \
+            arg.sums[b] = carry;                                                        \
+            carry      += sum;                                                          \
+        }                                                                               \
+        qutil_blocks(arg.nblocks, _prefix_ ## _scan_sweep, &arg);                       \
+        total = arg.sums[arg.nblocks - 1];                                              \
+        FREE(arg.sums, arg.nblocks * sizeof(_rtype_));                                  \
+        return total;                                                                   \
+    }
+
+TYPED_SCAN(qutil_double_scan, qutil_ds, double)
+TYPED_SCAN(qutil_uint_scan, qutil_uis, aligned_t)
+TYPED_SCAN(qutil_int_scan, qutil_is, saligned_t)
+
+/* The same, for records of any size and any associative op. An identity is
+ * only needed for exclusive scans; without one, the first block starts from
+ * its first record. */
+struct qutil_scan_args {
+    const char  *in;
+    char        *out;
+    char        *sums;                 /* one record per block */
+    size_t       nmemb, size, nblocks;
+    qt_accum_f   op;
+    const void  *identity;
+    int          exclusive;
+};
+
+static void qutil_scan_reduce(const size_t startat,
+                              const size_t stopat,
+                              void        *arg_)
+{   /*{{{*/
+    struct qutil_scan_args *arg = (struct qutil_scan_args *)arg_;
+
+    for (size_t b = startat; b < stopat; b++) {
+        const size_t start = BLOCK_START(arg->nmemb, arg->nblocks, b);
+        const size_t stop  = BLOCK_START(arg->nmemb, arg->nblocks, b + 1);
+        char *const  sum   = arg->sums + b * arg->size;
+
+        memcpy(sum, arg->in + start * arg->size, arg->size);
+        for (size_t i = start + 1; i < stop; i++) {
+            arg->op(sum, arg->in + i * arg->size);
+        }
+    }
+} /*}}}*/
+
+static void qutil_scan_sweep(const size_t startat,
+                             const size_t stopat,
+                             void        *arg_)
+{   /*{{{*/
+    struct qutil_scan_args *arg = (struct qutil_scan_args *)arg_;
+    const size_t            size = arg->size;
+    char                   *tmp  = MALLOC(size);
+
+    assert(tmp);
+    for (size_t b = startat; b < stopat; b++) {
+        const size_t stop = BLOCK_START(arg->nmemb, arg->nblocks, b + 1);
+        size_t       i    = BLOCK_START(arg->nmemb, arg->nblocks, b);
+        char *const  acc  = arg->sums + b * size;
+
+        if ((b == 0) && (arg->identity == NULL)) {
+            /* nothing to carry in; inclusive only */
+            memcpy(acc, arg->in, size);
+            memcpy(arg->out, acc, size);
+            i++;
+        }
+        if (arg->exclusive) {
+            for (; i < stop; i++) {
+                memcpy(tmp, arg->in + i * size, size);
+                memcpy(arg->out + i * size, acc, size);
+                arg->op(acc, tmp);
+            }
+        } else {
+            for (; i < stop; i++) {
+                arg->op(acc, arg->in + i * size);
+                memcpy(arg->out + i * size, acc, size);
+            }
+        }
+    }
+    FREE(tmp, size);
+} /*}}}*/
+
+/* Replaces each of the n partial sums with the sum of all those before it
+ * (starting from the identity, if there is one; otherwise the first partial
+ * sum is left alone, as its block/segment starts from its own first record).
+ * tmp is room for two records. */
+static void qutil_scan_carry_in(char        *sums,
+                                const size_t n,
+                                const size_t size,
+                                qt_accum_f   op,
+                                const void  *identity,
+                                char        *tmp)
+{   /*{{{*/
+    char *const carry = tmp;
+    char *const sum   = tmp + size;
+
+    memcpy(carry, identity ? identity : (const void *)sums, size);
+    for (size_t b = 0; b < n; b++) {
+        memcpy(sum, sums + b * size, size);
+        if ((b > 0) || identity) {
+            memcpy(sums + b * size, carry, size);
+            op(carry, sum);
+        }
+    }
+} /*}}}*/
+
+void API_FUNC qutil_scan(const void  *in,
+                         void        *out,
+                         const size_t nmemb,
+                         const size_t size,
+                         qt_accum_f   op,
+                         const void  *identity,
+                         const int    exclusive)
+{   /*{{{*/
+    struct qutil_scan_args arg;
+    char                  *carry;
+
+    assert(qthread_library_initialized);
+    assert(op);
+    assert(identity || !exclusive);
+    if (nmemb == 0) { return; }
+
+    arg.in        = (const char *)in;
+    arg.out       = (char *)out;
+    arg.nmemb     = nmemb;
+    arg.size      = size;
+    arg.nblocks   = qutil_nblocks(nmemb, SIZE_MAX);
+    arg.op        = op;
+    arg.identity  = identity;
+    arg.exclusive = exclusive;
+    arg.sums      = MALLOC((arg.nblocks + 2) * size);
+    assert(arg.sums);
+    carry = arg.sums + arg.nblocks * size;
+
+    if (arg.nblocks > 1) {
+        qt_loop(0, arg.nblocks, qutil_scan_reduce, &arg);
+        qutil_scan_carry_in(arg.sums, arg.nblocks, size, op, identity, carry);
+    } else if (identity) {
+        memcpy(arg.sums, identity, size);
+    }
+    qutil_blocks(arg.nblocks, qutil_scan_sweep, &arg);
+    FREE(arg.sums, (arg.nblocks + 2) * size);
+} /*}}}*/
+
+/* Compaction and partitioning: the first sweep counts each block's records
+ * that satisfy the predicate, the serial step turns the counts into each
+ * block's output positions, and the second sweep copies the records there,
+ * in their original order. The predicate is evaluated in both sweeps. */
+struct qutil_select_args {
+    const char   *in;
+    char         *out;
+    size_t        nmemb, size, nblocks;
+    qutil_pred_f  pred;
+    size_t       *offsets;             /* nblocks of them, then nblocks more */
+    int           partition;
+};
+
+static void qutil_select_count(const size_t startat,
+                               const size_t stopat,
+                               void        *arg_)
+{   /*{{{*/
+    struct qutil_select_args *arg = (struct qutil_select_args *)arg_;
+
+    for (size_t b = startat; b < stopat; b++) {
+        const size_t stop  = BLOCK_START(arg->nmemb, arg->nblocks, b + 1);
+        size_t       count = 0;
+
+        for (size_t i = BLOCK_START(arg->nmemb, arg->nblocks, b); i < stop; i++) {
+            count += (arg->pred(arg->in + i * arg->size) != 0);
+        }
+        arg->offsets[b] = count;
+        if (arg->partition) {
+            /* out is our scratch buffer */
+            qutil_touch(arg->out, BLOCK_START(arg->nmemb, arg->nblocks, b) * arg->size,
+                        stop * arg->size);
+        }
+    }
+} /*}}}*/
+
+/* kept records go to offsets[b] and, when partitioning, the rest go to
+ * offsets[nblocks + b] */
+static void qutil_select_copy(const size_t startat,
+                              const size_t stopat,
+                              void        *arg_)
+{   /*{{{*/
+    struct qutil_select_args *arg  = (struct qutil_select_args *)arg_;
+    const size_t              size = arg->size;
+
+    for (size_t b = startat; b < stopat; b++) {
+        const size_t stop = BLOCK_START(arg->nmemb, arg->nblocks, b + 1);
+        char        *yes  = arg->out + arg->offsets[b] * size;
+        char        *no   = arg->partition ? arg->out + arg->offsets[arg->nblocks + b] * size : NULL;
+
+        for (size_t i = BLOCK_START(arg->nmemb, arg->nblocks, b); i < stop; i++) {
+            const char *rec = arg->in + i * size;
+
+            if (arg->pred(rec)) {
+                memcpy(yes, rec, size);
+                yes += size;
+            } else if (no) {
+                memcpy(no, rec, size);
+                no += size;
+            }
+        }
+    }
+} /*}}}*/
+
+static size_t qutil_select(struct qutil_select_args *arg)
+{   /*{{{*/
+    size_t kept = 0, rest;
+
+    arg->nblocks = qutil_nblocks(arg->nmemb, SIZE_MAX);
+    arg->offsets = MALLOC(2 * arg->nblocks * sizeof(size_t));
+    assert(arg->offsets);
+    qutil_blocks(arg->nblocks, qutil_select_count, arg);
+    for (size_t b = 0; b < arg->nblocks; b++) {
+        const size_t count = arg->offsets[b];
+
+        arg->offsets[b] = kept;
+        kept           += count;
+    }
+    rest = kept;
+    for (size_t b = 0; b < arg->nblocks; b++) {
+        const size_t blocksize = BLOCK_START(arg->nmemb, arg->nblocks, b + 1) -
+                                 BLOCK_START(arg->nmemb, arg->nblocks, b);
+        const size_t nkept     = ((b + 1 < arg->nblocks) ? arg->offsets[b + 1] : kept) -
+                                 arg->offsets[b];
+
+        arg->offsets[arg->nblocks + b] = rest;
+        rest                          += blocksize - nkept;
+    }
+    qutil_blocks(arg->nblocks, qutil_select_copy, arg);
+    FREE(arg->offsets, 2 * arg->nblocks * sizeof(size_t));
+    return kept;
+} /*}}}*/
+
+size_t API_FUNC qutil_compact(const void  *in,
+                              void        *out,
+                              const size_t nmemb,
+                              const size_t size,
+                              qutil_pred_f pred)
+{   /*{{{*/
+    struct qutil_select_args arg;
+
+    assert(qthread_library_initialized);
+    assert(pred);
+    if (nmemb == 0) { return 0; }
+    arg.in        = (const char *)in;
+    arg.out       = (char *)out;
+    arg.nmemb     = nmemb;
+    arg.size      = size;
+    arg.pred      = pred;
+    arg.partition = 0;
+    return qutil_select(&arg);
+} /*}}}*/
+
+static void qutil_partition_copyback(const size_t startat,
+                                     const size_t stopat,
+                                     void        *arg_)
+{   /*{{{*/
+    struct qutil_select_args *arg = (struct qutil_select_args *)arg_;
+
+    for (size_t b = startat; b < stopat; b++) {
+        const size_t start = BLOCK_START(arg->nmemb, arg->nblocks, b);
+        const size_t stop  = BLOCK_START(arg->nmemb, arg->nblocks, b + 1);
+
+        memcpy((char *)arg->in + start * arg->size, arg->out + start * arg->size,
+               (stop - start) * arg->size);
+    }
+} /*}}}*/
+
+size_t API_FUNC qutil_partition(void        *array,
+                                const size_t nmemb,
+                                const size_t size,
+                                qutil_pred_f pred)
+{   /*{{{*/
+    struct qutil_select_args arg;
+    size_t                   kept;
+
+    assert(qthread_library_initialized);
+    assert(pred);
+    if (nmemb == 0) { return 0; }
+    arg.in        = (const char *)array;
+    arg.out       = MALLOC(nmemb * size);
+    arg.nmemb     = nmemb;
+    arg.size      = size;
+    arg.pred      = pred;
+    arg.partition = 1;
+    assert(arg.out);
+    kept = qutil_select(&arg);
+    qutil_blocks(arg.nblocks, qutil_partition_copyback, &arg);
+    FREE(arg.out, nmemb * size);
+    return kept;
+} /*}}}*/
+
+/* Histograms: every block counts into a private row of counters, and the
+ * rows are then summed, in parallel, a range of buckets at a time. When
+ * there are many more buckets than records per block, fewer blocks are
+ * used, so that the rows never outweigh the records. */
+struct qutil_histogram_args {
+    const char     *in;
+    size_t          nmemb, size, nblocks;
+    qutil_bucket_f  bucket;
+    size_t          nbuckets;
+    size_t         *rows;              /* nblocks x nbuckets */
+    size_t         *counts;
+};
+
+static void qutil_histogram_count(const size_t startat,
+                                  const size_t stopat,
+                                  void        *arg_)
+{   /*{{{*/
+    struct qutil_histogram_args *arg = (struct qutil_histogram_args *)arg_;
+
+    for (size_t b = startat; b < stopat; b++) {
+        const size_t stop = BLOCK_START(arg->nmemb, arg->nblocks, b + 1);
+        size_t      *row  = (arg->nblocks == 1) ? arg->counts : arg->rows + b * arg->nbuckets;
+
+        memset(row, 0, arg->nbuckets * sizeof(size_t));
+        for (size_t i = BLOCK_START(arg->nmemb, arg->nblocks, b); i < stop; i++) {
+            const size_t k = arg->bucket(arg->in + i * arg->size);
+
+            assert(k < arg->nbuckets);
+            row[k]++;
+        }
+    }
+} /*}}}*/
+
+static void qutil_histogram_sum(const size_t startat,
+                                const size_t stopat,
+                                void        *arg_)
+{   /*{{{*/
+    struct qutil_histogram_args *arg = (struct qutil_histogram_args *)arg_;
+
+    for (size_t r = startat; r < stopat; r++) {
+        const size_t stop = BLOCK_START(arg->nbuckets, arg->nblocks, r + 1);
+
+        for (size_t k = BLOCK_START(arg->nbuckets, arg->nblocks, r); k < stop; k++) {
+            size_t sum = 0;
+
+            for (size_t b = 0; b < arg->nblocks; b++) {
+                sum += arg->rows[b * arg->nbuckets + k];
+            }
+            arg->counts[k] = sum;
+        }
+    }
+} /*}}}*/
+
+void API_FUNC qutil_histogram(const void    *in,
+                              const size_t   nmemb,
+                              const size_t   size,
+                              qutil_bucket_f bucket,
+                              const size_t   nbuckets,
+                              size_t        *counts)
+{   /*{{{*/
+    struct qutil_histogram_args arg;
+
+    assert(qthread_library_initialized);
+    assert(bucket);
+    if (nbuckets == 0) { return; }
+    arg.in       = (const char *)in;
+    arg.nmemb    = nmemb;
+    arg.size     = size;
+    arg.bucket   = bucket;
+    arg.nbuckets = nbuckets;
+    arg.counts   = counts;
+    arg.nblocks  = qutil_nblocks(nmemb, (nmemb / nbuckets > 0) ? nmemb / nbuckets : 1);
+    if (arg.nblocks == 1) {
+        arg.rows = NULL;
+        qutil_histogram_count(0, 1, &arg);
+        return;
+    }
+    arg.rows = MALLOC(arg.nblocks * nbuckets * sizeof(size_t));
+    assert(arg.rows);
+    qt_loop(0, arg.nblocks, qutil_histogram_count, &arg);
+    qt_loop(0, arg.nblocks, qutil_histogram_sum, &arg);
+    FREE(arg.rows, arg.nblocks * nbuckets * sizeof(size_t));
+} /*}}}*/
+
+/* The qarray versions make the same two sweeps with qarray_iter_constloop(),
+ * so that each segment is handled by the shepherd it lives on, and keep their
+ * partial results per segment rather than per block. The output array should
+ * be distributed like the input (see qarray_dist_like()), so that the
+ * writes are local too. */
+struct qutil_qarray_args {
+    qarray         *out;
+    size_t          nsegs;
+    qt_accum_f      op;
+    const void     *identity;
+    int             exclusive;
+    char           *sums;              /* one record per segment */
+    qutil_pred_f    pred;
+    size_t         *offsets;           /* nsegs of them, then nsegs more */
+    int             partition;
+    qutil_bucket_f  bucket;
+    size_t          nbuckets;
+    size_t         *counts;
+};
+
+/* the end of the stretch of index i's segment that is in [i, stop) */
+static QINLINE size_t qutil_qarray_seg_end(const qarray *a,
+                                           const size_t  i,
+                                           const size_t  stop)
+{   /*{{{*/
+    const size_t end = (i / a->segment_size + 1) * a->segment_size;
+
+    return (end < stop) ? end : stop;
+} /*}}}*/
+
+static void qutil_qarray_scan_reduce(const size_t  startat,
+                                     const size_t  stopat,
+                                     const qarray *a,
+                                     void         *arg_)
+{   /*{{{*/
+    struct qutil_qarray_args *arg  = (struct qutil_qarray_args *)arg_;
+    const size_t              size = a->unit_size;
+
+    for (size_t first = startat, last; first < stopat; first = last) {
+        const char *rec = qarray_elem_nomigrate(a, first);
+        char *const sum = arg->sums + (first / a->segment_size) * size;
+
+        last = qutil_qarray_seg_end(a, first, stopat);
+        memcpy(sum, rec, size);
+        for (size_t i = first + 1; i < last; i++) {
+            rec += size;
+            arg->op(sum, rec);
+        }
+    }
+} /*}}}*/
+
+static void qutil_qarray_scan_sweep(const size_t  startat,
+                                    const size_t  stopat,
+                                    const qarray *a,
+                                    void         *arg_)
+{   /*{{{*/
+    struct qutil_qarray_args *arg  = (struct qutil_qarray_args *)arg_;
+    const size_t              size = a->unit_size;
+    char                     *tmp  = MALLOC(size);
+
+    assert(tmp);
+    for (size_t first = startat, last; first < stopat; first = last) {
+        const char *rec = qarray_elem_nomigrate(a, first);
+        char *const acc = arg->sums + (first / a->segment_size) * size;
+        size_t      i   = first;
+
+        last = qutil_qarray_seg_end(a, first, stopat);
+        if ((first == 0) && (arg->identity == NULL)) {
+            memcpy(acc, rec, size);
+            memcpy(qarray_elem_nomigrate(arg->out, 0), acc, size);
+            rec += size;
+            i++;
+        }
+        for (; i < last; i++, rec += size) {
+            char *const dst = qarray_elem_nomigrate(arg->out, i);
+
+            if (arg->exclusive) {
+                memcpy(tmp, rec, size);
+                memcpy(dst, acc, size);
+                arg->op(acc, tmp);
+            } else {
+                arg->op(acc, rec);
+                memcpy(dst, acc, size);
+            }
+        }
+    }
+    FREE(tmp, size);
+} /*}}}*/
+
+void API_FUNC qutil_qarray_scan(const qarray *in,
+                                qarray       *out,
+                                qt_accum_f    op,
+                                const void   *identity,
+                                const int     exclusive)
+{   /*{{{*/
+    struct qutil_qarray_args arg;
+    const size_t             size = in->unit_size;
+
+    assert(qthread_library_initialized);
+    assert(op);
+    assert(identity || !exclusive);
+    assert(out->count >= in->count && out->unit_size == size);
+    if (in->count == 0) { return; }
+
+    arg.out       = out;
+    arg.nsegs     = QT_CEIL_RATIO(in->count, in->segment_size);
+    arg.op        = op;
+    arg.identity  = identity;
+    arg.exclusive = exclusive;
+    arg.sums      = MALLOC((arg.nsegs + 2) * size);
+    assert(arg.sums);
+
+    qarray_iter_constloop(in, 0, in->count, qutil_qarray_scan_reduce, &arg);
+    qutil_scan_carry_in(arg.sums, arg.nsegs, size, op, identity,
+                        arg.sums + arg.nsegs * size);
+    qarray_iter_constloop(in, 0, in->count, qutil_qarray_scan_sweep, &arg);
+    FREE(arg.sums, (arg.nsegs + 2) * size);
+} /*}}}*/
+
+static void qutil_qarray_select_count(const size_t  startat,
+                                      const size_t  stopat,
+                                      const qarray *a,
+                                      void         *arg_)
+{   /*{{{*/
+    struct qutil_qarray_args *arg = (struct qutil_qarray_args *)arg_;
+
+    for (size_t first = startat, last; first < stopat; first = last) {
+        const char *rec   = qarray_elem_nomigrate(a, first);
+        size_t      count = 0;
+
+        last = qutil_qarray_seg_end(a, first, stopat);
+        for (size_t i = first; i < last; i++, rec += a->unit_size) {
+            count += (arg->pred(rec) != 0);
+        }
+        arg->offsets[first / a->segment_size] = count;
+    }
+} /*}}}*/
+
+static void qutil_qarray_select_copy(const size_t  startat,
+                                     const size_t  stopat,
+                                     const qarray *a,
+                                     void         *arg_)
+{   /*{{{*/
+    struct qutil_qarray_args *arg  = (struct qutil_qarray_args *)arg_;
+    const size_t              size = a->unit_size;
+
+    for (size_t first = startat, last; first < stopat; first = last) {
+        const size_t seg = first / a->segment_size;
+        const char  *rec = qarray_elem_nomigrate(a, first);
+        size_t       yes = arg->offsets[seg];
+        size_t       no  = arg->offsets[arg->nsegs + seg];
+
+        last = qutil_qarray_seg_end(a, first, stopat);
+        for (size_t i = first; i < last; i++, rec += size) {
+            if (arg->pred(rec)) {
+                memcpy(qarray_elem_nomigrate(arg->out, yes++), rec, size);
+            } else if (arg->partition) {
+                memcpy(qarray_elem_nomigrate(arg->out, no++), rec, size);
+            }
+        }
+    }
+} /*}}}*/
+
+static size_t qutil_qarray_select(const qarray             *in,
+                                  struct qutil_qarray_args *arg)
+{   /*{{{*/
+    size_t kept = 0, rest;
+
+    assert(qthread_library_initialized);
+    assert(arg->pred);
+    assert(arg->out->count >= in->count && arg->out->unit_size == in->unit_size);
+    if (in->count == 0) { return 0; }
+
+    arg->nsegs   = QT_CEIL_RATIO(in->count, in->segment_size);
+    arg->offsets = MALLOC(2 * arg->nsegs * sizeof(size_t));
+    assert(arg->offsets);
+    qarray_iter_constloop(in, 0, in->count, qutil_qarray_select_count, arg);
+    for (size_t s = 0; s < arg->nsegs; s++) {
+        const size_t count = arg->offsets[s];
+
+        arg->offsets[s] = kept;
+        kept           += count;
+    }
+    rest = kept;
+    for (size_t s = 0; s < arg->nsegs; s++) {
+        const size_t segsize = ((s + 1 < arg->nsegs) ? (s + 1) * in->segment_size : in->count) -
+                               s * in->segment_size;
+        const size_t nkept   = ((s + 1 < arg->nsegs) ? arg->offsets[s + 1] : kept) -
+                               arg->offsets[s];
+
+        arg->offsets[arg->nsegs + s] = rest;
+        rest                        += segsize - nkept;
+    }
+    qarray_iter_constloop(in, 0, in->count, qutil_qarray_select_copy, arg);
+    FREE(arg->offsets, 2 * arg->nsegs * sizeof(size_t));
+    return kept;
+} /*}}}*/
+
+size_t API_FUNC qutil_qarray_compact(const qarray *in,
+                                     qarray       *out,
+                                     qutil_pred_f  pred)
+{   /*{{{*/
+    struct qutil_qarray_args arg;
+
+    arg.out       = out;
+    arg.pred      = pred;
+    arg.partition = 0;
+    return qutil_qarray_select(in, &arg);
+} /*}}}*/
+
+size_t API_FUNC qutil_qarray_partition(const qarray *in,
+                                       qarray       *out,
+                                       qutil_pred_f  pred)
+{   /*{{{*/
+    struct qutil_qarray_args arg;
+
+    arg.out       = out;
+    arg.pred      = pred;
+    arg.partition = 1;
+    return qutil_qarray_select(in, &arg);
+} /*}}}*/
+
+/* each stretch counts into a private row, then adds the row into the shared
+ * counts, one atomic increment per bucket it actually hit */
+static void qutil_qarray_histogram_count(const size_t  startat,
+                                         const size_t  stopat,
+                                         const qarray *a,
+                                         void         *arg_)
+{   /*{{{*/
+    struct qutil_qarray_args *arg = (struct qutil_qarray_args *)arg_;
+    size_t                   *row = MALLOC(arg->nbuckets * sizeof(size_t));
+
+    assert(row);
+    memset(row, 0, arg->nbuckets * sizeof(size_t));
+    for (size_t first = startat, last; first < stopat; first = last) {
+        const char *rec = qarray_elem_nomigrate(a, first);
+
+        last = qutil_qarray_seg_end(a, first, stopat);
+        for (size_t i = first; i < last; i++, rec += a->unit_size) {
+            const size_t k = arg->bucket(rec);
+
+            assert(k < arg->nbuckets);
+            row[k]++;
+        }
+    }
+    for (size_t k = 0; k < arg->nbuckets; k++) {
+        if (row[k]) {
+            qthread_incr(&arg->counts[k], row[k]);
+        }
+    }
+    FREE(row, arg->nbuckets * sizeof(size_t));
+} /*}}}*/
+
+void API_FUNC qutil_qarray_histogram(const qarray  *in,
+                                     qutil_bucket_f bucket,
+                                     const size_t   nbuckets,
+                                     size_t        *counts)
+{   /*{{{*/
+    struct qutil_qarray_args arg;
+
+    assert(qthread_library_initialized);
+    assert(bucket);
+    arg.bucket   = bucket;
+    arg.nbuckets = nbuckets;
+    arg.counts   = counts;
+    memset(counts, 0, nbuckets * sizeof(size_t));
+    if ((in->count == 0) || (nbuckets == 0)) { return; }
+    qarray_iter_constloop(in, 0, in->count, qutil_qarray_histogram_count, &arg);
+} /*}}}*/
+
 /* vim:set expandtab: */
@@ -358,6 +358,46 @@ static int qthread_syncvar_blocker_func(void        *dest,
 #define SYNCFEB_STATE_EMPTY_NO_WAITERS   0x2
 #define SYNCFEB_STATE_EMPTY_WITH_WAITERS 0x3
 
+#if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) ||    \
+    (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA64) ||      \
+    (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC64) || \
+    (QTHREAD_ASSEMBLY_ARCH == QTHREAD_SPARCV9_64))
+# define SYNCVAR_ATOMIC_LOADS
+#endif
+
+/* Uncontended transitions. If the syncvar is unlocked and in exactly the
+ * state `from' (i.e. nobody is queued on it), it can be moved to state `to'
+ * with a single CAS instead of a lock/modify/unlock round trip through
+ * qthread_mwaitc(). The new data is *data, or the old data if data is NULL.
+ * Returns 1 (and the old data, in *old) on success; 0 means the caller has to
+ * take the locked path. */
+static QINLINE int qthread_syncvar_fast(syncvar_t *restrict      addr,
+                                        const unsigned int       from,
+                                        const unsigned int       to,
+                                        const uint64_t *restrict data,
+                                        uint64_t *restrict       old)
+{                                      /*{{{ */
+#ifdef SYNCVAR_ATOMIC_LOADS
+    syncvar_t cur = *addr;
+    uint64_t  val;
+
+    if ((cur.u.s.lock != 0) || (cur.u.s.state != from)) {
+        return 0;
+    }
+    val = data ? *data : (uint64_t)cur.u.s.data;
+    if (qthread_cas64(&(addr->u.w), cur.u.w, BUILD_UNLOCKED_SYNCVAR(val, (uint64_t)to)) != cur.u.w) {
+        return 0;
+    }
+    qthread_debug(SYNCVAR_DETAILS, "addr(%p): %u => %u without locking\n", addr, from, to);
+    if (old) {
+        *old = cur.u.s.data;
+    }
+    return 1;
+#else
+    return 0;
+#endif
+}                                      /*}}} */
+
 int API_FUNC qthread_syncvar_readFF(uint64_t *restrict  dest,
                                     syncvar_t *restrict src)
 {                                      /*{{{ */
@@ -376,10 +416,7 @@ int API_FUNC qthread_syncvar_readFF(uint64_t *restrict  dest,
     QTHREAD_FEB_UNIQUERECORD(feb, src, me);
     QTHREAD_FEB_TIMER_START(febblock);
 
-#if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) ||    \
-    (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA64) ||      \
-    (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC64) || \
-    (QTHREAD_ASSEMBLY_ARCH == QTHREAD_SPARCV9_64))
+#ifdef SYNCVAR_ATOMIC_LOADS
     {
         /* I'm being optimistic here; this only works if a basic 64-bit load is
          * atomic (on most platforms it is). Thus, if I've done an atomic read
@@ -395,7 +432,7 @@ int API_FUNC qthread_syncvar_readFF(uint64_t *restrict  dest,
             return QTHREAD_SUCCESS;
         }
     }
-#endif /* if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_SPARCV9_64)) */
+#endif /* ifdef SYNCVAR_ATOMIC_LOADS */
     ret = qthread_mwaitc(src, SYNCFEB_FULL, INITIAL_TIMEOUT, &e);
     qthread_debug(SYNCVAR_DETAILS, "2 src(%p) = %x, ret = %x\n", src,
                   (uintptr_t)src->u.w, ret);
@@ -500,10 +537,7 @@ int API_FUNC qthread_syncvar_readFF_nb(uint64_t *restrict  dest,
         return qthread_syncvar_blocker_func(dest, src, READFF_NB);
     }
 
-#if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) ||    \
-    (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA64) ||      \
-    (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC64) || \
-    (QTHREAD_ASSEMBLY_ARCH == QTHREAD_SPARCV9_64))
+#ifdef SYNCVAR_ATOMIC_LOADS
     {
         /* I'm being optimistic here; this only works if a basic 64-bit load is
          * atomic (on most platforms it is). Thus, if I've done an atomic read
@@ -519,7 +553,7 @@ int API_FUNC qthread_syncvar_readFF_nb(uint64_t *restrict  dest,
             return QTHREAD_SUCCESS;
         }
     }
-#endif /* if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_SPARCV9_64)) */
+#endif /* ifdef SYNCVAR_ATOMIC_LOADS */
     ret = qthread_mwaitc(src, SYNCFEB_FULL, 1, &e);
     qthread_debug(SYNCVAR_DETAILS, "2 src(%p) = %x, ret = %x\n", src,
                   (uintptr_t)src->u.w, ret);
@@ -550,6 +584,14 @@ int API_FUNC qthread_syncvar_fill(syncvar_t *restrict addr)
     if (!shep) {
         return qthread_syncvar_nonblocker_func(addr, NULL, FILL);
     }
+#ifdef SYNCVAR_ATOMIC_LOADS
+    if ((addr->u.s.lock == 0) && ((addr->u.s.state & 2) == 0)) {
+        return QTHREAD_SUCCESS;        /* already full; nothing to do */
+    }
+#endif
+    if (qthread_syncvar_fast(addr, SYNCFEB_STATE_EMPTY_NO_WAITERS, SYNCFEB_STATE_FULL_NO_WAITERS, NULL, NULL)) {
+        return QTHREAD_SUCCESS;
+    }
     ret = qthread_mwaitc(addr, SYNCFEB_ANY, INT_MAX, &e);
     qthread_debug(SYNCVAR_DETAILS, "shep(%p), addr(%p) = %x (b)\n", shep, addr,
                   (uintptr_t)addr->u.w);
@@ -628,6 +670,14 @@ int API_FUNC qthread_syncvar_empty(syncvar_t *restrict addr)
     if (!shep) {
         return qthread_syncvar_nonblocker_func(addr, NULL, EMPTY);
     }
+#ifdef SYNCVAR_ATOMIC_LOADS
+    if ((addr->u.s.lock == 0) && ((addr->u.s.state & 2) == 2)) {
+        return QTHREAD_SUCCESS;        /* already empty; nothing to do */
+    }
+#endif
+    if (qthread_syncvar_fast(addr, SYNCFEB_STATE_FULL_NO_WAITERS, SYNCFEB_STATE_EMPTY_NO_WAITERS, NULL, NULL)) {
+        return QTHREAD_SUCCESS;
+    }
     ret = qthread_mwaitc(addr, SYNCFEB_ANY, INT_MAX, &e);
     qthread_debug(SYNCVAR_DETAILS, "shep(%p), addr(%p) = %x (b)\n", shep, addr, (uintptr_t)addr->u.w);
     qassert_ret(e.cf == 0, QTHREAD_TIMEOUT); /* there better not have been a timeout */
@@ -708,6 +758,9 @@ int API_FUNC qthread_syncvar_readFE(uint64_t *restrict  dest,
     if (!me) {
         return qthread_syncvar_blocker_func(dest, src, READFE);
     }
+    if (qthread_syncvar_fast(src, SYNCFEB_STATE_FULL_NO_WAITERS, SYNCFEB_STATE_EMPTY_NO_WAITERS, NULL, dest)) {
+        return QTHREAD_SUCCESS;
+    }
 
     assert(me->rdata);
     assert(me->rdata->shepherd_ptr);
@@ -879,6 +932,9 @@ int API_FUNC qthread_syncvar_readFE_nb(uint64_t *restrict  dest,
     if (!me) {
         return qthread_syncvar_blocker_func(dest, src, READFE_NB);
     }
+    if (qthread_syncvar_fast(src, SYNCFEB_STATE_FULL_NO_WAITERS, SYNCFEB_STATE_EMPTY_NO_WAITERS, NULL, dest)) {
+        return QTHREAD_SUCCESS;
+    }
 
     assert(me->rdata);
     assert(me->rdata->shepherd_ptr);
@@ -963,7 +1019,7 @@ static QINLINE void qthread_syncvar_schedule(qthread_t          *waiter,
     QTPERF_QTHREAD_ENTER_STATE(waiter->rdata->performance_data, QTHREAD_STATE_RUNNING);
     if (waiter->flags & QTHREAD_UNSTEALABLE) {
         qt_threadqueue_enqueue(waiter->rdata->shepherd_ptr->ready, waiter);
-    } else {
+    } else if (!qthread_internal_handoff_offer(waiter, shep)) {
 #ifdef QTHREAD_USE_SPAWNCACHE
         if (!qt_spawncache_spawn(waiter, shep->ready))
 #endif
@@ -1134,6 +1190,10 @@ int API_FUNC qthread_syncvar_writeF(syncvar_t *restrict      dest,
     if (!shep) {
         return qthread_syncvar_nonblocker_func(dest, (void *)src, WRITEF);
     }
+    if (qthread_syncvar_fast(dest, SYNCFEB_STATE_FULL_NO_WAITERS, SYNCFEB_STATE_FULL_NO_WAITERS, src, NULL) ||
+        qthread_syncvar_fast(dest, SYNCFEB_STATE_EMPTY_NO_WAITERS, SYNCFEB_STATE_FULL_NO_WAITERS, src, NULL)) {
+        return QTHREAD_SUCCESS;
+    }
     QTHREAD_FEB_UNIQUERECORD2(feb, dest, shep);
     qthread_mwaitc(dest, SYNCFEB_ANY, INT_MAX, &e);
     qassert_ret(e.cf == 0, QTHREAD_TIMEOUT); /* there better not have been a timeout */
@@ -1215,6 +1275,9 @@ int API_FUNC qthread_syncvar_writeEF(syncvar_t *restrict      dest,
     if (!me) {
         return qthread_syncvar_blocker_func(dest, (void *)src, WRITEEF);
     }
+    if (qthread_syncvar_fast(dest, SYNCFEB_STATE_EMPTY_NO_WAITERS, SYNCFEB_STATE_FULL_NO_WAITERS, src, NULL)) {
+        return QTHREAD_SUCCESS;
+    }
     QTHREAD_FEB_UNIQUERECORD(feb, dest, me);
     QTHREAD_FEB_TIMER_START(febblock);
     (void)qthread_mwaitc(dest, SYNCFEB_EMPTY, INITIAL_TIMEOUT, &e);
@@ -1384,6 +1447,9 @@ int qthread_syncvar_writeEF_nb(syncvar_t *restrict      dest,
     if (!me) {
         return qthread_syncvar_blocker_func(dest, (void *)src, WRITEEF_NB);
     }
+    if (qthread_syncvar_fast(dest, SYNCFEB_STATE_EMPTY_NO_WAITERS, SYNCFEB_STATE_FULL_NO_WAITERS, src, NULL)) {
+        return QTHREAD_SUCCESS;
+    }
     (void)qthread_mwaitc(dest, SYNCFEB_EMPTY, 1, &e);
     if (e.cf) {                        /* there was a timeout */
         qthread_debug(SYNCVAR_BEHAVIOR, "tid %u non-blocking fail\n", me->thread_id);
@@ -1477,6 +1543,19 @@ uint64_t API_FUNC qthread_syncvar_incrF(syncvar_t *restrict operand,
     if (!me) {
         return qthread_syncvar_blocker_func(operand, (void *)&inc, INCR);
     }
+#ifdef SYNCVAR_ATOMIC_LOADS
+    {
+        /* unless someone is waiting for it to fill, the increment leaves the
+         * state alone, so an unlocked word can be bumped in place */
+        syncvar_t cur = *operand;
+        if ((cur.u.s.lock == 0) && (cur.u.s.state != SYNCFEB_STATE_EMPTY_WITH_WAITERS)) {
+            newv = cur.u.s.data + inc;
+            if (qthread_cas64(&(operand->u.w), cur.u.w, BUILD_UNLOCKED_SYNCVAR(newv, (uint64_t)cur.u.s.state)) == cur.u.w) {
+                return newv;
+            }
+        }
+    }
+#endif
     qthread_mwaitc(operand, SYNCFEB_ANY, INT_MAX, &e);
     qassert_ret(e.cf == 0, QTHREAD_TIMEOUT); /* there better not have been a timeout */
     if ((e.pf == 1) && (e.sf == 1)) {        /* there are waiters to release */
@@ -4,6 +4,10 @@
 
 /* System Headers */
 #include <qthread/qthread-int.h> /* for uint64_t */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
 
 #ifdef HAVE_SYS_SYSCALL_H
 # include <unistd.h>
@@ -19,14 +23,121 @@
 #include "qthread_innards.h" /* for qlib */
 #include "qt_qthread_mgmt.h"
 
+#if HAVE_SYSCALL && HAVE_DECL_SYS_ACCEPT
+# define QT_ACCEPT(s, a, l) syscall(SYS_accept, (s), (a), (l))
+#else
+# define QT_ACCEPT(s, a, l) accept((s), (a), (l))
+#endif
+
+/* Listening sockets that qt_accept() has made non-blocking for the tasks
+ * accepting on them right now, with the flags to put back when the last of
+ * them is done. The program may have made a socket non-blocking itself, in
+ * which case it should still get EAGAIN; this is how the two are told apart
+ * while several tasks accept on the same socket. */
+typedef struct qt_accepting_s {
+    int                    socket;
+    int                    flags;   /* as the program left them */
+    unsigned int           tasks;
+    struct qt_accepting_s *next;
+} qt_accepting_t;
+
+static qt_accepting_t    *accepting      = NULL;
+static volatile aligned_t accepting_lock = 0;
+
+static void qt_accepting_lock(void)
+{   /*{{{*/
+    do {
+        while (accepting_lock != 0) SPINLOCK_BODY();
+    } while (qthread_cas(&accepting_lock, 0, 1) != 0);
+} /*}}}*/
+
+static void qt_accepting_unlock(void)
+{   /*{{{*/
+    COMPILER_FENCE;
+    accepting_lock = 0;
+} /*}}}*/
+
+/* Makes socket non-blocking for the calling task, and sets *a to the entry to
+ * pass to qt_accepting_leave(); *a is NULL if that couldn't be done, and the
+ * call should go to a proxy. Returns nonzero, instead, if the call should be
+ * made just as it is: the program made socket non-blocking itself, or it
+ * isn't a descriptor at all. */
+static int qt_accepting_enter(int              socket,
+                              qt_accepting_t **a)
+{   /*{{{*/
+    qt_accepting_t *e;
+    int             flags;
+    int             inline_call = 0;
+
+    qt_accepting_lock();
+    for (e = accepting; e != NULL && e->socket != socket; e = e->next) ;
+    if (e != NULL) {
+        e->tasks++;
+    } else if (((flags = fcntl(socket, F_GETFL)) < 0) || (flags & O_NONBLOCK)) {
+        inline_call = 1;
+    } else if ((e = MALLOC(sizeof(qt_accepting_t))) != NULL) {
+        if (fcntl(socket, F_SETFL, flags | O_NONBLOCK) == 0) {
+            e->socket = socket;
+            e->flags  = flags;
+            e->tasks  = 1;
+            e->next   = accepting;
+            accepting = e;
+        } else {
+            FREE(e, sizeof(qt_accepting_t));
+            e = NULL;
+        }
+    }
+    qt_accepting_unlock();
+    *a = e;
+    return inline_call;
+} /*}}}*/
+
+static void qt_accepting_leave(qt_accepting_t *a)
+{   /*{{{*/
+    const int err = errno;
+
+    qt_accepting_lock();
+    if (--a->tasks == 0) {
+        qt_accepting_t **prev = &accepting;
+
+        while (*prev != a) {
+            prev = &(*prev)->next;
+        }
+        *prev = a->next;
+        (void)fcntl(a->socket, F_SETFL, a->flags);
+        FREE(a, sizeof(qt_accepting_t));
+    }
+    qt_accepting_unlock();
+    errno = err;
+} /*}}}*/
+
 int qt_accept(int                       socket,
               struct sockaddr *restrict address,
               socklen_t *restrict       address_len)
 {
-    qt_blocking_queue_node_t *job = ALLOC_SYSCALLJOB();
+    qt_blocking_queue_node_t *job;
     int                       ret;
     qthread_t                *me = qthread_internal_self();
+    qt_accepting_t           *a;
+
+    /* The socket is made non-blocking for as long as a task is accepting on
+     * it, so a connection can be taken without blocking, and the socket
+     * waited on if there is none yet. */
+    if (qt_accepting_enter(socket, &a)) {
+        return QT_ACCEPT(socket, address, address_len);
+    } else if (a != NULL) {
+        while ((ret = QT_ACCEPT(socket, address, address_len)) < 0 &&
+               ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            if (qt_blocking_subsystem_wait(socket, POLLIN) < 0) {
+                ret = -1;
+                break;
+            }
+        }
+        qt_accepting_leave(a);
+        return ret;
+    }
 
+    job = ALLOC_SYSCALLJOB();
     assert(job);
     job->next   = NULL;
     job->thread = me;
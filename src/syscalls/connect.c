@@ -4,6 +4,10 @@
 
 /* System Headers */
 #include <qthread/qthread-int.h> /* for uint64_t */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
 
 #ifdef HAVE_SYS_SYSCALL_H
 # include <unistd.h>
@@ -19,14 +23,55 @@
 #include "qthread_innards.h" /* for qlib */
 #include "qt_qthread_mgmt.h"
 
+#if HAVE_SYSCALL && HAVE_DECL_SYS_CONNECT
+# define QT_CONNECT(s, a, l) syscall(SYS_connect, (s), (a), (l))
+#else
+# define QT_CONNECT(s, a, l) connect((s), (a), (l))
+#endif
+
 int qt_connect(int                    socket,
                const struct sockaddr *address,
                socklen_t              address_len)
 {
-    qthread_t                *me  = qthread_internal_self();
-    qt_blocking_queue_node_t *job = ALLOC_SYSCALLJOB();
+    qthread_t                *me = qthread_internal_self();
+    qt_blocking_queue_node_t *job;
     int                       ret;
+    int                       flags = fcntl(socket, F_GETFL);
+
+    /* A socket the program made non-blocking can't block (and a ring would
+     * wait on it anyway). A blocking socket is made non-blocking just long
+     * enough to start connecting, and waited on until that finishes. (A
+     * local socket whose listener's backlog is full can't be waited on that
+     * way, and still needs a proxy.) */
+    if ((flags >= 0) && (flags & O_NONBLOCK)) {
+        return QT_CONNECT(socket, address, address_len);
+    } else if ((flags >= 0) &&
+        (fcntl(socket, F_SETFL, flags | O_NONBLOCK) == 0)) {
+        int       err = 0;
+        socklen_t len = sizeof(err);
+
+        ret = QT_CONNECT(socket, address, address_len);
+        if ((ret < 0) && (errno == EAGAIN)) {
+            (void)fcntl(socket, F_SETFL, flags);
+            goto proxy;
+        } else if ((ret < 0) && (errno == EINPROGRESS)) {
+            ret = qt_blocking_subsystem_wait(socket, POLLOUT);
+            if (ret >= 0) {
+                ret = getsockopt(socket, SOL_SOCKET, SO_ERROR, &err, &len);
+            }
+            if ((ret == 0) && (err != 0)) {
+                ret   = -1;
+                errno = err;
+            }
+        }
+        err = errno;
+        (void)fcntl(socket, F_SETFL, flags);
+        errno = err;
+        return ret;
+    }
 
+proxy:
+    job = ALLOC_SYSCALLJOB();
     assert(job);
     job->next   = NULL;
     job->thread = me;
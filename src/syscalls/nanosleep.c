@@ -15,9 +15,11 @@
 /* API Headers */
 #include "qthread/qthread.h"
 #include "qthread/qtimer.h"
+#include "qthread/qt_syscalls.h"
 
 /* Internal Headers */
 #include "qt_io.h"
+#include "qt_timers.h"
 #include "qthread_innards.h" /* for qlib */
 #include "qt_qthread_mgmt.h"
 
@@ -25,6 +27,14 @@ int qt_nanosleep(const struct timespec *rqtp,
                  struct timespec       *rmtp)
 {
     if (qt_blockable()) {
+#ifdef QTHREAD_USE_TIMER_WHEEL
+        qt_timer_sleep(NANOSLEEP, (uint64_t)rqtp->tv_sec * 1000000000 + rqtp->tv_nsec);
+        if (rmtp) {
+            rmtp->tv_sec  = 0;
+            rmtp->tv_nsec = 0;
+        }
+        return 0;
+#else
         qtimer_t t       = qtimer_create();
         double   seconds = rqtp->tv_sec + (rqtp->tv_nsec * 1e-9);
 
@@ -40,6 +50,7 @@ int qt_nanosleep(const struct timespec *rqtp,
         }
         qtimer_destroy(t);
         return 0;
+#endif
     } else {
         if (rmtp) {
             *rmtp = *rqtp;
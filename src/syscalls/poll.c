@@ -23,10 +23,20 @@ int qt_poll(struct pollfd fds[],
             nfds_t        nfds,
             int           timeout)
 {
-    qthread_t                *me  = qthread_internal_self();
-    qt_blocking_queue_node_t *job = ALLOC_SYSCALLJOB();
+    qthread_t                *me = qthread_internal_self();
+    qt_blocking_queue_node_t *job;
     int                       ret;
 
+    /* this can't block */
+    if (timeout == 0) {
+#if HAVE_SYSCALL && HAVE_DECL_SYS_POLL
+        return syscall(SYS_poll, fds, nfds, timeout);
+#else
+        return poll(fds, nfds, timeout);
+#endif
+    }
+
+    job = ALLOC_SYSCALLJOB();
     assert(job);
     job->next    = NULL;
     job->thread  = me;
@@ -5,6 +5,10 @@
 /* System Headers */
 #include <qthread/qthread-int.h> /* for uint64_t */
 
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>          /* for recv() */
+
 #ifdef HAVE_SYS_SYSCALL_H
 # include <unistd.h>
 # include <sys/syscall.h>        /* for SYS_accept and others */
@@ -19,14 +23,36 @@
 #include "qthread_innards.h" /* for qlib */
 #include "qt_qthread_mgmt.h"
 
+#if HAVE_SYSCALL && HAVE_DECL_SYS_READ
+# define QT_READ(f, b, n) syscall(SYS_read, (f), (b), (n))
+#else
+# define QT_READ(f, b, n) read((f), (b), (n))
+#endif
+
 ssize_t qt_read(int    filedes,
                 void  *buf,
                 size_t nbyte)
 {
-    qthread_t                *me  = qthread_internal_self();
-    qt_blocking_queue_node_t *job = ALLOC_SYSCALLJOB();
+    qthread_t                *me = qthread_internal_self();
+    qt_blocking_queue_node_t *job;
     ssize_t                   ret;
 
+    switch (qt_blocking_subsystem_fdmode(filedes, READ)) {
+        case QT_IO_FD_INLINE:
+            return QT_READ(filedes, buf, nbyte);
+
+        case QT_IO_FD_WAIT:
+            /* a socket can be read without blocking, and waited on if need be */
+            while ((ret = recv(filedes, buf, nbyte, MSG_DONTWAIT)) < 0 &&
+                   ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+                if (qt_blocking_subsystem_wait(filedes, POLLIN) < 0) {
+                    return -1;
+                }
+            }
+            return ret;
+    }
+
+    job = ALLOC_SYSCALLJOB();
     assert(job);
     job->next   = NULL;
     job->thread = me;
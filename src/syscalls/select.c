@@ -27,10 +27,20 @@ int qt_select(int                      nfds,
               fd_set *restrict         errorfds,
               struct timeval *restrict timeout)
 {
-    qthread_t                *me  = qthread_internal_self();
-    qt_blocking_queue_node_t *job = ALLOC_SYSCALLJOB();
+    qthread_t                *me = qthread_internal_self();
+    qt_blocking_queue_node_t *job;
     int                       ret;
 
+    /* this can't block */
+    if (timeout && (timeout->tv_sec == 0) && (timeout->tv_usec == 0)) {
+#if HAVE_SYSCALL && HAVE_DECL_SYS_SELECT
+        return syscall(SYS_select, nfds, readfds, writefds, errorfds, timeout);
+#else
+        return select(nfds, readfds, writefds, errorfds, timeout);
+#endif
+    }
+
+    job = ALLOC_SYSCALLJOB();
     assert(job);
     job->next   = NULL;
     job->thread = me;
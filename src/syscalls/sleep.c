@@ -13,9 +13,11 @@
 /* API Headers */
 #include "qthread/qthread.h"
 #include "qthread/qtimer.h"
+#include "qthread/qt_syscalls.h"
 
 /* Internal Headers */
 #include "qt_io.h"
+#include "qt_timers.h"
 #include "qt_asserts.h"
 #include "qthread_innards.h" /* for qlib */
 #include "qt_qthread_mgmt.h"
@@ -23,6 +25,10 @@
 unsigned int qt_sleep(unsigned int seconds)
 {
     if (qt_blockable()) {
+#ifdef QTHREAD_USE_TIMER_WHEEL
+        qt_timer_sleep(SLEEP, (uint64_t)seconds * 1000000000);
+        return 0;
+#else
         qtimer_t t = qtimer_create();
         qtimer_start(t);
         do {
@@ -31,6 +37,7 @@ unsigned int qt_sleep(unsigned int seconds)
         } while (qtimer_secs(t) < seconds);
         qtimer_destroy(t);
         return 0;
+#endif
     } else {
         return seconds;
     }
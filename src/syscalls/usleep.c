@@ -13,15 +13,21 @@
 /* Public Headers */
 #include "qthread/qthread.h"
 #include "qthread/qtimer.h"
+#include "qthread/qt_syscalls.h"
 
 /* Internal Headers */
 #include "qt_io.h"
+#include "qt_timers.h"
 #include "qthread_innards.h" /* for qlib */
 #include "qt_qthread_mgmt.h"
 
 int qt_usleep(useconds_t useconds)
 {
      if (qt_blockable()) {
+#ifdef QTHREAD_USE_TIMER_WHEEL
+        qt_timer_sleep(USLEEP, (uint64_t)useconds * 1000);
+        return 0;
+#else
         qtimer_t t       = qtimer_create();
         double   seconds = useconds * 1e-6;
         qtimer_start(t);
@@ -31,6 +37,7 @@ int qt_usleep(useconds_t useconds)
         } while (qtimer_secs(t) < seconds);
         qtimer_destroy(t);
         return 0;
+#endif
     } else {
         return -1;
     }
@@ -5,6 +5,10 @@
 /* System Headers */
 #include <qthread/qthread-int.h> /* for uint64_t */
 
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>          /* for send() */
+
 #ifdef HAVE_SYS_SYSCALL_H
 # include <unistd.h>
 # include <sys/syscall.h>        /* for SYS_accept and others */
@@ -19,14 +23,45 @@
 #include "qthread_innards.h" /* for qlib */
 #include "qt_qthread_mgmt.h"
 
+#if HAVE_SYSCALL && HAVE_DECL_SYS_WRITE
+# define QT_WRITE(f, b, n) syscall(SYS_write, (f), (b), (n))
+#else
+# define QT_WRITE(f, b, n) write((f), (b), (n))
+#endif
+
 ssize_t qt_write(int         filedes,
                  const void *buf,
                  size_t      nbyte)
 {
-    qthread_t                *me  = qthread_internal_self();
-    qt_blocking_queue_node_t *job = ALLOC_SYSCALLJOB();
+    qthread_t                *me   = qthread_internal_self();
+    qt_blocking_queue_node_t *job;
+    size_t                    done = 0;
     ssize_t                   ret;
 
+    switch (qt_blocking_subsystem_fdmode(filedes, WRITE)) {
+        case QT_IO_FD_INLINE:
+            return QT_WRITE(filedes, buf, nbyte);
+
+        case QT_IO_FD_WAIT:
+            /* a socket can be written without blocking, and waited on if need
+             * be; like a blocking write(), this keeps going until all of it is
+             * written */
+            for (;;) {
+                ret = send(filedes, (const char *)buf + done, nbyte - done, MSG_DONTWAIT);
+                if (ret >= 0) {
+                    done += ret;
+                    if (done == nbyte) {
+                        return done;
+                    }
+                } else if (((errno != EAGAIN) && (errno != EWOULDBLOCK)) ||
+                           (qt_blocking_subsystem_wait(filedes, POLLOUT) < 0)) {
+                    /* what was written before the error, if anything */
+                    return (done > 0) ? (ssize_t)done : -1;
+                }
+            }
+    }
+
+    job = ALLOC_SYSCALLJOB();
     assert(job);
     job->next   = NULL;
     job->thread = me;
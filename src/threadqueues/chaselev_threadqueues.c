@@ -0,0 +1,893 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Public Headers */
+#include "qthread/qthread.h"
+#include "qthread/cacheline.h"
+
+/* Internal Headers */
+#include "qt_alloc.h"
+#include "qt_visibility.h"
+#include "qthread_innards.h"           /* for qlib */
+#include "qt_shepherd_innards.h"
+#include "qt_qthread_struct.h"
+#include "qt_qthread_mgmt.h"
+#include "qt_asserts.h"
+#include "qt_prefetch.h"
+#include "qt_threadqueues.h"
+#include "qt_envariables.h"
+#include "qt_debug.h"
+#include "qt_atomics.h"
+#ifdef QTHREAD_USE_EUREKAS
+#include "qt_eurekas.h" /* for qt_eureka_check() */
+#endif /* QTHREAD_USE_EUREKAS */
+#include "qt_expect.h"
+#include "qt_subsystems.h"
+#include "qt_park.h"
+
+/* This is a work-stealing scheduler built on the Chase-Lev deque (see
+ * http://doi.acm.org/10.1145/1073970.1073974 and, for the memory-ordering
+ * details, http://doi.acm.org/10.1145/2442516.2442524).
+ *
+ * Every shepherd's queue contains one deque per worker. The owning worker
+ * pushes and pops the bottom of its deque without any locks or atomic
+ * read-modify-write operations (except when racing a thief for the last
+ * item); thieves take from the top with a single CAS. Enqueues that do not
+ * come from one of the queue's own workers (remote shepherds, external
+ * pthreads, yielded tasks) go onto a lock-free "inbox" stack, which the
+ * workers drain into their deques whenever their deques run dry.
+ *
+ * A worker that finds nothing anywhere spins, then yields, then parks until
+ * something is pushed that it could take.
+ */
+
+/* Loads of top/bottom in a steal must not be reordered, and the element
+ * store in a push must be visible before the new bottom is. TSO machines get
+ * that for free. */
+#if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) || \
+    (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA32))
+# define CL_ORDER_FENCE COMPILER_FENCE
+#else
+# define CL_ORDER_FENCE MACHINE_FENCE
+#endif
+
+#define CL_INITIAL_SIZE 256 /* must be a power of two */
+
+/* Data Structures */
+struct _qt_threadqueue_node {
+    struct _qt_threadqueue_node *next;
+    qthread_t                   *value;
+} /* qt_threadqueue_node_t */;
+
+typedef struct _qt_cl_array {
+    struct _qt_cl_array *prev; /* retired (smaller) array; thieves may still be reading it */
+    saligned_t           size;
+    qthread_t *volatile  buf[];
+} qt_cl_array_t;
+
+/* where an idle worker sleeps; padded so that wakers don't false-share */
+typedef struct {
+    qt_park_spot_t spot;
+    uint8_t        pad[CACHELINE_WIDTH - (sizeof(qt_park_spot_t) % CACHELINE_WIDTH)];
+} qt_threadqueue_spot_t;
+
+typedef struct {
+    volatile saligned_t     top;
+    uint8_t                 pad1[CACHELINE_WIDTH - sizeof(saligned_t)];
+    volatile saligned_t     bottom;
+    qt_cl_array_t *volatile array;
+    uint8_t                 pad2[CACHELINE_WIDTH - sizeof(saligned_t) - sizeof(void *)];
+} qt_cl_deque_t;
+
+struct _qt_threadqueue {
+    qt_cl_deque_t                  *deques; /* one per worker in the shepherd */
+    qt_threadqueue_node_t *volatile inbox;
+    saligned_t                      inbox_len;
+    qt_threadqueue_spot_t          *spots;   /* one per worker of this shepherd */
+    saligned_t                      nparked; /* how many of those are asleep */
+#ifdef STEAL_PROFILE
+    aligned_t steal_amount_stolen;
+#endif
+} /* qt_threadqueue_t */;
+
+/* The McCoy thread can only ever run on worker 0, so rather than letting it
+ * wander through the deques, it gets a slot of its own. */
+static qthread_t *volatile mccoy         = NULL;
+static int                 mccoy_turn    = 0; /* only touched by worker 0 */
+static aligned_t           steal_disable = 0;
+
+/* Idle workers spin for SPINCOUNT polls, then yield IDLE_YIELDS times, then
+ * park until an enqueue wakes them (or PARK_TIMEOUT usecs pass). */
+#ifdef QTHREAD_OVERSUBSCRIPTION
+# define DEFAULT_SPINCOUNT 300
+#else
+# define DEFAULT_SPINCOUNT 300000
+#endif
+#define IDLE_YIELDS  64
+#define PARK_TIMEOUT 100000
+static unsigned long idle_spincount = DEFAULT_SPINCOUNT;
+static saligned_t    parked_total   = 0;
+
+#ifdef STEAL_PROFILE
+# define STEAL_CALLED(shep)     qthread_incr( & ((shep)->steal_called), 1)
+# define STEAL_ELECTED(shep)    do {} while (0)
+# define STEAL_ATTEMPTED(shep)  qthread_incr( & ((shep)->steal_attempted), 1)
+# define STEAL_SUCCESSFUL(shep) do {} while (0)
+# define STEAL_FAILED(shep)     qthread_incr( & ((shep)->steal_failed), 1)
+# define STEAL_AMOUNT(q, ct)    qthread_incr( & ((q)->steal_amount_stolen), ct)
+#else
+# define STEAL_CALLED(shep)     do {} while(0)
+# define STEAL_ELECTED(shep)    do {} while(0)
+# define STEAL_ATTEMPTED(shep)  do {} while(0)
+# define STEAL_SUCCESSFUL(shep) do {} while(0)
+# define STEAL_FAILED(shep)     do {} while(0)
+# define STEAL_AMOUNT(q, ct)    do {} while(0)
+#endif /* ifdef STEAL_PROFILE */
+
+/* Memory Management */
+#if defined(UNPOOLED_QUEUES) || defined(UNPOOLED)
+# define ALLOC_THREADQUEUE() (qt_threadqueue_t *)MALLOC(sizeof(qt_threadqueue_t))
+# define FREE_THREADQUEUE(t) FREE(t, sizeof(qt_threadqueue_t))
+# define ALLOC_TQNODE()      (qt_threadqueue_node_t *)MALLOC(sizeof(qt_threadqueue_node_t))
+# define FREE_TQNODE(t)      FREE(t, sizeof(qt_threadqueue_node_t))
+void INTERNAL qt_threadqueue_subsystem_init(void)
+{   /*{{{*/
+    idle_spincount = qt_internal_get_env_num("SPINCOUNT", DEFAULT_SPINCOUNT, 0);
+} /*}}}*/
+#else /* if defined(UNPOOLED_QUEUES) || defined(UNPOOLED) */
+qt_threadqueue_pools_t generic_threadqueue_pools;
+# define ALLOC_THREADQUEUE() (qt_threadqueue_t *)qt_mpool_alloc(generic_threadqueue_pools.queues)
+# define FREE_THREADQUEUE(t) qt_mpool_free(generic_threadqueue_pools.queues, t)
+# define ALLOC_TQNODE()      (qt_threadqueue_node_t *)qt_mpool_alloc(generic_threadqueue_pools.nodes)
+# define FREE_TQNODE(t)      qt_mpool_free(generic_threadqueue_pools.nodes, t)
+
+static void qt_threadqueue_subsystem_shutdown(void)
+{   /*{{{*/
+    qt_mpool_destroy(generic_threadqueue_pools.nodes);
+    qt_mpool_destroy(generic_threadqueue_pools.queues);
+} /*}}}*/
+
+void INTERNAL qt_threadqueue_subsystem_init(void)
+{   /*{{{*/
+    generic_threadqueue_pools.queues = qt_mpool_create(sizeof(qt_threadqueue_t));
+    generic_threadqueue_pools.nodes  = qt_mpool_create_aligned(sizeof(qt_threadqueue_node_t),
+                                                               sizeof(void *));
+    idle_spincount                   = qt_internal_get_env_num("SPINCOUNT", DEFAULT_SPINCOUNT, 0);
+    qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
+} /*}}}*/
+#endif /* if defined(UNPOOLED_QUEUES) || defined(UNPOOLED) */
+
+#if defined(UNPOOLED_QTHREAD_T) || defined(UNPOOLED)
+# define FREE_QTHREAD(t) FREE(t, sizeof(qthread_t) + qlib->qthread_argcopy_size + qlib->qthread_tasklocal_size)
+#else
+extern qt_mpool generic_qthread_pool;
+# define FREE_QTHREAD(t) qt_mpool_free(generic_qthread_pool, t)
+#endif
+
+/*********************************/
+/* the Chase-Lev deque itself    */
+/*********************************/
+
+static qt_cl_array_t *qt_cl_array_new(saligned_t size)
+{   /*{{{*/
+    qt_cl_array_t *a = qt_malloc(sizeof(qt_cl_array_t) + size * sizeof(qthread_t *));
+
+    assert(a);
+    a->prev = NULL;
+    a->size = size;
+    return a;
+} /*}}}*/
+
+/* Only ever called by the owner, and only when the deque is full. The old
+ * array is kept around until the queue is freed, since a thief may have
+ * loaded it before the new one was published. */
+static qt_cl_array_t *qt_cl_grow(qt_cl_deque_t *d,
+                                 qt_cl_array_t *a,
+                                 saligned_t     b,
+                                 saligned_t     t)
+{   /*{{{*/
+    qt_cl_array_t *n = qt_cl_array_new(a->size << 1);
+
+    qthread_debug(THREADQUEUE_DETAILS, "d(%p): growing from %li to %li\n", d, (long)a->size, (long)n->size);
+    for (saligned_t i = t; i < b; i++) {
+        n->buf[i & (n->size - 1)] = a->buf[i & (a->size - 1)];
+    }
+    n->prev = a;
+    CL_ORDER_FENCE;
+    d->array = n;
+    return n;
+} /*}}}*/
+
+static QINLINE void qt_cl_push(qt_cl_deque_t *d,
+                               qthread_t     *t)
+{   /*{{{*/
+    saligned_t     b = d->bottom;
+    saligned_t     top = d->top;
+    qt_cl_array_t *a = d->array;
+
+    if (QTHREAD_UNLIKELY(b - top > a->size - 1)) {
+        a = qt_cl_grow(d, a, b, top);
+    }
+    a->buf[b & (a->size - 1)] = t;
+    CL_ORDER_FENCE;
+    d->bottom = b + 1;
+} /*}}}*/
+
+static QINLINE qthread_t *qt_cl_take(qt_cl_deque_t *d)
+{   /*{{{*/
+    saligned_t     b = d->bottom - 1;
+    qt_cl_array_t *a = d->array;
+    saligned_t     top;
+    qthread_t     *t = NULL;
+
+    d->bottom = b;
+    MACHINE_FENCE;
+    top = d->top;
+    if (top <= b) {
+        t = a->buf[b & (a->size - 1)];
+        if (top == b) {
+            /* last item: race the thieves for it */
+            if (qthread_cas(&d->top, top, top + 1) != top) {
+                t = NULL;
+            }
+            d->bottom = b + 1;
+        }
+    } else {
+        d->bottom = b + 1;
+    }
+    return t;
+} /*}}}*/
+
+/* Returns NULL if the deque was empty OR if another thief won the race;
+ * *contended distinguishes the two. */
+static QINLINE qthread_t *qt_cl_steal(qt_cl_deque_t *d,
+                                      int           *contended)
+{   /*{{{*/
+    saligned_t     top = d->top;
+    saligned_t     b;
+    qt_cl_array_t *a;
+    qthread_t     *t;
+
+    CL_ORDER_FENCE;
+    b = d->bottom;
+    if (top >= b) {
+        return NULL;
+    }
+    a = d->array;
+    t = a->buf[top & (a->size - 1)];
+    if (qthread_cas(&d->top, top, top + 1) != top) {
+        *contended = 1;
+        return NULL;
+    }
+    return t;
+} /*}}}*/
+
+static QINLINE qthread_t *qt_cl_steal_retry(qt_cl_deque_t *d)
+{   /*{{{*/
+    qthread_t *t;
+    int        contended;
+
+    do {
+        contended = 0;
+        t         = qt_cl_steal(d, &contended);
+    } while (t == NULL && contended);
+    return t;
+} /*}}}*/
+
+/*********************************/
+/* parking idle workers          */
+/*********************************/
+
+/* Wake worker i of q's shepherd, if it is parked. */
+static QINLINE int qt_threadqueue_unpark_worker(qt_threadqueue_t   *q,
+                                                qthread_worker_id_t i)
+{   /*{{{*/
+    qt_park_spot_t *spot = &q->spots[i].spot;
+
+    if ((spot->state == QT_PARK_PARKED) && qt_park_claim(spot)) {
+        (void)qthread_incr(&q->nparked, -1);
+        (void)qthread_incr(&parked_total, -1);
+        qt_park_wake(spot);
+        return 1;
+    }
+    return 0;
+} /*}}}*/
+
+/* Called after work has been made visible on q. Prefers a sleeper on q's own
+ * shepherd; if there is none and the work can be stolen, any sleeper will do,
+ * since it will find the work by stealing. */
+static QINLINE void qt_threadqueue_wake_one(qt_threadqueue_t *q,
+                                            int               stealable)
+{   /*{{{*/
+    /* pairs with the fence in qt_threadqueue_park(): either we see the
+     * sleeper, or the sleeper sees the work */
+    MACHINE_FENCE;
+    if (QTHREAD_LIKELY(parked_total == 0)) { return; }
+    if (q->nparked > 0) {
+        for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; ++i) {
+            if (qt_threadqueue_unpark_worker(q, i)) { return; }
+        }
+    }
+    if (stealable && !steal_disable) {
+        for (qthread_shepherd_id_t s = 0; s < qlib->nshepherds; ++s) {
+            qt_threadqueue_t *other = qlib->shepherds[s].ready;
+
+            if (other->nparked == 0) { continue; }
+            for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; ++i) {
+                if (qt_threadqueue_unpark_worker(other, i)) { return; }
+            }
+        }
+    }
+} /*}}}*/
+
+/* Returns nonzero if there is anything in q, or (if can_steal) in any other
+ * shepherd's queue, that worker w could take. */
+static int qt_threadqueue_has_work(qt_threadqueue_t *q,
+                                   qthread_worker_t *w,
+                                   int               can_steal)
+{   /*{{{*/
+    if ((q->inbox != NULL) || (mccoy && (w->packed_worker_id == 0))) { return 1; }
+    for (qthread_shepherd_id_t s = 0; s < qlib->nshepherds; ++s) {
+        qt_threadqueue_t *other = qlib->shepherds[s].ready;
+
+        if ((other != q) && !can_steal) { continue; }
+        for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; ++i) {
+            if (other->deques[i].bottom - other->deques[i].top > 0) { return 1; }
+        }
+    }
+    return 0;
+} /*}}}*/
+
+static void qt_threadqueue_park(qt_threadqueue_t *q,
+                                qthread_worker_t *w,
+                                int               can_steal)
+{   /*{{{*/
+    qt_park_spot_t *spot = &q->spots[w->worker_id].spot;
+
+    spot->state = QT_PARK_PARKED;
+    (void)qthread_incr(&q->nparked, 1);
+    (void)qthread_incr(&parked_total, 1);
+    MACHINE_FENCE;
+    /* re-check everything this worker could take */
+    if (!qt_threadqueue_has_work(q, w, can_steal)) {
+        qthread_debug(THREADQUEUE_DETAILS, "q(%p) worker %i parking\n", q, (int)w->worker_id);
+        qt_park_wait(spot, PARK_TIMEOUT);
+    }
+    /* if nobody claimed the spot, take it back ourselves */
+    if (qt_park_claim(spot)) {
+        (void)qthread_incr(&q->nparked, -1);
+        (void)qthread_incr(&parked_total, -1);
+    }
+} /*}}}*/
+
+/* One step of the idle policy: spin, then yield, then park. */
+static QINLINE void qt_threadqueue_idle(qt_threadqueue_t *q,
+                                        qthread_worker_t *w,
+                                        int               can_steal,
+                                        unsigned long    *idle)
+{   /*{{{*/
+    if (*idle < idle_spincount) {
+        SPINLOCK_BODY();
+        ++*idle;
+    } else if (*idle < idle_spincount + IDLE_YIELDS) {
+#ifdef HAVE_PTHREAD_YIELD
+        pthread_yield();
+#elif defined(HAVE_SCHED_YIELD)
+        sched_yield();
+#endif
+        ++*idle;
+    } else {
+        qt_threadqueue_park(q, w, can_steal);
+    }
+} /*}}}*/
+
+/*********************************/
+/* the inbox                     */
+/*********************************/
+
+static QINLINE void qt_threadqueue_inbox_push(qt_threadqueue_t *q,
+                                              qthread_t        *t)
+{   /*{{{*/
+    qt_threadqueue_node_t *node = ALLOC_TQNODE();
+    qt_threadqueue_node_t *old, *new;
+
+    assert(node != NULL);
+    node->value = t;
+
+    old = q->inbox;
+    do {
+        node->next = old;
+        new        = qthread_cas_ptr(&(q->inbox), old, node);
+        if (new != old) {
+            old = new;
+        } else {
+            break;
+        }
+    } while (1);
+    (void)qthread_incr(&(q->inbox_len), 1);
+    qt_threadqueue_wake_one(q, (t->flags & QTHREAD_UNSTEALABLE) == 0);
+} /*}}}*/
+
+/* Takes the whole inbox at once (which sidesteps ABA); the list comes back
+ * newest-first. */
+static QINLINE qt_threadqueue_node_t *qt_threadqueue_inbox_grab(qt_threadqueue_t *q)
+{   /*{{{*/
+    qt_threadqueue_node_t *head = q->inbox;
+    qt_threadqueue_node_t *old;
+    saligned_t             count = 0;
+
+    while (head != NULL) {
+        old = qthread_cas_ptr(&(q->inbox), head, NULL);
+        if (old == head) { break; }
+        head = old;
+    }
+    for (old = head; old != NULL; old = old->next) count++;
+    if (count) {
+        (void)qthread_incr(&(q->inbox_len), -count);
+    }
+    return head;
+} /*}}}*/
+
+/* Pushing newest-first means the oldest arrival ends up on the bottom of the
+ * deque, so it is the first one popped. */
+static QINLINE void qt_threadqueue_inbox_drain(qt_threadqueue_t *q,
+                                               qt_cl_deque_t    *d)
+{   /*{{{*/
+    qt_threadqueue_node_t *node = qt_threadqueue_inbox_grab(q);
+
+    while (node) {
+        qt_threadqueue_node_t *next = node->next;
+        qt_cl_push(d, node->value);
+        FREE_TQNODE(node);
+        node = next;
+    }
+} /*}}}*/
+
+/*****************************************/
+/* functions to manage the thread queues */
+/*****************************************/
+
+/* Returns the calling worker's deque in q, or NULL if the caller does not
+ * belong to the shepherd that owns q. */
+static QINLINE qt_cl_deque_t *qt_threadqueue_mydeque(qt_threadqueue_t *q)
+{   /*{{{*/
+    qthread_worker_t *w = qthread_internal_getworker();
+
+    if (w && (w->shepherd->ready == q)) {
+        return &q->deques[w->worker_id];
+    }
+    return NULL;
+} /*}}}*/
+
+qt_threadqueue_t INTERNAL *qt_threadqueue_new(void)
+{   /*{{{*/
+    qt_threadqueue_t *q = ALLOC_THREADQUEUE();
+
+    qassert_ret(q != NULL, NULL);
+
+    q->deques = qt_internal_aligned_alloc(qlib->nworkerspershep * sizeof(qt_cl_deque_t),
+                                          CACHELINE_WIDTH);
+    assert(q->deques);
+    for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; i++) {
+        q->deques[i].top    = 0;
+        q->deques[i].bottom = 0;
+        q->deques[i].array  = qt_cl_array_new(CL_INITIAL_SIZE);
+    }
+    q->inbox     = NULL;
+    q->inbox_len = 0;
+    q->nparked   = 0;
+    q->spots     = qt_internal_aligned_alloc(qlib->nworkerspershep * sizeof(qt_threadqueue_spot_t),
+                                             CACHELINE_WIDTH);
+    assert(q->spots);
+    for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; ++i) {
+        qt_park_init(&q->spots[i].spot);
+    }
+#ifdef STEAL_PROFILE
+    q->steal_amount_stolen = 0;
+#endif
+
+    return q;
+} /*}}}*/
+
+void INTERNAL qt_threadqueue_free(qt_threadqueue_t *q)
+{   /*{{{*/
+    qt_threadqueue_node_t *node = qt_threadqueue_inbox_grab(q);
+
+    assert(q);
+    while (node) {
+        qt_threadqueue_node_t *next = node->next;
+        FREE_QTHREAD(node->value);
+        FREE_TQNODE(node);
+        node = next;
+    }
+    for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; i++) {
+        qt_cl_deque_t *d = &q->deques[i];
+        qthread_t     *t;
+        qt_cl_array_t *a;
+
+        while ((t = qt_cl_steal_retry(d)) != NULL) {
+            FREE_QTHREAD(t);
+        }
+        a = d->array;
+        while (a) {
+            qt_cl_array_t *prev = a->prev;
+            qt_free(a);
+            a = prev;
+        }
+        qt_park_destroy(&q->spots[i].spot);
+    }
+    qt_internal_aligned_free(q->spots, CACHELINE_WIDTH);
+    qt_internal_aligned_free(q->deques, CACHELINE_WIDTH);
+    FREE_THREADQUEUE(q);
+} /*}}}*/
+
+ssize_t INTERNAL qt_threadqueue_advisory_queuelen(qt_threadqueue_t *q)
+{   /*{{{*/
+    ssize_t len = q->inbox_len;
+
+    for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; i++) {
+        saligned_t diff = q->deques[i].bottom - q->deques[i].top;
+        if (diff > 0) { len += diff; }
+    }
+    return len;
+} /*}}}*/
+
+/* Only the worker whose packed id is 0 (worker 0 of shepherd 0) may run the
+ * McCoy thread, so that is the one to wake. */
+static QINLINE void qt_threadqueue_enqueue_mccoy(qthread_t *t)
+{   /*{{{*/
+    assert(mccoy == NULL);
+    mccoy = t;
+    MACHINE_FENCE;
+    if (parked_total > 0) {
+        (void)qt_threadqueue_unpark_worker(qlib->shepherds[0].ready, 0);
+    }
+} /*}}}*/
+
+void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
+                                     qthread_t *restrict        t)
+{   /*{{{*/
+    qt_cl_deque_t *d;
+
+    assert(q != NULL);
+    assert(t != NULL);
+
+    qthread_debug(THREADQUEUE_CALLS, "q(%p), t(%p->%u)\n", q, t, t->thread_id);
+    if (QTHREAD_UNLIKELY(t->flags & QTHREAD_REAL_MCCOY)) {
+        qt_threadqueue_enqueue_mccoy(t);
+        return;
+    }
+    d = qt_threadqueue_mydeque(q);
+    if (d) {
+        qt_cl_push(d, t);
+        qt_threadqueue_wake_one(q, (t->flags & QTHREAD_UNSTEALABLE) == 0);
+    } else {
+        qt_threadqueue_inbox_push(q, t);
+    }
+} /*}}}*/
+
+void INTERNAL qt_threadqueue_enqueue_batch(qt_threadqueue_t *q,
+                                           qthread_t       **t,
+                                           size_t            n)
+{   /*{{{*/
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_enqueue(q, t[i]);
+    }
+} /*}}}*/
+
+/* Yielded threads go through the inbox, which is only drained once the
+ * worker's deque is empty; this gives them the same "run everything else
+ * first" treatment that enqueueing at the head gives them elsewhere. */
+void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
+                                             qthread_t *restrict        t)
+{   /*{{{*/
+    assert(q != NULL);
+    assert(t != NULL);
+
+    qthread_debug(THREADQUEUE_CALLS, "q(%p), t(%p->%u)\n", q, t, t->thread_id);
+    if (QTHREAD_UNLIKELY(t->flags & QTHREAD_REAL_MCCOY)) {
+        qt_threadqueue_enqueue_mccoy(t);
+        return;
+    }
+    qt_threadqueue_inbox_push(q, t);
+} /*}}}*/
+
+#ifdef QTHREAD_USE_SPAWNCACHE
+/* Each worker already has a private deque, so there is nothing for the spawn
+ * cache to do. */
+qthread_t INTERNAL *qt_threadqueue_private_dequeue(qt_threadqueue_private_t *c)
+{   /*{{{*/
+    return NULL;
+} /*}}}*/
+
+int INTERNAL qt_threadqueue_private_enqueue(qt_threadqueue_private_t *restrict pq,
+                                            qt_threadqueue_t *restrict         q,
+                                            qthread_t *restrict                t)
+{   /*{{{*/
+    return 0;
+} /*}}}*/
+
+int INTERNAL qt_threadqueue_private_enqueue_yielded(qt_threadqueue_private_t *restrict q,
+                                                    qthread_t *restrict                t)
+{   /*{{{*/
+    return 0;
+} /*}}}*/
+
+void INTERNAL qt_threadqueue_enqueue_cache(qt_threadqueue_t         *q,
+                                           qt_threadqueue_private_t *cache)
+{}
+
+void INTERNAL qt_threadqueue_private_filter(qt_threadqueue_private_t *restrict c,
+                                            qt_threadqueue_filter_f            f)
+{}
+#endif /* ifdef QTHREAD_USE_SPAWNCACHE */
+
+/* Steal one task from some other shepherd. Unstealable tasks that we
+ * happen to grab are handed back through the victim's inbox. */
+static QINLINE qthread_t *qthread_steal(qthread_shepherd_t *thief_shepherd,
+                                        qthread_worker_id_t worker_id)
+{   /*{{{*/
+    qthread_shepherd_t *const    shepherds       = qlib->shepherds;
+    qthread_shepherd_id_t *const sorted_sheplist = thief_shepherd->sorted_sheplist;
+    qt_threadqueue_t            *myqueue         = thief_shepherd->ready;
+
+    assert(sorted_sheplist);
+    STEAL_CALLED(thief_shepherd);
+    for (qthread_shepherd_id_t i = 0; i < qlib->nshepherds - 1; i++) {
+        qt_threadqueue_t *victim_queue = shepherds[sorted_sheplist[i]].ready;
+
+        for (qthread_worker_id_t j = 0; j < qlib->nworkerspershep; j++) {
+            qt_cl_deque_t *d = &victim_queue->deques[(worker_id + j) % qlib->nworkerspershep];
+            qthread_t     *t;
+
+            if (d->bottom - d->top <= 0) { continue; }
+            STEAL_ATTEMPTED(thief_shepherd);
+            t = qt_cl_steal_retry(d);
+            if (t == NULL) {
+                STEAL_FAILED(thief_shepherd);
+                continue;
+            }
+            if (t->flags & QTHREAD_UNSTEALABLE) {
+                qt_threadqueue_inbox_push(victim_queue, t);
+                STEAL_FAILED(thief_shepherd);
+                break; /* on to the next shepherd */
+            }
+            STEAL_SUCCESSFUL(thief_shepherd);
+            STEAL_AMOUNT(victim_queue, 1);
+            return t;
+        }
+        if (myqueue->inbox != NULL) { break; } // work at home; quit steal attempt
+    }
+    return NULL;
+} /*}}}*/
+
+qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
+#ifdef QTHREAD_LOCAL_PRIORITY
+                                            qt_threadqueue_t         *lpq,
+#endif /* ifdef QTHREAD_LOCAL_PRIORITY */
+                                            qt_threadqueue_private_t *QUNUSED(qc),
+                                            uint_fast8_t              active)
+{   /*{{{*/
+    qthread_shepherd_t *my_shepherd = qthread_internal_getshep();
+    qthread_worker_t   *my_worker   = qthread_internal_getworker();
+    qthread_worker_id_t worker_id;
+    qt_cl_deque_t      *d;
+    qthread_t          *t;
+    unsigned long       idle = 0;
+
+    assert(q != NULL);
+    assert(my_shepherd);
+    assert(my_shepherd->ready == q);
+    worker_id = my_worker->worker_id;
+    d         = &q->deques[worker_id];
+
+#ifdef QTHREAD_USE_EUREKAS
+    qt_eureka_disable();
+#endif /* QTHREAD_USE_EUREKAS */
+    while (1) {
+#ifdef QTHREAD_LOCAL_PRIORITY
+        if (lpq->inbox) {
+            qt_threadqueue_node_t *node = qt_threadqueue_inbox_grab(lpq);
+            while (node) {
+                qt_threadqueue_node_t *next = node->next;
+                qt_cl_push(d, node->value);
+                FREE_TQNODE(node);
+                node = next;
+            }
+        }
+#endif /* ifdef QTHREAD_LOCAL_PRIORITY */
+        /* 1: my own deque */
+        if ((t = qt_cl_take(d)) != NULL) { break; }
+
+        /* 2: the McCoy thread (if I'm the one worker allowed to run it) and
+         * whatever has been sent to this shepherd from elsewhere. These take
+         * turns, since either one may be yield-spinning on the other. */
+        if (mccoy && (my_worker->packed_worker_id == 0) &&
+            (mccoy_turn || (q->inbox == NULL))) {
+            t          = mccoy;
+            mccoy      = NULL;
+            mccoy_turn = 0;
+            break;
+        }
+        if (q->inbox) {
+            if (my_worker->packed_worker_id == 0) { mccoy_turn = 1; }
+            qt_threadqueue_inbox_drain(q, d);
+            if ((t = qt_cl_take(d)) != NULL) { break; }
+        }
+
+        /* 3: my siblings within the shepherd (unstealable tasks are fair game) */
+
+        for (qthread_worker_id_t i = 1; i < qlib->nworkerspershep; i++) {
+            qt_cl_deque_t *sib = &q->deques[(worker_id + i) % qlib->nworkerspershep];
+            if (sib->bottom - sib->top > 0) {
+                if ((t = qt_cl_steal_retry(sib)) != NULL) { break; }
+            }
+        }
+        if (t) { break; }
+
+        /* 4: other shepherds */
+        if (active && (qlib->nshepherds > 1) && !steal_disable) {
+            if ((t = qthread_steal(my_shepherd, worker_id)) != NULL) { break; }
+        }
+#ifdef QTHREAD_USE_EUREKAS
+        qt_eureka_check(1);
+#endif /* QTHREAD_USE_EUREKAS */
+        qt_threadqueue_idle(q, my_worker, active && (qlib->nshepherds > 1) && !steal_disable, &idle);
+    }
+#ifdef QTHREAD_USE_EUREKAS
+    qt_eureka_disable();
+#endif /* QTHREAD_USE_EUREKAS */
+    qthread_debug(THREADQUEUE_BEHAVIOR, "found thread %u (%p); q(%p)\n", t->thread_id, t, q);
+    return t;
+} /*}}}*/
+
+#ifdef STEAL_PROFILE
+void INTERNAL qthread_steal_stat(void)
+{   /*{{{*/
+    int i;
+
+    assert(qlib);
+    for (i = 0; i < qlib->nshepherds; i++) {
+        fprintf(stdout,
+                "QTHREADS: shepherd %d - steals called:%ld attempted:%ld(failed:%ld successful:%ld) tasks-stolen:%ld\n",
+                qlib->shepherds[i].shepherd_id,
+                qlib->shepherds[i].steal_called,
+                qlib->shepherds[i].steal_attempted,
+                qlib->shepherds[i].steal_failed,
+                qlib->shepherds[i].steal_attempted - qlib->shepherds[i].steal_failed,
+                qlib->shepherds[i].ready->steal_amount_stolen);
+    }
+} /*}}}*/
+#endif  /* ifdef STEAL_PROFILE */
+
+/* Pulls every task out of q, using the thieves' protocol so that this is
+ * safe against concurrent pushes and pops by the workers. */
+static qt_threadqueue_node_t *qt_threadqueue_take_all(qt_threadqueue_t *q)
+{   /*{{{*/
+    qt_threadqueue_node_t *list = qt_threadqueue_inbox_grab(q);
+    qt_threadqueue_node_t *tail = list;
+
+    while (tail && tail->next) tail = tail->next;
+    for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; i++) {
+        qthread_t *t;
+        while ((t = qt_cl_steal_retry(&q->deques[i])) != NULL) {
+            qt_threadqueue_node_t *node = ALLOC_TQNODE();
+            node->value = t;
+            node->next  = NULL;
+            if (tail) {
+                tail->next = node;
+            } else {
+                list = node;
+            }
+            tail = node;
+        }
+    }
+    return list;
+} /*}}}*/
+
+/* walk queue removing all tasks matching this description */
+void INTERNAL qt_threadqueue_filter(qt_threadqueue_t       *q,
+                                    qt_threadqueue_filter_f f)
+{   /*{{{*/
+    qt_threadqueue_node_t *list = qt_threadqueue_take_all(q);
+    qt_threadqueue_node_t *keep = NULL;
+    int                    stop = 0;
+
+    assert(q != NULL);
+    while (list) {
+        qt_threadqueue_node_t *node = list;
+        qthread_t             *t    = node->value;
+
+        list = node->next;
+        switch (stop ? IGNORE_AND_STOP : f(t)) {
+            case IGNORE_AND_STOP: // ignore, stop looking
+                stop = 1;
+            case IGNORE_AND_CONTINUE: // ignore, move on
+                node->next = keep;
+                keep       = node;
+                break;
+            case REMOVE_AND_STOP: // remove, stop looking
+                stop = 1;
+            case REMOVE_AND_CONTINUE: // remove, move on
+#ifdef QTHREAD_USE_EUREKAS
+                qthread_internal_assassinate(t);
+#endif /* QTHREAD_USE_EUREKAS */
+                FREE_TQNODE(node);
+                break;
+        }
+    }
+    while (keep) {
+        qt_threadqueue_node_t *next = keep->next;
+        qt_threadqueue_enqueue(q, keep->value);
+        FREE_TQNODE(keep);
+        keep = next;
+    }
+} /*}}}*/
+
+/* Look for a specific value in the calling worker's deque (and anything
+ * waiting in the shepherd's inbox) -- if found, move it to the bottom of the
+ * deque so it is the next thing this worker runs, and return it. Sibling
+ * deques are not searched. */
+qthread_t INTERNAL *qt_threadqueue_dequeue_specific(qt_threadqueue_t *q,
+                                                    void             *value)
+{   /*{{{*/
+    qt_cl_deque_t         *d      = qt_threadqueue_mydeque(q);
+    qt_threadqueue_node_t *popped = NULL;
+    qthread_t             *t;
+
+    assert(q != NULL);
+    if (d == NULL) { return NULL; }
+
+    qt_threadqueue_inbox_drain(q, d);
+    while ((t = qt_cl_take(d)) != NULL && t->ret != value) {
+        qt_threadqueue_node_t *node = ALLOC_TQNODE();
+        node->value = t;
+        node->next  = popped;
+        popped      = node;
+    }
+    /* put back what we popped, deepest first, then the target on top */
+    while (popped) {
+        qt_threadqueue_node_t *next = popped->next;
+        qt_cl_push(d, popped->value);
+        FREE_TQNODE(popped);
+        popped = next;
+    }
+    if (t) {
+        qt_cl_push(d, t);
+    }
+    return t;
+} /*}}}*/
+
+void INTERNAL qthread_steal_enable(void)
+{   /*{{{*/
+    steal_disable = 0;
+} /*}}}*/
+
+void INTERNAL qthread_steal_disable(void)
+{   /*{{{*/
+    steal_disable = 1;
+} /*}}}*/
+
+qthread_shepherd_id_t INTERNAL qt_threadqueue_choose_dest(qthread_shepherd_t * curr_shep)
+{
+    if (curr_shep) {
+        return curr_shep->shepherd_id;
+    } else {
+        return (qthread_shepherd_id_t)0;
+    }
+}
+
+size_t INTERNAL qt_threadqueue_policy(const enum threadqueue_policy policy)
+{
+    switch (policy) {
+        default:
+            return THREADQUEUE_POLICY_UNSUPPORTED;
+    }
+}
+
+/* vim:set expandtab: */
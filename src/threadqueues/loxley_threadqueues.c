@@ -198,6 +198,15 @@ void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
     q->empty = 0;
 } /*}}}*/
 
+void INTERNAL qt_threadqueue_enqueue_batch(qt_threadqueue_t *q,
+                                           qthread_t       **t,
+                                           size_t            n)
+{   /*{{{*/
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_enqueue(q, t[i]);
+    }
+} /*}}}*/
+
 /* enqueue multiple (from steal) */
 void INTERNAL qt_threadqueue_enqueue_multiple(qt_threadqueue_t   *q,
                                               int                 stealcount,
@@ -280,6 +280,15 @@ void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
     hazardous_ptr(0, NULL); // release the ptr (avoid hazardptr resource exhaustion)
 }                           /*}}} */
 
+void INTERNAL qt_threadqueue_enqueue_batch(qt_threadqueue_t *q,
+                                           qthread_t       **t,
+                                           size_t            n)
+{   /*{{{*/
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_enqueue(q, t[i]);
+    }
+} /*}}}*/
+
 void qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
                                     qthread_t *restrict        t)
 {   /*{{{*/
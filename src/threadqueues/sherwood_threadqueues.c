@@ -28,6 +28,9 @@
 #endif /* QTHREAD_USE_EUREKAS */
 #include "qt_expect.h"
 #include "qt_subsystems.h"
+#include "qt_park.h"
+#include "qt_io.h"                      /* for qt_blocking_subsystem_poll() */
+#include "qt_timers.h"                  /* for qt_timer_poll() */
 
 /* Data Structures */
 struct _qt_threadqueue_node {
@@ -37,6 +40,12 @@ struct _qt_threadqueue_node {
     qthread_t                   *value;
 } /* qt_threadqueue_node_t */;
 
+/* where an idle worker sleeps; padded so that wakers don't false-share */
+typedef struct {
+    qt_park_spot_t spot;
+    uint8_t        pad[CACHELINE_WIDTH - (sizeof(qt_park_spot_t) % CACHELINE_WIDTH)];
+} qt_threadqueue_spot_t;
+
 struct _qt_threadqueue {
     qt_threadqueue_node_t *head;
     qt_threadqueue_node_t *tail;
@@ -47,12 +56,28 @@ struct _qt_threadqueue {
 #ifdef STEAL_PROFILE
     aligned_t steal_amount_stolen;
 #endif
+    uint32_t steal_seed;                                        /* victim selection state; only touched by the elected thief */
+    qt_threadqueue_spot_t *spots;                               /* one per worker of this shepherd */
+    saligned_t             nparked;                             /* how many of those are asleep */
 
     QTHREAD_TRYLOCK_TYPE qlock;
 } /* qt_threadqueue_t */;
 
-static aligned_t steal_disable   = 0;
-static long      steal_chunksize = 0;
+static aligned_t steal_disable     = 0;
+static long      steal_chunksize   = 0;
+static long      steal_backoff_max = 1024;
+
+/* Idle workers spin for SPINCOUNT polls, then yield IDLE_YIELDS times, then
+ * park until an enqueue wakes them (or PARK_TIMEOUT usecs pass). */
+#ifdef QTHREAD_OVERSUBSCRIPTION
+# define DEFAULT_SPINCOUNT 300
+#else
+# define DEFAULT_SPINCOUNT 300000
+#endif
+#define IDLE_YIELDS  64
+#define PARK_TIMEOUT 100000
+static unsigned long idle_spincount = DEFAULT_SPINCOUNT;
+static saligned_t    parked_total   = 0;
 
 #ifdef STEAL_PROFILE
 # define STEAL_CALLED(shep)     qthread_incr( & ((shep)->steal_called), 1)
@@ -176,7 +201,9 @@ static void qt_threadqueue_subsystem_shutdown(void)
 void INTERNAL qt_threadqueue_subsystem_init(void)
 {
     init_agged_tasks();
-    steal_chunksize = qt_internal_get_env_num("STEAL_CHUNK", 0, 0);
+    steal_chunksize   = qt_internal_get_env_num("STEAL_CHUNK", 0, 0);
+    steal_backoff_max = qt_internal_get_env_num("STEAL_BACKOFF", 1024, 0);
+    idle_spincount    = qt_internal_get_env_num("SPINCOUNT", DEFAULT_SPINCOUNT, 0);
     qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
 }
 
@@ -206,7 +233,9 @@ void INTERNAL qt_threadqueue_subsystem_init(void)
                                                                qthread_cacheline());
     generic_threadqueue_pools.nodes = qt_mpool_create_aligned(sizeof(qt_threadqueue_node_t),
                                                               qthread_cacheline());
-    steal_chunksize = qt_internal_get_env_num("STEAL_CHUNK", 0, 0);
+    steal_chunksize   = qt_internal_get_env_num("STEAL_CHUNK", 0, 0);
+    steal_backoff_max = qt_internal_get_env_num("STEAL_BACKOFF", 1024, 0);
+    idle_spincount    = qt_internal_get_env_num("SPINCOUNT", DEFAULT_SPINCOUNT, 0);
     qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
 } /*}}}*/
 #endif /* if defined(UNPOOLED_QUEUES) || defined(UNPOOLED) */
@@ -234,7 +263,8 @@ ssize_t INTERNAL qt_threadqueue_advisory_queuelen(qt_threadqueue_t *q)
 /* functions to manage the thread queues */
 /*****************************************/
 
-static QINLINE qt_threadqueue_node_t *qthread_steal(qthread_shepherd_t *thief_shepherd);
+static QINLINE qt_threadqueue_node_t *qthread_steal(qthread_shepherd_t *thief_shepherd,
+                                                    unsigned long      *idle);
 
 qt_threadqueue_t INTERNAL *qt_threadqueue_new(void)
 {   /*{{{*/
@@ -245,6 +275,14 @@ qt_threadqueue_t INTERNAL *qt_threadqueue_new(void)
         q->tail              = NULL;
         q->qlength           = 0;
         q->qlength_stealable = 0;
+        q->steal_seed        = 0;
+        q->nparked           = 0;
+        q->spots             = qt_internal_aligned_alloc(qlib->nworkerspershep * sizeof(qt_threadqueue_spot_t),
+                                                         CACHELINE_WIDTH);
+        assert(q->spots);
+        for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; ++i) {
+            qt_park_init(&q->spots[i].spot);
+        }
         QTHREAD_TRYLOCK_INIT(q->qlock);
     }
 
@@ -287,6 +325,10 @@ void INTERNAL qt_threadqueue_free(qt_threadqueue_t *q)
         QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
     }
     assert(q->head == q->tail);
+    for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; ++i) {
+        qt_park_destroy(&q->spots[i].spot);
+    }
+    qt_internal_aligned_free(q->spots, CACHELINE_WIDTH);
     QTHREAD_TRYLOCK_DESTROY(q->qlock);
     FREE_THREADQUEUE(q);
 } /*}}}*/
@@ -296,17 +338,118 @@ static QINLINE int qt_threadqueue_isstealable(qthread_t *t)
     return ((t->flags & QTHREAD_UNSTEALABLE) == 0) ? 1 : 0;
 } /*}}}*/
 
+/* Wake one worker parked on q, lowest worker first (so that worker 0 is
+ * preferred for the McCoy thread). */
+static int qt_threadqueue_unpark(qt_threadqueue_t *q)
+{   /*{{{*/
+    for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; ++i) {
+        qt_park_spot_t *spot = &q->spots[i].spot;
+        if ((spot->state == QT_PARK_PARKED) && qt_park_claim(spot)) {
+            (void)qthread_incr(&q->nparked, -1);
+            (void)qthread_incr(&parked_total, -1);
+            qt_park_wake(spot);
+            qt_blocking_subsystem_unpark(spot);
+            return 1;
+        }
+    }
+    return 0;
+} /*}}}*/
+
+/* Called after work has been made visible on q. Prefers a sleeper on q's own
+ * shepherd; if there is none and the work can be stolen, any sleeper will do,
+ * since it will find the work by stealing. */
+static QINLINE void qt_threadqueue_wake_one(qt_threadqueue_t *q,
+                                            int               stealable)
+{   /*{{{*/
+    /* pairs with the fence in qt_threadqueue_park(): either we see the
+     * sleeper, or the sleeper sees the work */
+    MACHINE_FENCE;
+    if (QTHREAD_LIKELY(parked_total == 0)) { return; }
+    if ((q->nparked > 0) && qt_threadqueue_unpark(q)) { return; }
+    if (stealable) {
+        for (qthread_shepherd_id_t i = 0; i < qlib->nshepherds; ++i) {
+            qt_threadqueue_t *other = qlib->shepherds[i].ready;
+            if ((other->nparked > 0) && qt_threadqueue_unpark(other)) { return; }
+        }
+    }
+} /*}}}*/
+
+static void qt_threadqueue_park(qt_threadqueue_t   *q,
+                                qthread_worker_id_t worker_id,
+                                int                 can_steal)
+{   /*{{{*/
+    qt_park_spot_t *spot = &q->spots[worker_id].spot;
+    int             work = 0;
+    /* don't sleep past the next timer */
+    unsigned long   usec = qt_timer_park_usecs(qthread_internal_getshep()->shepherd_id, PARK_TIMEOUT);
+
+    spot->state = QT_PARK_PARKED;
+    (void)qthread_incr(&q->nparked, 1);
+    (void)qthread_incr(&parked_total, 1);
+    MACHINE_FENCE;
+    /* re-check everything this worker could take */
+    if (q->head != NULL) {
+        work = 1;
+    } else if (can_steal) {
+        for (qthread_shepherd_id_t i = 0; i < qlib->nshepherds; ++i) {
+            if (qlib->shepherds[i].ready->qlength_stealable > 0) {
+                work = 1;
+                break;
+            }
+        }
+    }
+    if (!work && (usec > 0)) {
+        qthread_debug(THREADQUEUE_DETAILS, "q(%p) worker %i parking\n", q, (int)worker_id);
+        /* with blocking calls in flight, wait for them instead */
+        if (!qt_blocking_subsystem_park(qthread_internal_getshep()->shepherd_id, spot, usec)) {
+            qt_park_wait(spot, usec);
+        }
+    }
+    /* if nobody claimed the spot, take it back ourselves */
+    if (qt_park_claim(spot)) {
+        (void)qthread_incr(&q->nparked, -1);
+        (void)qthread_incr(&parked_total, -1);
+    }
+} /*}}}*/
+
+/* One step of the idle policy: spin, then yield, then park. */
+static QINLINE void qt_threadqueue_idle(qt_threadqueue_t *q,
+                                        int               can_steal,
+                                        unsigned long    *idle)
+{   /*{{{*/
+    if (q->head != NULL) { return; }
+    if ((qt_blocking_subsystem_poll(qthread_internal_getshep()->shepherd_id, 1) > 0) ||
+        (qt_timer_poll(qthread_internal_getshep()->shepherd_id, 1) > 0)) {
+        *idle = 0;
+        return;
+    }
+    if (*idle < idle_spincount) {
+        SPINLOCK_BODY();
+        ++*idle;
+    } else if (*idle < idle_spincount + IDLE_YIELDS) {
+#ifdef HAVE_PTHREAD_YIELD
+        pthread_yield();
+#elif defined(HAVE_SCHED_YIELD)
+        sched_yield();
+#endif
+        ++*idle;
+    } else {
+        qt_threadqueue_park(q, qthread_internal_getworker()->worker_id, can_steal);
+    }
+} /*}}}*/
+
 /* enqueue at tail */
 void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
                                      qthread_t *restrict        t)
 {   /*{{{*/
     qt_threadqueue_node_t *node;
+    const int              stealable = qt_threadqueue_isstealable(t);
 
     node = ALLOC_TQNODE();
     assert(node != NULL);
 
     node->value     = t;
-    node->stealable = qt_threadqueue_isstealable(t);
+    node->stealable = stealable;
 
     assert(q != NULL);
     assert(t != NULL);
@@ -322,8 +465,9 @@ void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
         node->prev->next = node;
     }
     q->qlength++;
-    q->qlength_stealable += node->stealable;
+    q->qlength_stealable += stealable;
     QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    qt_threadqueue_wake_one(q, stealable);
 } /*}}}*/
 
 #ifdef QTHREAD_USE_SPAWNCACHE
@@ -440,12 +584,13 @@ void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
                                              qthread_t *restrict        t)
 {   /*{{{*/
     qt_threadqueue_node_t *node;
+    const int              stealable = qt_threadqueue_isstealable(t);
 
     node = ALLOC_TQNODE();
     assert(node != NULL);
 
     node->value     = t;
-    node->stealable = qt_threadqueue_isstealable(t);
+    node->stealable = stealable;
 
     assert(q != NULL);
     assert(t != NULL);
@@ -461,8 +606,9 @@ void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
         node->next->prev = node;
     }
     q->qlength++;
-    if (node->stealable) { q->qlength_stealable++; }
+    if (stealable) { q->qlength_stealable++; }
     QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    qt_threadqueue_wake_one(q, stealable);
 } /*}}}*/
 
 #define QTHREAD_TASK_IS_AGGREGABLE(f) (0 &&                                                \
@@ -704,6 +850,7 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
     qthread_t          *t;
     qthread_worker_id_t worker_id = NO_WORKER;
     int                 curr_cost, max_t, ret_agg_task;
+    unsigned long       idle = 0;
 
     assert(q != NULL);
     assert(my_shepherd);
@@ -716,6 +863,10 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
 #ifdef QTHREAD_USE_EUREKAS
     qt_eureka_disable();
 #endif /* QTHREAD_USE_EUREKAS */
+    /* tasks whose blocking calls have finished, or whose timers have gone
+     * off, go back on q */
+    (void)qt_blocking_subsystem_poll(my_shepherd->shepherd_id, 0);
+    (void)qt_timer_poll(my_shepherd->shepherd_id, 0);
     while (1) {
         qt_threadqueue_node_t *node = NULL;
 #ifdef QTHREAD_TASK_AGGREGATION
@@ -837,6 +988,7 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
                 assert(q->tail->next == NULL);
                 assert(q->head->prev == NULL);
                 QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+                qt_threadqueue_wake_one(q, qc->qlength_stealable > 0);
                 qc->head    = qc->tail = NULL;
                 qc->qlength = qc->qlength_stealable = 0;
 #endif          /* if 0 */
@@ -899,13 +1051,18 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
         if ((node == NULL) && (active)) {
             if (qlib->nshepherds > 1) {
                 if (!steal_disable) {
-                    node = qthread_steal(my_shepherd); // TODO: same agg behavior when stealing
-                } else {
-                    while (NULL == q->head) SPINLOCK_BODY();
-                    continue;
+                    node = qthread_steal(my_shepherd, &idle); // TODO: same agg behavior when stealing
+                    if (node == NULL) {
+                        qt_threadqueue_idle(q, 1, &idle);
+                        continue;
+                    }
                 }
             }
         }
+        if (node == NULL) {
+            qt_threadqueue_idle(q, 0, &idle);
+            continue;
+        }
         if (node) {
 #ifdef QTHREAD_TASK_AGGREGATION
             qthread_thread_free(t); // free agg task; only reallocate it if mccoy found
@@ -972,6 +1129,53 @@ void INTERNAL qt_threadqueue_enqueue_multiple(qt_threadqueue_t      *q,
     q->qlength           += addCnt;
     q->qlength_stealable += addCnt;
     QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    qt_threadqueue_wake_one(q, 0);
+} /*}}}*/
+
+/* enqueue multiple (from the I/O proxies), taking the lock once */
+void INTERNAL qt_threadqueue_enqueue_batch(qt_threadqueue_t *q,
+                                           qthread_t       **t,
+                                           size_t            n)
+{   /*{{{*/
+    qt_threadqueue_node_t *first = NULL, *last = NULL;
+    size_t                 stealable = 0;
+
+    assert(q != NULL);
+    if (n == 0) { return; }
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_node_t *node = ALLOC_TQNODE();
+
+        assert(node != NULL);
+        assert(t[i] != NULL);
+        node->value     = t[i];
+        node->stealable = qt_threadqueue_isstealable(t[i]);
+        node->next      = NULL;
+        node->prev      = last;
+        if (last == NULL) {
+            first = node;
+        } else {
+            last->next = node;
+        }
+        last       = node;
+        stealable += node->stealable;
+    }
+
+    QTHREAD_TRYLOCK_LOCK(&q->qlock);
+    PARANOIA_ONLY(sanity_check_queue(q));
+    first->prev = q->tail;
+    q->tail     = last;
+    if (q->head == NULL) {
+        q->head = first;
+    } else {
+        first->prev->next = first;
+    }
+    q->qlength           += n;
+    q->qlength_stealable += stealable;
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    /* wake as many sleepers as there are tasks, if there are any */
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_wake_one(q, stealable > i);
+    }
 } /*}}}*/
 
 #ifdef QTHREAD_USE_SPAWNCACHE
@@ -1011,6 +1215,7 @@ void INTERNAL qt_threadqueue_enqueue_cache(qt_threadqueue_t         *q,
     q->qlength           += cache->qlength;
     q->qlength_stealable += cache->qlength_stealable;
     QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    qt_threadqueue_wake_one(q, cache->qlength_stealable > 0);
     cache->qlength           = 0;
     cache->qlength_stealable = 0;
 } /*}}}*/
@@ -1026,9 +1231,9 @@ qt_threadqueue_node_t INTERNAL *qt_threadqueue_dequeue_steal(qt_threadqueue_t *h
     long                   amtStolen = 0;
     long                   desired_stolen;
 
-    if (steal_chunksize == 0) {
-        desired_stolen = v->qlength_stealable / 2;
-    } else {
+    /* steal half of what the victim can give up, optionally capped */
+    desired_stolen = v->qlength_stealable / 2;
+    if ((steal_chunksize > 0) && (desired_stolen > steal_chunksize)) {
         desired_stolen = steal_chunksize;
     }
 
@@ -1116,10 +1321,23 @@ qt_threadqueue_node_t INTERNAL *qt_threadqueue_dequeue_steal(qt_threadqueue_t *h
     return (first);
 }                                      /*}}} */
 
+/* xorshift32; cheap and good enough to spread thieves across victims */
+static QINLINE uint32_t qt_steal_rand(uint32_t *seed)
+{   /*{{{*/
+    uint32_t x = *seed;
+
+    x    ^= x << 13;
+    x    ^= x >> 17;
+    x    ^= x << 5;
+    *seed = x;
+    return x;
+} /*}}}*/
+
 /*  Steal work from another shepherd's queue
  *  Returns the work stolen
  */
-static QINLINE qt_threadqueue_node_t *qthread_steal(qthread_shepherd_t *thief_shepherd)
+static QINLINE qt_threadqueue_node_t *qthread_steal(qthread_shepherd_t *thief_shepherd,
+                                                    unsigned long      *idle)
 {   /*{{{*/
     qt_threadqueue_node_t *stolen = NULL;
 
@@ -1146,9 +1364,12 @@ static QINLINE qt_threadqueue_node_t *qthread_steal(qthread_shepherd_t *thief_sh
     }
     STEAL_ELECTED(thief_shepherd);
 
-    qthread_shepherd_id_t        i               = 0;
     qthread_shepherd_t *const    shepherds       = qlib->shepherds;
     qthread_shepherd_id_t *const sorted_sheplist = thief_shepherd->sorted_sheplist;
+    const unsigned int *const    shep_dists      = thief_shepherd->shep_dists;
+    const qthread_shepherd_id_t  nvictims        = qlib->nshepherds - 1;
+    long                         backoff         = 1;
+    int                          quit            = 0;
     assert(sorted_sheplist);
 
     qt_threadqueue_t *myqueue = thief_shepherd->ready;
@@ -1156,47 +1377,69 @@ static QINLINE qt_threadqueue_node_t *qthread_steal(qthread_shepherd_t *thief_sh
 #ifdef QTHREAD_LOCAL_PRIORITY
     qt_threadqueue_t *mypriorityqueue = thief_shepherd->local_priority_queue;
 #endif /* ifdef QTHREAD_LOCAL_PRIORITY */
-    while (stolen == NULL) {
-        qt_threadqueue_t *victim_queue = shepherds[sorted_sheplist[i]].ready;
-        if (0 != victim_queue->qlength_stealable) {
-            STEAL_ATTEMPTED(thief_shepherd);
-            stolen = qt_threadqueue_dequeue_steal(myqueue, victim_queue);
-            if (stolen) {
-                qt_threadqueue_node_t *surplus = stolen->next;
-                if (surplus) {
-                    stolen->next  = NULL;
-                    surplus->prev = NULL;
-                    qt_threadqueue_enqueue_multiple(myqueue, surplus);
+    if (myqueue->steal_seed == 0) {
+        myqueue->steal_seed = 0x9e3779b9u * (uint32_t)(thief_shepherd->shepherd_id + 1);
+    }
+    while (stolen == NULL && !quit) {
+        /* One sweep: sorted_sheplist is ordered by distance, so walk it one
+         * distance tier at a time (nearest first), starting each tier at a
+         * random member so that thieves do not all hammer the same victim. */
+        qthread_shepherd_id_t tier_start = 0;
+        while (tier_start < nvictims && stolen == NULL && !quit) {
+            qthread_shepherd_id_t tier_end = nvictims;
+            if (shep_dists) {
+                const unsigned int d = shep_dists[sorted_sheplist[tier_start]];
+                for (tier_end = tier_start + 1; tier_end < nvictims; ++tier_end) {
+                    if (shep_dists[sorted_sheplist[tier_end]] != d) { break; }
                 }
-                STEAL_SUCCESSFUL(thief_shepherd);
-                break;
-            } else {
-                STEAL_FAILED(thief_shepherd);
             }
-        }
+            const qthread_shepherd_id_t tier_len = tier_end - tier_start;
+            const qthread_shepherd_id_t first    = qt_steal_rand(&myqueue->steal_seed) % tier_len;
+
+            for (qthread_shepherd_id_t k = 0; k < tier_len; ++k) {
+                qt_threadqueue_t *victim_queue = shepherds[sorted_sheplist[tier_start + (first + k) % tier_len]].ready;
+                if (0 != victim_queue->qlength_stealable) {
+                    STEAL_ATTEMPTED(thief_shepherd);
+                    stolen = qt_threadqueue_dequeue_steal(myqueue, victim_queue);
+                    if (stolen) {
+                        qt_threadqueue_node_t *surplus = stolen->next;
+                        if (surplus) {
+                            stolen->next  = NULL;
+                            surplus->prev = NULL;
+                            qt_threadqueue_enqueue_multiple(myqueue, surplus);
+                        }
+                        STEAL_SUCCESSFUL(thief_shepherd);
+                        break;
+                    } else {
+                        STEAL_FAILED(thief_shepherd);
+                    }
+                }
 #ifdef QTHREAD_LOCAL_PRIORITY
-        if ((0 < mypriorityqueue->qlength)){
-          break;
-        }
+                if ((0 < mypriorityqueue->qlength)) {
+                    quit = 1;
+                    break;
+                }
 #endif /* ifdef QTHREAD_LOCAL_PRIORITY */
-       
-        if ((0 < myqueue->qlength) || steal_disable) {  // work at home quit steal attempt
-            break;
+                if ((0 < myqueue->qlength) || steal_disable) {  // work at home quit steal attempt
+                    quit = 1;
+                    break;
+                }
+                SPINLOCK_BODY();
+            }
+            tier_start = tier_end;
         }
+        if (stolen || quit) { break; }
 
-        i++;
-        i *= (i < qlib->nshepherds - 1);
-        if (i == 0) {
 #ifdef QTHREAD_USE_EUREKAS
-            qt_eureka_check(1);
+        qt_eureka_check(1);
 #endif /* QTHREAD_USE_EUREKAS */
-#ifdef HAVE_PTHREAD_YIELD
-            pthread_yield();
-#elif defined(HAVE_SCHED_YIELD)
-            sched_yield();
-#endif
-        }
-        SPINLOCK_BODY();
+        /* Nothing anywhere: once the idle spin budget is used up, give up
+         * and let the caller yield or park; until then, back off
+         * exponentially before the next sweep, watching for local work. */
+        if (*idle >= idle_spincount) { break; }
+        for (long b = 0; b < backoff && 0 == myqueue->qlength; ++b) SPINLOCK_BODY();
+        *idle += backoff;
+        if (backoff < steal_backoff_max) { backoff <<= 1; }
     }
     thief_shepherd->stealing = 0;
     return stolen;
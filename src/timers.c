@@ -0,0 +1,480 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <qthread/qthread-int.h>       /* for uint64_t */
+#include <string.h>                    /* for memset() */
+#include <time.h>
+
+/* API Headers */
+#include "qthread/qthread.h"
+#include "qthread/qtimer.h"
+
+/* Internal Headers */
+#include "qt_timers.h"
+#include "qt_io.h"
+#include "qt_macros.h"
+#include "qt_asserts.h"
+#include "qt_alloc.h"
+#include "qt_atomics.h"
+#include "qthread_innards.h"           /* for qlib */
+#include "qt_threadqueues.h"
+#include "qt_subsystems.h"
+#include "qt_debug.h"
+#include "qt_expect.h"
+#include "qt_initialized.h"             /* for qthread_library_initialized */
+
+#ifdef QTHREAD_USE_TIMER_WHEEL
+/* Each shepherd has a hierarchical timer wheel. A timer due within
+ * LEVEL0_SLOTS ticks sits in the slot for its tick on level 0; later ones sit
+ * in coarser slots on the levels above, and are moved down (cascaded) when
+ * the level below wraps around to them. So starting, cancelling and firing a
+ * timer are all constant time, however many there are, and a sleeping task
+ * costs nothing until it is due. The shepherd's workers advance the wheel when
+ * they look for work, idle workers also advance the other shepherds' wheels,
+ * and a worker that parks does so only until the next timer is due. */
+
+#define TICK_SHIFT     16              /* 65.536 usec ticks */
+#define LEVEL0_BITS    8
+#define LEVEL_BITS     6
+#define LEVELS         3               /* above level 0 */
+#define LEVEL0_SLOTS   (1 << LEVEL0_BITS)
+#define LEVEL_SLOTS    (1 << LEVEL_BITS)
+#define MAX_TICKS      (UINT64_C(1) << (LEVEL0_BITS + LEVELS * LEVEL_BITS))
+
+/* a busy worker only looks at the wheel every TIMER_INTERVAL scheduling
+ * decisions */
+#define TIMER_INTERVAL 16
+
+typedef struct {
+    volatile aligned_t lock;
+    volatile aligned_t count;          /* timers in the wheel */
+    uint64_t           now;            /* the next tick to run */
+    unsigned           ticks;
+    qt_timer_t        *level0[LEVEL0_SLOTS];
+    qt_timer_t        *levels[LEVELS][LEVEL_SLOTS];
+} Q_ALIGNED(CACHELINE_WIDTH) qt_wheel_t;
+
+static qt_wheel_t           *wheels  = NULL;
+static qthread_shepherd_id_t nwheels = 0;
+
+static QINLINE void qt_wheel_lock(volatile aligned_t *lock)
+{   /*{{{*/
+    do {
+        while (*lock != 0) SPINLOCK_BODY();
+    } while (qthread_cas(lock, 0, 1) != 0);
+} /*}}}*/
+
+static QINLINE void qt_wheel_unlock(volatile aligned_t *lock)
+{   /*{{{*/
+    COMPILER_FENCE;
+    *lock = 0;
+} /*}}}*/
+
+uint64_t INTERNAL qt_timer_now(void)
+{   /*{{{*/
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+} /*}}}*/
+
+static void qt_timer_internal_freemem(void)
+{   /*{{{*/
+    qt_internal_aligned_free(wheels, nwheels * sizeof(qt_wheel_t));
+    wheels  = NULL;
+    nwheels = 0;
+} /*}}}*/
+
+void INTERNAL qt_timer_subsystem_init(void)
+{   /*{{{*/
+    const uint64_t now = qt_timer_now() >> TICK_SHIFT;
+
+    wheels = qt_internal_aligned_alloc(qlib->nshepherds * sizeof(qt_wheel_t), CACHELINE_WIDTH);
+    assert(wheels);
+    memset(wheels, 0, qlib->nshepherds * sizeof(qt_wheel_t));
+    for (qthread_shepherd_id_t i = 0; i < qlib->nshepherds; i++) {
+        wheels[i].now = now;
+    }
+    nwheels = qlib->nshepherds;
+    qthread_internal_cleanup(qt_timer_internal_freemem);
+} /*}}}*/
+
+/* Links t into the slot for its deadline; must be called with w->lock held. */
+static void qt_wheel_insert(qt_wheel_t *w,
+                            qt_timer_t *t)
+{   /*{{{*/
+    /* round up, so that a timer never fires early */
+    uint64_t     expires = (t->deadline + (UINT64_C(1) << TICK_SHIFT) - 1) >> TICK_SHIFT;
+    qt_timer_t **slot;
+
+    if (expires < w->now) {
+        expires = w->now;
+    }
+    if (expires - w->now < LEVEL0_SLOTS) {
+        slot = &w->level0[expires & (LEVEL0_SLOTS - 1)];
+    } else {
+        int l;
+
+        /* too far off for the top level: park it in the last slot it can
+         * reach, and it will be put back when that slot cascades */
+        if (expires - w->now >= MAX_TICKS) {
+            expires = w->now + MAX_TICKS - 1;
+        }
+        for (l = 0; l < LEVELS - 1; l++) {
+            if (expires - w->now < (UINT64_C(1) << (LEVEL0_BITS + (l + 1) * LEVEL_BITS))) { break; }
+        }
+        slot = &w->levels[l][(expires >> (LEVEL0_BITS + l * LEVEL_BITS)) & (LEVEL_SLOTS - 1)];
+    }
+    t->next = *slot;
+    if (t->next) {
+        t->next->prev = &t->next;
+    }
+    t->prev = slot;
+    *slot   = t;
+} /*}}}*/
+
+static QINLINE void qt_wheel_unlink(qt_timer_t *t)
+{   /*{{{*/
+    *t->prev = t->next;
+    if (t->next) {
+        t->next->prev = t->prev;
+    }
+    t->prev = NULL;
+} /*}}}*/
+
+/* Moves the timers in a slot of level l down to where they now belong, and
+ * returns the slot's index (when that is zero, level l has wrapped around,
+ * and the level above is due to cascade as well). */
+static size_t qt_wheel_cascade(qt_wheel_t *w,
+                               int         l)
+{   /*{{{*/
+    const size_t index = (w->now >> (LEVEL0_BITS + l * LEVEL_BITS)) & (LEVEL_SLOTS - 1);
+    qt_timer_t  *t     = w->levels[l][index];
+
+    w->levels[l][index] = NULL;
+    while (t != NULL) {
+        qt_timer_t *next = t->next;
+
+        qt_wheel_insert(w, t);
+        t = next;
+    }
+    return index;
+} /*}}}*/
+
+/* Runs the wheel up to the present, and returns the timers that are due,
+ * unlinked, in a list; must be called with w->lock held. */
+static qt_timer_t *qt_wheel_advance(qt_wheel_t    *w,
+                                    const uint64_t now)
+{   /*{{{*/
+    const uint64_t target  = now >> TICK_SHIFT;
+    qt_timer_t    *expired = NULL;
+
+    while (w->count > 0 && w->now <= target) {
+        const size_t index = w->now & (LEVEL0_SLOTS - 1);
+        qt_timer_t  *t;
+
+        if (index == 0) {
+            /* level 0 has wrapped around, and maybe the levels above it */
+            int l = 0;
+
+            while (l < LEVELS && qt_wheel_cascade(w, l) == 0) l++;
+        }
+        t                = w->level0[index];
+        w->level0[index] = NULL;
+        w->now++;
+        while (t != NULL) {
+            qt_timer_t *next = t->next;
+
+            if (t->deadline > now) {
+                /* only happens to timers that were beyond the top level */
+                qt_wheel_insert(w, t);
+            } else {
+                t->prev = NULL;
+                t->next = expired;
+                expired = t;
+                w->count--;
+            }
+            t = next;
+        }
+    }
+    if (w->now <= target) {
+        /* nothing left in the wheel, so there is nothing to step through */
+        w->now = target + 1;
+    }
+    return expired;
+} /*}}}*/
+
+void INTERNAL qt_timer_start(qt_timer_t           *t,
+                             qthread_shepherd_id_t shep)
+{   /*{{{*/
+    qt_wheel_t *w = &wheels[shep];
+
+    assert(wheels);
+    assert(t->fire);
+    t->shep = shep;
+    qt_wheel_lock(&w->lock);
+    if (w->count == 0) {
+        /* nobody has been advancing an empty wheel; catch it up */
+        const uint64_t now = qt_timer_now() >> TICK_SHIFT;
+
+        if (w->now < now) { w->now = now; }
+    }
+    qt_wheel_insert(w, t);
+    w->count++;
+    qt_wheel_unlock(&w->lock);
+    qthread_debug(IO_DETAILS, "timer %p on shep %i, deadline %llu\n", t, (int)shep, (unsigned long long)t->deadline);
+} /*}}}*/
+
+/* Returns nonzero if t was taken out of its wheel before it could fire; zero
+ * means it has fired, or is being fired right now. */
+int INTERNAL qt_timer_cancel(qt_timer_t *t)
+{   /*{{{*/
+    qt_wheel_t *w = &wheels[t->shep];
+    int         ret = 0;
+
+    qt_wheel_lock(&w->lock);
+    if (t->prev != NULL) {
+        qt_wheel_unlink(t);
+        w->count--;
+        ret = 1;
+    }
+    qt_wheel_unlock(&w->lock);
+    return ret;
+} /*}}}*/
+
+static int qt_wheel_tryrun(qt_wheel_t *w)
+{   /*{{{*/
+    qt_timer_t *expired;
+    int         n = 0;
+
+    if ((w->count == 0) || (w->lock != 0) || (qthread_cas(&w->lock, 0, 1) != 0)) {
+        return 0;
+    }
+    expired = qt_wheel_advance(w, qt_timer_now());
+    qt_wheel_unlock(&w->lock);
+    while (expired != NULL) {
+        qt_timer_t *t = expired;
+
+        expired = t->next;
+        t->next = NULL;
+        t->fire(t);
+        n++;
+    }
+    return n;
+} /*}}}*/
+
+/* Fires the timers on shep's wheel that are due; returns how many there
+ * were. A busy worker only looks now and then; an idle one also looks at the
+ * other shepherds' wheels, since their workers may be too busy to. */
+int INTERNAL qt_timer_poll(qthread_shepherd_id_t shep,
+                           int                   idle)
+{   /*{{{*/
+    int n;
+
+    if (wheels == NULL) { return 0; }
+    if (!idle) {
+        if ((wheels[shep].count == 0) || ((++wheels[shep].ticks % TIMER_INTERVAL) != 0)) {
+            return 0;
+        }
+        return qt_wheel_tryrun(&wheels[shep]);
+    }
+    n = qt_wheel_tryrun(&wheels[shep]);
+    for (qthread_shepherd_id_t i = 1; n == 0 && i < nwheels; i++) {
+        n = qt_wheel_tryrun(&wheels[(shep + i) % nwheels]);
+    }
+    return n;
+} /*}}}*/
+
+unsigned long INTERNAL qt_timer_park_usecs(qthread_shepherd_id_t shep,
+                                           unsigned long         usec)
+{   /*{{{*/
+    qt_wheel_t *w;
+    uint64_t    next, now;
+
+    if ((wheels == NULL) || (wheels[shep].count == 0)) { return usec; }
+    w = &wheels[shep];
+    qt_wheel_lock(&w->lock);
+    /* the first full slot on level 0, or failing that the next cascade,
+     * before which nothing can be due */
+    for (next = w->now; w->level0[next & (LEVEL0_SLOTS - 1)] == NULL; ) {
+        if ((++next & (LEVEL0_SLOTS - 1)) == 0) { break; }
+    }
+    qt_wheel_unlock(&w->lock);
+    next <<= TICK_SHIFT;
+    now    = qt_timer_now();
+    if (next <= now) { return 0; }
+    next = (next - now + 999) / 1000;
+    return (next < usec) ? (unsigned long)next : usec;
+} /*}}}*/
+
+/* Sleeping tasks are switched out as if they were making a blocking call; the
+ * shepherd hands the job to qt_blocking_subsystem_enqueue(), which starts the
+ * timer (on the task's stack) once the task is safely off its stack. */
+static void qt_timer_wake(qt_timer_t *t)
+{   /*{{{*/
+    qt_blocking_queue_node_t *job = (qt_blocking_queue_node_t *)t->arg;
+
+    job->ret = 0;
+    job->err = 0;
+    qt_threadqueue_enqueue(job->thread->rdata->shepherd_ptr->ready, job->thread);
+} /*}}}*/
+
+void INTERNAL qt_timer_sleep(syscall_t op,
+                             uint64_t  nsecs)
+{   /*{{{*/
+    qthread_t                *me = qthread_internal_self();
+    qt_blocking_queue_node_t *job;
+    qt_timer_t                t;
+
+    assert(me);
+    assert(me->rdata);
+    job = ALLOC_SYSCALLJOB();
+    assert(job);
+    t.deadline   = qt_timer_now() + nsecs;
+    t.fire       = qt_timer_wake;
+    t.arg        = job;
+    job->next    = NULL;
+    job->thread  = me;
+    job->op      = op;
+    job->args[0] = (uintptr_t)&t;
+
+    me->rdata->blockedon.io = job;
+    me->thread_state        = QTHREAD_STATE_SYSCALL;
+    qthread_back_to_master(me);
+    FREE_SYSCALLJOB(job);
+} /*}}}*/
+#endif /* ifdef QTHREAD_USE_TIMER_WHEEL */
+
+/* Tasks forked with a delay. With the timer wheel, nothing is spawned until
+ * the timer fires; otherwise a task is spawned at once, and yields until it
+ * is time to call f. */
+typedef struct {
+#ifdef QTHREAD_USE_TIMER_WHEEL
+    qt_timer_t timer;
+#else
+    double     deadline;               /* qtimer_wtime() */
+#endif
+    qthread_f  f;
+    void      *arg;
+    aligned_t *ret;
+    uint64_t   period;                 /* usecs; zero for a one-shot */
+} qt_timed_fork_t;
+
+#ifdef QTHREAD_USE_TIMER_WHEEL
+static aligned_t qt_timed_fork_periodic(void *arg)
+{   /*{{{*/
+    qt_timed_fork_t *tf  = (qt_timed_fork_t *)arg;
+    aligned_t        ret = tf->f(tf->arg);
+
+    if (ret != 0) {
+        if (tf->ret) {
+            qthread_writeF_const(tf->ret, ret);
+        }
+        FREE(tf, sizeof(qt_timed_fork_t));
+    } else {
+        const uint64_t now = qt_timer_now();
+
+        /* keep to the original schedule, unless f has fallen behind it */
+        tf->timer.deadline += tf->period * 1000;
+        if (tf->timer.deadline < now) {
+            tf->timer.deadline = now;
+        }
+        qt_timer_start(&tf->timer, qthread_shep());
+    }
+    return 0;
+} /*}}}*/
+
+static void qt_timed_fork_fire(qt_timer_t *t)
+{   /*{{{*/
+    qt_timed_fork_t *tf = (qt_timed_fork_t *)t->arg;
+
+    if (tf->period == 0) {
+        qthread_fork(tf->f, tf->arg, tf->ret);
+        FREE(tf, sizeof(qt_timed_fork_t));
+    } else {
+        qthread_fork(qt_timed_fork_periodic, tf, NULL);
+    }
+} /*}}}*/
+
+#else /* ifdef QTHREAD_USE_TIMER_WHEEL */
+static aligned_t qt_timed_fork_wait(void *arg)
+{   /*{{{*/
+    qt_timed_fork_t *tf = (qt_timed_fork_t *)arg;
+    aligned_t        ret;
+
+    do {
+        while (qtimer_wtime() < tf->deadline) {
+            qthread_yield();
+        }
+        ret           = tf->f(tf->arg);
+        tf->deadline += tf->period * 1e-6;
+    } while (tf->period != 0 && ret == 0);
+    FREE(tf, sizeof(qt_timed_fork_t));
+    return ret;
+} /*}}}*/
+#endif /* ifdef QTHREAD_USE_TIMER_WHEEL */
+
+static int qt_timed_fork(qthread_f   f,
+                         const void *arg,
+                         aligned_t  *ret,
+                         uint64_t    usecs,
+                         uint64_t    period)
+{   /*{{{*/
+    qt_timed_fork_t *tf;
+
+    assert(qthread_library_initialized);
+    qassert_ret(f, QTHREAD_BADARGS);
+    tf = MALLOC(sizeof(qt_timed_fork_t));
+    if (tf == NULL) {
+        return QTHREAD_MALLOC_ERROR;
+    }
+    tf->f      = f;
+    tf->arg    = (void *)arg;
+    tf->ret    = ret;
+    tf->period = period;
+#ifdef QTHREAD_USE_TIMER_WHEEL
+    {
+        qthread_shepherd_t *shep = qthread_internal_getshep();
+
+        if (ret) {
+            qthread_empty(ret);
+        }
+        tf->timer.deadline = qt_timer_now() + usecs * 1000;
+        tf->timer.fire     = qt_timed_fork_fire;
+        tf->timer.arg      = tf;
+        qt_timer_start(&tf->timer, shep ? shep->shepherd_id : 0);
+        return QTHREAD_SUCCESS;
+    }
+#else
+    tf->deadline = qtimer_wtime() + usecs * 1e-6;
+    {
+        const int r = qthread_fork(qt_timed_fork_wait, tf, ret);
+
+        if (r != QTHREAD_SUCCESS) {
+            FREE(tf, sizeof(qt_timed_fork_t));
+        }
+        return r;
+    }
+#endif /* ifdef QTHREAD_USE_TIMER_WHEEL */
+} /*}}}*/
+
+int API_FUNC qthread_fork_after(qthread_f   f,
+                                const void *arg,
+                                aligned_t  *ret,
+                                uint64_t    usecs)
+{   /*{{{*/
+    return qt_timed_fork(f, arg, ret, usecs, 0);
+} /*}}}*/
+
+int API_FUNC qthread_fork_every(qthread_f   f,
+                                const void *arg,
+                                aligned_t  *ret,
+                                uint64_t    usecs)
+{   /*{{{*/
+    qassert_ret(usecs > 0, QTHREAD_BADARGS);
+    return qt_timed_fork(f, arg, ret, usecs, usecs);
+} /*}}}*/
+
+/* vim:set expandtab: */
@@ -0,0 +1,127 @@
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include "qt_feb.h" /* for qthread_readFF_nb() */
+#include "argparsing.h"
+
+// Touches many more addresses than the FEB table has slots (16384 by
+// default), so that slots have to be handed from one address to the next,
+// while a few addresses hold on to theirs by being empty and waited on. First,
+// though, keeps them all empty at once, so that most overflow the table.
+
+#define HELD 64
+
+static aligned_t  held[HELD];
+static aligned_t *words;
+static size_t     num_words = 4 * 16384;
+static size_t     num_tasks;
+
+static aligned_t wait_for_held(void *arg)
+{
+    aligned_t *w = arg;
+    aligned_t  v;
+
+    qthread_readFF(&v, w);
+    assert(v == (aligned_t)(w - held) + 1);
+    return 0;
+}
+
+static aligned_t churn(void *arg)
+{
+    const size_t id = (uintptr_t)arg;
+
+    for (size_t i = id; i < num_words; i += num_tasks) {
+        aligned_t v;
+
+        qthread_empty(&words[i]);
+        assert(qthread_feb_status(&words[i]) == 0);
+        qthread_writeEF_const(&words[i], i);
+        assert(qthread_feb_status(&words[i]) == 1);
+        qthread_readFE(&v, &words[i]);
+        assert(v == i);
+        assert(qthread_feb_status(&words[i]) == 0);
+        qthread_fill(&words[i]);
+    }
+    return 0;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t  held_ret[HELD];
+    aligned_t *churn_ret;
+
+    assert(qthread_initialize() == 0);
+    CHECK_VERBOSE();
+    NUMARG(num_words, "TEST_LEN");
+    num_tasks = qthread_num_workers() * 2;
+    iprintf("%i shepherds...\n", qthread_num_shepherds());
+    iprintf("  %i threads total\n", qthread_num_workers());
+
+    words     = calloc(num_words, sizeof(aligned_t));
+    churn_ret = malloc(num_tasks * sizeof(aligned_t));
+    assert(words && churn_ret);
+
+    for (size_t i = 0; i < HELD; i++) {
+        qthread_empty(&held[i]);
+        qthread_fork(wait_for_held, &held[i], &held_ret[i]);
+    }
+
+    // empty words have to keep their slots, so most of these overflow the
+    // table, many while it still has unclaimed slots; they must be found
+    // empty, not mistaken for words that never had a slot
+    for (size_t i = 0; i < num_words; i++) {
+        aligned_t v;
+
+        qthread_empty(&words[i]);
+        assert(qthread_feb_status(&words[i]) == 0);
+        assert(qthread_readFF_nb(&v, &words[i]) == QTHREAD_OPFAIL);
+    }
+    for (size_t i = 0; i < num_words; i++) {
+        assert(qthread_feb_status(&words[i]) == 0);
+    }
+    for (size_t i = 0; i < num_words; i++) {
+        aligned_t v;
+
+        qthread_writeF_const(&words[i], i);
+        assert(qthread_feb_status(&words[i]) == 1);
+        assert(qthread_readFF_nb(&v, &words[i]) == QTHREAD_SUCCESS);
+        assert(v == i);
+    }
+    iprintf("emptied %lu words at once\n", (unsigned long)num_words);
+
+    for (size_t i = 0; i < num_tasks; i++) {
+        qthread_fork(churn, (void *)(uintptr_t)i, &churn_ret[i]);
+    }
+    for (size_t i = 0; i < num_tasks; i++) {
+        qthread_readFF(NULL, &churn_ret[i]);
+    }
+    iprintf("emptied and filled %lu words\n", (unsigned long)num_words);
+
+    for (size_t i = 0; i < num_words; i++) {
+        assert(qthread_feb_status(&words[i]) == 1);
+        assert(words[i] == i);
+    }
+
+    // the held words kept their state, and their waiters, throughout
+    for (size_t i = 0; i < HELD; i++) {
+        assert(qthread_feb_status(&held[i]) == 0);
+        qthread_writeEF_const(&held[i], i + 1);
+    }
+    for (size_t i = 0; i < HELD; i++) {
+        qthread_readFF(NULL, &held_ret[i]);
+        assert(qthread_feb_status(&held[i]) == 1);
+    }
+    iprintf("%i held words were woken\n", HELD);
+
+    free(words);
+    free(churn_ret);
+    return 0;
+}
+
+/* vim:set expandtab */
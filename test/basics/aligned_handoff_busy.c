@@ -0,0 +1,80 @@
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qtimer.h>
+#include "argparsing.h"
+
+// A task that fills a word somebody is waiting on, and then keeps running
+// instead of blocking, must not hold up the waiter: another worker of the
+// shepherd has to run it.
+
+static aligned_t word;
+static aligned_t waiting;
+static aligned_t woken;
+
+static aligned_t waiter(void *arg)
+{
+    qthread_incr(&waiting, 1);
+    qthread_readFF(NULL, &word);
+    qthread_incr(&woken, 1);
+    return 0;
+}
+
+static aligned_t busy_waker(void *arg)
+{
+    qtimer_t timer = qtimer_create();
+
+    qtimer_start(timer);
+    qthread_fill(&word);
+    // neither blocks nor yields until the waiter has run (or it's hopeless)
+    do {
+        qtimer_stop(timer);
+    } while (qthread_incr(&woken, 0) == 0 && qtimer_secs(timer) < 10.0);
+    qtimer_destroy(timer);
+    assert(woken == 1);
+    return 0;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    size_t rounds = 20;
+
+    // the waiter needs a second worker on the waker's shepherd
+    setenv("QT_NUM_SHEPHERDS", "1", 0);
+    setenv("QT_NUM_WORKERS_PER_SHEPHERD", "2", 0);
+    assert(qthread_initialize() == 0);
+    CHECK_VERBOSE();
+    NUMARG(rounds, "TEST_ROUNDS");
+    iprintf("%i shepherds...\n", qthread_num_shepherds());
+    iprintf("  %i threads total\n", qthread_num_workers());
+
+    if (qthread_num_workers() < 2 * qthread_num_shepherds()) {
+        iprintf("only one worker per shepherd; nothing to test\n");
+        return 0;
+    }
+
+    for (size_t r = 0; r < rounds; r++) {
+        aligned_t waiter_ret, waker_ret;
+
+        qthread_empty(&word);
+        waiting = woken = 0;
+        qthread_fork(waiter, NULL, &waiter_ret);
+        while (qthread_incr(&waiting, 0) == 0) {
+            qthread_yield();
+        }
+        qthread_fork(busy_waker, NULL, &waker_ret);
+        qthread_readFF(NULL, &waker_ret);
+        qthread_readFF(NULL, &waiter_ret);
+    }
+    iprintf("%lu waiters ran while their wakers were busy\n", (unsigned long)rounds);
+
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,196 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"                   /* for QTHREAD_DICTIONARY_STYLE */
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include <qthread/qthread.h>
+#include <qthread/qloop.h>
+#include <qthread/qtimer.h>
+#include <qthread/dictionary.h>
+#include "argparsing.h"
+
+/* Times qt_dictionary under a read-mostly and a write-heavy mix of operations,
+ * and the batch interfaces. The dictionary implementation is chosen when
+ * qthreads is configured (--with-dict), so comparing them means running this
+ * against each build; it says which one it is timing. */
+
+#ifndef QTHREAD_DICTIONARY_STYLE
+# define QTHREAD_DICTIONARY_STYLE "unknown"
+#endif
+
+#define BATCH 32
+
+static size_t         nkeys = 1 << 16;
+static size_t         nops  = 1 << 21;
+static qt_dictionary *dict;
+static qtimer_t       timer;
+
+static int key_equals(void *a,
+                      void *b)
+{
+    return a == b;
+}
+
+static int key_hash(void *k)
+{
+    return (int)(uintptr_t)k;
+}
+
+static QINLINE uint64_t xorshift(uint64_t *s)
+{
+    uint64_t x = *s;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *s = x;
+}
+
+/* keys are 1..nkeys; 0 would be NULL */
+static QINLINE void *key_of(uint64_t r)
+{
+    return (void *)(uintptr_t)(1 + r % nkeys);
+}
+
+static void populate(const size_t startat,
+                     const size_t stopat,
+                     void        *arg)
+{
+    for (size_t i = startat; i < stopat; i++) {
+        void *k = (void *)(uintptr_t)(i + 1);
+
+        if (qt_dictionary_put(dict, k, k) == NULL) {
+            fprintf(stderr, "qt_dictionary_put(%lu) failed!\n", (unsigned long)i + 1);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/* arg is the percentage of operations that write: half of those put (and
+ * re-insert whatever the other half deleted), half delete */
+static void mix(const size_t startat,
+                const size_t stopat,
+                void        *arg)
+{
+    const uint64_t writes = (uintptr_t)arg;
+    uint64_t       seed   = 0x9e3779b97f4a7c15ULL ^ (startat + 1);
+
+    for (size_t i = startat; i < stopat; i++) {
+        const uint64_t r  = xorshift(&seed);
+        const uint64_t op = (r >> 40) % 100;
+        void          *k  = key_of(r);
+
+        if (op >= writes) {
+            void *v = qt_dictionary_get(dict, k);
+
+            if ((v != NULL) && (v != k)) {
+                fprintf(stderr, "qt_dictionary_get(%p) returned %p!\n", k, v);
+                exit(EXIT_FAILURE);
+            }
+        } else if (op & 1) {
+            (void)qt_dictionary_delete(dict, k);
+        } else {
+            (void)qt_dictionary_put(dict, k, k);
+        }
+    }
+}
+
+static void batch_put(const size_t startat,
+                      const size_t stopat,
+                      void        *arg)
+{
+    void *keys[BATCH];
+
+    for (size_t i = startat; i < stopat; i += BATCH) {
+        const size_t n = (stopat - i < BATCH) ? (stopat - i) : BATCH;
+
+        for (size_t j = 0; j < n; j++) {
+            keys[j] = (void *)(uintptr_t)(i + j + 1);
+        }
+        if (qt_dictionary_put_many(dict, keys, keys, n, NULL) != n) {
+            fprintf(stderr, "qt_dictionary_put_many() failed!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static void batch_get(const size_t startat,
+                      const size_t stopat,
+                      void        *arg)
+{
+    void *keys[BATCH], *vals[BATCH];
+
+    for (size_t i = startat; i < stopat; i += BATCH) {
+        const size_t n = (stopat - i < BATCH) ? (stopat - i) : BATCH;
+
+        for (size_t j = 0; j < n; j++) {
+            keys[j] = (void *)(uintptr_t)(i + j + 1);
+        }
+        if (qt_dictionary_get_many(dict, keys, vals, n) != n) {
+            fprintf(stderr, "qt_dictionary_get_many() missed!\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t j = 0; j < n; j++) {
+            assert(vals[j] == keys[j]);
+        }
+    }
+}
+
+static void report(const char *what,
+                   size_t      ops)
+{
+    printf("%-28s %9.4f secs %9.2f nsecs/op\n", what,
+           qtimer_secs(timer), 1e9 * qtimer_secs(timer) / ops);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(nkeys, "DICT_KEYS");
+    NUMARG(nops, "DICT_OPS");
+    timer = qtimer_create();
+
+    printf("dictionary style: %s, %u workers, %lu keys, %lu ops\n",
+           QTHREAD_DICTIONARY_STYLE, qthread_num_workers(),
+           (unsigned long)nkeys, (unsigned long)nops);
+
+    dict = qt_dictionary_create(key_equals, key_hash, NULL);
+    assert(dict);
+    qtimer_start(timer);
+    qt_loop_balance(0, nkeys, populate, NULL);
+    qtimer_stop(timer);
+    report("populate:", nkeys);
+
+    qtimer_start(timer);
+    qt_loop_balance(0, nops, mix, (void *)(uintptr_t)10);
+    qtimer_stop(timer);
+    report("read-mostly (90% get):", nops);
+
+    qtimer_start(timer);
+    qt_loop_balance(0, nops, mix, (void *)(uintptr_t)90);
+    qtimer_stop(timer);
+    report("write-heavy (10% get):", nops);
+
+    qtimer_start(timer);
+    qt_loop_balance(0, nkeys, batch_put, NULL);
+    qtimer_stop(timer);
+    report("put_many:", nkeys);
+
+    qtimer_start(timer);
+    qt_loop_balance(0, nkeys, batch_get, NULL);
+    qtimer_stop(timer);
+    report("get_many:", nkeys);
+
+    qt_dictionary_destroy(dict);
+    qtimer_destroy(timer);
+
+    return 0;
+}
+
+/* vim:set expandtab */
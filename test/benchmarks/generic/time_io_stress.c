@@ -0,0 +1,144 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include <qthread/qthread.h>
+#include <qthread/qtimer.h>
+#include <qthread/io.h>
+#include <qthread/qt_syscalls.h>
+#include "argparsing.h"
+
+/* Hammers the blocking I/O subsystem from every shepherd at once: blocking
+ * actions that do next to nothing (so what gets timed is handing the task to
+ * a proxy thread and back), lots of small pwrites, as a checkpoint writer
+ * would issue, and bursts of blocking actions with idle gaps between them,
+ * which is when proxies used to time out and have to be started again.
+ * pwrite goes to io_uring rather than the proxies where the library has it;
+ * set QT_IO_URING=0 to time the proxies instead. */
+
+#define CHUNK 64
+
+static size_t   tasks  = 256;
+static size_t   ops    = 64;
+static size_t   bursts = 100;
+static size_t   gap    = 1000; /* usecs between bursts */
+static int      fd     = -1;
+static qtimer_t timer;
+
+static aligned_t actions(void *arg)
+{
+    for (size_t i = 0; i < ops; i++) {
+        qt_begin_blocking_action();
+        (void)getppid();
+        qt_end_blocking_action();
+    }
+    return 0;
+}
+
+static aligned_t writes(void *arg)
+{
+    const size_t t = (uintptr_t)arg;
+    char         buf[CHUNK];
+
+    memset(buf, 'a' + (int)(t % 26), CHUNK);
+    for (size_t i = 0; i < ops; i++) {
+        const off_t offset = (off_t)((i * tasks + t) * CHUNK);
+
+        if (qt_pwrite(fd, buf, CHUNK, offset) != CHUNK) {
+            fprintf(stderr, "qt_pwrite() failed (%s)\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    return 0;
+}
+
+static aligned_t action(void *arg)
+{
+    qt_begin_blocking_action();
+    (void)getppid();
+    qt_end_blocking_action();
+    return 0;
+}
+
+static void run(qthread_f  f,
+                aligned_t *rets,
+                size_t     n)
+{
+    for (size_t i = 0; i < n; i++) {
+        assert(qthread_fork(f, (void *)(uintptr_t)i, &rets[i]) == QTHREAD_SUCCESS);
+    }
+    for (size_t i = 0; i < n; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+}
+
+static void report(const char *what,
+                   double      secs,
+                   size_t      n)
+{
+    printf("%-28s %9.4f secs %9.2f usecs/op\n", what, secs, 1e6 * secs / n);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t *rets;
+    char       path[] = "/tmp/time_io_stressXXXXXX";
+    double     busy   = 0.0;
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(tasks, "IO_TASKS");
+    NUMARG(ops, "IO_OPS");
+    NUMARG(bursts, "IO_BURSTS");
+    NUMARG(gap, "IO_GAP");
+    timer = qtimer_create();
+    rets  = calloc(tasks, sizeof(aligned_t));
+    assert(rets);
+
+    printf("%u shepherds, %u workers, %lu tasks, %lu ops each\n",
+           qthread_num_shepherds(), qthread_num_workers(),
+           (unsigned long)tasks, (unsigned long)ops);
+
+    qtimer_start(timer);
+    run(actions, rets, tasks);
+    qtimer_stop(timer);
+    report("blocking actions:", qtimer_secs(timer), tasks * ops);
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        exit(EXIT_FAILURE);
+    }
+    unlink(path);
+    qtimer_start(timer);
+    run(writes, rets, tasks);
+    qtimer_stop(timer);
+    report("small pwrites:", qtimer_secs(timer), tasks * ops);
+    close(fd);
+
+    /* only the bursts themselves are timed, not the gaps */
+    for (size_t b = 0; b < bursts; b++) {
+        qt_usleep((useconds_t)gap);
+        qtimer_start(timer);
+        run(action, rets, tasks);
+        qtimer_stop(timer);
+        busy += qtimer_secs(timer);
+    }
+    report("bursts:", busy, bursts * tasks);
+
+    free(rets);
+    qtimer_destroy(timer);
+
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -170,6 +170,7 @@ int main(int   argc,
     run_iterations(qt_loopaccum_balance_sv, count, multi_op, overhead, "balanced", "syncvar");
     run_iterations(qt_loopaccum_balance_sinc, count, multi_op, overhead, "balanced", "sinc");
     run_iterations(qt_loopaccum_balance_dc, count, multi_op, overhead, "balanced", "donecount");
+    run_iterations(qt_loopaccum_split, count, multi_op, overhead, "split", "sinc");
 
     return 0;
 }
@@ -110,7 +110,7 @@ int main(int   argc,
 
     qt_loop(0, numincrs, sum, NULL);
 
-    run_args_t pure_args[8] = {
+    run_args_t pure_args[9] = {
         {qt_loop_dc,              sum, "solo pure TPI",      "donecount"},
         {qt_loop_aligned,         sum, "solo pure TPI",      "aligned"},
         {qt_loop_sv,              sum, "solo pure TPI",      "syncvar"},
@@ -119,9 +119,10 @@ int main(int   argc,
         {qt_loop_balance_aligned, sum, "solo pure balanced", "aligned"},
         {qt_loop_balance_sv,      sum, "solo pure balanced", "syncvar"},
         {qt_loop_balance_sinc,    sum, "solo pure balanced", "sinc"},
+        {qt_loop_split,           sum, "solo pure split",    "sinc"},
     };
 
-    for (int i = 0; i < 8; i++) {
+    for (int i = 0; i < 9; i++) {
         qthread_fork(run_iterations, &pure_args[i], &ret);
         qthread_readFE(NULL, &ret);
     }
@@ -133,7 +134,7 @@ int main(int   argc,
 
     qt_loop(0, numincrs, sum, NULL);
 
-    run_args_t team_pure_args[8] = {
+    run_args_t team_pure_args[9] = {
         {qt_loop_dc,              sum, "team pure TPI",      "donecount"},
         {qt_loop_aligned,         sum, "team pure TPI",      "aligned"},
         {qt_loop_sv,              sum, "team pure TPI",      "syncvar"},
@@ -142,9 +143,10 @@ int main(int   argc,
         {qt_loop_balance_aligned, sum, "team pure balanced", "aligned"},
         {qt_loop_balance_sv,      sum, "team pure balanced", "syncvar"},
         {qt_loop_balance_sinc,    sum, "team pure balanced", "sinc"},
+        {qt_loop_split,           sum, "team pure split",    "sinc"},
     };
 
-    for (int i = 0; i < 8; i++) {
+    for (int i = 0; i < 9; i++) {
         qthread_fork_new_team(run_iterations, &team_pure_args[i], &ret);
         qthread_readFE(NULL, &ret);
     }
@@ -155,7 +157,7 @@ int main(int   argc,
         printf("%-4s %-4s %-23s %-9s %8s time\n", "sheps", "workers", "grouping work looptype", "sync", "iters");
     }
 
-    run_args_t rand_args[8] = {
+    run_args_t rand_args[9] = {
         {qt_loop_dc,              sumrand, "solo rand TPI",      "donecount"},
         {qt_loop_aligned,         sumrand, "solo rand TPI",      "aligned"},
         {qt_loop_sv,              sumrand, "solo rand TPI",      "syncvar"},
@@ -164,9 +166,10 @@ int main(int   argc,
         {qt_loop_balance_aligned, sumrand, "solo rand balanced", "aligned"},
         {qt_loop_balance_sv,      sumrand, "solo rand balanced", "syncvar"},
         {qt_loop_balance_sinc,    sumrand, "solo rand balanced", "sinc"},
+        {qt_loop_split,           sumrand, "solo rand split",    "sinc"},
     };
     
-    for (int i = 0; i < 8; i++) {
+    for (int i = 0; i < 9; i++) {
         qthread_fork(run_iterations, &rand_args[i], &ret);
         qthread_readFE(NULL, &ret);
     }
@@ -177,7 +180,7 @@ int main(int   argc,
         printf("%-4s %-4s %-23s %-9s %8s time\n", "sheps", "workers", "grouping work looptype", "sync", "iters");
     }
 
-    run_args_t team_rand_args[8] = {
+    run_args_t team_rand_args[9] = {
         {qt_loop_dc,              sumrand, "team rand TPI",      "donecount"},
         {qt_loop_aligned,         sumrand, "team rand TPI",      "aligned"},
         {qt_loop_sv,              sumrand, "team rand TPI",      "syncvar"},
@@ -186,9 +189,10 @@ int main(int   argc,
         {qt_loop_balance_aligned, sumrand, "team rand balanced", "aligned"},
         {qt_loop_balance_sv,      sumrand, "team rand balanced", "syncvar"},
         {qt_loop_balance_sinc,    sumrand, "team rand balanced", "sinc"},
+        {qt_loop_split,           sumrand, "team rand split",    "sinc"},
     };
     
-    for (int i = 0; i < 8; i++) {
+    for (int i = 0; i < 9; i++) {
         qthread_fork_new_team(run_iterations, &team_rand_args[i], &ret);
         qthread_readFE(NULL, &ret);
     }
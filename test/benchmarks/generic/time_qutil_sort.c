@@ -0,0 +1,170 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"                   /* for _GNU_SOURCE */
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <qthread/qthread.h>
+#include <qthread/qutil.h>
+#include <qthread/qtimer.h>
+#include "argparsing.h"
+
+/* Compares the generic sorts against the type-specific qutil sorts and libc
+ * qsort(), on the array sizes used by test/features/qutil_qsort.c. */
+
+typedef struct {
+    uint64_t key;
+    char     payload[24];
+} record_t;
+
+static size_t        len        = 1000000;
+static unsigned long iterations = 10;
+static qtimer_t      timer;
+
+static int acmp(const void *a,
+                const void *b)
+{
+    const aligned_t x = *(const aligned_t *)a, y = *(const aligned_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int dcmp(const void *a,
+                const void *b)
+{
+    const double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int rcmp(const void *a,
+                const void *b)
+{
+    const uint64_t x = ((const record_t *)a)->key, y = ((const record_t *)b)->key;
+
+    return (x > y) - (x < y);
+}
+
+static uint64_t akey(const void *a)
+{
+    return *(const aligned_t *)a;
+}
+
+static uint64_t dkey(const void *a)
+{
+    return qutil_radix_key_double(*(const double *)a);
+}
+
+static uint64_t rkey(const void *a)
+{
+    return ((const record_t *)a)->key;
+}
+
+enum { QUTIL_TYPED, RADIX, SAMPLE, LIBC };
+static const char *const names[] = { "qutil typed", "qutil_radix_sort", "qutil_sample_sort", "libc qsort" };
+
+static void run(const char   *what,
+                const void   *orig,
+                size_t        size,
+                int           how,
+                qutil_key_f   key,
+                qutil_cmp_f   cmp,
+                void          (*typed)(void *, size_t))
+{
+    void  *work = malloc(len * size);
+    double total = 0.0;
+
+    assert(work);
+    for (unsigned long i = 0; i < iterations; i++) {
+        memcpy(work, orig, len * size);
+        qtimer_start(timer);
+        switch (how) {
+            case QUTIL_TYPED: typed(work, len); break;
+            case RADIX: qutil_radix_sort(work, len, size, key); break;
+            case SAMPLE: qutil_sample_sort(work, len, size, cmp); break;
+            case LIBC: qsort(work, len, size, cmp); break;
+        }
+        qtimer_stop(timer);
+        total += qtimer_secs(timer);
+        for (size_t j = 1; j < len; j++) {
+            if (cmp((char *)work + (j - 1) * size, (char *)work + j * size) > 0) {
+                fprintf(stderr, "%s with %s: out of order at %lu\n", what,
+                        names[how], (unsigned long)j);
+                abort();
+            }
+        }
+    }
+    printf("%-8s %-18s %10lu %f\n", what, names[how], (unsigned long)len,
+           total / iterations);
+    free(work);
+}
+
+static void typed_aligned(void  *a,
+                          size_t n)
+{
+    qutil_aligned_qsort(a, n);
+}
+
+static void typed_double(void  *a,
+                         size_t n)
+{
+    qutil_qsort(a, n);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t *ui_array;
+    double    *d_array;
+    record_t  *r_array;
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    timer = qtimer_create();
+
+    CHECK_VERBOSE();
+    NUMARG(len, "TEST_LEN");
+    NUMARG(iterations, "TEST_ITERATIONS");
+    printf("%i workers\n", (int)qthread_num_workers());
+    printf("%-8s %-18s %10s %s\n", "type", "sort", "records", "seconds (avg)");
+
+    ui_array = malloc(len * sizeof(aligned_t));
+    assert(ui_array);
+    for (size_t i = 0; i < len; i++) {
+        ui_array[i] = random();
+    }
+    run("aligned", ui_array, sizeof(aligned_t), QUTIL_TYPED, akey, acmp, typed_aligned);
+    run("aligned", ui_array, sizeof(aligned_t), RADIX, akey, acmp, NULL);
+    run("aligned", ui_array, sizeof(aligned_t), SAMPLE, akey, acmp, NULL);
+    run("aligned", ui_array, sizeof(aligned_t), LIBC, akey, acmp, NULL);
+    free(ui_array);
+
+    d_array = malloc(len * sizeof(double));
+    assert(d_array);
+    for (size_t i = 0; i < len; i++) {
+        d_array[i] = random() / (double)RAND_MAX * 10;
+    }
+    run("double", d_array, sizeof(double), QUTIL_TYPED, dkey, dcmp, typed_double);
+    run("double", d_array, sizeof(double), RADIX, dkey, dcmp, NULL);
+    run("double", d_array, sizeof(double), SAMPLE, dkey, dcmp, NULL);
+    run("double", d_array, sizeof(double), LIBC, dkey, dcmp, NULL);
+    free(d_array);
+
+    r_array = malloc(len * sizeof(record_t));
+    assert(r_array);
+    for (size_t i = 0; i < len; i++) {
+        r_array[i].key = ((uint64_t)random() << 31) ^ random();
+        memset(r_array[i].payload, (int)i, sizeof(r_array[i].payload));
+    }
+    run("record", r_array, sizeof(record_t), RADIX, rkey, rcmp, NULL);
+    run("record", r_array, sizeof(record_t), SAMPLE, rkey, rcmp, NULL);
+    run("record", r_array, sizeof(record_t), LIBC, rkey, rcmp, NULL);
+    free(r_array);
+
+    qtimer_destroy(timer);
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -1,9 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 #include <qthread/qthread.h>
 #include <qthread/qloop.h>
 #include <qthread/qtimer.h>
+#include "argparsing.h"
 
 
 // native qthreads version of thread-ring, based on Chapel's release version
@@ -13,6 +16,16 @@
 static int n = 50000000, ntasks = 503;
 static aligned_t *mailbox;
 
+// user+system time burned by the whole process; compared against wall-clock
+// time this shows how much CPU the idle workers eat (see SPINCOUNT)
+static double cpu_secs(void) {
+  struct rusage ru;
+
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+         (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
 static void passTokens(size_t start, size_t stop, void* arg) {
   uint64_t id = start;
 
@@ -43,16 +56,22 @@ static void init() {
 
 int main(int argc, char **argv) {
   qtimer_t timer = qtimer_create();
-  double ring_time;
+  double ring_time, cpu_time;
+
+  CHECK_VERBOSE();
+  NUMARG(n, "NUM_PASSES");
   init();
 
+  cpu_time = cpu_secs();
   qtimer_start(timer);
   qthread_writeEF_const(&mailbox[0], 0);
   qt_loop_simple(0, ntasks, passTokens, NULL);
   qtimer_stop(timer);
   ring_time = qtimer_secs(timer);
+  cpu_time  = cpu_secs() - cpu_time;
 
   printf("\tThread ring time: %f usecs, %f/sec\n", 1000000 * ring_time / ntasks, ntasks / ring_time);
+  printf("\tCPU time: %f secs, %f cores busy on average\n", cpu_time, cpu_time / ring_time);
 
   return 0;
 }
@@ -4,6 +4,7 @@
 #include <qthread/qthread.h>
 #include <qthread/qloop.h>
 #include <qthread/qdqueue.h>
+#include <qthread/qlfqueue.h>
 #include <qthread/qpool.h>
 #include <qthread/qtimer.h>
 #include "argparsing.h"
@@ -91,6 +92,55 @@ static void loop_dequeuer(const size_t startat, const size_t stopat,
     qpool_free(memory, ref);
 }                                      /*}}} */
 
+/* The baseline: one qlfqueue per shepherd, where a dequeuer that finds its
+ * own empty simply tries the others in order. */
+static qlfqueue_t **localqs = NULL;
+
+static void loop_local_queuer(const size_t startat, const size_t stopat,
+                              void *arg)
+{                                      /*{{{ */
+    size_t i;
+    qlfqueue_t *q = localqs[qthread_shep()];
+
+    for (i = startat; i < stopat; i++) {
+        void *tmp = qpool_alloc(memory);
+        memset(tmp, 1, objsize);
+        if (qlfqueue_enqueue(q, tmp) != QTHREAD_SUCCESS) {
+            fprintf(stderr, "qlfqueue_enqueue(q, %p) failed!\n", (void *)tmp);
+            exit(-2);
+        }
+    }
+}                                      /*}}} */
+
+static void loop_local_dequeuer(const size_t startat, const size_t stopat,
+                                void *arg)
+{                                      /*{{{ */
+    size_t i;
+    const qthread_shepherd_id_t here = qthread_shep();
+    const qthread_shepherd_id_t nsheps = qthread_num_shepherds();
+    void *ref = qpool_alloc(memory);
+
+    memset(ref, 1, objsize);
+    for (i = startat; i < stopat; i++) {
+        void *tmp = NULL;
+        qthread_shepherd_id_t s;
+
+        for (s = 0; s < nsheps && tmp == NULL; s++) {
+            tmp = qlfqueue_dequeue(localqs[(here + s) % nsheps]);
+        }
+        if (tmp == NULL) {
+            fprintf(stderr, "qlfqueue_dequeue() failed!\n");
+            exit(-2);
+        }
+        if (memcmp(ref, tmp, objsize)) {
+            fprintf(stderr, "memory was corrupted!\n");
+            exit(-3);
+        }
+        qpool_free(memory, tmp);
+    }
+    qpool_free(memory, ref);
+}                                      /*}}} */
+
 int main(int argc, char *argv[])
 {
     qdqueue_t *q;
@@ -131,6 +181,29 @@ int main(int argc, char *argv[])
         exit(-2);
     }
 
+    localqs = calloc(qthread_num_shepherds(), sizeof(qlfqueue_t *));
+    assert(localqs != NULL);
+    for (i = 0; i < qthread_num_shepherds(); i++) {
+        localqs[i] = qlfqueue_create();
+        assert(localqs[i] != NULL);
+    }
+    qtimer_start(timer);
+    qt_loop_balance(0, THREAD_COUNT * ELEMENT_COUNT, loop_local_queuer, NULL);
+    qtimer_stop(timer);
+    printf("loop balance local enqueue: %f secs\n", qtimer_secs(timer));
+    qtimer_start(timer);
+    qt_loop_balance(0, THREAD_COUNT * ELEMENT_COUNT, loop_local_dequeuer, NULL);
+    qtimer_stop(timer);
+    printf("loop balance local dequeue: %f secs\n", qtimer_secs(timer));
+    for (i = 0; i < qthread_num_shepherds(); i++) {
+        if (!qlfqueue_empty(localqs[i])) {
+            fprintf(stderr, "local queue %i not empty after loop balance test!\n", (int)i);
+            exit(-2);
+        }
+        qlfqueue_destroy(localqs[i]);
+    }
+    free(localqs);
+
     rets = calloc(THREAD_COUNT, sizeof(aligned_t));
     assert(rets != NULL);
     qtimer_start(timer);
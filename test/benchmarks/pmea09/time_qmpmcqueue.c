@@ -0,0 +1,262 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qloop.h>
+#include <qthread/qmpmcqueue.h>
+#include <qthread/qlfqueue.h>
+#include <qthread/qtimer.h>
+#include "argparsing.h"
+
+#define ELEMENT_COUNT 10000
+#define THREAD_COUNT  128
+#define BATCH         32
+#define SMALL_RING    256
+
+static aligned_t queuer(void *arg)
+{
+    qmpmcqueue_t *q  = (qmpmcqueue_t *)arg;
+    void         *me = (void *)(uintptr_t)qthread_id();
+    size_t        i;
+
+    for (i = 0; i < ELEMENT_COUNT; i++) {
+        if (qmpmcqueue_enqueue_blocking(q, me) != QTHREAD_SUCCESS) {
+            fprintf(stderr, "qmpmcqueue_enqueue_blocking(q, %p) failed!\n", me);
+            exit(-2);
+        }
+    }
+    return 0;
+}
+
+static aligned_t dequeuer(void *arg)
+{
+    qmpmcqueue_t *q = (qmpmcqueue_t *)arg;
+    size_t        i;
+
+    for (i = 0; i < ELEMENT_COUNT; i++) {
+        if (qmpmcqueue_dequeue_blocking(q) == NULL) {
+            fprintf(stderr, "qmpmcqueue_dequeue_blocking(%p) failed!\n", (void *)q);
+            exit(-2);
+        }
+    }
+    return 0;
+}
+
+static aligned_t lfqueuer(void *arg)
+{
+    qlfqueue_t *q  = (qlfqueue_t *)arg;
+    void       *me = (void *)(uintptr_t)qthread_id();
+    size_t      i;
+
+    for (i = 0; i < ELEMENT_COUNT; i++) {
+        if (qlfqueue_enqueue(q, me) != QTHREAD_SUCCESS) {
+            fprintf(stderr, "qlfqueue_enqueue(q, %p) failed!\n", me);
+            exit(-2);
+        }
+    }
+    return 0;
+}
+
+static aligned_t lfdequeuer(void *arg)
+{
+    qlfqueue_t *q = (qlfqueue_t *)arg;
+    size_t      i;
+
+    for (i = 0; i < ELEMENT_COUNT; i++) {
+        while (qlfqueue_dequeue(q) == NULL) {
+            qthread_yield();
+        }
+    }
+    return 0;
+}
+
+static void loop_queuer(const size_t startat,
+                        const size_t stopat,
+                        void        *arg)
+{                                      /*{{{ */
+    size_t        i;
+    qmpmcqueue_t *q  = (qmpmcqueue_t *)arg;
+    void         *me = (void *)(uintptr_t)qthread_id();
+
+    for (i = startat; i < stopat; i++) {
+        if (qmpmcqueue_enqueue(q, me) != QTHREAD_SUCCESS) {
+            fprintf(stderr, "qmpmcqueue_enqueue(q, %p) failed!\n", me);
+            exit(-2);
+        }
+    }
+}                                      /*}}} */
+
+static void loop_dequeuer(const size_t startat,
+                          const size_t stopat,
+                          void        *arg)
+{                                      /*{{{ */
+    size_t        i;
+    qmpmcqueue_t *q = (qmpmcqueue_t *)arg;
+
+    for (i = startat; i < stopat; i++) {
+        if (qmpmcqueue_dequeue(q) == NULL) {
+            fprintf(stderr, "qmpmcqueue_dequeue(%p) failed!\n", (void *)q);
+            exit(-2);
+        }
+    }
+}                                      /*}}} */
+
+static void loop_batch_queuer(const size_t startat,
+                              const size_t stopat,
+                              void        *arg)
+{                                      /*{{{ */
+    size_t        i;
+    qmpmcqueue_t *q = (qmpmcqueue_t *)arg;
+    void         *batch[BATCH];
+
+    for (i = 0; i < BATCH; i++) {
+        batch[i] = (void *)(uintptr_t)qthread_id();
+    }
+    for (i = startat; i < stopat;) {
+        const size_t want = (stopat - i < BATCH) ? (stopat - i) : BATCH;
+        const size_t got  = qmpmcqueue_enqueue_many(q, batch, want);
+
+        if (got == 0) {
+            fprintf(stderr, "qmpmcqueue_enqueue_many(q, %lu) failed!\n", (unsigned long)want);
+            exit(-2);
+        }
+        i += got;
+    }
+}                                      /*}}} */
+
+static void loop_batch_dequeuer(const size_t startat,
+                                const size_t stopat,
+                                void        *arg)
+{                                      /*{{{ */
+    size_t        i;
+    qmpmcqueue_t *q = (qmpmcqueue_t *)arg;
+    void         *batch[BATCH];
+
+    for (i = startat; i < stopat;) {
+        const size_t want = (stopat - i < BATCH) ? (stopat - i) : BATCH;
+        const size_t got  = qmpmcqueue_dequeue_many(q, batch, want);
+
+        if (got == 0) {
+            fprintf(stderr, "qmpmcqueue_dequeue_many(%p) failed!\n", (void *)q);
+            exit(-2);
+        }
+        i += got;
+    }
+}                                      /*}}} */
+
+int main(int   argc,
+         char *argv[])
+{
+    qmpmcqueue_t *q;
+    qlfqueue_t   *lfq;
+    size_t        i;
+    aligned_t    *rets;
+    const size_t  total = THREAD_COUNT * ELEMENT_COUNT;
+    qtimer_t      timer = qtimer_create();
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+
+    CHECK_VERBOSE();
+
+    if ((q = qmpmcqueue_create(total)) == NULL) {
+        fprintf(stderr, "qmpmcqueue_create() failed!\n");
+        exit(-1);
+    }
+
+    /* prime the pump */
+    qt_loop_balance(0, total, loop_queuer, q);
+    qt_loop_balance(0, total, loop_dequeuer, q);
+    if (!qmpmcqueue_empty(q)) {
+        fprintf(stderr, "qmpmcqueue not empty after priming!\n");
+        exit(-2);
+    }
+
+    qtimer_start(timer);
+    qt_loop_balance(0, total, loop_queuer, q);
+    qtimer_stop(timer);
+    printf("loop balance enqueue: %g secs (%g nsecs/enqueue)\n", qtimer_secs(timer), 1e9 * qtimer_secs(timer) / total);
+    qtimer_start(timer);
+    qt_loop_balance(0, total, loop_dequeuer, q);
+    qtimer_stop(timer);
+    printf("loop balance dequeue: %g secs (%g nsecs/dequeue)\n", qtimer_secs(timer), 1e9 * qtimer_secs(timer) / total);
+    if (!qmpmcqueue_empty(q)) {
+        fprintf(stderr, "qmpmcqueue not empty after loop balance test!\n");
+        exit(-2);
+    }
+
+    qtimer_start(timer);
+    qt_loop_balance(0, total, loop_batch_queuer, q);
+    qtimer_stop(timer);
+    printf("loop balance enqueue_many(%i): %g secs (%g nsecs/enqueue)\n", BATCH, qtimer_secs(timer), 1e9 * qtimer_secs(timer) / total);
+    qtimer_start(timer);
+    qt_loop_balance(0, total, loop_batch_dequeuer, q);
+    qtimer_stop(timer);
+    printf("loop balance dequeue_many(%i): %g secs (%g nsecs/dequeue)\n", BATCH, qtimer_secs(timer), 1e9 * qtimer_secs(timer) / total);
+    if (!qmpmcqueue_empty(q)) {
+        fprintf(stderr, "qmpmcqueue not empty after batch loop balance test!\n");
+        exit(-2);
+    }
+    if (qmpmcqueue_destroy(q) != QTHREAD_SUCCESS) {
+        fprintf(stderr, "qmpmcqueue_destroy() failed!\n");
+        exit(-2);
+    }
+
+    /* a small ring, so that producers and consumers really block */
+    if ((q = qmpmcqueue_create(SMALL_RING)) == NULL) {
+        fprintf(stderr, "qmpmcqueue_create() failed!\n");
+        exit(-1);
+    }
+    rets = calloc(THREAD_COUNT, sizeof(aligned_t));
+    assert(rets != NULL);
+    qtimer_start(timer);
+    for (i = 0; i < THREAD_COUNT; i++) {
+        assert(qthread_fork(dequeuer, q, &(rets[i])) == QTHREAD_SUCCESS);
+    }
+    for (i = 0; i < THREAD_COUNT; i++) {
+        assert(qthread_fork(queuer, q, NULL) == QTHREAD_SUCCESS);
+    }
+    for (i = 0; i < THREAD_COUNT; i++) {
+        assert(qthread_readFF(NULL, &(rets[i])) == QTHREAD_SUCCESS);
+    }
+    qtimer_stop(timer);
+    if (!qmpmcqueue_empty(q)) {
+        fprintf(stderr, "qmpmcqueue not empty after threaded test!\n");
+        exit(-2);
+    }
+    printf("threaded blocking test (%i slots): %f secs\n", SMALL_RING, qtimer_secs(timer));
+
+    /* the same, on the unbounded lock-free queue */
+    if ((lfq = qlfqueue_create()) == NULL) {
+        fprintf(stderr, "qlfqueue_create() failed!\n");
+        exit(-1);
+    }
+    qtimer_start(timer);
+    for (i = 0; i < THREAD_COUNT; i++) {
+        assert(qthread_fork(lfdequeuer, lfq, &(rets[i])) == QTHREAD_SUCCESS);
+    }
+    for (i = 0; i < THREAD_COUNT; i++) {
+        assert(qthread_fork(lfqueuer, lfq, NULL) == QTHREAD_SUCCESS);
+    }
+    for (i = 0; i < THREAD_COUNT; i++) {
+        assert(qthread_readFF(NULL, &(rets[i])) == QTHREAD_SUCCESS);
+    }
+    qtimer_stop(timer);
+    free(rets);
+    printf("threaded lf test: %f secs\n", qtimer_secs(timer));
+
+    if ((qmpmcqueue_destroy(q) != QTHREAD_SUCCESS) ||
+        (qlfqueue_destroy(lfq) != QTHREAD_SUCCESS)) {
+        fprintf(stderr, "queue destroy failed!\n");
+        exit(-2);
+    }
+    qtimer_destroy(timer);
+
+    iprintf("success!\n");
+
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -42,6 +42,58 @@ static void assignoff1(const size_t startat,
     qthread_incr(&count, stopat - startat);
 }
 
+static void mark_owned(const size_t startat,
+                       const size_t stopat,
+                       qarray * q,
+                       void Q_UNUSED *arg)
+{
+    for (size_t i = startat; i < stopat; i++) {
+        assert(qarray_shepof(q, i) == qthread_shep());
+        (*(aligned_t *)qarray_elem_nomigrate(q, i))++;
+    }
+    qthread_incr(&count, stopat - startat);
+}
+
+static void sum_owned(const size_t startat,
+                      const size_t stopat,
+                      qarray * q,
+                      void Q_UNUSED *arg,
+                      void *ret)
+{
+    aligned_t sum = 0;
+
+    for (size_t i = startat; i < stopat; i++) {
+        assert(qarray_shepof(q, i) == qthread_shep());
+        sum += *(aligned_t *)qarray_elem_nomigrate(q, i);
+    }
+    *(aligned_t *)ret = sum;
+}
+
+static void sum_acc(void *restrict       a,
+                    const void *restrict b)
+{
+    *(aligned_t *)a += *(const aligned_t *)b;
+}
+
+static void check_marks(qarray *q,
+                        size_t  lo,
+                        size_t  hi)
+{
+    aligned_t sum = 0;
+
+    count = 0;
+    for (size_t i = 0; i < q->count; i++) {
+        *(aligned_t *)qarray_elem_nomigrate(q, i) = 0;
+    }
+    qarray_iter_loop(q, lo, hi, mark_owned, NULL);
+    assert(count == hi - lo);
+    for (size_t i = 0; i < q->count; i++) {
+        assert(*(aligned_t *)qarray_elem_nomigrate(q, i) == ((i >= lo && i < hi) ? 1 : 0));
+    }
+    qarray_iter_loopaccum(q, 0, q->count, sum_owned, NULL, &sum, sizeof(aligned_t), sum_acc);
+    assert(sum == hi - lo);
+}
+
 int main(int argc,
          char *argv[])
 {
@@ -173,6 +225,41 @@ int main(int argc,
         qarray_destroy(a);
     }
 
+    /* move segments around, and make sure that iteration (including over
+     * ranges that start and stop partway through segments) still visits each
+     * element exactly once, on the shepherd that owns it */
+    {
+        const qthread_shepherd_id_t nsheps = qthread_num_shepherds();
+        qarray                     *b;
+        size_t                      segsize, lo, hi;
+
+        a = qarray_create_configured(ELEMENT_COUNT * 256, sizeof(aligned_t),
+                                     DIST_STRIPES, 1, 0);
+        b = qarray_create_configured(ELEMENT_COUNT * 256, sizeof(aligned_t),
+                                     DIST_RAND, 1, 0);
+        assert(a && b);
+        segsize = a->segment_size;
+        lo      = a->count / 5 + 1;
+        hi      = a->count - a->count / 7;
+        check_marks(a, lo, hi);
+        for (size_t i = 0; i < a->count; i += segsize) {
+            qarray_set_shepof(a, i, (qthread_shepherd_id_t)((i / segsize / 3) % nsheps));
+        }
+        check_marks(a, lo, hi);
+        check_marks(a, 0, a->count);
+        qarray_dist_like(a, b);
+        check_marks(b, lo, hi);
+        qarray_destroy(a);
+        qarray_destroy(b);
+        a = qarray_create_configured(ELEMENT_COUNT * 256, sizeof(aligned_t),
+                                     ALL_LOCAL, 1, 0);
+        assert(a);
+        qarray_set_shepof(a, 0, nsheps - 1);
+        check_marks(a, lo, hi);
+        qarray_destroy(a);
+        iprintf("redistributed arrays: correct result!\n");
+    }
+
     return 0;
 }
 
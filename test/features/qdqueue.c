@@ -7,6 +7,7 @@
 
 static unsigned int ELEMENT_COUNT = 1000;
 static unsigned int THREAD_COUNT = 128;
+static char *seen;
 
 static aligned_t queuer(void *arg)
 {
@@ -37,6 +38,35 @@ static aligned_t dequeuer(void *arg)
     return 0;
 }
 
+/* Everything is on shepherd 0's FIFO; this runs on another shepherd, so its
+ * first dequeue has to steal. */
+static aligned_t first_theft(void *arg)
+{
+    return (aligned_t)(intptr_t)qdqueue_dequeue((qdqueue_t *)arg);
+}
+
+/* Dequeues everything that's left, stealing from shepherd 0 whenever its own
+ * FIFO runs dry; since nobody else is dequeueing, it must see the elements in
+ * the order they were enqueued. */
+static aligned_t rest_of_theft(void *arg)
+{
+    qdqueue_t *q    = (qdqueue_t *)arg;
+    intptr_t   last = 0;
+    void      *elem;
+
+    while ((elem = qdqueue_dequeue(q)) != NULL) {
+        const intptr_t e = (intptr_t)elem;
+
+        if ((e <= last) || (e > (intptr_t)ELEMENT_COUNT) || seen[e - 1]) {
+            fprintf(stderr, "thief dequeued %i after %i!\n", (int)e, (int)last);
+            exit(-3);
+        }
+        seen[e - 1] = 1;
+        last        = e;
+    }
+    return 0;
+}
+
 static aligned_t spawn_dequeuers(void *arg)
 {
     for (size_t i = 0; i < THREAD_COUNT; i++) {
@@ -45,12 +75,20 @@ static aligned_t spawn_dequeuers(void *arg)
     return 0;
 }
 
+#ifdef __INTEL_COMPILER
+int setenv(const char *name,
+           const char *value,
+           int overwrite);
+#endif
+
 int main(int argc,
          char *argv[])
 {
     qdqueue_t *q;
     size_t i;
 
+    /* the batch steal test needs a second shepherd */
+    setenv("QT_NUM_SHEPHERDS", "2", 0);
     assert(qthread_initialize() == QTHREAD_SUCCESS);
     CHECK_VERBOSE();
     NUMARG(ELEMENT_COUNT, "ELEMENT_COUNT");
@@ -95,6 +133,49 @@ int main(int argc,
     }
     iprintf("ordering test succeeded\n");
 
+    if ((qthread_num_shepherds() > 1) && (ELEMENT_COUNT >= 3)) {
+        aligned_t first, next;
+
+        seen = calloc(ELEMENT_COUNT, 1);
+        assert(seen);
+        for (i = 0; i < ELEMENT_COUNT; i++) {
+            if (qdqueue_enqueue_there(q, (void *)(intptr_t)(i + 1), 0) != 0) {
+                fprintf(stderr, "qdqueue_enqueue_there(q,%i,0) failed!\n", (int)i);
+                exit(-1);
+            }
+        }
+        assert(qthread_fork_to(first_theft, q, &first, 1) == QTHREAD_SUCCESS);
+        assert(qthread_readFF(NULL, &first) == QTHREAD_SUCCESS);
+        if (first != 1) {
+            fprintf(stderr, "first stolen element was %i, not 1!\n", (int)first);
+            exit(-1);
+        }
+        seen[0] = 1;
+        /* the thief took a batch, so shepherd 0's oldest element is now
+         * further along than the second one */
+        next = (aligned_t)(intptr_t)qdqueue_dequeue(q);
+        if ((next <= 2) || (next > ELEMENT_COUNT)) {
+            fprintf(stderr, "shepherd 0 dequeued %i after a theft!\n", (int)next);
+            exit(-1);
+        }
+        seen[next - 1] = 1;
+        iprintf("thief took a batch of %i\n", (int)(next - 1));
+        assert(qthread_fork_to(rest_of_theft, q, &first, 1) == QTHREAD_SUCCESS);
+        assert(qthread_readFF(NULL, &first) == QTHREAD_SUCCESS);
+        for (i = 0; i < ELEMENT_COUNT; i++) {
+            if (!seen[i]) {
+                fprintf(stderr, "element %i was never dequeued!\n", (int)(i + 1));
+                exit(-1);
+            }
+        }
+        if (!qdqueue_empty(q)) {
+            fprintf(stderr, "qdqueue not empty after batch steal test!\n");
+            exit(-1);
+        }
+        free(seen);
+        iprintf("batch steal test succeeded\n");
+    }
+
     aligned_t ret;
     assert(qthread_fork_new_team(spawn_dequeuers, q, &ret) == QTHREAD_SUCCESS);
     iprintf("dequeuers forked\n");
@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qmpmcqueue.h>
+#include "argparsing.h"
+
+static size_t    elementcount = 10000;
+static size_t    threadcount  = 16;
+static aligned_t consumed_sum = 0;
+
+static aligned_t queuer(void *arg)
+{
+    qmpmcqueue_t *q = (qmpmcqueue_t *)arg;
+
+    for (size_t i = 1; i <= elementcount; i++) {
+        assert(qmpmcqueue_enqueue_blocking(q, (void *)(intptr_t)i) == QTHREAD_SUCCESS);
+    }
+    return 0;
+}
+
+static aligned_t batch_queuer(void *arg)
+{
+    qmpmcqueue_t *q = (qmpmcqueue_t *)arg;
+    void         *batch[7];
+    size_t        i = 1;
+
+    while (i <= elementcount) {
+        size_t n = 0, sent = 0;
+
+        while (n < 7 && i + n <= elementcount) {
+            batch[n] = (void *)(intptr_t)(i + n);
+            n++;
+        }
+        while (sent < n) {
+            size_t got = qmpmcqueue_enqueue_many(q, batch + sent, n - sent);
+
+            if (got == 0) {
+                qthread_yield();
+            }
+            sent += got;
+        }
+        i += n;
+    }
+    return 0;
+}
+
+static aligned_t dequeuer(void *arg)
+{
+    qmpmcqueue_t *q   = (qmpmcqueue_t *)arg;
+    aligned_t     sum = 0;
+
+    for (size_t i = 0; i < elementcount; i++) {
+        sum += (aligned_t)(intptr_t)qmpmcqueue_dequeue_blocking(q);
+    }
+    qthread_incr(&consumed_sum, sum);
+    return 0;
+}
+
+static aligned_t batch_dequeuer(void *arg)
+{
+    qmpmcqueue_t *q   = (qmpmcqueue_t *)arg;
+    aligned_t     sum = 0;
+    void         *batch[5];
+    size_t        left = elementcount;
+
+    while (left > 0) {
+        size_t got = qmpmcqueue_dequeue_many(q, batch, (left < 5) ? left : 5);
+
+        if (got == 0) {
+            qthread_yield();
+        }
+        for (size_t j = 0; j < got; j++) {
+            sum += (aligned_t)(intptr_t)batch[j];
+        }
+        left -= got;
+    }
+    qthread_incr(&consumed_sum, sum);
+    return 0;
+}
+
+static void threaded(qmpmcqueue_t *q,
+                     qthread_f     producer,
+                     qthread_f     consumer)
+{
+    aligned_t *rets = calloc(threadcount, sizeof(aligned_t));
+    aligned_t  expect;
+
+    assert(rets);
+    consumed_sum = 0;
+    for (size_t i = 0; i < threadcount; i++) {
+        assert(qthread_fork(consumer, q, &rets[i]) == QTHREAD_SUCCESS);
+    }
+    for (size_t i = 0; i < threadcount; i++) {
+        assert(qthread_fork(producer, q, NULL) == QTHREAD_SUCCESS);
+    }
+    for (size_t i = 0; i < threadcount; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    expect = threadcount * (elementcount * (elementcount + 1) / 2);
+    if (consumed_sum != expect) {
+        fprintf(stderr, "consumed %lu, expected %lu\n",
+                (unsigned long)consumed_sum, (unsigned long)expect);
+        exit(EXIT_FAILURE);
+    }
+    if (!qmpmcqueue_empty(q)) {
+        fprintf(stderr, "qmpmcqueue not empty after threaded test!\n");
+        exit(EXIT_FAILURE);
+    }
+    free(rets);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    qmpmcqueue_t *q;
+    void         *batch[100];
+    size_t        i;
+
+    assert(qthread_initialize() == 0);
+    NUMARG(threadcount, "THREAD_COUNT");
+    NUMARG(elementcount, "ELEMENT_COUNT");
+    CHECK_VERBOSE();
+    iprintf("%i threads\n", qthread_num_workers());
+
+    /* 100 rounds up to 128 */
+    if ((q = qmpmcqueue_create(100)) == NULL) {
+        fprintf(stderr, "qmpmcqueue_create() failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    assert(qmpmcqueue_empty(q));
+    assert(qmpmcqueue_dequeue(q) == NULL);
+
+    /* ordering, across several laps of the ring */
+    for (size_t lap = 0; lap < 5; lap++) {
+        for (i = 0; i < 100; i++) {
+            if (qmpmcqueue_enqueue(q, (void *)(intptr_t)(i + 1)) != QTHREAD_SUCCESS) {
+                fprintf(stderr, "qmpmcqueue_enqueue(q,%i) failed!\n", (int)i);
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (i = 0; i < 100; i++) {
+            if (qmpmcqueue_dequeue(q) != (void *)(intptr_t)(i + 1)) {
+                fprintf(stderr, "qmpmcqueue_dequeue() failed, didn't equal %i!\n",
+                        (int)i + 1);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    assert(qmpmcqueue_empty(q));
+    iprintf("ordering test succeeded\n");
+
+    /* capacity */
+    for (i = 0; qmpmcqueue_enqueue(q, (void *)(intptr_t)(i + 1)) == QTHREAD_SUCCESS; i++) ;
+    assert(i == 128);
+    assert(qmpmcqueue_dequeue(q) == (void *)(intptr_t)1);
+    assert(qmpmcqueue_enqueue(q, (void *)(intptr_t)129) == QTHREAD_SUCCESS);
+    assert(qmpmcqueue_enqueue(q, (void *)(intptr_t)130) == QTHREAD_OPFAIL);
+    for (i = 2; i <= 129; i++) {
+        assert(qmpmcqueue_dequeue(q) == (void *)(intptr_t)i);
+    }
+    assert(qmpmcqueue_empty(q));
+    iprintf("capacity test succeeded\n");
+
+    /* batches: partial enqueues when nearly full, partial dequeues */
+    for (i = 0; i < 100; i++) {
+        batch[i] = (void *)(intptr_t)(i + 1);
+    }
+    assert(qmpmcqueue_enqueue_many(q, batch, 100) == 100);
+    assert(qmpmcqueue_enqueue_many(q, batch, 100) == 28);
+    assert(qmpmcqueue_enqueue_many(q, batch, 1) == 0);
+    assert(qmpmcqueue_dequeue_many(q, batch, 60) == 60);
+    for (i = 0; i < 60; i++) {
+        assert(batch[i] == (void *)(intptr_t)(i + 1));
+    }
+    assert(qmpmcqueue_dequeue_many(q, batch, 100) == 68);
+    for (i = 0; i < 40; i++) {
+        assert(batch[i] == (void *)(intptr_t)(i + 61));
+    }
+    for (i = 40; i < 68; i++) {
+        assert(batch[i] == (void *)(intptr_t)(i - 39));
+    }
+    assert(qmpmcqueue_dequeue_many(q, batch, 100) == 0);
+    assert(qmpmcqueue_empty(q));
+    iprintf("batch test succeeded\n");
+    assert(qmpmcqueue_destroy(q) == QTHREAD_SUCCESS);
+
+    /* a small ring, so that the blocking calls really block */
+    q = qmpmcqueue_create(8);
+    assert(q);
+    threaded(q, queuer, dequeuer);
+    iprintf("blocking threaded test succeeded\n");
+    threaded(q, batch_queuer, dequeuer);
+    threaded(q, queuer, batch_dequeuer);
+    iprintf("batch threaded test succeeded\n");
+
+    if (qmpmcqueue_destroy(q) != QTHREAD_SUCCESS) {
+        fprintf(stderr, "qmpmcqueue_destroy() failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    iprintf("success!\n");
+
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,165 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/dictionary.h>
+#include "argparsing.h"
+
+/* Grows a dictionary well past its initial size, one put at a time and in
+ * batches, and then has tasks on every shepherd put, get, and delete their own
+ * keys while reading everyone's. */
+
+#define BATCH 32
+
+static size_t         nkeys   = 4096;
+static size_t         nrounds = 64;
+static size_t         ntasks;
+static qt_dictionary *dict;
+
+static int key_equals(void *a,
+                      void *b)
+{
+    return a == b;
+}
+
+static int key_hash(void *k)
+{
+    return (int)(uintptr_t)k;
+}
+
+/* keys start at 1; 0 would be NULL */
+static void *key_of(size_t i)
+{
+    return (void *)(uintptr_t)(i + 1);
+}
+
+static void *value_of(size_t i)
+{
+    return (void *)(uintptr_t)(2 * i + 1);
+}
+
+static aligned_t churn(void *arg)
+{
+    const size_t id    = (uintptr_t)arg;
+    const size_t first = 2 * nkeys + id * BATCH;
+
+    for (size_t r = 0; r < nrounds; r++) {
+        for (size_t i = first; i < first + BATCH; i++) {
+            assert(qt_dictionary_put(dict, key_of(i), value_of(i)) != NULL);
+        }
+        for (size_t i = first; i < first + BATCH; i++) {
+            const size_t other = (i * 7 + r) % (2 * nkeys);
+
+            assert(qt_dictionary_get(dict, key_of(i)) == value_of(i));
+            assert(qt_dictionary_get(dict, key_of(other)) == value_of(other));
+        }
+        for (size_t i = first; i < first + BATCH; i++) {
+            assert(qt_dictionary_delete(dict, key_of(i)) == value_of(i));
+            assert(qt_dictionary_get(dict, key_of(i)) == NULL);
+        }
+    }
+    return 0;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    void      *keys[BATCH];
+    void      *values[BATCH];
+    void      *results[BATCH];
+    aligned_t *rets;
+    size_t     count;
+
+    assert(qthread_initialize() == 0);
+    CHECK_VERBOSE();
+    NUMARG(nkeys, "TEST_NKEYS");
+    NUMARG(nrounds, "TEST_NROUNDS");
+    ntasks = qthread_num_shepherds() * 4;
+
+    dict = qt_dictionary_create(key_equals, key_hash, NULL);
+    assert(dict);
+
+    /* one at a time, checking older keys while the table is being grown */
+    for (size_t i = 0; i < nkeys; i++) {
+        assert(qt_dictionary_put(dict, key_of(i), value_of(i)) != NULL);
+        assert(qt_dictionary_get(dict, key_of(i)) == value_of(i));
+        assert(qt_dictionary_get(dict, key_of(i / 2)) == value_of(i / 2));
+    }
+    for (size_t i = 0; i < nkeys; i++) {
+        assert(qt_dictionary_get(dict, key_of(i)) == value_of(i));
+    }
+    iprintf("put and got %lu keys\n", (unsigned long)nkeys);
+
+    /* in batches */
+    for (size_t i = nkeys; i < 2 * nkeys; i += count) {
+        count = (2 * nkeys - i < BATCH) ? (2 * nkeys - i) : BATCH;
+        for (size_t j = 0; j < count; j++) {
+            keys[j]   = key_of(i + j);
+            values[j] = value_of(i + j);
+        }
+        assert(qt_dictionary_put_many(dict, keys, values, count, results) == count);
+        for (size_t j = 0; j < count; j++) {
+            assert(results[j] == values[j]);
+        }
+    }
+    for (size_t i = 0; i < 2 * nkeys; i += count) {
+        count = (2 * nkeys - i < BATCH) ? (2 * nkeys - i) : BATCH;
+        for (size_t j = 0; j < count; j++) {
+            keys[j] = key_of(i + j);
+        }
+        assert(qt_dictionary_get_many(dict, keys, values, count) == count);
+        for (size_t j = 0; j < count; j++) {
+            assert(values[j] == value_of(i + j));
+        }
+    }
+    for (size_t j = 0; j < BATCH; j++) {
+        keys[j] = key_of(2 * nkeys + j);
+    }
+    assert(qt_dictionary_get_many(dict, keys, values, BATCH) == 0);
+    for (size_t j = 0; j < BATCH; j++) {
+        assert(values[j] == NULL);
+    }
+    iprintf("put and got %lu keys in batches\n", (unsigned long)nkeys);
+
+    /* from every shepherd at once */
+    rets = malloc(ntasks * sizeof(aligned_t));
+    assert(rets);
+    for (size_t i = 0; i < ntasks; i++) {
+        qthread_fork_to(churn, (void *)(uintptr_t)i, &rets[i],
+                        (qthread_shepherd_id_t)(i % qthread_num_shepherds()));
+    }
+    for (size_t i = 0; i < ntasks; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    free(rets);
+    iprintf("%lu tasks put, got, and deleted %lu keys %lu times\n",
+            (unsigned long)ntasks, (unsigned long)BATCH, (unsigned long)nrounds);
+
+    count = 0;
+    {
+        qt_dictionary_iterator *it = qt_dictionary_iterator_create(dict);
+
+        while (qt_dictionary_iterator_next(it) != NULL) {
+            list_entry *le = qt_dictionary_iterator_get(it);
+
+            assert(le != NULL);
+            assert(le->value == value_of((uintptr_t)le->key - 1));
+            count++;
+        }
+        qt_dictionary_iterator_destroy(it);
+    }
+    assert(count == 2 * nkeys);
+
+    for (size_t i = 0; i < 2 * nkeys; i++) {
+        assert(qt_dictionary_delete(dict, key_of(i)) == value_of(i));
+    }
+    for (size_t i = 0; i < 2 * nkeys; i++) {
+        assert(qt_dictionary_get(dict, key_of(i)) == NULL);
+    }
+    qt_dictionary_destroy(dict);
+
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,77 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"                   /* for _GNU_SOURCE */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qloop.h>
+#include <qthread/qtimer.h>
+#include "argparsing.h"
+
+static aligned_t  threads  = 0;
+static aligned_t  numincrs = 1024;
+static aligned_t *seen     = NULL;
+
+static void sum(const size_t startat,
+                const size_t stopat,
+                void        *arg_)
+{
+    for (size_t i = startat; i < stopat; ++i) {
+        qthread_incr(&seen[i], 1);
+    }
+    qthread_incr(&threads, stopat - startat);
+}
+
+/* the later iterations take much longer, so the range must get split */
+static void lopsided(const size_t startat,
+                     const size_t stopat,
+                     void        *arg_,
+                     void        *ret_)
+{
+    aligned_t ret = 0;
+
+    for (size_t i = startat; i < stopat; ++i) {
+        size_t spins = (i > numincrs / 2) ? 1000 : 0;
+        while (spins--) {
+            (void)qtimer_fastrand();
+        }
+        ret += i;
+    }
+    *(aligned_t *)ret_ = ret;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t total = 1;
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(numincrs, "NUM_INCRS");
+    iprintf("%i shepherds\n", qthread_num_shepherds());
+    iprintf("%i threads\n", qthread_num_workers());
+
+    seen = calloc(numincrs, sizeof(aligned_t));
+    assert(seen);
+    qt_loop_split(0, numincrs, sum, NULL);
+    if (threads != numincrs) {
+        iprintf("threads == %lu, not %lu\n", (unsigned long)threads, (unsigned long)numincrs);
+    }
+    assert(threads == numincrs);
+    for (size_t i = 0; i < numincrs; ++i) {
+        assert(seen[i] == 1);
+    }
+    free(seen);
+
+    qt_loopaccum_split(0, numincrs, sizeof(aligned_t), &total, lopsided, NULL, qt_uint_add_acc);
+    iprintf("total == %lu\n", (unsigned long)total);
+    assert(total == numincrs * (numincrs - 1) / 2);
+
+    /* an empty range leaves out alone */
+    qt_loopaccum_split(5, 5, sizeof(aligned_t), &total, lopsided, NULL, qt_uint_add_acc);
+    assert(total == numincrs * (numincrs - 1) / 2);
+
+    return 0;
+}
+
+/* vim:set expandtab */
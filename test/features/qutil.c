@@ -39,8 +39,17 @@ double *d_array;
 double  d_out, d_sum_authoritative = 0.0, d_mult_authoritative =
     1.0, d_max_authoritative = DBL_MIN, d_min_authoritative = DBL_MAX;
 size_t         d_len         = 1000000;
+float         *f_array;
+size_t         f_len         = 1000000;
 struct timeval start, stop;
 
+static aligned_t fill_later(void *arg)
+{
+    qthread_yield();
+    qthread_fill((aligned_t *)arg);
+    return 0;
+}
+
 static aligned_t qmain(void *junk)
 {
     size_t i;
@@ -71,6 +80,25 @@ static aligned_t qmain(void *junk)
     ui_out = qutil_uint_min(ui_array, ui_len, 0);
     assert(ui_out == ui_min_authoritative);
     iprintf(" - qutil_uint_min is correct\n");
+    /* with checkfeb, everything starts out full... */
+    ui_out = qutil_uint_sum(ui_array, ui_len, 1);
+    assert(ui_out == ui_sum_authoritative);
+    /* ...but entries that are empty have to be waited for */
+    {
+        aligned_t rets[3];
+        size_t    which[3] = { 0, ui_len / 2, ui_len - 1 };
+
+        for (i = 0; i < 3; i++) {
+            qthread_empty(ui_array + which[i]);
+            qthread_fork(fill_later, ui_array + which[i], rets + i);
+        }
+        ui_out = qutil_uint_max(ui_array, ui_len, 1);
+        assert(ui_out == ui_max_authoritative);
+        for (i = 0; i < 3; i++) {
+            qthread_readFF(NULL, rets + i);
+        }
+    }
+    iprintf(" - checkfeb is correct\n");
     gettimeofday(&start, NULL);
     qutil_aligned_qsort(ui_array, ui_len);
     gettimeofday(&stop, NULL);
@@ -208,6 +236,38 @@ static aligned_t qmain(void *junk)
                                                        (start.tv_usec *
                                                         1.0e-6)));
     free(d_array);
+
+    f_array = (float *)calloc(f_len, sizeof(float));
+    assert(f_array != NULL);
+    {
+        /* rounding error in a float product grows quickly; keep it short */
+        size_t f_mult_len = (f_len < 1000) ? f_len : 1000;
+        double f_sum      = 0.0, f_mult = 1.0;
+        float  f_max      = -FLT_MAX, f_min = FLT_MAX, f_out;
+
+        for (i = 0; i < f_len; i++) {
+            /* close to one, so that products stay in range */
+            f_array[i] = 1.0f + (random() / (float)RAND_MAX - 0.5f) * 1.0e-2f;
+            f_sum     += f_array[i];
+            if (i < f_mult_len) { f_mult *= f_array[i]; }
+            if (f_max < f_array[i]) { f_max = f_array[i]; }
+            if (f_min > f_array[i]) { f_min = f_array[i]; }
+        }
+        iprintf("f_array generated...\n");
+        f_out = qutil_float_sum(f_array, f_len, 0);
+        assert(fabs(f_out - f_sum) <= f_sum * 1.0e-4);
+        iprintf(" - qutil_float_sum is correct\n");
+        f_out = qutil_float_mult(f_array, f_mult_len, 0);
+        assert(fabs(f_out - f_mult) <= f_mult * 1.0e-4);
+        iprintf(" - qutil_float_mult is correct\n");
+        f_out = qutil_float_max(f_array, f_len, 0);
+        assert(f_out == f_max);
+        iprintf(" - qutil_float_max is correct\n");
+        f_out = qutil_float_min(f_array, f_len, 0);
+        assert(f_out == f_min);
+        iprintf(" - qutil_float_min is correct\n");
+    }
+    free(f_array);
     return 0;
 }
 
@@ -222,6 +282,7 @@ int main(int   argc,
     NUMARG(d_len, "TEST_LEN");
     NUMARG(i_len, "TEST_LEN");
     NUMARG(ui_len, "TEST_LEN");
+    NUMARG(f_len, "TEST_LEN");
 
     assert(qthread_fork(qmain, NULL, &ret) == 0);
     qthread_readFF(NULL, &ret);
@@ -0,0 +1,182 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"                   /* for _GNU_SOURCE */
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <qthread/qthread.h>
+#include <qthread/qutil.h>
+#include <qthread/qarray.h>
+#include "argparsing.h"
+
+static void max_op(void *restrict       a,
+                   const void *restrict b)
+{
+    if (*(const aligned_t *)b > *(aligned_t *)a) {
+        *(aligned_t *)a = *(const aligned_t *)b;
+    }
+}
+
+static void sum_op(void *restrict       a,
+                   const void *restrict b)
+{
+    *(aligned_t *)a += *(const aligned_t *)b;
+}
+
+static int is_odd(const void *r)
+{
+    return *(const aligned_t *)r & 1;
+}
+
+static size_t mod_bucket(const void *r)
+{
+    return *(const aligned_t *)r % 37;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    size_t      len = 1000000;
+    aligned_t  *in, *out, total, zero = 0;
+    saligned_t *si, *so, stotal;
+    double     *di, *dout, dtotal;
+    size_t      kept, counts[37], expect_counts[37];
+    qarray     *qa, *qb;
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(len, "TEST_LEN");
+
+    in  = malloc(len * sizeof(aligned_t));
+    out = malloc(len * sizeof(aligned_t));
+    assert(in && out);
+    for (size_t i = 0; i < len; i++) {
+        in[i] = random() % 1000;
+    }
+
+    /* typed sums, inclusive, exclusive and in place */
+    total = qutil_uint_scan(in, out, len, 0);
+    for (size_t i = 0, acc = 0; i < len; i++) {
+        acc += in[i];
+        assert(out[i] == acc);
+    }
+    assert(total == out[len - 1]);
+    total = qutil_uint_scan(in, out, len, 1);
+    assert(out[0] == 0);
+    for (size_t i = 1; i < len; i++) {
+        assert(out[i] == out[i - 1] + in[i - 1]);
+    }
+    assert(total == out[len - 1] + in[len - 1]);
+    memcpy(out, in, len * sizeof(aligned_t));
+    assert(qutil_uint_scan(out, out, len, 1) == total);
+    for (size_t i = 1; i < len; i++) {
+        assert(out[i] == out[i - 1] + in[i - 1]);
+    }
+    iprintf("uint scans passed\n");
+
+    si = malloc(len * sizeof(saligned_t));
+    so = malloc(len * sizeof(saligned_t));
+    di = malloc(len * sizeof(double));
+    dout = malloc(len * sizeof(double));
+    assert(si && so && di && dout);
+    for (size_t i = 0; i < len; i++) {
+        si[i] = (saligned_t)(random() % 1000) - 500;
+        di[i] = (double)(random() % 1000);
+    }
+    stotal = qutil_int_scan(si, so, len, 0);
+    for (size_t i = 1; i < len; i++) {
+        assert(so[i] == so[i - 1] + si[i]);
+    }
+    assert(stotal == so[len - 1]);
+    dtotal = qutil_double_scan(di, dout, len, 0);
+    for (size_t i = 1; i < len; i++) {
+        assert(dout[i] == dout[i - 1] + di[i]);    /* small integers are exact */
+    }
+    assert(dtotal == dout[len - 1]);
+    free(si);
+    free(so);
+    free(di);
+    free(dout);
+    iprintf("int and double scans passed\n");
+
+    /* generic: running max, with and without an identity */
+    qutil_scan(in, out, len, sizeof(aligned_t), max_op, NULL, 0);
+    for (size_t i = 0, m = in[0]; i < len; i++) {
+        if (in[i] > m) { m = in[i]; }
+        assert(out[i] == m);
+    }
+    qutil_scan(in, out, len, sizeof(aligned_t), sum_op, &zero, 1);
+    assert(out[0] == 0);
+    for (size_t i = 1; i < len; i++) {
+        assert(out[i] == out[i - 1] + in[i - 1]);
+    }
+    iprintf("generic scans passed\n");
+
+    /* compaction, partitioning, histogram */
+    kept = qutil_compact(in, out, len, sizeof(aligned_t), is_odd);
+    {
+        size_t j = 0;
+
+        for (size_t i = 0; i < len; i++) {
+            if (in[i] & 1) { assert(out[j++] == in[i]); }
+        }
+        assert(j == kept);
+    }
+    memcpy(out, in, len * sizeof(aligned_t));
+    assert(qutil_partition(out, len, sizeof(aligned_t), is_odd) == kept);
+    {
+        size_t odd = 0, even = kept;
+
+        for (size_t i = 0; i < len; i++) {
+            if (in[i] & 1) {
+                assert(out[odd++] == in[i]);
+            } else {
+                assert(out[even++] == in[i]);
+            }
+        }
+    }
+    memset(expect_counts, 0, sizeof(expect_counts));
+    for (size_t i = 0; i < len; i++) {
+        expect_counts[in[i] % 37]++;
+    }
+    qutil_histogram(in, len, sizeof(aligned_t), mod_bucket, 37, counts);
+    assert(memcmp(counts, expect_counts, sizeof(counts)) == 0);
+    iprintf("compact, partition and histogram passed\n");
+
+    /* and over qarrays */
+    qa = qarray_create_tight(len, sizeof(aligned_t));
+    qb = qarray_create_tight(len, sizeof(aligned_t));
+    assert(qa && qb);
+    for (size_t i = 0; i < len; i++) {
+        *(aligned_t *)qarray_elem(qa, i) = in[i];
+    }
+    qutil_qarray_scan(qa, qb, sum_op, &zero, 0);
+    for (size_t i = 0, acc = 0; i < len; i++) {
+        acc += in[i];
+        assert(*(aligned_t *)qarray_elem(qb, i) == acc);
+    }
+    qutil_qarray_scan(qa, qb, max_op, NULL, 0);
+    for (size_t i = 0, m = in[0]; i < len; i++) {
+        if (in[i] > m) { m = in[i]; }
+        assert(*(aligned_t *)qarray_elem(qb, i) == m);
+    }
+    assert(qutil_qarray_compact(qa, qb, is_odd) == kept);
+    assert(qutil_qarray_partition(qa, qb, is_odd) == kept);
+    for (size_t i = 0; i < len; i++) {
+        assert(*(aligned_t *)qarray_elem(qb, i) == out[i]);
+    }
+    qutil_qarray_histogram(qa, mod_bucket, 37, counts);
+    assert(memcmp(counts, expect_counts, sizeof(counts)) == 0);
+    qarray_destroy(qa);
+    qarray_destroy(qb);
+    iprintf("qarray versions passed\n");
+
+    free(in);
+    free(out);
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,181 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"                   /* for _GNU_SOURCE */
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <qthread/qthread.h>
+#include <qthread/qutil.h>
+#include "argparsing.h"
+
+/* a record with a key, a tag recording its original position, and some
+ * payload that has to travel with it */
+typedef struct {
+    int64_t  key;
+    double   dkey;
+    uint32_t tag;
+    char     payload[20];
+} record_t;
+
+static uint64_t int_key(const void *r)
+{
+    return qutil_radix_key_int(((const record_t *)r)->key);
+}
+
+static uint64_t double_key(const void *r)
+{
+    return qutil_radix_key_double(((const record_t *)r)->dkey);
+}
+
+static int int_cmp(const void *a,
+                   const void *b)
+{
+    const int64_t ka = ((const record_t *)a)->key;
+    const int64_t kb = ((const record_t *)b)->key;
+
+    return (ka > kb) - (ka < kb);
+}
+
+static uint64_t aligned_key(const void *r)
+{
+    return *(const aligned_t *)r;
+}
+
+static void fill(record_t *r,
+                 size_t    len,
+                 long      range)
+{
+    for (size_t i = 0; i < len; i++) {
+        r[i].key  = (int64_t)(random() % range) - range / 2;
+        r[i].dkey = ((double)random() / RAND_MAX - 0.5) * 1e6;
+        r[i].tag  = (uint32_t)i;
+        snprintf(r[i].payload, sizeof(r[i].payload), "%ld", (long)r[i].key);
+    }
+}
+
+static void check_payloads(const record_t *r,
+                           size_t          len)
+{
+    for (size_t i = 0; i < len; i++) {
+        char buf[sizeof(r[i].payload)];
+
+        snprintf(buf, sizeof(buf), "%ld", (long)r[i].key);
+        assert(strcmp(buf, r[i].payload) == 0);
+    }
+}
+
+static size_t in_task_len = 10000;
+
+/* the sorts have to fit in a qthread's stack, not just main()'s */
+static aligned_t sort_in_task(void *arg)
+{
+    record_t *r = (record_t *)arg;
+
+    fill(r, in_task_len, 1000);
+    qutil_radix_sort(r, in_task_len, sizeof(record_t), int_key);
+    for (size_t i = 1; i < in_task_len; i++) {
+        assert(r[i - 1].key <= r[i].key);
+    }
+    fill(r, in_task_len, 1000);
+    qutil_sample_sort(r, in_task_len, sizeof(record_t), int_cmp);
+    for (size_t i = 1; i < in_task_len; i++) {
+        assert(r[i - 1].key <= r[i].key);
+    }
+    check_payloads(r, in_task_len);
+    return 0;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    size_t     len = 1000000;
+    record_t  *r;
+    aligned_t *a;
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(len, "TEST_LEN");
+
+    r = malloc(len * sizeof(record_t));
+    a = malloc(len * sizeof(aligned_t));
+    assert(r && a);
+
+    /* radix, signed keys with lots of duplicates: must be sorted and stable */
+    fill(r, len, 1000);
+    qutil_radix_sort(r, len, sizeof(record_t), int_key);
+    for (size_t i = 1; i < len; i++) {
+        assert(r[i - 1].key <= r[i].key);
+        if (r[i - 1].key == r[i].key) {
+            assert(r[i - 1].tag < r[i].tag);
+        }
+    }
+    check_payloads(r, len);
+    iprintf("radix sort of %lu records by int key passed\n", (unsigned long)len);
+
+    /* radix, floating-point keys of both signs */
+    fill(r, len, 1000);
+    qutil_radix_sort(r, len, sizeof(record_t), double_key);
+    for (size_t i = 1; i < len; i++) {
+        assert(r[i - 1].dkey <= r[i].dkey);
+    }
+    check_payloads(r, len);
+    iprintf("radix sort of %lu records by double key passed\n", (unsigned long)len);
+
+    /* radix, records no bigger than the key */
+    for (size_t i = 0; i < len; i++) {
+        a[i] = random();
+    }
+    qutil_sort(a, len, sizeof(aligned_t), aligned_key, NULL);
+    for (size_t i = 1; i < len; i++) {
+        assert(a[i - 1] <= a[i]);
+    }
+    iprintf("radix sort of %lu aligned_ts passed\n", (unsigned long)len);
+
+    /* sample sort, wide and narrow key ranges */
+    fill(r, len, 1L << 30);
+    qutil_sample_sort(r, len, sizeof(record_t), int_cmp);
+    for (size_t i = 1; i < len; i++) {
+        assert(r[i - 1].key <= r[i].key);
+    }
+    check_payloads(r, len);
+    fill(r, len, 3);
+    qutil_sort(r, len, sizeof(record_t), NULL, int_cmp);
+    for (size_t i = 1; i < len; i++) {
+        assert(r[i - 1].key <= r[i].key);
+    }
+    check_payloads(r, len);
+    iprintf("sample sort of %lu records passed\n", (unsigned long)len);
+
+    /* arrays too small to split */
+    fill(r, 7, 1000);
+    qutil_radix_sort(r, 7, sizeof(record_t), int_key);
+    for (size_t i = 1; i < 7; i++) {
+        assert(r[i - 1].key <= r[i].key);
+    }
+    fill(r, 7, 1000);
+    qutil_sample_sort(r, 7, sizeof(record_t), int_cmp);
+    for (size_t i = 1; i < 7; i++) {
+        assert(r[i - 1].key <= r[i].key);
+    }
+    qutil_radix_sort(r, 0, sizeof(record_t), int_key);
+    qutil_sample_sort(r, 0, sizeof(record_t), int_cmp);
+
+    /* from inside a task */
+    {
+        aligned_t ret;
+
+        if (in_task_len > len) { in_task_len = len; }
+        qthread_fork(sort_in_task, r, &ret);
+        qthread_readFF(NULL, &ret);
+        iprintf("sorts of %lu records from a qthread passed\n", (unsigned long)in_task_len);
+    }
+
+    free(r);
+    free(a);
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,392 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <qthread/qthread.h>
+#include <qthread/qt_syscalls.h>
+#include <qthread/io.h>
+#include "argparsing.h"
+
+/* without io_uring, every blocked reader ties up a proxy thread, so there must
+ * be fewer pairs than QT_MAX_IO_WORKERS */
+static size_t pairs    = 4;
+static size_t messages = 256;
+static size_t chunks   = 1024;
+static int    scratch  = -1;
+/* sockets are waited on with io_uring or epoll, where there is one, so
+ * blocked socket tasks don't need proxies */
+#if defined(QTHREAD_USE_IO_URING) || defined(QTHREAD_USE_EPOLL)
+static size_t sockets = 64;
+#else
+static size_t sockets = 4;
+#endif
+static int listener = -1;
+
+#define BLOCK 512
+#define CHUNK 64
+
+typedef struct {
+    int       fds[2];
+    aligned_t done;
+} pipe_pair_t;
+
+static aligned_t writer(void *arg)
+{
+    pipe_pair_t *p = (pipe_pair_t *)arg;
+
+    for (size_t i = 0; i < messages; i++) {
+        size_t msg = i;
+
+        if (qt_write(p->fds[1], &msg, sizeof(msg)) != sizeof(msg)) {
+            fprintf(stderr, "qt_write() failed (%s)\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    return 0;
+}
+
+/* reads everything the matching writer sends, polling for every other
+ * message first */
+static aligned_t reader(void *arg)
+{
+    pipe_pair_t *p = (pipe_pair_t *)arg;
+
+    for (size_t i = 0; i < messages; i++) {
+        size_t  msg = ~(size_t)0;
+        ssize_t got = 0;
+
+        if (i & 1) {
+            struct pollfd pfd;
+
+            pfd.fd      = p->fds[0];
+            pfd.events  = POLLIN;
+            pfd.revents = 0;
+            if ((qt_poll(&pfd, 1, -1) != 1) || !(pfd.revents & POLLIN)) {
+                fprintf(stderr, "qt_poll() failed (%s)\n", strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+        }
+        while (got < (ssize_t)sizeof(msg)) {
+            ssize_t r = qt_read(p->fds[0], (char *)&msg + got, sizeof(msg) - got);
+
+            if (r <= 0) {
+                fprintf(stderr, "qt_read() failed (%s)\n", strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+            got += r;
+        }
+        if (msg != i) {
+            fprintf(stderr, "pipe %i: got message %lu, expected %lu\n",
+                    p->fds[0], (unsigned long)msg, (unsigned long)i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return 0;
+}
+
+/* every reader is ready before any writer starts */
+static void run_pairs(size_t n,
+                      int    use_sockets)
+{
+    pipe_pair_t *p = calloc(n, sizeof(pipe_pair_t));
+
+    assert(p);
+    for (size_t i = 0; i < n; i++) {
+        if ((use_sockets ? socketpair(AF_UNIX, SOCK_STREAM, 0, p[i].fds) : pipe(p[i].fds)) != 0) {
+            perror(use_sockets ? "socketpair" : "pipe");
+            exit(EXIT_FAILURE);
+        }
+        assert(qthread_fork(reader, &p[i], &p[i].done) == QTHREAD_SUCCESS);
+    }
+    for (size_t i = 0; i < n; i++) {
+        assert(qthread_fork(writer, &p[i], NULL) == QTHREAD_SUCCESS);
+    }
+    for (size_t i = 0; i < n; i++) {
+        qthread_readFF(NULL, &p[i].done);
+        close(p[i].fds[0]);
+        close(p[i].fds[1]);
+    }
+    free(p);
+}
+
+/* takes a connection, and the number its client sends */
+static aligned_t acceptor(void *arg)
+{
+    size_t  msg = 0;
+    ssize_t got = 0;
+    int     conn;
+
+    if ((conn = qt_accept(listener, NULL, NULL)) < 0) {
+        fprintf(stderr, "qt_accept() failed (%s)\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    while (got < (ssize_t)sizeof(msg)) {
+        ssize_t r = qt_read(conn, (char *)&msg + got, sizeof(msg) - got);
+
+        if (r <= 0) {
+            fprintf(stderr, "qt_read() failed (%s)\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        got += r;
+    }
+    close(conn);
+    return msg + 1;
+}
+
+/* sockets the program made non-blocking must fail rather than wait */
+static aligned_t nonblocking(void *arg)
+{
+    const struct sockaddr_un *addr = (const struct sockaddr_un *)arg;
+    int                       fds[2], l;
+    const size_t              len  = 4096;
+    char                     *buf  = calloc(1, len); /* not on a task's stack */
+
+    assert(buf);
+    if ((socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) ||
+        (fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK) != 0) ||
+        (fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK) != 0)) {
+        perror("socketpair");
+        exit(EXIT_FAILURE);
+    }
+    errno = 0;
+    if ((qt_read(fds[0], buf, len) != -1) || ((errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+        fprintf(stderr, "qt_read() of an empty non-blocking socket didn't fail with EAGAIN (%s)\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    while (send(fds[1], buf, len, MSG_DONTWAIT) > 0) ;
+    errno = 0;
+    if ((qt_write(fds[1], buf, len) != -1) || ((errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+        fprintf(stderr, "qt_write() to a full non-blocking socket didn't fail with EAGAIN (%s)\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    close(fds[0]);
+    close(fds[1]);
+    free(buf);
+
+    unlink(addr->sun_path);
+    l = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ((l < 0) || (bind(l, (const struct sockaddr *)addr, sizeof(*addr)) != 0) ||
+        (listen(l, 1) != 0) || (fcntl(l, F_SETFL, fcntl(l, F_GETFL) | O_NONBLOCK) != 0)) {
+        perror("listen");
+        exit(EXIT_FAILURE);
+    }
+    errno = 0;
+    if ((qt_accept(l, NULL, NULL) != -1) || ((errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+        fprintf(stderr, "qt_accept() on a non-blocking socket didn't fail with EAGAIN (%s)\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    close(l);
+    unlink(addr->sun_path);
+    return 0;
+}
+
+static aligned_t connector(void *arg)
+{
+    const struct sockaddr_un *addr = (const struct sockaddr_un *)arg;
+    size_t                    msg  = 1;
+    int                       s    = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    assert(s >= 0);
+    if (qt_connect(s, (const struct sockaddr *)addr, sizeof(*addr)) != 0) {
+        fprintf(stderr, "qt_connect() failed (%s)\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (qt_write(s, &msg, sizeof(msg)) != sizeof(msg)) {
+        fprintf(stderr, "qt_write() failed (%s)\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    close(s);
+    return 0;
+}
+
+/* each task owns block i of the scratch file */
+static aligned_t positional(void *arg)
+{
+    const size_t   i   = (uintptr_t)arg;
+    unsigned char *out = malloc(2 * BLOCK); /* qthread stacks are small */
+    unsigned char *in  = out + BLOCK;
+
+    assert(out);
+    memset(out, (int)(i & 0xff), BLOCK);
+    if (qt_pwrite(scratch, out, BLOCK, (off_t)(i * BLOCK)) != BLOCK) {
+        fprintf(stderr, "qt_pwrite() failed (%s)\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (qt_pread(scratch, in, BLOCK, (off_t)(i * BLOCK)) != BLOCK) {
+        fprintf(stderr, "qt_pread() failed (%s)\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (memcmp(in, out, BLOCK) != 0) {
+        fprintf(stderr, "block %lu read back wrong\n", (unsigned long)i);
+        exit(EXIT_FAILURE);
+    }
+    free(out);
+    return 0;
+}
+
+/* like a checkpoint writer: lots of small writes, end to end */
+static aligned_t chunk(void *arg)
+{
+    const size_t i = (uintptr_t)arg;
+    char         out[CHUNK], in[CHUNK];
+
+    memset(out, 'a' + (int)(i % 26), CHUNK);
+    if (qt_pwrite(scratch, out, CHUNK, (off_t)(i * CHUNK)) != CHUNK) {
+        fprintf(stderr, "qt_pwrite() failed (%s)\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (qt_pread(scratch, in, CHUNK, (off_t)(i * CHUNK)) != CHUNK) {
+        fprintf(stderr, "qt_pread() failed (%s)\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (memcmp(in, out, CHUNK) != 0) {
+        fprintf(stderr, "chunk %lu read back wrong\n", (unsigned long)i);
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
+
+static aligned_t user_defined(void *arg)
+{
+    aligned_t *counter = (aligned_t *)arg;
+
+    qt_begin_blocking_action();
+    usleep(1000);
+    qt_end_blocking_action();
+    (void)qthread_incr(counter, 1);
+    return 0;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t         *rets;
+    aligned_t          counter = 0;
+    char               path[]  = "/tmp/qt_syscallsXXXXXX";
+    struct sockaddr_un addr;
+
+    assert(qthread_initialize() == 0);
+    CHECK_VERBOSE();
+    NUMARG(pairs, "PAIRS");
+    NUMARG(messages, "MESSAGES");
+    NUMARG(sockets, "SOCKETS");
+    NUMARG(chunks, "CHUNKS");
+    iprintf("%i shepherds, %i threads\n", qthread_num_shepherds(), qthread_num_workers());
+
+    /* reads and writes that really block */
+    run_pairs(pairs, 0);
+    iprintf("pipe test succeeded\n");
+
+    /* more blocked socket reads than there are proxies */
+    run_pairs(sockets, 1);
+    iprintf("socket test succeeded\n");
+
+    /* as many blocked accepts, then as many connections */
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "/tmp/qt_syscalls%i", (int)getpid());
+    unlink(addr.sun_path);
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ((listener < 0) || (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+        (listen(listener, (int)sockets) != 0)) {
+        perror("listen");
+        exit(EXIT_FAILURE);
+    }
+    rets = calloc(sockets, sizeof(aligned_t));
+    assert(rets);
+    for (size_t i = 0; i < sockets; i++) {
+        assert(qthread_fork(acceptor, NULL, &rets[i]) == QTHREAD_SUCCESS);
+    }
+    for (size_t i = 0; i < sockets; i++) {
+        assert(qthread_fork(connector, &addr, NULL) == QTHREAD_SUCCESS);
+    }
+    for (size_t i = 0; i < sockets; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        assert(rets[i] == 2);
+    }
+    free(rets);
+    /* the listener is left the way it was found */
+    assert(!(fcntl(listener, F_GETFL) & O_NONBLOCK));
+    close(listener);
+    unlink(addr.sun_path);
+    iprintf("accept/connect test succeeded\n");
+
+    /* descriptors the program made non-blocking; the listener reuses the
+     * last one's descriptor */
+    rets = calloc(1, sizeof(aligned_t));
+    assert(rets);
+    assert(qthread_fork(nonblocking, &addr, rets) == QTHREAD_SUCCESS);
+    qthread_readFF(NULL, rets);
+    free(rets);
+    iprintf("non-blocking socket test succeeded\n");
+
+    /* positional I/O */
+    scratch = mkstemp(path);
+    if (scratch < 0) {
+        perror("mkstemp");
+        exit(EXIT_FAILURE);
+    }
+    unlink(path);
+    rets = calloc(pairs, sizeof(aligned_t));
+    assert(rets);
+    for (size_t i = 0; i < pairs; i++) {
+        assert(qthread_fork(positional, (void *)(uintptr_t)i, &rets[i]) == QTHREAD_SUCCESS);
+    }
+    for (size_t i = 0; i < pairs; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    free(rets);
+    iprintf("pread/pwrite test succeeded\n");
+
+    /* many small positional calls, which the proxies can merge */
+    if (ftruncate(scratch, 0) != 0) {
+        perror("ftruncate");
+        exit(EXIT_FAILURE);
+    }
+    rets = calloc(chunks, sizeof(aligned_t));
+    assert(rets);
+    for (size_t i = 0; i < chunks; i++) {
+        assert(qthread_fork(chunk, (void *)(uintptr_t)i, &rets[i]) == QTHREAD_SUCCESS);
+    }
+    for (size_t i = 0; i < chunks; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    free(rets);
+    for (size_t i = 0; i < chunks; i++) {
+        char in[CHUNK];
+
+        if ((pread(scratch, in, CHUNK, (off_t)(i * CHUNK)) != CHUNK) ||
+            (in[0] != 'a' + (int)(i % 26)) || (in[CHUNK - 1] != in[0])) {
+            fprintf(stderr, "chunk %lu was not written\n", (unsigned long)i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    close(scratch);
+    iprintf("small pread/pwrite test succeeded\n");
+
+    /* user-defined blocking actions run on the proxy threads */
+    rets = calloc(pairs, sizeof(aligned_t));
+    assert(rets);
+    for (size_t i = 0; i < pairs; i++) {
+        assert(qthread_fork(user_defined, &counter, &rets[i]) == QTHREAD_SUCCESS);
+    }
+    for (size_t i = 0; i < pairs; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    assert(counter == pairs);
+    free(rets);
+    iprintf("blocking action test succeeded\n");
+
+    return 0;
+}
+
+/* vim:set expandtab */
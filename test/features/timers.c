@@ -0,0 +1,191 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qtimer.h>
+#include <qthread/qt_syscalls.h>
+#include "argparsing.h"
+
+/* without timer wheels, sleepers yield until they are due, so there should
+ * not be too many of them */
+#ifdef QTHREAD_USE_TIMER_WHEEL
+static size_t sleepers = 1000;
+#else
+static size_t sleepers = 16;
+#endif
+static size_t values   = 200;
+
+static aligned_t sequence = 0;
+static aligned_t word     = 0;
+static aligned_t consumed = 0;
+static aligned_t sum      = 0;
+
+/* sleeps for up to 20 msecs, and checks that it slept at least that long */
+static aligned_t sleeper(void *arg)
+{
+    const useconds_t usecs = (useconds_t)((uintptr_t)arg % 20000);
+    const double     start = qtimer_wtime();
+
+    assert(qt_usleep(usecs) == 0);
+    assert(qtimer_wtime() - start >= usecs * 1e-6);
+    return 1;
+}
+
+typedef struct {
+    double   start;
+    uint64_t delay;
+} delayed_t;
+
+/* returns its place in the order the delayed tasks ran in */
+static aligned_t delayed(void *arg)
+{
+    delayed_t *d = (delayed_t *)arg;
+
+    assert(qtimer_wtime() - d->start >= d->delay * 1e-6);
+    return qthread_incr(&sequence, 1) + 1;
+}
+
+static aligned_t ticker(void *arg)
+{
+    aligned_t *ticks = (aligned_t *)arg;
+
+    return (++*ticks == 5) ? *ticks : 0;
+}
+
+/* fills word after a while */
+static aligned_t filler(void *arg)
+{
+    qthread_writeF_const(&word, 42);
+    return 0;
+}
+
+static aligned_t producer(void *arg)
+{
+    for (aligned_t i = 1; i <= values; i++) {
+        /* now and then, keep the consumers waiting long enough to give up */
+        if (i % 10 == 0) {
+            qt_usleep(500);
+        }
+        qthread_writeEF_const(&word, i);
+    }
+    return 0;
+}
+
+/* takes values from word, giving up every so often, until they are gone */
+static aligned_t consumer(void *arg)
+{
+    aligned_t timeouts = 0;
+
+    while (consumed < values) {
+        aligned_t v;
+
+        switch (qthread_readFE_timed(&v, &word, 100 + (uintptr_t)arg * 50)) {
+            case QTHREAD_SUCCESS:
+                qthread_incr(&sum, v);
+                qthread_incr(&consumed, 1);
+                break;
+            case QTHREAD_TIMEOUT:
+                timeouts++;
+                break;
+            default:
+                assert(0);
+        }
+    }
+    return timeouts;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t *rets;
+    aligned_t  ticks = 0;
+    aligned_t  v;
+    delayed_t  d[3];
+    double     start;
+
+    assert(qthread_initialize() == 0);
+    CHECK_VERBOSE();
+    NUMARG(sleepers, "SLEEPERS");
+    NUMARG(values, "VALUES");
+    iprintf("%i shepherds, %i threads\n", qthread_num_shepherds(), qthread_num_workers());
+
+    /* lots of sleeping tasks */
+    rets = calloc(sleepers, sizeof(aligned_t));
+    assert(rets);
+    for (size_t i = 0; i < sleepers; i++) {
+        assert(qthread_fork(sleeper, (void *)(uintptr_t)(i * 7919), &rets[i]) == QTHREAD_SUCCESS);
+    }
+    for (size_t i = 0; i < sleepers; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        assert(rets[i] == 1);
+    }
+    free(rets);
+    iprintf("sleep test succeeded\n");
+
+    /* delayed tasks run in the order they are due, and not before */
+    start = qtimer_wtime();
+    for (int i = 0; i < 3; i++) {
+        d[i].start = start;
+        d[i].delay = ((i + 1) % 3 + 1) * 20000;
+    }
+    rets = calloc(3, sizeof(aligned_t));
+    assert(rets);
+    for (int i = 0; i < 3; i++) {
+        assert(qthread_fork_after(delayed, &d[i], &rets[i], d[i].delay) == QTHREAD_SUCCESS);
+    }
+    for (int i = 0; i < 3; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        iprintf("task delayed by %lu usecs ran %luth\n", (unsigned long)d[i].delay, (unsigned long)rets[i]);
+        assert(rets[i] == d[i].delay / 20000);
+    }
+    free(rets);
+    iprintf("fork_after test succeeded\n");
+
+    /* a periodic task, until it says to stop */
+    start = qtimer_wtime();
+    assert(qthread_fork_every(ticker, &ticks, &v, 2000) == QTHREAD_SUCCESS);
+    qthread_readFF(NULL, &v);
+    assert(v == 5 && ticks == 5);
+    assert(qtimer_wtime() - start >= 5 * 2000e-6);
+    iprintf("fork_every test succeeded\n");
+
+    /* timed reads that time out, and that don't */
+    qthread_empty(&word);
+    start = qtimer_wtime();
+    assert(qthread_readFE_timed(&v, &word, 5000) == QTHREAD_TIMEOUT);
+    assert(qtimer_wtime() - start >= 5000e-6);
+    assert(qthread_readFF_timed(&v, &word, 0) == QTHREAD_TIMEOUT);
+    assert(qthread_feb_status(&word) == 0);
+    assert(qthread_fork_after(filler, NULL, NULL, 5000) == QTHREAD_SUCCESS);
+    assert(qthread_readFF_timed(&v, &word, 10000000) == QTHREAD_SUCCESS);
+    assert(v == 42 && qthread_feb_status(&word) == 1);
+    assert(qthread_readFE_timed(&v, &word, 1000) == QTHREAD_SUCCESS);
+    assert(v == 42 && qthread_feb_status(&word) == 0);
+    iprintf("timed read test succeeded\n");
+
+    /* consumers that keep timing out, racing a producer */
+    rets = calloc(8, sizeof(aligned_t));
+    assert(rets);
+    for (uintptr_t i = 0; i < 8; i++) {
+        assert(qthread_fork(consumer, (void *)i, &rets[i]) == QTHREAD_SUCCESS);
+    }
+    assert(qthread_fork(producer, NULL, NULL) == QTHREAD_SUCCESS);
+    v = 0;
+    for (int i = 0; i < 8; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        v += rets[i];
+    }
+    free(rets);
+    iprintf("%lu values consumed, %lu timeouts\n", (unsigned long)consumed, (unsigned long)v);
+    assert(consumed == values);
+    assert(sum == values * (values + 1) / 2);
+    assert(qthread_feb_status(&word) == 0);
+    iprintf("timed read race test succeeded\n");
+
+    return 0;
+}
+
+/* vim:set expandtab */